@@ -0,0 +1,134 @@
+/**
+ * @brief compare the precedence climbing with the recursive descent of one function per
+ * precedence level on expression-heavy inputs. both have to make the same AST
+ */
+#include <cpplox/debug.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static constexpr size_t Iteration = 5;
+
+static auto repeat(const std::string & str, const size_t n) -> std::string
+{
+  std::string result;
+  result.reserve(str.size() * n);
+  for (size_t i = 0; i < n; ++i) {
+    result += str;
+  }
+  return result;
+}
+
+/**
+ * @brief var a = x;var a = y; ... with operands only, where every level is passed through
+ */
+static auto operands(const size_t n) -> std::string
+{
+  return repeat("var a = x;\nvar b = f(y, 1);\nvar c = o.p;\n", n);
+}
+
+/**
+ * @brief var a = 1 + 2 * 3 - 4 / 5 < 6 == true and ... with all the operators
+ */
+static auto mixed_operators(const size_t n) -> std::string
+{
+  return repeat(
+    "var a = 1 + 2 * 3 - 4 / 5 < 6 == true and x >= -y or !z != nil and w <= 7 * (8 - v);\n", n);
+}
+
+/**
+ * @brief var a = 1 + (2 * (3 - (4 / (...))));
+ */
+static auto nested_group(const size_t depth) -> std::string
+{
+  std::string source = "var a = ";
+  for (size_t i = 0; i < depth; ++i) {
+    source += std::to_string(i) + (i % 2 == 0 ? " + (" : " * (");
+  }
+  return source + "1" + repeat(")", depth) + ";";
+}
+
+static auto parse(const lox::Tokens & tokens, const bool recursive_descent)
+  -> std::variant<lox::Program, lox::SyntaxError>
+{
+  lox::Tokens copied = tokens;
+  auto parser = lox::Parser(std::move(copied));
+  parser.use_recursive_descent(recursive_descent);
+  return parser.program();
+}
+
+static auto measure(const char * name, const lox::Tokens & tokens, const bool recursive_descent)
+  -> double
+{
+  double elapsed = 0.0;
+  for (size_t i = 0; i < Iteration; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto program = parse(tokens, recursive_descent);
+    const auto end = std::chrono::steady_clock::now();
+    if (!lox::is_variant_v<lox::Program>(program)) {
+      std::printf("%s: failed to parse\n", name);
+      std::exit(1);
+    }
+    elapsed += std::chrono::duration<double, std::milli>(end - start).count();
+  }
+  return elapsed / Iteration;
+}
+
+/**
+ * @brief the initializers of all the variable declarations in lisp notation
+ */
+static auto dump(const lox::Program & program) -> std::string
+{
+  std::string result;
+  for (const auto & declaration : program.declarations) {
+    result += lox::to_lisp_repr(boost::get<lox::VarDecl>(declaration).initializer.value());
+    result += '\n';
+  }
+  return result;
+}
+
+static auto run(const char * name, const std::string & source) -> void
+{
+  auto tokenizer = lox::Tokenizer(source);
+  const auto tokens_result = tokenizer.take_tokens();
+  if (!lox::is_variant_v<lox::Tokens>(tokens_result)) {
+    std::printf("%s: failed to tokenize\n", name);
+    std::exit(1);
+  }
+  const auto & tokens = lox::as_variant<lox::Tokens>(tokens_result);
+
+  const auto expected = parse(tokens, true);
+  const auto result = parse(tokens, false);
+  if (
+    dump(lox::as_variant<lox::Program>(expected)) != dump(lox::as_variant<lox::Program>(result))) {
+    std::printf("%s: the ASTs differ\n", name);
+    std::exit(1);
+  }
+
+  const auto descent = measure(name, tokens, true);
+  const auto climbing = measure(name, tokens, false);
+  std::printf(
+    "%-24s tokens = %8zu, descent = %8.3f [ms] (%6.1f [ns/token]), climbing = %8.3f [ms] "
+    "(%6.1f [ns/token]), x%.2f\n",
+    name, tokens.size(), descent, descent * 1e6 / tokens.size(), climbing,
+    climbing * 1e6 / tokens.size(), descent / climbing);
+}
+
+int main()
+{
+  for (const size_t n : {1000, 10000, 100000}) {
+    run(("operands(" + std::to_string(n) + ")").c_str(), operands(n));
+  }
+  for (const size_t n : {1000, 10000, 100000}) {
+    run(("mixed_operators(" + std::to_string(n) + ")").c_str(), mixed_operators(n));
+  }
+  for (const size_t depth : {250, 1000}) {
+    run(("nested_group(" + std::to_string(depth) + ")").c_str(), nested_group(depth));
+  }
+  return 0;
+}
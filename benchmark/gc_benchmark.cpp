@@ -0,0 +1,131 @@
+/**
+ * @brief compare the allocation of the closures, the classes and the instances in the nursery
+ * with their allocation by `new` on allocation-heavy scripts. both have to give the same result
+ */
+#include <cpplox/interpreter.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static constexpr size_t Iteration = 5;
+
+/**
+ * @brief `body` run n * 1000 times, where `i` is the counter
+ */
+static auto loop(const std::string & prelude, const std::string & body, const size_t n)
+  -> std::string
+{
+  return prelude + "var result = 0;\nfor (var j = 0; j < " + std::to_string(n) +
+         "; j = j + 1) {\n  for (var i = 0; i < 1000; i = i + 1) {\n" + body + "  }\n}\n";
+}
+
+/**
+ * @brief nested blocks and if-clauses, whose variables are placed in the frame as they are not
+ * captured
+ */
+static auto blocks(const size_t n) -> std::string
+{
+  return loop(
+    "",
+    "    { var a = i; { var b = a + 1; if (var c = b * 2; c > 0) { result = result + 1; } } }\n",
+    n);
+}
+
+/**
+ * @brief calls of a small function, whose parameters are placed in the frame
+ */
+static auto calls(const size_t n) -> std::string
+{
+  return loop(
+    "fun add(a, b) { return a + b; }\n", "    result = add(result, add(i, 1)) - i;\n", n);
+}
+
+/**
+ * @brief closures which capture a parameter of their call
+ */
+static auto closures(const size_t n) -> std::string
+{
+  return loop(
+    "fun make(n) {\n  fun get() { return n; }\n  return get;\n}\n",
+    "    var f = make(i);\n    result = result + f() - i + 1;\n", n);
+}
+
+/**
+ * @brief instances with a few fields
+ */
+static auto instances(const size_t n) -> std::string
+{
+  return loop(
+    "class Point {}\n",
+    "    var p = Point();\n    p.x = i;\n    p.y = 1;\n    result = result + p.y;\n", n);
+}
+
+static auto execute(const char * name, const lox::Program & program, const size_t nursery_size)
+  -> std::pair<int64_t, lox::HeapStats>
+{
+  lox::Interpreter interpreter(lox::Heap::DefaultThreshold, nursery_size);
+  if (interpreter.execute(program)) {
+    std::printf("%s: failed to execute\n", name);
+    std::exit(1);
+  }
+  const auto result =
+    interpreter.get_variable(lox::Token(lox::TokenType::Identifier, std::string_view("result"), 0));
+  return {lox::as_variant<int64_t>(result.value()), interpreter.heap_stats()};
+}
+
+static auto measure(const char * name, const lox::Program & program, const size_t nursery_size)
+  -> double
+{
+  double elapsed = 0.0;
+  for (size_t i = 0; i < Iteration; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    execute(name, program, nursery_size);
+    const auto end = std::chrono::steady_clock::now();
+    elapsed += std::chrono::duration<double, std::milli>(end - start).count();
+  }
+  return elapsed / Iteration;
+}
+
+static auto run(const char * name, const std::string & source) -> void
+{
+  auto parser = lox::Parser(lox::TokenStream(source));
+  auto program_result = parser.program();
+  if (!lox::is_variant_v<lox::Program>(program_result)) {
+    std::printf("%s: failed to parse\n", name);
+    std::exit(1);
+  }
+  const auto & program = lox::as_variant<lox::Program>(program_result);
+
+  const auto [expected, malloc_stats] = execute(name, program, 0);
+  const auto [result, nursery_stats] = execute(name, program, lox::Heap::DefaultNurserySize);
+  if (expected != result) {
+    std::printf("%s: the results differ\n", name);
+    std::exit(1);
+  }
+
+  const auto malloc_path = measure(name, program, 0);
+  const auto nursery = measure(name, program, lox::Heap::DefaultNurserySize);
+  std::printf(
+    "%-16s objects = %9zu, new = %9.3f [ms] (%3zu collections), nursery = %9.3f [ms] "
+    "(%5zu minor, %3zu major, %7zu promoted), x%.2f\n",
+    name, nursery_stats.allocated, malloc_path, malloc_stats.collections, nursery,
+    nursery_stats.minor_collections,
+    nursery_stats.collections - nursery_stats.minor_collections, nursery_stats.promoted,
+    malloc_path / nursery);
+}
+
+int main()
+{
+  for (const size_t n : {10, 100}) {
+    run(("blocks(" + std::to_string(n) + ")").c_str(), blocks(n));
+    run(("calls(" + std::to_string(n) + ")").c_str(), calls(n));
+    run(("closures(" + std::to_string(n) + ")").c_str(), closures(n));
+    run(("instances(" + std::to_string(n) + ")").c_str(), instances(n));
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * @brief measure the parse time of deeply nested expressions/blocks and of large generated files.
+ * the parser is linear if the time per token stays flat while the input grows
+ */
+#include <cpplox/parser.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+static size_t allocation_count = 0;
+
+void * operator new(size_t size)
+{
+  allocation_count++;
+  if (void * ptr = std::malloc(size); ptr) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+static constexpr size_t Iteration = 5;
+
+static auto repeat(const std::string & str, const size_t n) -> std::string
+{
+  std::string result;
+  result.reserve(str.size() * n);
+  for (size_t i = 0; i < n; ++i) {
+    result += str;
+  }
+  return result;
+}
+
+/**
+ * @brief var a = ((((1))));
+ */
+static auto nested_group(const size_t depth) -> std::string
+{
+  return "var a = " + repeat("(", depth) + "1" + repeat(")", depth) + ";";
+}
+
+/**
+ * @brief var a = 1 + (1 + (1 + (1 + 1)));
+ */
+static auto nested_binary(const size_t depth) -> std::string
+{
+  return "var a = " + repeat("1 + (", depth) + "1" + repeat(")", depth) + ";";
+}
+
+/**
+ * @brief { { { var a = 1; } } }
+ */
+static auto nested_block(const size_t depth) -> std::string
+{
+  return repeat("{ ", depth) + "var a = 1;" + repeat(" }", depth);
+}
+
+/**
+ * @brief many small functions with loops, branches and calls
+ */
+static auto generated_file(const size_t n_functions) -> std::string
+{
+  std::string source;
+  for (size_t i = 0; i < n_functions; ++i) {
+    const auto name = "f" + std::to_string(i);
+    source += "fun " + name + "(a, b) {\n";
+    source += "  var sum = 0;\n";
+    source += "  for (var i = 0; i < a; i = i + 1) {\n";
+    source += "    if (i == b) { sum = sum + i * 2; }\n";
+    source += "    else if (i > b) { break; } else { continue; }\n";
+    source += "  }\n";
+    source += "  while (sum > 100) { sum = sum - (a + b) / 2; }\n";
+    source += "  return sum + \"" + name + "\".len;\n";
+    source += "}\n";
+    source += "print " + name + "(" + std::to_string(i) + ", 3);\n";
+  }
+  return source;
+}
+
+static auto run(const char * name, const std::string & source) -> void
+{
+  auto tokenizer = lox::Tokenizer(source);
+  const auto tokens_result = tokenizer.take_tokens();
+  if (!lox::is_variant_v<lox::Tokens>(tokens_result)) {
+    std::printf("%s: failed to tokenize\n", name);
+    std::exit(1);
+  }
+  const auto & tokens = lox::as_variant<lox::Tokens>(tokens_result);
+
+  double elapsed = 0.0;
+  size_t allocations = 0;
+  for (size_t i = 0; i < Iteration; ++i) {
+    lox::Tokens copied = tokens;
+    const auto start_count = allocation_count;
+    const auto start = std::chrono::steady_clock::now();
+    auto parser = lox::Parser(std::move(copied));
+    const auto program = parser.program();
+    const auto end = std::chrono::steady_clock::now();
+    allocations = allocation_count - start_count;
+    if (!lox::is_variant_v<lox::Program>(program)) {
+      std::printf("%s: failed to parse\n", name);
+      std::exit(1);
+    }
+    elapsed += std::chrono::duration<double, std::milli>(end - start).count();
+  }
+  elapsed /= Iteration;
+  std::printf(
+    "%-24s tokens = %8zu, parse = %9.3f [ms], %7.1f [ns/token], %5.2f [alloc/token]\n", name,
+    tokens.size(), elapsed, elapsed * 1e6 / tokens.size(),
+    static_cast<double>(allocations) / tokens.size());
+}
+
+int main()
+{
+  for (const size_t depth : {125, 250, 500, 1000}) {
+    run(("nested_group(" + std::to_string(depth) + ")").c_str(), nested_group(depth));
+  }
+  for (const size_t depth : {125, 250, 500, 1000}) {
+    run(("nested_binary(" + std::to_string(depth) + ")").c_str(), nested_binary(depth));
+  }
+  for (const size_t depth : {125, 250, 500, 1000}) {
+    run(("nested_block(" + std::to_string(depth) + ")").c_str(), nested_block(depth));
+  }
+  for (const size_t n : {1000, 4000, 16000}) {
+    run(("generated_file(" + std::to_string(n) + ")").c_str(), generated_file(n));
+  }
+  return 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * @brief measure the time from opening a script to the resolved program, either by parsing the
+ * script (cold), by pre-parsing the function bodies (lazy) or by loading it from the cache (hit)
+ */
+#include <cpplox/cache.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/resolver.hpp>
+#include <cpplox/source.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+static constexpr size_t Iteration = 5;
+
+/**
+ * @brief many small functions with loops, branches and calls
+ */
+static auto generated_file(const size_t n_functions) -> std::string
+{
+  std::string source;
+  for (size_t i = 0; i < n_functions; ++i) {
+    const auto name = "f" + std::to_string(i);
+    source += "fun " + name + "(a, b) {\n";
+    source += "  var sum = 0;\n";
+    source += "  for (var i = 0; i < a; i = i + 1) {\n";
+    source += "    if (i == b) { sum = sum + i * 2; }\n";
+    source += "    else if (i > b) { break; } else { continue; }\n";
+    source += "  }\n";
+    source += "  while (sum > 100) { sum = sum - (a + b) / 2; }\n";
+    source += "  return sum + \"" + name + "\".len;\n";
+    source += "}\n";
+    source += "print " + name + "(" + std::to_string(i) + ", 3);\n";
+  }
+  return source;
+}
+
+static auto fail(const char * name, const char * what) -> void
+{
+  std::printf("%s: failed to %s\n", name, what);
+  std::exit(1);
+}
+
+/**
+ * @brief tokenize, parse and resolve the script
+ */
+static auto cold_start(
+  const char * name, const std::string_view source,
+  const lox::ParseMode mode = lox::ParseMode::Eager) -> lox::Program
+{
+  auto parser = lox::Parser(lox::TokenStream(source), mode);
+  auto program_result = parser.program();
+  if (!lox::is_variant_v<lox::Program>(program_result)) {
+    fail(name, "parse");
+  }
+  auto & program = lox::as_variant_mut<lox::Program>(program_result);
+  lox::Scope globals;
+  if (lox::resolve_program(program, globals)) {
+    fail(name, "resolve");
+  }
+  program.resolved_globals = lox::to_global_slots(globals);
+  return std::move(program);
+}
+
+/**
+ * @brief open the script, load its cache and restore the global variables
+ */
+static auto cache_hit(const char * name, const std::string & path, const std::string & cache_path)
+  -> lox::Program
+{
+  const auto buffer = lox::SourceBuffer::open(path);
+  auto program = lox::load_cache(cache_path, buffer->view(), lox::ParseMode::Eager);
+  if (!program) {
+    fail(name, "load the cache");
+  }
+  lox::Scope globals;
+  if (lox::resolve_program(program.value(), globals)) {
+    fail(name, "resolve");
+  }
+  return std::move(program.value());
+}
+
+template <typename Func>
+static auto measure(Func && func) -> double
+{
+  double elapsed = 0.0;
+  for (size_t i = 0; i < Iteration; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto program = func();
+    const auto end = std::chrono::steady_clock::now();
+    elapsed += std::chrono::duration<double, std::milli>(end - start).count();
+  }
+  return elapsed / Iteration;
+}
+
+static auto run(const char * name, const std::string & source) -> void
+{
+  const std::string path = "/tmp/startup_benchmark.lox";
+  const auto cache_path = lox::cache_path_of(path, source, std::nullopt);
+  std::ofstream(path, std::ios::binary) << source;
+
+  const auto cold = measure([&]() {
+    const auto buffer = lox::SourceBuffer::open(path);
+    return cold_start(name, buffer->view());
+  });
+  const auto lazy = measure([&]() {
+    const auto buffer = lox::SourceBuffer::open(path);
+    return cold_start(name, buffer->view(), lox::ParseMode::Lazy);
+  });
+  const auto arena_size = [&](const lox::ParseMode mode) {
+    return cold_start(name, source, mode).arena->reserved_bytes() / 1024;
+  };
+  {
+    const auto buffer = lox::SourceBuffer::open(path);
+    const auto program = cold_start(name, buffer->view());
+    if (!lox::save_cache(cache_path, program, buffer->view(), lox::ParseMode::Eager)) {
+      fail(name, "save the cache");
+    }
+  }
+  const auto hit = measure([&]() { return cache_hit(name, path, cache_path); });
+  std::ifstream cache(cache_path, std::ios::binary | std::ios::ate);
+  std::printf(
+    "%-22s source = %7zu [KiB], cache = %8zu [KiB], arena = %7zu / %6zu [KiB] (eager / lazy)\n",
+    name, source.size() / 1024, static_cast<size_t>(cache.tellg()) / 1024,
+    arena_size(lox::ParseMode::Eager), arena_size(lox::ParseMode::Lazy));
+  std::printf(
+    "%-22s cold = %9.3f [ms], lazy = %9.3f [ms] (x%.2f), hit = %9.3f [ms] (x%.2f)\n", "", cold,
+    lazy, cold / lazy, hit, cold / hit);
+  std::remove(path.c_str());
+  std::remove(cache_path.c_str());
+}
+
+int main()
+{
+  for (const size_t n : {100, 1000, 4000, 16000}) {
+    run(("generated_file(" + std::to_string(n) + ")").c_str(), generated_file(n));
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * @brief compare the peak heap usage and the time of parsing a large generated file from the
+ * vector of all the tokens and from the TokenStream which scans the tokens on demand
+ */
+#include <cpplox/parser.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+static size_t live_bytes = 0;
+static size_t peak_bytes = 0;
+
+// NOTE: the size of each block is kept in front of it so that operator delete knows it
+static constexpr size_t Header = alignof(std::max_align_t);
+
+void * operator new(size_t size)
+{
+  if (auto * ptr = static_cast<char *>(std::malloc(size + Header)); ptr) {
+    *reinterpret_cast<size_t *>(ptr) = size;
+    live_bytes += size;
+    peak_bytes = std::max(peak_bytes, live_bytes);
+    return ptr + Header;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept
+{
+  if (ptr) {
+    auto * block = static_cast<char *>(ptr) - Header;
+    live_bytes -= *reinterpret_cast<size_t *>(block);
+    std::free(block);
+  }
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+static constexpr size_t Iteration = 5;
+
+/**
+ * @brief many small functions with loops, branches and calls
+ */
+static auto generated_file(const size_t n_functions) -> std::string
+{
+  std::string source;
+  for (size_t i = 0; i < n_functions; ++i) {
+    const auto name = "f" + std::to_string(i);
+    source += "fun " + name + "(a, b) {\n";
+    source += "  var sum = 0;\n";
+    source += "  for (var i = 0; i < a; i = i + 1) {\n";
+    source += "    if (i == b) { sum = sum + i * 2; }\n";
+    source += "    else if (i > b) { break; } else { continue; }\n";
+    source += "  }\n";
+    source += "  while (sum > 100) { sum = sum - (a + b) / 2; }\n";
+    source += "  return sum + \"" + name + "\".len;\n";
+    source += "}\n";
+    source += "print " + name + "(" + std::to_string(i) + ", 3);\n";
+  }
+  return source;
+}
+
+/**
+ * @brief tokenize the whole source first, and then parse it
+ */
+static auto parse_vector(const std::string & source) -> std::variant<lox::Program, lox::SyntaxError>
+{
+  auto tokenizer = lox::Tokenizer(source);
+  auto tokens = tokenizer.take_tokens();
+  if (lox::is_variant_v<lox::SyntaxError>(tokens)) {
+    return lox::as_variant<lox::SyntaxError>(tokens);
+  }
+  auto parser = lox::Parser(std::move(lox::as_variant_mut<lox::Tokens>(tokens)));
+  return parser.program();
+}
+
+/**
+ * @brief parse the tokens scanned on demand
+ */
+static auto parse_stream(const std::string & source) -> std::variant<lox::Program, lox::SyntaxError>
+{
+  auto parser = lox::Parser(lox::TokenStream(source));
+  return parser.program();
+}
+
+template <typename Parse>
+static auto measure(const std::string & source, Parse parse, double & elapsed) -> size_t
+{
+  elapsed = 1e100;
+  size_t peak = 0;
+  for (size_t i = 0; i < Iteration; ++i) {
+    const auto base_bytes = live_bytes;
+    peak_bytes = live_bytes;
+    const auto start = std::chrono::steady_clock::now();
+    const auto program = parse(source);
+    const auto end = std::chrono::steady_clock::now();
+    if (!lox::is_variant_v<lox::Program>(program)) {
+      std::printf("failed to parse\n");
+      std::exit(1);
+    }
+    peak = peak_bytes - base_bytes;
+    elapsed = std::min(elapsed, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return peak;
+}
+
+int main()
+{
+  for (const size_t n : {1000, 10000, 50000}) {
+    const auto source = generated_file(n);
+    double vector_ms = 0.0;
+    double stream_ms = 0.0;
+    const auto vector_peak = measure(source, parse_vector, vector_ms);
+    const auto stream_peak = measure(source, parse_stream, stream_ms);
+    std::printf(
+      "generated_file(%5zu) source = %6.2f [MB], peak: vector = %7.2f [MB], stream = %7.2f [MB], "
+      "time: vector = %8.3f [ms], stream = %8.3f [ms]\n",
+      n, static_cast<double>(source.size()) / 1e6, static_cast<double>(vector_peak) / 1e6,
+      static_cast<double>(stream_peak) / 1e6, vector_ms, stream_ms);
+  }
+  return 0;
+}
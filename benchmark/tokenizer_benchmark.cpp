@@ -0,0 +1,96 @@
+/**
+ * @brief measure the throughput of the tokenizer in MB/s on large generated sources, sequentially
+ * and on multiple threads
+ */
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static constexpr size_t Iteration = 5;
+
+/**
+ * @brief many small functions with loops, branches and calls
+ */
+static auto generated_file(const size_t n_functions) -> std::string
+{
+  std::string source;
+  for (size_t i = 0; i < n_functions; ++i) {
+    const auto name = "function_" + std::to_string(i);
+    source += "// " + name + " sums up the values below the limit\n";
+    source += "fun " + name + "(limit, threshold) {\n";
+    source += "  var accumulated_sum = 0;\n";
+    source += "  for (var index = 0; index < limit; index = index + 1) {\n";
+    source += "    if (index == threshold) { accumulated_sum = accumulated_sum + index * 2; }\n";
+    source += "    else if (index > threshold) { break; } else { continue; }\n";
+    source += "  }\n";
+    source += "  while (accumulated_sum >= 100.5) {\n";
+    source += "    accumulated_sum = accumulated_sum - (limit + threshold) / 2;\n";
+    source += "  }\n";
+    source += "  return accumulated_sum + \"" + name + "\".len;\n";
+    source += "}\n\n";
+    source += "print " + name + "(" + std::to_string(i) + ", 3);\n";
+  }
+  return source;
+}
+
+/**
+ * @brief deeply indented code with long comments
+ */
+static auto indented_file(const size_t n_lines) -> std::string
+{
+  std::string source;
+  for (size_t i = 0; i < n_lines; ++i) {
+    source += std::string(4 * (i % 8), ' ');
+    if (i % 3 == 0) {
+      source += "// the quick brown fox jumps over the lazy dog, " + std::to_string(i) + "\n";
+    } else {
+      source += "var variable_" + std::to_string(i) + " = \"some string literal\";\n";
+    }
+  }
+  return source;
+}
+
+/**
+ * @param n_threads 1 for Tokenizer::take_tokens(), otherwise for take_tokens_parallel()
+ */
+static auto run(const std::string & label, const std::string & source, const size_t n_threads)
+  -> void
+{
+  const auto name = label + ", threads = " + std::to_string(n_threads);
+  double best = 1e100;
+  size_t n_tokens = 0;
+  for (size_t i = 0; i < Iteration; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = (n_threads == 1) ? lox::Tokenizer(source).take_tokens()
+                                         : lox::take_tokens_parallel(source, n_threads);
+    const auto end = std::chrono::steady_clock::now();
+    if (!lox::is_variant_v<lox::Tokens>(result)) {
+      std::printf("%s: failed to tokenize\n", name.c_str());
+      std::exit(1);
+    }
+    n_tokens = lox::as_variant<lox::Tokens>(result).size();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  std::printf(
+    "%-36s size = %7.2f [MB], tokens = %8zu, %8.3f [ms], %7.1f [MB/s]\n", name.c_str(),
+    static_cast<double>(source.size()) / 1e6, n_tokens, best * 1e3,
+    static_cast<double>(source.size()) / 1e6 / best);
+}
+
+int main()
+{
+  for (const size_t n_threads : {1, 2, 4, 8}) {
+    for (const size_t n : {1000, 10000, 50000}) {
+      run("generated_file(" + std::to_string(n) + ")", generated_file(n), n_threads);
+    }
+    for (const size_t n : {10000, 100000, 500000}) {
+      run("indented_file(" + std::to_string(n) + ")", indented_file(n), n_threads);
+    }
+  }
+  return 0;
+}
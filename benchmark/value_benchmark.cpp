@@ -0,0 +1,115 @@
+/**
+ * @brief compare the memory footprint and the copy throughput of lox::Value, which is the variant
+ * used by the tree-walking interpreter, and lox::vm::Value, which is the 16-byte tagged union used
+ * by the virtual machine
+ */
+#include <cpplox/expression.hpp>
+#include <cpplox/object.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+static size_t allocated_bytes = 0;
+
+void * operator new(size_t size)
+{
+  allocated_bytes += size;
+  if (void * ptr = std::malloc(size); ptr) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+static constexpr size_t N = 1'000'000;
+static constexpr size_t Iteration = 20;
+static const std::string text = "a string which does not fit in the small buffer";
+
+/**
+ * @brief the values which are copied like the reads of variables
+ */
+static auto make_tree_prototypes() -> std::vector<lox::Value>
+{
+  return {lox::Nil{}, true, int64_t{42}, 3.14, lox::String(text)};
+}
+
+static auto make_vm_prototypes() -> std::vector<lox::vm::Value>
+{
+  return {
+    lox::vm::Value{}, lox::vm::Value{true}, lox::vm::Value{int64_t{42}}, lox::vm::Value{3.14},
+    lox::vm::make_object<lox::vm::StringObject>(lox::String(text))};
+}
+
+static auto sum(const std::vector<lox::Value> & values) -> double
+{
+  double acc = 0.0;
+  for (const auto & value : values) {
+    if (lox::is_variant_v<int64_t>(value)) {
+      acc += lox::as_variant<int64_t>(value);
+    } else if (lox::is_variant_v<double>(value)) {
+      acc += lox::as_variant<double>(value);
+    }
+  }
+  return acc;
+}
+
+static auto sum(const std::vector<lox::vm::Value> & values) -> double
+{
+  double acc = 0.0;
+  for (const auto & value : values) {
+    if (value.is_numeric()) {
+      acc += value.to_double();
+    }
+  }
+  return acc;
+}
+
+template <typename ValueT>
+static auto run(const char * name, const std::vector<ValueT> & prototypes) -> void
+{
+  // memory: fill a vector by copying the prototypes
+  const auto before = allocated_bytes;
+  std::vector<ValueT> values;
+  values.reserve(N);
+  for (size_t i = 0; i < N; ++i) {
+    values.push_back(prototypes[i % prototypes.size()]);
+  }
+  const auto memory = allocated_bytes - before;
+
+  // throughput: copy the whole vector and read the numeric values, like pushing operands
+  double checksum = 0.0;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < Iteration; ++i) {
+    const std::vector<ValueT> copied = values;
+    checksum += sum(copied);
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const auto elapsed = std::chrono::duration<double, std::nano>(end - start).count();
+
+  std::printf(
+    "%-14s sizeof = %2zu [byte], memory = %8.2f [MB] for %zu values, copy+read = %6.2f [ns/value] "
+    "(checksum %.1f)\n",
+    name, sizeof(ValueT), static_cast<double>(memory) / 1e6, N, elapsed / (N * Iteration),
+    checksum);
+}
+
+int main()
+{
+  run("lox::Value", make_tree_prototypes());
+  run("lox::vm::Value", make_vm_prototypes());
+  return 0;
+}
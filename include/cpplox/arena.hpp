@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lox
+{
+
+inline namespace arena
+{
+
+/**
+ * @brief a non-owning reference to a node allocated in an Arena. it is implicitly converted to
+ * `const T &`, so boost::static_visitor which takes `const T &` can visit it directly
+ */
+template <typename T>
+class Ref
+{
+public:
+  explicit Ref(const T * node) noexcept : node_(node) {}
+
+  operator const T &() const noexcept { return *node_; }
+
+  auto get() const noexcept -> const T & { return *node_; }
+
+  auto operator->() const noexcept -> const T * { return node_; }
+
+private:
+  const T * node_;
+};
+
+/**
+ * @brief the storage of the nodes of a program. the nodes are placed contiguously in large chunks
+ * in the order of the construction, and they are released all at once with the Arena
+ */
+class Arena
+{
+public:
+  Arena() = default;
+
+  Arena(const Arena &) = delete;
+
+  auto operator=(const Arena &) -> Arena & = delete;
+
+  ~Arena();
+
+  /**
+   * @brief construct a new node as `T{args...}`
+   */
+  template <typename T, typename... Args>
+  auto make(Args &&... args) -> Ref<T>
+  {
+    void * storage = allocate(sizeof(T), alignof(T));
+    const T * node = new (storage) T{std::forward<Args>(args)...};
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      destructors_.emplace_back(storage, [](void * ptr) { static_cast<T *>(ptr)->~T(); });
+    }
+    return Ref<T>(node);
+  }
+
+  /**
+   * @brief the number of the bytes reserved for the nodes
+   */
+  auto reserved_bytes() const noexcept -> size_t { return reserved_bytes_; }
+
+private:
+  static constexpr size_t ChunkSize = 16 * 1024;
+
+  auto allocate(const size_t size, const size_t align) -> void *;
+
+  std::vector<std::unique_ptr<std::byte[]>> chunks_;
+  size_t offset_{0};    //!< the offset of the next node in chunks_.back()
+  size_t capacity_{0};  //!< the size of chunks_.back()
+  size_t reserved_bytes_{0};
+  std::vector<std::pair<void *, void (*)(void *)>> destructors_;
+};
+
+}  // namespace arena
+}  // namespace lox
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cpplox/parser.hpp>
+#include <cpplox/statement.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace lox
+{
+
+inline namespace cache
+{
+
+/**
+ * @brief the version of the format of the cache. increment this whenever the nodes, the
+ * annotations of the resolver or the encoding change, so that the old caches are ignored
+ */
+static constexpr uint32_t CacheVersion = 5;
+
+/**
+ * @brief the 64-bit FNV-1a hash of `data`, which keys the cache by the content of the source
+ */
+auto content_hash(const std::string_view data) noexcept -> uint64_t;
+
+/**
+ * @brief encode a resolved program. each token is saved as its position on `source`, and the
+ * literals are saved as their values
+ * @param mode the mode by which `program` is parsed
+ * @pre `program.resolved_globals` is set, and the tokens of `program` refer to `source`
+ */
+auto serialize_program(const Program & program, const std::string_view source, const ParseMode mode)
+  -> std::string;
+
+/**
+ * @brief decode a program so that its tokens refer to `source`
+ * @return nullopt if `data` is broken, or is not the cache of `source` parsed by `mode` of the
+ * current version. a lazy program is not loaded in the eager mode, where the syntax errors of the
+ * bodies which are never called have to be reported, and vice versa
+ */
+auto deserialize_program(
+  const std::string_view data, const std::string_view source, const ParseMode mode)
+  -> std::optional<Program>;
+
+/**
+ * @brief the path of the cache of the script at `path`. it is "<path>c" next to the script if
+ * `cache_dir` is null, otherwise it is named by the hash of `source` under `cache_dir`
+ */
+auto cache_path_of(
+  const std::string & path, const std::string_view source,
+  const std::optional<std::string> & cache_dir) -> std::string;
+
+/**
+ * @brief load the program of `source` parsed by `mode` from the cache file at `cache_path`
+ * @return nullopt if there is no valid cache
+ */
+auto load_cache(const std::string & cache_path, const std::string_view source, const ParseMode mode)
+  -> std::optional<Program>;
+
+/**
+ * @brief write the cache of a resolved program to `cache_path`. the file is replaced atomically,
+ * so a concurrent run never reads a partially written cache
+ * @return false if the file could not be written
+ */
+auto save_cache(
+  const std::string & cache_path, const Program & program, const std::string_view source,
+  const ParseMode mode) -> bool;
+
+}  // namespace cache
+}  // namespace lox
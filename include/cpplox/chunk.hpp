@@ -0,0 +1,137 @@
+#pragma once
+#include <cpplox/expression.hpp>
+#include <cpplox/object.hpp>
+#include <cpplox/statement.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace lox
+{
+
+namespace vm
+{
+
+// clang-format off
+enum class OpCode : uint8_t {
+  Constant,      //!< [u32 constant]        push constants[constant]
+  Nil,           //!<                       push nil
+  True,          //!<                       push true
+  False,         //!<                       push false
+  Pop,           //!<                       discard the top
+  GetLocal,      //!< [u16 slot]            push frame[slot]
+  SetLocal,      //!< [u16 slot]            frame[slot] = top (top is kept)
+  GetUpvalue,    //!< [u16 index]           push upvalues[index]
+  SetUpvalue,    //!< [u16 index]           upvalues[index] = top (top is kept)
+  DefineGlobal,  //!< [u32 global]          globals[global] = pop
+  GetGlobal,     //!< [u32 global][u32 site] push globals[global]
+  SetGlobal,     //!< [u32 global][u32 site] globals[global] = top (top is kept)
+  Undefined,     //!< [u32 site]            raise UndefinedVariableError for unresolved variable
+  GetProperty,   //!< [u32 site]            replace the instance on top with its property
+  SetProperty,   //!< [u32 site]            instance.prop = value, leaving value on top
+  Equal,         //!<                       a == b
+  NotEqual,      //!<                       a != b
+  Greater,       //!< [u32 site]            a > b
+  GreaterEqual,  //!< [u32 site]            a >= b
+  Less,          //!< [u32 site]            a < b
+  LessEqual,     //!< [u32 site]            a <= b
+  Add,           //!< [u32 site]            a + b
+  Subtract,      //!< [u32 site]            a - b
+  Multiply,      //!< [u32 site]            a * b
+  Divide,        //!< [u32 site]            a / b
+  Not,           //!<                       !a
+  Negate,        //!< [u32 site]            -a
+  Truthy,        //!<                       replace the top with its truthiness
+  Print,         //!<                       print pop
+  Jump,          //!< [u32 offset]          ip += offset
+  JumpIfFalse,   //!< [u32 offset]          if !truthy(pop) then ip += offset
+  JumpIfTrue,    //!< [u32 offset]          if truthy(pop) then ip += offset
+  Loop,          //!< [u32 offset]          ip -= offset
+  LoopGuard,     //!< [u16 slot][u32 site]  increment the loop counter and check MaxLoopError
+  Call,          //!< [u8 argc][u32 site]   call the callee below the arguments
+  Closure,       //!< [u32 function] ([u8 is_local][u16 index])* create a closure
+  CloseUpvalue,  //!<                       move the top local to heap and discard it
+  Class,         //!< [u32 class]           push a class
+  Return,        //!<                       return pop to the caller
+  NoReturn,      //!<                       raise NoReturnFromFunction
+};
+// clang-format on
+
+/**
+ * @brief the AST node which is used to build RuntimeError when an instruction fails. it refers to
+ * the program, so the program must outlive the compiled chunk
+ */
+using Site = std::variant<
+  const Unary *, const Binary *, const Variable *, const Assign *, const Call *,
+  const ReadProperty *, const SetProperty *, const WhileStmt *, const ForStmt *>;
+
+struct Function;
+
+struct ClassProto
+{
+  const ClassDecl * declaration;
+  std::vector<std::pair<std::string_view, uint32_t>> methods;  //!< name and function index
+};
+
+struct Chunk
+{
+  std::vector<uint8_t> code;
+  std::vector<Value> constants;
+  std::vector<Site> sites;
+  std::vector<std::shared_ptr<const Function>> functions;
+  std::vector<ClassProto> classes;
+
+  auto write(const OpCode op) -> void { code.push_back(static_cast<uint8_t>(op)); }
+
+  auto write_u8(const uint8_t value) -> void { code.push_back(value); }
+
+  auto write_u16(const uint16_t value) -> void
+  {
+    code.push_back(static_cast<uint8_t>(value & 0xff));
+    code.push_back(static_cast<uint8_t>((value >> 8) & 0xff));
+  }
+
+  auto write_u32(const uint32_t value) -> void
+  {
+    for (unsigned i = 0; i < 4; ++i) {
+      code.push_back(static_cast<uint8_t>((value >> (8 * i)) & 0xff));
+    }
+  }
+
+  /**
+   * @brief overwrite the u32 operand at given offset, which is used for backpatching jumps
+   */
+  auto patch_u32(const size_t offset, const uint32_t value) -> void
+  {
+    for (unsigned i = 0; i < 4; ++i) {
+      code[offset + i] = static_cast<uint8_t>((value >> (8 * i)) & 0xff);
+    }
+  }
+};
+
+struct Function
+{
+  std::string_view name;      //!< empty for the top-level script
+  size_t arity{0};
+  size_t upvalue_count{0};
+  Chunk chunk;
+  const FuncDecl * declaration{nullptr};  //!< nullptr for the top-level script
+};
+
+inline auto read_u16(const uint8_t * ip) -> uint16_t
+{
+  return static_cast<uint16_t>(ip[0] | (ip[1] << 8));
+}
+
+inline auto read_u32(const uint8_t * ip) -> uint32_t
+{
+  return static_cast<uint32_t>(ip[0]) | (static_cast<uint32_t>(ip[1]) << 8) |
+         (static_cast<uint32_t>(ip[2]) << 16) | (static_cast<uint32_t>(ip[3]) << 24);
+}
+
+}  // namespace vm
+}  // namespace lox
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cpplox/chunk.hpp>
+#include <cpplox/expression.hpp>
+#include <cpplox/resolver.hpp>
+#include <cpplox/statement.hpp>
+
+#include <boost/variant/static_visitor.hpp>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lox
+{
+
+namespace vm
+{
+
+/**
+ * @brief the global variable table shared by the compiler and the VM. global variables are
+ * accessed by index at runtime, and this table keeps the name of each index
+ */
+struct GlobalTable
+{
+  std::unordered_map<std::string, uint32_t> slots;
+  std::vector<std::string> names;
+
+  auto find(const std::string_view & name) const -> std::optional<uint32_t>
+  {
+    if (const auto it = slots.find(std::string(name)); it != slots.end()) {
+      return it->second;
+    }
+    return std::nullopt;
+  }
+
+  auto declare(const std::string_view & name) -> uint32_t
+  {
+    if (const auto slot = find(name); slot) {
+      return slot.value();
+    }
+    const auto slot = static_cast<uint32_t>(names.size());
+    names.emplace_back(name);
+    slots.emplace(names.back(), slot);
+    return slot;
+  }
+};
+
+class Compiler
+{
+public:
+  /**
+   * @brief the program must be resolved beforehand
+   */
+  explicit Compiler(GlobalTable & globals) : globals_(globals) {}
+
+  /**
+   * @brief lower the program into the bytecode of a top-level function
+   * @note the returned function refers to the nodes of `program`, so `program.arena` must outlive
+   * it
+   */
+  auto compile(const Program & program) -> std::shared_ptr<const Function>;
+
+  /**
+   * @brief the first error in materializing the functions parsed lazily. the compiled function is
+   * invalid if this is set
+   */
+  auto error() const noexcept -> const std::optional<RuntimeError> & { return error_; }
+
+private:
+  friend class CompileExprVisitor;
+  friend class CompileStmtVisitor;
+  friend class CompileDeclVisitor;
+
+  struct Local
+  {
+    std::string_view name;  //!< empty for the hidden local like loop counter
+    size_t depth;
+    bool is_captured{false};
+  };
+
+  struct UpvalueRef
+  {
+    uint16_t index;
+    bool is_local;
+  };
+
+  struct LoopContext
+  {
+    size_t start;                     //!< the offset where `continue` jumps to
+    size_t local_count;               //!< the number of locals alive when entering the body
+    std::vector<size_t> break_jumps;  //!< the operand offsets patched at the exit of the loop
+  };
+
+  struct FunctionState
+  {
+    FunctionState * enclosing;
+    std::shared_ptr<Function> function;
+    std::vector<Local> locals;
+    std::vector<UpvalueRef> upvalues;
+    size_t scope_depth{0};
+    std::vector<LoopContext> loops;
+  };
+
+  GlobalTable & globals_;
+  FunctionState * current_{nullptr};
+  std::optional<RuntimeError> error_{std::nullopt};
+
+  auto chunk() -> Chunk &;
+
+  auto expression(const Expr & expr) -> void;
+
+  auto declaration(const Declaration & declaration) -> void;
+
+  auto block(const Block & block) -> void;
+
+  /**
+   * @brief compile the body of func_decl into a new function
+   * @param enclosing the function whose locals can be captured, nullptr if nothing is captured
+   * @return the function and the description of the variables it captures
+   */
+  auto function(const FuncDecl & func_decl, FunctionState * enclosing)
+    -> std::pair<std::shared_ptr<const Function>, std::vector<UpvalueRef>>;
+
+  /**
+   * @brief register the function to current chunk and emit Closure for it
+   */
+  auto emit_closure(
+    const std::shared_ptr<const Function> & function, const std::vector<UpvalueRef> & upvalues)
+    -> void;
+
+  auto add_constant(const Value & value) -> uint32_t;
+
+  auto add_site(const Site & site) -> uint32_t;
+
+  /**
+   * @brief emit a jump instruction and return the offset of its operand for backpatching
+   */
+  auto emit_jump(const OpCode op) -> size_t;
+
+  auto patch_jump(const size_t operand_offset) -> void;
+
+  auto emit_loop(const size_t loop_start) -> void;
+
+  auto begin_scope() -> void;
+
+  /**
+   * @brief discard the locals of the innermost scope, closing the captured ones
+   */
+  auto end_scope() -> void;
+
+  /**
+   * @brief emit the instructions to discard the locals above `local_count` without forgetting
+   * them at compile time, which is used for the jumps leaving scopes
+   */
+  auto emit_discard_locals(const size_t local_count) -> void;
+
+  auto add_local(const std::string_view & name) -> uint16_t;
+
+  /**
+   * @brief declare the variable either as global or local depending on the current scope
+   * @post if it is local, the value on the stack top becomes the local
+   */
+  auto define_variable(const Token & name) -> void;
+
+  auto emit_get_variable(const Variable & variable) -> void;
+
+  auto emit_set_variable(const Assign & assign) -> void;
+
+  static auto resolve_local(const FunctionState & state, const std::string_view & name)
+    -> std::optional<uint16_t>;
+
+  static auto resolve_upvalue(FunctionState & state, const std::string_view & name)
+    -> std::optional<uint16_t>;
+
+  static auto add_upvalue(FunctionState & state, const uint16_t index, const bool is_local)
+    -> uint16_t;
+};
+
+class CompileExprVisitor : boost::static_visitor<void>
+{
+public:
+  explicit CompileExprVisitor(Compiler & compiler) : compiler(compiler) {}
+
+  void operator()(const Literal & literal);
+
+  void operator()(const Unary & unary);
+
+  void operator()(const Binary & binary);
+
+  void operator()(const Group & group);
+
+  void operator()(const Variable & variable);
+
+  void operator()(const Assign & assign);
+
+  void operator()(const Logical & logical);
+
+  void operator()(const Call & call);
+
+  void operator()(const ReadProperty & property);
+
+  void operator()(const SetProperty & property);
+
+private:
+  Compiler & compiler;
+};
+
+class CompileStmtVisitor : boost::static_visitor<void>
+{
+public:
+  explicit CompileStmtVisitor(Compiler & compiler) : compiler(compiler) {}
+
+  void operator()(const ExprStmt & stmt);
+
+  void operator()(const PrintStmt & stmt);
+
+  void operator()(const Block & block);
+
+  /**
+   * @brief each clause opens a scope which is visible from the following clauses, in the same
+   * manner as the tree-walking interpreter
+   */
+  void operator()(const IfBlock & if_block);
+
+  void operator()(const WhileStmt & while_stmt);
+
+  /**
+   * @note `continue` jumps to the condition without executing the `next` expression, in the same
+   * manner as the tree-walking interpreter
+   */
+  void operator()(const ForStmt & for_stmt);
+
+  void operator()(const BreakStmt & break_stmt);
+
+  void operator()(const ContinueStmt & continue_stmt);
+
+  void operator()(const ReturnStmt & return_stmt);
+
+private:
+  Compiler & compiler;
+};
+
+class CompileDeclVisitor : boost::static_visitor<void>
+{
+public:
+  explicit CompileDeclVisitor(Compiler & compiler) : compiler(compiler) {}
+
+  void operator()(const VarDecl & var_decl);
+
+  void operator()(const Stmt & stmt);
+
+  void operator()(const FuncDecl & func_decl);
+
+  /**
+   * @brief classes are always defined as global and their methods can only see globals, in the
+   * same manner as the tree-walking interpreter
+   */
+  void operator()(const ClassDecl & class_decl);
+
+private:
+  Compiler & compiler;
+};
+
+}  // namespace vm
+}  // namespace lox
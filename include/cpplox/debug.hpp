@@ -2,7 +2,7 @@
 
 #include <cpplox/error.hpp>
 #include <cpplox/expression.hpp>
-#include <cpplox/resolver.hpp>
+#include <cpplox/statement.hpp>
 
 #include <iosfwd>
 #include <sstream>
@@ -18,6 +18,11 @@ inline namespace debug
  */
 auto to_lisp_repr(const Expr & expr) -> std::string;
 
+/**
+ * @brief convert each declaration of the program to list-style like "(var a (+ 1 2))" in a line
+ */
+auto to_lisp_repr(const Program & program) -> std::string;
+
 static constexpr const char * Bold = "\033[1m";
 static constexpr const char * Italic = "\033[3m";
 static constexpr const char * Thin = "\033[2m";
@@ -37,7 +42,7 @@ class PrintResolveExprVisitor : boost::static_visitor<void>
 public:
   std::stringstream ss;
 
-  explicit PrintResolveExprVisitor(const ScopeLookup & lookup) : lookup(lookup) {}
+  PrintResolveExprVisitor() = default;
 
   void operator()(const Literal & expr);
 
@@ -58,9 +63,6 @@ public:
   void operator()(const ReadProperty & expr);
 
   void operator()(const SetProperty & expr);
-
-private:
-  const ScopeLookup & lookup;
 };
 
 class PrintResolveStmtVisitor : boost::static_visitor<void>
@@ -68,10 +70,7 @@ class PrintResolveStmtVisitor : boost::static_visitor<void>
 public:
   std::stringstream ss;
 
-  PrintResolveStmtVisitor(const size_t offset, const ScopeLookup & lookup)
-  : offset(offset), lookup(lookup)
-  {
-  }
+  explicit PrintResolveStmtVisitor(const size_t offset) : offset(offset) {}
 
   void operator()(const ExprStmt & stmt);
 
@@ -93,7 +92,6 @@ public:
 
 private:
   const size_t offset;
-  const ScopeLookup & lookup;
   const size_t skip{4};
 };
 
@@ -102,10 +100,7 @@ class PrintResolveDeclVisitor : boost::static_visitor<void>
 public:
   std::stringstream ss;
 
-  PrintResolveDeclVisitor(const size_t offset, const ScopeLookup & lookup)
-  : offset(offset), lookup(lookup)
-  {
-  }
+  explicit PrintResolveDeclVisitor(const size_t offset) : offset(offset) {}
 
   void operator()(const VarDecl & var_decl);
 
@@ -117,7 +112,6 @@ public:
 
 private:
   const size_t offset;
-  const ScopeLookup & lookup;
   const size_t skip{4};
 };
 
@@ -132,7 +126,7 @@ public:
 
   std::string operator()(const double & expr) { return std::to_string(expr); }
 
-  std::string operator()(const std::string & expr) { return expr; }
+  std::string operator()(const String & expr) { return expr.str(); }
 
   std::string operator()(const Callable & expr)
   {
@@ -146,7 +140,7 @@ public:
 
   std::string operator()(const Instance & expr)
   {
-    return "<instance " + std::string(expr.cls->definition->name.lexeme) + ">";
+    return "<instance " + std::string(expr->cls->definition->name.lexeme) + ">";
   }
 };
 
@@ -1,47 +1,69 @@
 #pragma once
 #include <cpplox/error.hpp>
 #include <cpplox/expression.hpp>
+#include <cpplox/gc.hpp>
 
 #include <memory>
+#include <optional>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 namespace lox
 {
+inline namespace gc
+{
+class Heap;
+}
+
 inline namespace environment
 {
-class Environment
+/**
+ * @brief the global variables. it is allocated by Heap::make, and it is kept alive by the
+ * interpreter. the local variables are in the ValueStack or in the upvalues of the closures instead
+ */
+class Environment : public GcObject
 {
 public:
-  Environment() = default;
+  Environment() : GcObject(GcKind::Environment) {}
 
-  explicit Environment(std::shared_ptr<Environment> enclosing) : enclosing_(enclosing) {}
+  /**
+   * @brief define the variable at `slot`, which is assigned by the resolver
+   * @param heap the owner of this, whose write barrier is applied to the overwritten value and
+   * `var_value`
+   */
+  auto define(const size_t slot, const Value & var_value, Heap & heap) -> void;
 
-  auto define(const Token & var, const Value & var_value) -> void
+  /**
+   * @brief get the variable at `slot` of this environment if it is defined
+   */
+  auto get(const size_t slot) const -> std::optional<Value>
   {
-    values_[var.lexeme] = var_value;
+    if (slot < values_.size()) {
+      return values_[slot];
+    }
+    return std::nullopt;
   }
 
-  /*
-  [[nodiscard]] auto assign(const Token & var, const Value & var_value)
-    -> std::optional<RuntimeError>;
-  auto get(const Token & name) const -> std::variant<Value, RuntimeError>;
-  */
+  /**
+   * @brief get the variable at `slot`, or an error for `name` if it is not defined yet
+   */
+  auto get(const Token & name, const size_t slot) const -> std::variant<Value, RuntimeError>;
 
-  [[nodiscard]] auto assign_deBruijn(const Token & var, const Value & var_value, const size_t depth)
+  /**
+   * @brief assign the variable at `slot` if it is defined
+   */
+  [[nodiscard]] auto assign(
+    const Token & var, const Value & var_value, const size_t slot, Heap & heap)
     -> std::optional<RuntimeError>;
 
-  auto get_deBruijn(const Token & name, const size_t depth) const
-    -> std::variant<Value, RuntimeError>;
-
 private:
-  std::unordered_map<std::string_view, Value> values_;
+  friend class gc::Heap;
 
   /**
-   * @brief when a sub scope is created, the sub-environment has the main scope as "enclosing".
-   * "enclosing" is nullptr if and only if the enviroment is global scope
+   * @brief the values indexed by the slot. the element is null if the variable at the slot is not
+   * defined yet
    */
-  std::shared_ptr<Environment> enclosing_{nullptr};
+  std::vector<std::optional<Value>> values_;
 };
 
 }  // namespace environment
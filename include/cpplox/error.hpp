@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 
 namespace lox
 {
@@ -39,40 +40,29 @@ enum class SyntaxErrorKind {
 
 struct SyntaxError
 {
-  SyntaxError(
-    const SyntaxErrorKind kind, const std::shared_ptr<Line> line, const size_t ctx_start_index,
-    const size_t ctx_end_index)
-  : kind(kind), line(line), ctx_start_index(ctx_start_index), ctx_end_index(ctx_end_index)
-  {
-  }
-
-  SyntaxError(const SyntaxError & other)
-  : kind(other.kind),
-    line(other.line),
-    ctx_start_index(other.ctx_start_index),
-    ctx_end_index(other.ctx_end_index)
+  SyntaxError(const SyntaxErrorKind kind, const size_t line, const std::string_view & ctx)
+  : kind(kind), line(line), ctx(ctx)
   {
   }
 
   /**
    * @brief get the column number on its line, starting from 1
    */
-  auto get_lexical_column() const noexcept -> size_t
+  auto get_lexical_column(const LineTable & lines) const -> size_t
   {
-    return ctx_start_index - line->start_index + 1;
+    return lines.offset(ctx) - lines.start_index(line) + 1;
   }
 
   // LCOV_EXCL_START
-  auto get_line_string(const size_t offset = 0) const -> std::string;
+  auto get_line_string(const LineTable & lines, const size_t offset = 0) const -> std::string;
 
-  auto get_visualization_string(const std::string_view & source, const size_t offset = 0) const
+  auto get_visualization_string(const LineTable & lines, const size_t offset = 0) const
     -> std::string;
   // LCOV_EXCL_STOP
 
   const SyntaxErrorKind kind;
-  const std::shared_ptr<Line> line;
-  const size_t ctx_start_index;  //<! start index of the rough range of the error
-  const size_t ctx_end_index;    //<! end index of the rough range of the error
+  const size_t line;           //!< the line number of the beginning of the error
+  const std::string_view ctx;  //<! the rough range of the error on the source
 };
 
 struct TypeError
@@ -130,15 +120,19 @@ struct InvalidAttributeError
   const ReadProperty property;
 };
 
+/**
+ * @note SyntaxError is raised at runtime if the body of a function parsed lazily is invalid
+ */
 using RuntimeError = std::variant<
   TypeError, UndefinedVariableError, MaxLoopError, NotInvocableError, NoReturnFromFunction,
-  CompileError, NotInstanceError, InvalidAttributeError>;
+  CompileError, NotInstanceError, InvalidAttributeError, SyntaxError>;
 
 // LCOV_EXCL_START
-auto get_line_string(const RuntimeError & error, const size_t offset = 0) -> std::string;
+auto get_line_string(const LineTable & lines, const RuntimeError & error, const size_t offset = 0)
+  -> std::string;
 
 auto get_visualization_string(
-  const std::string & source, const RuntimeError & error, const size_t offset = 0) -> std::string;
+  const LineTable & lines, const RuntimeError & error, const size_t offset = 0) -> std::string;
 
 // LCOV_EXCL_STOP
 
@@ -1,12 +1,18 @@
 #pragma once
+#include <cpplox/arena.hpp>
+#include <cpplox/gc.hpp>
+#include <cpplox/string.hpp>
 #include <cpplox/token.hpp>
 #include <cpplox/variant.hpp>
 
-#include <boost/variant/recursive_variant.hpp>
+#include <boost/variant.hpp>
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace lox
@@ -18,11 +24,6 @@ struct FuncDecl;
 struct ClassDecl;
 }  // namespace stmt
 
-inline namespace environment
-{
-class Environment;
-}
-
 inline namespace expression
 {
 
@@ -37,115 +38,209 @@ struct Call;
 struct ReadProperty;
 struct SetProperty;
 
+/**
+ * @brief the nodes other than Literal are allocated in the Arena of the program. the members of the
+ * nodes are not const so that the parser can move the subtrees into place, and the nodes are only
+ * accessible as const through Ref once they are allocated
+ */
 using Expr = boost::variant<
-  Literal, boost::recursive_wrapper<Unary>, boost::recursive_wrapper<Binary>,
-  boost::recursive_wrapper<Group>, boost::recursive_wrapper<Variable>,
-  boost::recursive_wrapper<Assign>, boost::recursive_wrapper<Logical>,
-  boost::recursive_wrapper<Call>, boost::recursive_wrapper<ReadProperty>,
-  boost::recursive_wrapper<SetProperty>>;
+  Literal, Ref<Unary>, Ref<Binary>, Ref<Group>, Ref<Variable>, Ref<Assign>, Ref<Logical>, Ref<Call>,
+  Ref<ReadProperty>, Ref<SetProperty>>;
+
+using Nil = std::monostate;
+
+/**
+ * @brief the value of a literal, which is converted from the lexeme only once by the parser
+ */
+using Constant = std::variant<Nil, bool, int64_t, double, String>;
 
 struct Literal : public Token
 {
   using Token::Token;
+
+  Literal(const Token & token, Constant constant) : Token(token), constant(std::move(constant)) {}
+
+  Constant constant{};
 };
 
 struct Unary
 {
-  const Token op;
-  const Expr expr;
+  Token op;
+  Expr expr;
+  /**
+   * @brief annotated by the optimizer if the subtree is evaluated to this constant
+   */
+  mutable std::optional<Constant> folded{std::nullopt};
 };
 
 struct Binary
 {
-  const Expr left;
-  const Token op;
-  const Expr right;
+  Expr left;
+  Token op;
+  Expr right;
+  /**
+   * @brief annotated by the optimizer if the subtree is evaluated to this constant
+   */
+  mutable std::optional<Constant> folded{std::nullopt};
 };
 
 struct Group
 {
-  const Token left_paren;  //!< only for saving position info
-  const Expr expr;
-  const Token right_paren;  //!< only for saving position info
+  Token left_paren;  //!< only for saving position info
+  Expr expr;
+  Token right_paren;  //!< only for saving position info
+  /**
+   * @brief annotated by the optimizer if the subtree is evaluated to this constant
+   */
+  mutable std::optional<Constant> folded{std::nullopt};
+};
+
+/**
+ * @brief where a resolved variable is stored at runtime
+ */
+enum class Storage : uint8_t {
+  Global,   //!< in the global Environment
+  Local,    //!< in the frame of the running function
+  Upvalue,  //!< in an upvalue of the running closure
+};
+
+/**
+ * @brief the location of a variable from the function where it is accessed
+ */
+struct VariableLocation
+{
+  Storage storage;
+  size_t slot;  //!< the index in the global Environment, in the frame or in the upvalues
 };
 
 struct Variable
 {
-  const Token name;
+  Token name;
+  /**
+   * @brief annotated by the resolver, and remains null if the variable could not be resolved
+   */
+  mutable std::optional<VariableLocation> location{std::nullopt};
 };
 
 struct Assign
 {
-  const Token name;
+  Token name;
   /**
      a = b = 1; is
      a = (b = 1); where (b = 1) is also "Assign"
   */
-  const Expr expr;
+  Expr expr;
+  /**
+   * @brief annotated by the resolver, and remains null if the variable could not be resolved
+   */
+  mutable std::optional<VariableLocation> location{std::nullopt};
 };
 
 struct Logical
 {
-  const Expr left;
-  const Token op;
-  const Expr right;
+  Expr left;
+  Token op;
+  Expr right;
+  /**
+   * @brief annotated by the optimizer if the subtree is evaluated to this constant
+   */
+  mutable std::optional<Constant> folded{std::nullopt};
 };
 
 struct Call
 {
-  const Expr callee;
-  const std::vector<Expr> arguments;
+  Expr callee;
+  std::vector<Expr> arguments;
 };
 
 struct ReadProperty
 {
-  const Expr base;
-  const Token prop;
+  Expr base;
+  Token prop;
 };
 
 struct SetProperty
 {
-  const Expr base;
-  const Token prop;
-  const Expr value;
+  Expr base;
+  Token prop;
+  Expr value;
 };
 
-using Nil = std::monostate;
+struct ClosureObject;
 
+/**
+ * @brief a function object. `definition` refers to the node in the Arena of the program, which is
+ * kept alive by the engine, so creating a closure does not copy the body
+ */
 struct Callable
 {
-  std::shared_ptr<const FuncDecl> definition;
+  Ref<FuncDecl> definition;
   /**
-   * NOTE: when a closure is defined in a subscope, the subscope owns this Callable object, and the
-   * closure object itself refers to the subscope at `closure` field. Thus `closure` field needs to
-   * be weak_ptr because otherwise they form a circular dependency.
+   * @brief the upvalues of the variables captured by the function, or null if it captures none
+   * NOTE: a local function which refers to itself captures the variable holding it, so they form a
+   * cycle, which is released by the collector of the Heap owning the closure
    */
-  std::shared_ptr<Environment> closure;
+  ClosureObject * closure;
 };
 
-struct ClassTemplate
+struct ClassTemplate : public GcObject
 {
-  std::shared_ptr<const ClassDecl> definition;
+  Ref<ClassDecl> definition;
   std::unordered_map<std::string_view, Callable> methods;
 
   ClassTemplate(
-    const std::shared_ptr<const ClassDecl> definition,
-    const std::unordered_map<std::string_view, Callable> & methods)
-  : definition(definition), methods(methods)
+    const Ref<ClassDecl> definition, std::unordered_map<std::string_view, Callable> methods)
+  : GcObject(GcKind::Class), definition(definition), methods(std::move(methods))
   {
   }
 };
 
-using Class = std::shared_ptr<ClassTemplate>;
+/**
+ * @brief the classes and the instances are owned by the Heap of the interpreter, and they are
+ * shared by reference
+ */
+using Class = ClassTemplate *;
+
+struct InstanceObject;
 
-struct Instance;
+using Instance = InstanceObject *;
 
-using Value = boost::variant<Nil, bool, int64_t, double, std::string, Callable, Class, Instance>;
+using Value = boost::variant<Nil, bool, int64_t, double, String, Callable, Class, Instance>;
 
-struct Instance
+struct InstanceObject : public GcObject
 {
-  Class cls;
-  std::shared_ptr<std::unordered_map<std::string_view, Value>> fields;
+  explicit InstanceObject(const Class cls) : GcObject(GcKind::Instance), cls(cls) {}
+
+  const Class cls;
+  std::unordered_map<std::string_view, Value> fields;
+};
+
+/**
+ * @brief a local variable captured by closures. while the variable is alive in the ValueStack of
+ * the interpreter, it is "open" and refers to the stack slot. when the scope of the variable
+ * exits, it is "closed" and the value is moved to `closed`, so the closures keep sharing it
+ */
+struct UpvalueObject : public GcObject
+{
+  explicit UpvalueObject(const size_t slot) : GcObject(GcKind::Upvalue), slot(slot) {}
+
+  size_t slot;  //!< the index in the ValueStack from its bottom
+  Value closed{};
+  bool is_open{true};
+};
+
+/**
+ * @brief the upvalues of a closure in the order of FuncDecl::upvalues. a closure retains only the
+ * variables which it captures, instead of the whole scopes enclosing it
+ */
+struct ClosureObject : public GcObject
+{
+  explicit ClosureObject(std::vector<UpvalueObject *> upvalues)
+  : GcObject(GcKind::Closure), upvalues(std::move(upvalues))
+  {
+  }
+
+  const std::vector<UpvalueObject *> upvalues;
 };
 
 namespace helper
@@ -183,7 +278,7 @@ inline auto is_numeric(const Value & value) -> bool
 
 inline auto is_str(const Value & value) -> bool
 {
-  return is_variant_v<std::string>(value);
+  return is_variant_v<String>(value);
 }
 
 };  // namespace helper
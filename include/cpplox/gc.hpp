@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace lox
+{
+
+inline namespace gc
+{
+
+enum class GcKind : uint8_t {
+  Environment,
+  Class,
+  Instance,
+  Upvalue,
+  Closure,
+};
+
+/**
+ * @brief the common header of the objects of the tree-walk interpreter which are owned by Heap.
+ * they refer to each other by raw pointers, and are released by the collector once they are
+ * unreachable from the roots
+ */
+struct GcObject
+{
+  explicit GcObject(const GcKind kind) : kind(kind) {}
+
+  GcObject(const GcObject &) = delete;
+
+  auto operator=(const GcObject &) -> GcObject & = delete;
+
+  const GcKind kind;
+  std::atomic<bool> marked{false};  //!< it is set by the marker threads concurrently
+  bool young{false};       //!< true while it is in the nursery and has not survived a collection
+  bool chunked{false};     //!< true if it is placed in a chunk of the nursery instead of by `new`
+  bool remembered{false};  //!< true if it is old and may refer to a young object
+  GcObject * next{nullptr};  //!< the next object in the list of its generation in the Heap
+};
+
+}  // namespace gc
+}  // namespace lox
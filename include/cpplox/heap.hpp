@@ -0,0 +1,347 @@
+#pragma once
+
+#include <cpplox/environment.hpp>
+#include <cpplox/expression.hpp>
+#include <cpplox/gc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace lox
+{
+
+inline namespace gc
+{
+
+struct HeapStats
+{
+  size_t bytes{0};              //!< the estimated size of the objects in the heap
+  size_t young_bytes{0};        //!< the part of `bytes` in the nursery
+  size_t objects{0};            //!< the number of the objects in the heap
+  size_t collections{0};        //!< the number of the collections so far, either minor or major
+  size_t minor_collections{0};  //!< the number of the collections of only the nursery
+  size_t allocated{0};          //!< the number of the objects allocated so far
+  size_t freed{0};              //!< the number of the objects released so far
+  size_t promoted{0};           //!< the number of the objects which survived the nursery
+  size_t chunks{0};             //!< the number of the chunks reserved for the nursery
+  size_t peak_bytes{0};         //!< the maximum of `bytes`
+  size_t next_collection{0};    //!< `bytes` of the old objects which triggers a major collection
+  size_t mark_steps{0};         //!< the number of the slices of the incremental marking
+  size_t pauses{0};             //!< the number of the pauses measured so far
+};
+
+/**
+ * @brief the owner of the global Environment, the closures, their upvalues, the classes and the
+ * instances of the tree-walk interpreter.
+ * the new objects are placed in the nursery by bumping a pointer in a chunk, and most of them die
+ * there. when the nursery is full, the young objects reachable from the roots or from the
+ * remembered old objects are promoted in place, and the others are released. when the old objects
+ * exceed the threshold, it marks all the objects reachable from the roots and releases the others,
+ * including the cycles of closures. the marking of a large heap is shared by a pool of threads, or
+ * it is interleaved with the execution in small slices
+ * @note the objects are never moved, so a chunk is reused only after all its objects are released
+ */
+class Heap
+{
+public:
+  static constexpr size_t DefaultThreshold = 1024 * 1024;
+  static constexpr size_t DefaultNurserySize = 256 * 1024;
+  static constexpr size_t GrowthFactor = 2;
+  static constexpr size_t ChunkSize = 32 * 1024;
+  static constexpr size_t ParallelMarkThreshold = 4096;  //!< the objects to mark in parallel
+  static constexpr size_t MarkStepBudget = 256;  //!< the objects traced by a slice of marking
+  static constexpr size_t PauseWindow = 1024;    //!< the recent pauses kept for the percentiles
+
+  /**
+   * @param nursery_size the bytes of the young objects which trigger a minor collection, which is
+   * at most `threshold`. if it is 0, the objects are allocated by `new` as old ones
+   */
+  explicit Heap(
+    const size_t threshold = DefaultThreshold, const size_t nursery_size = DefaultNurserySize);
+
+  Heap(const Heap &) = delete;
+
+  auto operator=(const Heap &) -> Heap & = delete;
+
+  ~Heap();
+
+  /**
+   * @brief allocate a new object, which may collect the garbage before the allocation
+   * @note the objects given to `args` have to be reachable from the roots, because they are not
+   * traced while the new object is not constructed yet
+   */
+  template <typename T, typename... Args>
+  auto make(Args &&... args) -> T *
+  {
+    if (marking_) {
+      mark_step();
+    }
+    T * object = nullptr;
+    if (nursery_size_ == 0) {
+      if (stats_.bytes + sizeof(T) > stats_.next_collection) {
+        collect_major();
+      }
+      object = new T(std::forward<Args>(args)...);
+      object->next = old_objects_;
+      old_objects_ = object;
+    } else {
+      if (stats_.young_bytes + sizeof(T) > nursery_size_) {
+        collect_minor();
+      }
+      object = new (bump(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      object->young = true;
+      object->chunked = true;
+      object->next = young_objects_;
+      young_objects_ = object;
+      stats_.young_bytes += sizeof(T);
+    }
+    // the objects allocated while marking are not in the snapshot, so they are black
+    object->marked.store(marking_, std::memory_order_relaxed);
+    stats_.bytes += sizeof(T);
+    stats_.objects++;
+    stats_.allocated++;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.bytes);
+    return object;
+  }
+
+  /**
+   * @brief mark the objects reachable from the roots, and release the others
+   */
+  auto collect() -> void;
+
+  /**
+   * @brief release the young objects which are unreachable from the roots and the remembered old
+   * objects, and promote the others. it runs a major collection as well if the old objects exceed
+   * the threshold
+   */
+  auto collect_minor() -> void;
+
+  /**
+   * @brief collect the old objects, or start the incremental marking if it is enabled. the
+   * marking proceeds on the following allocations, and the garbage is released once it is done
+   */
+  auto collect_major() -> void;
+
+  /**
+   * @brief remember `owner` if it is old and `value` which is written to it refers to a young
+   * object, so that the young object survives the minor collections. while the incremental marking,
+   * the `overwritten` value is marked so that the objects reachable at its beginning survive
+   * (snapshot-at-the-beginning)
+   */
+  auto write_barrier(GcObject * owner, const Value * overwritten, const Value & value) -> void
+  {
+    if (marking_ && overwritten) {
+      mark(*overwritten);
+    }
+    if (!owner->young && !owner->remembered) {
+      remember(owner, value);
+    }
+  }
+
+  /**
+   * @brief mark the heap by `threads` threads including the caller, if it has more than
+   * ParallelMarkThreshold objects. the other threads are started here and wait for the
+   * collections
+   */
+  auto use_parallel_marking(const size_t threads) -> void;
+
+  /**
+   * @brief mark the old objects in slices of MarkStepBudget objects on the allocations, instead
+   * of stopping until all of them are marked
+   */
+  auto use_incremental_marking(const bool incremental) -> void { incremental_ = incremental; }
+
+  auto stats() const noexcept -> const HeapStats & { return stats_; }
+
+  /**
+   * @brief the durations of the last PauseWindow collections and slices of the marking in
+   * microseconds, which are not in order once the window is full
+   */
+  auto pauses() const noexcept -> const std::vector<double> & { return pauses_; }
+
+  /**
+   * @brief the pause at `percentile` (0 to 100) of pauses() by the nearest rank, or 0 if none
+   */
+  auto pause_percentile(const double percentile) const -> double;
+
+  /**
+   * @brief register a variable on the C++ stack as a root while this is alive. the variable is read
+   * at each collection, so it may be reassigned in the meantime
+   * @note the roots have to be released in the reverse order of the registration
+   */
+  class Root
+  {
+  public:
+    Root(Heap & heap, Environment * const & env) : heap_(heap) { heap_.roots_.emplace_back(&env); }
+
+    Root(Heap & heap, const Value & value) : heap_(heap) { heap_.roots_.emplace_back(&value); }
+
+    Root(Heap & heap, const std::vector<Value> & values) : heap_(heap)
+    {
+      heap_.roots_.emplace_back(&values);
+    }
+
+    Root(Heap & heap, const std::vector<UpvalueObject *> & upvalues) : heap_(heap)
+    {
+      heap_.roots_.emplace_back(&upvalues);
+    }
+
+    Root(const Root &) = delete;
+
+    auto operator=(const Root &) -> Root & = delete;
+
+    ~Root() { heap_.roots_.pop_back(); }
+
+  private:
+    Heap & heap_;
+  };
+
+private:
+  class MarkerPool;
+
+  /**
+   * @brief the header of a chunk, which is aligned by ChunkSize so that an object finds its chunk
+   * from its address
+   */
+  struct Chunk
+  {
+    size_t used;  //!< the offset of the free space
+    size_t live;  //!< the number of the objects in the chunk which are not released yet
+  };
+
+  GcObject * young_objects_{nullptr};  //!< the list of the objects in the nursery
+  GcObject * old_objects_{nullptr};    //!< the list of the objects which are promoted
+  HeapStats stats_;
+  size_t threshold_;     //!< the minimum of `stats_.next_collection`
+  size_t nursery_size_;  //!< the maximum of `stats_.young_bytes`
+  bool minor_{false};    //!< true while a minor collection, which marks only the young objects
+  bool marking_{false};  //!< true while the incremental marking is in progress
+  bool incremental_{false};
+  std::unique_ptr<MarkerPool> marker_pool_;  //!< null unless the marking is parallel
+  size_t pause_depth_{0};  //!< the nested collections are measured as a pause
+  std::vector<double> pauses_;  //!< the ring buffer of the recent pauses
+  size_t next_pause_{0};        //!< the oldest pause, which is overwritten next
+  Chunk * current_{nullptr};  //!< the chunk where the new objects are placed
+  std::vector<Chunk *> free_chunks_;
+  std::vector<GcObject *> remembered_;  //!< the old objects which may refer to young objects
+  std::vector<std::variant<
+    Environment * const *, const Value *, const std::vector<Value> *,
+    const std::vector<UpvalueObject *> *>>
+    roots_;
+  std::vector<GcObject *> gray_;  //!< the marked objects whose references are not traced yet
+
+  /**
+   * @brief measure the duration of the outermost collection
+   */
+  class Pause
+  {
+  public:
+    explicit Pause(Heap & heap) : heap_(heap), start_(std::chrono::steady_clock::now())
+    {
+      heap_.pause_depth_++;
+    }
+
+    Pause(const Pause &) = delete;
+
+    auto operator=(const Pause &) -> Pause & = delete;
+
+    ~Pause()
+    {
+      if (--heap_.pause_depth_ == 0) {
+        const auto end = std::chrono::steady_clock::now();
+        heap_.record_pause(std::chrono::duration<double, std::micro>(end - start_).count());
+      }
+    }
+
+  private:
+    Heap & heap_;
+    const std::chrono::steady_clock::time_point start_;
+  };
+
+  /**
+   * @brief keep `pause` in the window, replacing the oldest one if it is full
+   */
+  auto record_pause(const double pause) -> void;
+
+  /**
+   * @brief reserve `size` bytes aligned by `align` in the current chunk
+   */
+  auto bump(const size_t size, const size_t align) -> void *;
+
+  /**
+   * @brief trace MarkStepBudget objects, and release the garbage if all of them are traced
+   */
+  auto mark_step() -> void;
+
+  /**
+   * @brief trace the gray objects until all the reachable objects are marked
+   */
+  auto drain() -> void;
+
+  /**
+   * @brief trace the gray objects by the work-stealing threads of `marker_pool_`
+   */
+  auto drain_parallel() -> void;
+
+  /**
+   * @brief release the unmarked objects of both generations after the major marking
+   */
+  auto sweep_all() -> void;
+
+  auto remember(GcObject * owner, const Value & value) -> void;
+
+  /**
+   * @brief mark the roots, and trace the remembered objects if it is a minor collection
+   */
+  auto mark_roots() -> void;
+
+  /**
+   * @brief release the unmarked objects in `list` and unmark the others. the survivors are moved
+   * to the old objects
+   * @return the size of the survivors
+   */
+  auto sweep(GcObject *& list) -> size_t;
+
+  auto release(GcObject * object) -> void;
+
+  auto mark(GcObject * object) -> void { mark(object, gray_); }
+
+  auto mark(const Value & value) -> void;
+
+  /**
+   * @brief mark the object and push it to `gray` unless it is already marked, or it is old in a
+   * minor collection. it is safe to be called by the marker threads concurrently
+   */
+  auto mark(GcObject * object, std::vector<GcObject *> & gray) const -> void
+  {
+    if (
+      object && (!minor_ || object->young) && !object->marked.load(std::memory_order_relaxed) &&
+      !object->marked.exchange(true, std::memory_order_relaxed)) {
+      gray.push_back(object);
+    }
+  }
+
+  /**
+   * @brief mark the objects referred by `object` into `gray`
+   */
+  auto trace(const GcObject * object, std::vector<GcObject *> & gray) const -> void;
+
+  /**
+   * @brief the size of the object including its variable-sized storage
+   */
+  static auto size_of(const GcObject * object) -> size_t;
+
+  /**
+   * @brief call the destructor of the object
+   */
+  static auto destroy(GcObject * object) -> void;
+};
+
+}  // namespace gc
+}  // namespace lox
@@ -4,11 +4,13 @@
 #include <cpplox/environment.hpp>
 #include <cpplox/error.hpp>
 #include <cpplox/expression.hpp>
+#include <cpplox/heap.hpp>
 #include <cpplox/resolver.hpp>
 #include <cpplox/statement.hpp>
 
 #include <memory>
 #include <optional>
+#include <vector>
 
 namespace lox
 {
@@ -16,10 +18,155 @@ namespace lox
 inline namespace interpreter
 {
 
+/**
+ * @brief the values of the local variables. a call pushes a frame of the slots of its function, and
+ * the variables are indexed from the base of the frame. the variables captured by closures are
+ * shared with them through the open upvalues until their scopes exit
+ */
+class ValueStack
+{
+public:
+  explicit ValueStack(Heap & heap)
+  : heap_(heap), root_(heap, values_), open_upvalues_root_(heap, open_upvalues_)
+  {
+  }
+
+  ValueStack(const ValueStack &) = delete;
+
+  auto operator=(const ValueStack &) -> ValueStack & = delete;
+
+  /**
+   * @brief the variable at `slot` of the frame of the running function
+   * @note the reference is invalidated by the next call
+   */
+  auto local(const size_t slot) -> Value & { return values_[base_ + slot]; }
+
+  /**
+   * @brief the open upvalue of the variable at `slot` of the frame of the running function, which
+   * is shared by all the closures capturing the variable
+   */
+  auto capture(const size_t slot) -> UpvalueObject *;
+
+  /**
+   * @brief the value of the variable captured by `upvalue`
+   */
+  auto get(const UpvalueObject & upvalue) const -> const Value &
+  {
+    return upvalue.is_open ? values_[upvalue.slot] : upvalue.closed;
+  }
+
+  /**
+   * @brief assign the variable captured by `upvalue`
+   */
+  auto set(UpvalueObject * upvalue, const Value & value) -> void
+  {
+    if (upvalue->is_open) {
+      values_[upvalue->slot] = value;
+      return;
+    }
+    heap_.write_barrier(upvalue, &upvalue->closed, value);
+    upvalue->closed = value;
+  }
+
+  /**
+   * @brief close the upvalues of the variables at or above `slot` of the frame of the running
+   * function, whose scope exits
+   */
+  auto close_upvalues(const size_t slot) -> void { close(base_ + slot); }
+
+  /**
+   * @brief a frame which is pushed on the construction and popped on the destruction
+   */
+  class Frame
+  {
+  public:
+    Frame(ValueStack & stack, const size_t size)
+    : stack_(stack), base_(stack.values_.size()), caller_base_(stack.base_)
+    {
+      stack_.values_.resize(base_ + size);
+    }
+
+    Frame(const Frame &) = delete;
+
+    auto operator=(const Frame &) -> Frame & = delete;
+
+    ~Frame()
+    {
+      stack_.close(base_);
+      stack_.values_.resize(base_);
+      stack_.base_ = caller_base_;
+    }
+
+    /**
+     * @brief the variable at `slot` of this frame, which is written before the frame is entered
+     * while the arguments are evaluated in the frame of the caller
+     */
+    auto local(const size_t slot) -> Value & { return stack_.values_[base_ + slot]; }
+
+    /**
+     * @brief make this the frame of the running function
+     */
+    auto enter() -> void { stack_.base_ = base_; }
+
+  private:
+    ValueStack & stack_;
+    size_t base_;
+    size_t caller_base_;
+  };
+
+  /**
+   * @brief close the upvalues of a scope on the destruction, if any variable of it is captured
+   */
+  class ScopeExit
+  {
+  public:
+    ScopeExit(ValueStack & stack, const std::optional<size_t> captured_base)
+    : stack_(stack), captured_base_(captured_base)
+    {
+    }
+
+    ScopeExit(const ScopeExit &) = delete;
+
+    auto operator=(const ScopeExit &) -> ScopeExit & = delete;
+
+    ~ScopeExit()
+    {
+      if (captured_base_) {
+        stack_.close_upvalues(captured_base_.value());
+      }
+    }
+
+  private:
+    ValueStack & stack_;
+    const std::optional<size_t> captured_base_;
+  };
+
+private:
+  Heap & heap_;
+  std::vector<Value> values_;
+  size_t base_{0};
+  Heap::Root root_;  //!< the values are traced by the collector as they are
+  std::vector<UpvalueObject *> open_upvalues_;  //!< sorted by the slot
+  Heap::Root open_upvalues_root_;               //!< kept alive until they are closed
+
+  /**
+   * @brief move the values of the open upvalues at or above `index` to them
+   */
+  auto close(const size_t index) -> void;
+};
+
 class Interpreter
 {
 public:
-  Interpreter() { global_env_ = std::make_shared<Environment>(); }
+  explicit Interpreter(
+    const size_t heap_threshold = Heap::DefaultThreshold,
+    const size_t nursery_size = Heap::DefaultNurserySize)
+  : heap_(heap_threshold, nursery_size),
+    global_env_(heap_.make<Environment>()),
+    global_root_(heap_, global_env_),
+    stack_(heap_)
+  {
+  }
 
   /**
    * @brief execute the given program
@@ -37,9 +184,32 @@ public:
 
   auto get_variable(const Token & token) const -> std::optional<Value>;
 
+  /**
+   * @brief the statistics of the heap of the closures, the classes and the instances
+   */
+  auto heap_stats() const -> const HeapStats & { return heap_.stats(); }
+
+  /**
+   * @brief the heap to configure its collector and to read its pauses
+   */
+  auto heap() -> Heap & { return heap_; }
+
+  /**
+   * @brief release the unreachable objects now
+   */
+  auto collect_garbage() -> void { heap_.collect(); }
+
 private:
-  std::shared_ptr<Environment> global_env_;
-  ScopeLookup lookup_;
+  Heap heap_;
+  Environment * global_env_;
+  Heap::Root global_root_;  //!< the global variables are always reachable
+  ValueStack stack_;
+  Scope global_scope_;  //!< the slots of the global variables, which is kept across execute()
+  /**
+   * @brief the nodes of the executed programs, which may be referred from the functions and classes
+   * defined by them
+   */
+  std::vector<std::shared_ptr<const Arena>> arenas_;
 
   /**
    * @brief execute the given declaration
@@ -53,19 +223,19 @@ namespace impl
 class EvaluateExprVisitor : boost::static_visitor<std::variant<Value, RuntimeError>>
 {
 private:
-  const ScopeLookup & lookup_;
-  // NOTE: passing env as mutable reference does not meet the const requirement of operator()
-  std::shared_ptr<Environment> env;
-  // if the expression contained function call, the function must not use `env`, because function
-  // must not refer to the parameters defined out of its scope. it is only allowed to access to the
-  // scope enclosing global scope + its parameters.
-  std::shared_ptr<Environment> global_env;
+  // the upvalues of the running function, which is null for the top-level code
+  ClosureObject * closure;
+  Environment * global_env;
+  // the new closures and instances are allocated here, and the values which are only held by this
+  // visitor during the evaluation are registered as its roots
+  Heap & heap;
+  // the local variables of the running function
+  ValueStack & stack;
 
 public:
   explicit EvaluateExprVisitor(
-    const ScopeLookup & lookup, std::shared_ptr<Environment> env_,
-    std::shared_ptr<Environment> global_env_)
-  : lookup_(lookup), env(env_), global_env(global_env_)
+    ClosureObject * closure_, Environment * global_env_, Heap & heap_, ValueStack & stack_)
+  : closure(closure_), global_env(global_env_), heap(heap_), stack(stack_)
   {
   }
 
@@ -91,28 +261,28 @@ public:
 };
 
 auto evaluate_expr_impl(
-  const Expr & expr, const ScopeLookup & lookup, std::shared_ptr<Environment> env,
-  std::shared_ptr<Environment> global_env) -> std::variant<Value, RuntimeError>;
+  const Expr & expr, ClosureObject * closure, Environment * global_env, Heap & heap,
+  ValueStack & stack) -> std::variant<Value, RuntimeError>;
 
 class ExecuteStmtVisitor : boost::static_visitor<std::optional<RuntimeError>>
 {
 private:
-  const ScopeLookup & lookup_;
-  std::shared_ptr<Environment> env;
-  std::shared_ptr<Environment> global_env;
+  ClosureObject * closure;
+  Environment * global_env;
+  Heap & heap;
+  ValueStack & stack;
   std::optional<ControlFlowKind> & procedure;
 
 public:
   explicit ExecuteStmtVisitor(
-    const ScopeLookup & lookup, std::shared_ptr<Environment> env,
-    std::shared_ptr<Environment> global_env, std::optional<ControlFlowKind> & proc)
-  : lookup_(lookup), env(env), global_env(global_env), procedure(proc)
+    ClosureObject * closure, Environment * global_env, Heap & heap, ValueStack & stack,
+    std::optional<ControlFlowKind> & proc)
+  : closure(closure), global_env(global_env), heap(heap), stack(stack), procedure(proc)
   {
     assert(!procedure);
   }
 
-  std::variant<bool, RuntimeError> execute_branch_clause(
-    const BranchClause & clause, std::shared_ptr<Environment> env);
+  std::variant<bool, RuntimeError> execute_branch_clause(const BranchClause & clause);
 
   /**
    * @brief execute <expr_statement>, so environment is updated
@@ -170,23 +340,23 @@ public:
 };
 
 auto execute_stmt_impl(
-  const Stmt & stmt, const ScopeLookup & lookup, std::shared_ptr<Environment> env,
-  std::shared_ptr<Environment> global_env,
-  std::optional<ControlFlowKind> & procedure) -> std::optional<RuntimeError>;
+  const Stmt & stmt, ClosureObject * closure, Environment * global_env, Heap & heap,
+  ValueStack & stack, std::optional<ControlFlowKind> & procedure) -> std::optional<RuntimeError>;
 
 class ExecuteDeclarationVisitor : boost::static_visitor<std::optional<RuntimeError>>
 {
 private:
-  const ScopeLookup & lookup_;
-  std::shared_ptr<Environment> env;
-  std::shared_ptr<Environment> global_env;
+  ClosureObject * closure;
+  Environment * global_env;
+  Heap & heap;
+  ValueStack & stack;
   std::optional<ControlFlowKind> & procedure;
 
 public:
   explicit ExecuteDeclarationVisitor(
-    const ScopeLookup & lookup, std::shared_ptr<Environment> env,
-    std::shared_ptr<Environment> global_env, std::optional<ControlFlowKind> & proc)
-  : lookup_(lookup), env(env), global_env(global_env), procedure(proc)
+    ClosureObject * closure, Environment * global_env, Heap & heap, ValueStack & stack,
+    std::optional<ControlFlowKind> & proc)
+  : closure(closure), global_env(global_env), heap(heap), stack(stack), procedure(proc)
   {
   }
 
@@ -197,6 +367,12 @@ public:
   std::optional<RuntimeError> operator()(const FuncDecl & func_decl);
 
   std::optional<RuntimeError> operator()(const ClassDecl & class_decl);
+
+private:
+  /**
+   * @brief define a variable either in the frame of the running function or in `global_env`
+   */
+  auto define(const bool on_stack, const size_t slot, const Value & value) -> void;
 };
 
 }  // namespace impl
@@ -0,0 +1,235 @@
+#pragma once
+#include <cpplox/expression.hpp>
+#include <cpplox/statement.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lox
+{
+
+namespace vm
+{
+
+struct Function;
+
+enum class ObjectKind : uint8_t {
+  String,
+  Closure,
+  Class,
+  Instance,
+};
+
+/**
+ * @brief the common header of the heap objects of the virtual machine. the objects are reference
+ * counted intrusively by Value
+ */
+struct Object
+{
+  explicit Object(const ObjectKind kind) : kind(kind) {}
+
+  const ObjectKind kind;
+  uint32_t refcount{0};
+};
+
+/**
+ * @brief release the memory of the object whose refcount became zero
+ */
+auto free_object(Object * object) -> void;
+
+/**
+ * @brief the 16-byte value type of the virtual machine, which is a tag and a payload of either a
+ * scalar or a pointer to Object. scalars follow the same semantics as lox::Value, and heap objects
+ * are shared by reference
+ */
+class Value
+{
+public:
+  enum class Tag : uint8_t {
+    Nil,
+    Bool,
+    Int,
+    Double,
+    Object,
+  };
+
+  Value() noexcept : tag_(Tag::Nil) { as_.i = 0; }
+
+  Value(const Nil &) noexcept : Value() {}
+
+  Value(const bool b) noexcept : tag_(Tag::Bool) { as_.b = b; }
+
+  Value(const int64_t i) noexcept : tag_(Tag::Int) { as_.i = i; }
+
+  Value(const double d) noexcept : tag_(Tag::Double) { as_.d = d; }
+
+  /**
+   * @brief take a reference to the object
+   */
+  explicit Value(Object * object) noexcept : tag_(Tag::Object)
+  {
+    as_.object = object;
+    retain();
+  }
+
+  Value(const Value & other) noexcept : tag_(other.tag_), as_(other.as_) { retain(); }
+
+  Value(Value && other) noexcept : tag_(other.tag_), as_(other.as_) { other.tag_ = Tag::Nil; }
+
+  auto operator=(const Value & other) noexcept -> Value &
+  {
+    // NOTE: retain first in case of self assignment
+    other.retain();
+    release();
+    tag_ = other.tag_;
+    as_ = other.as_;
+    return *this;
+  }
+
+  auto operator=(Value && other) noexcept -> Value &
+  {
+    if (this != &other) {
+      release();
+      tag_ = other.tag_;
+      as_ = other.as_;
+      other.tag_ = Tag::Nil;
+    }
+    return *this;
+  }
+
+  ~Value() { release(); }
+
+  auto tag() const noexcept -> Tag { return tag_; }
+
+  auto is_nil() const noexcept -> bool { return tag_ == Tag::Nil; }
+
+  auto is_bool() const noexcept -> bool { return tag_ == Tag::Bool; }
+
+  auto is_int() const noexcept -> bool { return tag_ == Tag::Int; }
+
+  auto is_double() const noexcept -> bool { return tag_ == Tag::Double; }
+
+  auto is_numeric() const noexcept -> bool { return tag_ == Tag::Int || tag_ == Tag::Double; }
+
+  auto is_object(const ObjectKind kind) const noexcept -> bool
+  {
+    return tag_ == Tag::Object && as_.object->kind == kind;
+  }
+
+  auto as_bool() const noexcept -> bool { return as_.b; }
+
+  auto as_int() const noexcept -> int64_t { return as_.i; }
+
+  auto as_double() const noexcept -> double { return as_.d; }
+
+  /**
+   * @brief the numeric value as double, int64_t is promoted
+   */
+  auto to_double() const noexcept -> double
+  {
+    return tag_ == Tag::Int ? static_cast<double>(as_.i) : as_.d;
+  }
+
+  template <typename T>
+  auto as() const noexcept -> T *
+  {
+    return static_cast<T *>(as_.object);
+  }
+
+private:
+  Tag tag_;
+  union {
+    bool b;
+    int64_t i;
+    double d;
+    Object * object;
+  } as_;
+
+  auto retain() const noexcept -> void
+  {
+    if (tag_ == Tag::Object) {
+      as_.object->refcount++;
+    }
+  }
+
+  auto release() noexcept -> void
+  {
+    if (tag_ == Tag::Object && --as_.object->refcount == 0) {
+      free_object(as_.object);
+    }
+  }
+};
+
+static_assert(sizeof(Value) == 16, "vm::Value is expected to be a 16-byte tagged union");
+
+struct StringObject : public Object
+{
+  explicit StringObject(String value) : Object(ObjectKind::String), value(std::move(value)) {}
+
+  const String value;
+};
+
+/**
+ * @brief a variable captured by closures. while the variable is alive on the stack, it is "open"
+ * and refers to the stack slot. when the variable goes out of scope, it is "closed" and the value
+ * is moved to `closed`
+ */
+struct Upvalue
+{
+  size_t slot;
+  Value closed{};
+  bool is_open{true};
+};
+
+struct Closure : public Object
+{
+  explicit Closure(std::shared_ptr<const Function> function)
+  : Object(ObjectKind::Closure), function(std::move(function))
+  {
+  }
+
+  const std::shared_ptr<const Function> function;
+  std::vector<std::shared_ptr<Upvalue>> upvalues;
+};
+
+struct ClassObject : public Object
+{
+  explicit ClassObject(const ClassDecl * declaration)
+  : Object(ObjectKind::Class), declaration(declaration)
+  {
+  }
+
+  const ClassDecl * declaration;
+  std::unordered_map<std::string_view, Value> methods;  //!< Closure
+};
+
+struct InstanceObject : public Object
+{
+  explicit InstanceObject(const Value & cls) : Object(ObjectKind::Instance), cls(cls) {}
+
+  const Value cls;  //!< ClassObject
+  std::unordered_map<std::string_view, Value> fields;
+};
+
+/**
+ * @brief allocate a new object and return the first reference to it
+ */
+template <typename T, typename... Args>
+auto make_object(Args &&... args) -> Value
+{
+  return Value(new T(std::forward<Args>(args)...));
+}
+
+auto is_truthy(const Value & value) -> bool;
+
+auto is_equal(const Value & left, const Value & right) -> bool;
+
+auto stringify(const Value & value) -> std::string;
+
+}  // namespace vm
+}  // namespace lox
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cpplox/expression.hpp>
+#include <cpplox/statement.hpp>
+
+#include <boost/variant/recursive_variant.hpp>
+
+namespace lox
+{
+
+inline namespace optimizer
+{
+
+/**
+ * @brief fold the constant subtrees of an expression
+ * @return true if the expression is evaluated to a constant, which is either a Literal or a node
+ * annotated with `folded`
+ */
+class FoldExprVisitor : boost::static_visitor<bool>
+{
+public:
+  bool operator()(const Literal & literal);
+
+  bool operator()(const Unary & unary);
+
+  bool operator()(const Binary & binary);
+
+  bool operator()(const Group & group);
+
+  bool operator()(const Variable & variable);
+
+  bool operator()(const Assign & assign);
+
+  bool operator()(const Logical & logical);
+
+  bool operator()(const Call & call);
+
+  bool operator()(const ReadProperty & property);
+
+  bool operator()(const SetProperty & property);
+};
+
+class FoldStmtVisitor : boost::static_visitor<void>
+{
+public:
+  void operator()(const ExprStmt & stmt);
+
+  void operator()(const PrintStmt & stmt);
+
+  void operator()(const Block & block);
+
+  void operator()(const IfBlock & stmt);
+
+  void operator()(const WhileStmt & stmt);
+
+  void operator()(const ForStmt & stmt);
+
+  void operator()(const BreakStmt & stmt);
+
+  void operator()(const ContinueStmt & stmt);
+
+  void operator()(const ReturnStmt & stmt);
+};
+
+class FoldDeclVisitor : boost::static_visitor<void>
+{
+public:
+  void operator()(const VarDecl & var_decl);
+
+  void operator()(const Stmt & stmt);
+
+  void operator()(const FuncDecl & func_decl);
+
+  void operator()(const ClassDecl & class_decl);
+};
+
+/**
+ * @brief fold the constant Unary, Binary, Logical and Group subtrees of a resolved program. the
+ * root of each constant subtree is annotated with its value, and the engine uses the value instead
+ * of evaluating the subtree
+ * @note a subtree whose evaluation fails, like `1 + "a"` or an integer division by zero, is left
+ * as is so that the error is raised only if it is executed. the body of a function which is not
+ * yet materialized is skipped, and it is folded by `optimize_function()` on its first call
+ */
+auto optimize_program(const Program & program) -> void;
+
+/**
+ * @brief fold the constant subtrees in the body of a function
+ */
+auto optimize_function(const FuncDecl & func_decl) -> void;
+
+}  // namespace optimizer
+}  // namespace lox
@@ -1,20 +1,87 @@
 #pragma once
 
+#include <cpplox/arena.hpp>
 #include <cpplox/error.hpp>
 #include <cpplox/expression.hpp>
 #include <cpplox/statement.hpp>
 #include <cpplox/token.hpp>
+#include <cpplox/tokenizer.hpp>
 
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <vector>
 
 namespace lox
 {
 inline namespace parser
 {
+/**
+ * @brief how the bodies of the functions are parsed
+ */
+enum class ParseMode {
+  Eager,  //!< build the nodes of every body
+  Lazy,   //!< pre-parse the bodies by brace-matching, and parse each of them on its first call
+};
+
+/**
+ * @brief the binding power of the binary operators, from the lowest
+ */
+enum class Precedence : uint8_t {
+  None,        //!< not a binary operator
+  Or,          //!< or
+  And,         //!< and
+  Equality,    //!< == !=
+  Comparison,  //!< > >= < <=
+  Term,        //!< + -
+  Factor,      //!< * /
+};
+
+/**
+ * @brief the precedence of `type` as a binary operator
+ */
+constexpr auto binary_precedence(const TokenType type) noexcept -> Precedence
+{
+  switch (type) {
+    case TokenType::Or:
+      return Precedence::Or;
+    case TokenType::And:
+      return Precedence::And;
+    case TokenType::BangEqual:
+    case TokenType::EqualEqual:
+      return Precedence::Equality;
+    case TokenType::Greater:
+    case TokenType::GreaterEqual:
+    case TokenType::Less:
+    case TokenType::LessEqual:
+      return Precedence::Comparison;
+    case TokenType::Plus:
+    case TokenType::Minus:
+      return Precedence::Term;
+    case TokenType::Slash:
+    case TokenType::Star:
+      return Precedence::Factor;
+    default:
+      return Precedence::None;
+  }
+}
+
 class Parser
 {
 public:
-  explicit Parser(const Tokens & tokens);
+  explicit Parser(Tokens tokens, const ParseMode mode = ParseMode::Eager);
+
+  /**
+   * @brief parse the tokens which are pulled from `tokens` on demand
+   */
+  explicit Parser(TokenStream tokens, const ParseMode mode = ParseMode::Eager);
+
+  /**
+   * @brief parse the body of `func_decl` skipped by the pre-parse into the arena of its program.
+   * the functions in the body are pre-parsed again
+   * @post `func_decl.body` is set if succeeded. `func_decl.lazy` is kept for the resolution
+   */
+  static auto parse_body(const FuncDecl & func_decl) -> std::optional<SyntaxError>;
 
   /**
    * @brief <program> ::= <declaration>* EOF
@@ -79,18 +146,18 @@ public:
    *                       ("else" "{" <declaration>* "}")?
    * @detail responsible for consuming "if () {} else if (){}... else {}"
    */
-  auto if_block(const size_t if_start_ctx) -> std::variant<IfBlock, SyntaxError>;
+  auto if_block(const Token & if_start_ctx) -> std::variant<IfBlock, SyntaxError>;
 
   /**
    * @brief <while_stmt> ::= "while" "(" <expression> ")" "{" <declarations>* "}"
    */
-  auto while_stmt(const size_t while_start_ctx) -> std::variant<WhileStmt, SyntaxError>;
+  auto while_stmt(const Token & while_start_ctx) -> std::variant<WhileStmt, SyntaxError>;
 
   /**
    * @brief <for_stmt> ::= "for" "(" ( <var_decl> | <expr_stmt> | ";" ) <expression>? ";"
    *                       <expression>? ")" "{" <declaration>* "}"
    */
-  auto for_stmt(const size_t for_start_ctx) -> std::variant<ForStmt, SyntaxError>;
+  auto for_stmt(const Token & for_start_ctx) -> std::variant<ForStmt, SyntaxError>;
 
   /**
    * @brief <break_stmt> ::= "break" ";"
@@ -112,7 +179,7 @@ public:
    * @post after success, current_ is next to the last '}'
    * @detail responsible for consuming "( <cond> ){ <body> }"
    */
-  auto branch_clause(const size_t if_start_ctx) -> std::variant<BranchClause, SyntaxError>;
+  auto branch_clause(const Token & if_start_ctx) -> std::variant<BranchClause, SyntaxError>;
 
   /**
     @brief <expression> ::= <assignment>
@@ -124,6 +191,20 @@ public:
    */
   auto assignment() -> std::variant<Expr, SyntaxError>;
 
+  /**
+   * @brief parse <logic_or> by the precedence climbing. the operators of `min_precedence` or
+   * higher are consumed, and a binary node is made only when an operator is found
+   * @detail equivalent to logic_or() for Precedence::Or, but the operand is parsed by unary()
+   * directly instead of through a function per precedence level
+   */
+  auto binary(const Precedence min_precedence) -> std::variant<Expr, SyntaxError>;
+
+  /**
+   * @brief parse <logic_or> by the recursive descent from logic_or() to unary() rather than by
+   * binary(). this is kept as the reference of binary()
+   */
+  auto use_recursive_descent(const bool enable = true) -> void { recursive_descent_ = enable; }
+
   /**
    * @brief <logic_or> ::= <logic_and> ( "or" <logic_and> )*;
    */
@@ -135,8 +216,26 @@ public:
   auto logic_and() -> std::variant<Expr, SyntaxError>;
 
 private:
-  Tokens tokens_;
-  size_t current_{0};
+  TokenStream tokens_;
+  std::shared_ptr<Arena> arena_;  //!< the storage of the nodes, which is shared with the Program
+  ParseMode mode_;
+  bool recursive_descent_{false};
+
+  Parser(TokenStream tokens, const ParseMode mode, std::shared_ptr<Arena> arena);
+
+  /**
+   * @brief consume "{ <body> }" only by matching the braces, and record the range and the
+   * identifiers of the body
+   * @return the parsed body instead if the body declares a class
+   */
+  auto skip_body() -> std::variant<std::shared_ptr<LazyBody>, Block, SyntaxError>;
+
+  /**
+   * @brief parse the text of a body recorded by skip_body() as <block>
+   */
+  static auto parse_skipped(
+    const LazyBody & lazy, const ParseMode mode, std::shared_ptr<Arena> arena)
+    -> std::variant<Block, SyntaxError>;
 
   /**
     @brief <equality> ::= <comparison> (("==" | "!=") <comparison>)*
@@ -181,10 +280,10 @@ private:
   auto primary() -> std::variant<Expr, SyntaxError>;
 
   template <typename... Types>
-  auto match(const Types... types) const -> bool;
+  auto match(const Types... types) -> bool;
 
   template <typename TokenType, typename... TypeTail>
-  auto match(const TokenType & head, const TypeTail... tail) const -> bool
+  auto match(const TokenType & head, const TypeTail... tail) -> bool
   {
     const auto type = peek().type;
     if (type == head) {
@@ -196,23 +295,23 @@ private:
   /**
     @brief check if current token is at EOF
    */
-  auto is_at_end() const noexcept -> bool;
+  auto is_at_end() -> bool;
 
   /**
     @brief get current token
    */
-  auto peek() const -> const Token &;
+  auto peek() -> const Token &;
 
   /**
-    @brief increment current
+    @brief get current token and consume it
    */
-  auto advance() -> const Token &;
+  auto advance() -> Token;
 
-  auto create_error(const SyntaxErrorKind & kind, const size_t error_ctx) const -> SyntaxError;
+  auto create_error(const SyntaxErrorKind & kind, const Token & error_ctx) const -> SyntaxError;
 };
 
 template <>
-auto Parser::match(const TokenType & token) const -> bool
+inline auto Parser::match(const TokenType & token) -> bool
 {
   return peek().type == token;
 }
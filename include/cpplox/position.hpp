@@ -2,6 +2,8 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace lox
 {
@@ -9,21 +11,63 @@ namespace lox
 inline namespace position
 {
 
-struct Line
+/**
+ * @brief the start index of each line of a source. the tokens only keep their line numbers, and the
+ * columns and the ranges of the lines are looked up from this table when a diagnostic is printed
+ */
+class LineTable
 {
-  Line(
-    const std::optional<std::string> & filename, const size_t number, const size_t start_index,
-    const size_t end_index)
-  : filename(filename), number(number), start_index(start_index), end_index(end_index)
+public:
+  explicit LineTable(
+    const std::string_view source, std::optional<std::string> filename = std::nullopt);
+
+  auto source() const noexcept -> std::string_view { return source_; }
+
+  /**
+   * @brief the name of the source file, which is null in REPL
+   */
+  auto filename() const noexcept -> const std::optional<std::string> & { return filename_; }
+
+  auto line_count() const noexcept -> size_t { return start_indices_.size(); }
+
+  /**
+   * @brief get the index of `text[0]` on the source
+   * @pre `text` is a part of the source
+   */
+  auto offset(const std::string_view text) const noexcept -> size_t
   {
+    return static_cast<size_t>(text.data() - source_.data());
   }
 
-  const std::optional<std::string> filename;  //!< this value is null in REPL
-  const size_t number;                        //!< the line number(starting from 1, not index)
-  const size_t start_index;  //!< the index of cursor position for the beginning of this line on the
-                             //!< program string
-  const size_t end_index;    //!< the index of cursor position for the end of this line on the
-                             //!< program string
+  /**
+   * @brief get the index of the beginning of the line `number`(starting from 1)
+   */
+  auto start_index(const size_t number) const -> size_t { return start_indices_.at(number - 1); }
+
+  /**
+   * @brief get the index of the '\n' of the line `number`, or the index of the last character of
+   * the source for the last line
+   */
+  auto end_index(const size_t number) const -> size_t;
+
+  /**
+   * @brief get the line number(starting from 1) which contains the index `offset`
+   */
+  auto line_number(const size_t offset) const -> size_t;
+
+  /**
+   * @brief get the column number(starting from 1) of the index `offset` on its line
+   */
+  auto column(const size_t offset) const -> size_t
+  {
+    return offset - start_index(line_number(offset)) + 1;
+  }
+
+private:
+  std::string_view source_;
+  std::optional<std::string> filename_;
+  std::vector<size_t> start_indices_;
 };
+
 }  // namespace position
 }  // namespace lox
@@ -9,35 +9,74 @@
 #include <deque>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
-namespace std
+namespace lox
 {
-template <>
-struct hash<lox::token::Token>
+
+inline namespace resolver
 {
-  size_t operator()(const lox::token::Token & token) const
-  {
-    size_t h1 = std::hash<lox::token::TokenType>()(token.type);
-    size_t h2 = std::hash<std::string_view>()(token.lexeme);
-    size_t h3 = std::hash<size_t>()(token.start_index);
-    return h1 ^ (h2 << 1) ^ (h3 << 2);
-  }
-};
-}  // namespace std
 
-namespace lox
+/**
+ * @brief the state of a variable in a scope during resolution
+ */
+struct ScopeEntry
 {
+  bool defined;  //!< false while its initializer is resolved
+  /**
+   * @brief the index of the variable in the frame of its function if it is local, or in the global
+   * Environment
+   */
+  size_t slot;
+  bool captured{false};  //!< true if a nested function refers to the local variable
+  /**
+   * @brief true if the variable is already the upvalue at `slot` of the function enclosed by the
+   * scope, which is the case for the variables captured by a function resolved later
+   */
+  bool upvalue{false};
+};
 
-inline namespace resolver
+/**
+ * @brief the slot of a new variable is the number of the variables declared before in the scope
+ */
+using Scope = std::unordered_map<std::string_view, ScopeEntry>;
+
+/**
+ * @brief a scope which is open during resolution
+ */
+struct LexicalScope
 {
+  Scope variables;
+  size_t function{0};  //!< the nesting level of the function which the scope belongs to
+  /**
+   * @brief false for the global scope and the scopes outside of the resolved code, whose variables
+   * are not in the frames. only the outermost one of them is the global scope
+   */
+  bool local{true};
+  size_t environment_size{0};  //!< the number of the variables in the global Environment
+  size_t stack_base{0};        //!< the slots of the frame in use when the scope is opened
+};
 
-using ScopeChain = std::deque<std::unordered_map<std::string_view, bool>>;
-using ScopeLookup = std::unordered_map<Token, size_t>;
+/**
+ * @brief the scopes from the outermost to the innermost one, and the functions enclosing the
+ * innermost scope whose upvalues are collected
+ */
+struct ScopeChain
+{
+  std::deque<LexicalScope> scopes;
+  /**
+   * @brief the upvalues of the function at each nesting level. the top-level code at level 0 has
+   * none
+   */
+  std::vector<std::vector<UpvalueRef> *> functions{nullptr};
+  size_t stack_size{0};  //!< the slots of the frame of the current function in use
+  size_t frame_size{0};  //!< the maximum of `stack_size` in the current function
+};
 
 class StmtResolver : boost::static_visitor<std::optional<CompileError>>
 {
 public:
-  StmtResolver(ScopeChain & scopes, ScopeLookup & lookup) : scopes(scopes), lookup(lookup) {}
+  explicit StmtResolver(ScopeChain & chain) : chain(chain) {}
 
   std::optional<CompileError> operator()(const ExprStmt & stmt);
 
@@ -58,17 +97,19 @@ public:
   std::optional<CompileError> operator()(const ReturnStmt & stmt);
 
 private:
-  ScopeChain & scopes;
-  ScopeLookup & lookup;
+  ScopeChain & chain;
 
   void begin_scope();
-  void end_scope();
+  /**
+   * @param captured_base the annotation of the node which opened the scope
+   */
+  void end_scope(std::optional<size_t> & captured_base);
 };
 
 class DeclResolver : boost::static_visitor<std::optional<CompileError>>
 {
 public:
-  DeclResolver(ScopeChain & scopes, ScopeLookup & lookup) : scopes(scopes), lookup(lookup) {}
+  explicit DeclResolver(ScopeChain & chain) : chain(chain) {}
 
   std::optional<CompileError> operator()(const VarDecl & var_decl);
 
@@ -79,19 +120,19 @@ public:
   std::optional<CompileError> operator()(const ClassDecl & class_decl);
 
 private:
-  ScopeChain & scopes;
-  ScopeLookup & lookup;
+  ScopeChain & chain;
 
-  void begin_scope();
-  void end_scope();
-  void declare(const Token & name);
+  /**
+   * @brief declare the variable in the innermost scope and return its slot
+   */
+  auto declare(const Token & name) -> size_t;
   void define(const Token & name);
 };
 
 class ExprResolver : boost::static_visitor<std::optional<CompileError>>
 {
 public:
-  ExprResolver(ScopeChain & scopes, ScopeLookup & lookup) : scopes(scopes), lookup(lookup) {}
+  explicit ExprResolver(ScopeChain & chain) : chain(chain) {}
 
   std::optional<CompileError> operator()(const Literal & literal);
 
@@ -114,11 +155,34 @@ public:
   std::optional<CompileError> operator()(const SetProperty & property);
 
 private:
-  ScopeChain & scopes;
-  ScopeLookup & lookup;
+  ScopeChain & chain;
 
-  void resolve_local(const Token & name);
+  auto resolve_local(const Token & name) -> std::optional<VariableLocation>;
 };
 
+/**
+ * @brief resolve the declarations of the program from the global scope
+ * @param global_scope the global variables declared so far, which is updated if the resolution
+ * succeeded
+ * @post the slot of each declaration and the location of each resolved variable are annotated to
+ * the nodes of `program`. the local variables are placed in the frames of their functions, and the
+ * ones referred from the nested functions are captured as their upvalues
+ * @note if `program.resolved_globals` is set and `global_scope` is empty, the annotations are
+ * reused and only the global variables are restored
+ */
+auto resolve_program(const Program & program, Scope & global_scope) -> std::optional<CompileError>;
+
+/**
+ * @brief parse and resolve the body of a function skipped by the pre-parse, if it is not yet. this
+ * has to be called before the body is executed or compiled
+ * @return a SyntaxError in the body or a CompileError of the body
+ */
+auto materialize_body(const FuncDecl & func_decl) -> std::optional<RuntimeError>;
+
+/**
+ * @brief get the global variables of a resolved program in the order of the slots
+ */
+auto to_global_slots(const Scope & global_scope) -> std::vector<GlobalSlot>;
+
 }  // namespace resolver
 }  // namespace lox
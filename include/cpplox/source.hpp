@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace lox
+{
+
+inline namespace source
+{
+
+/**
+ * @brief the text of a script, which is either a read-only mapping of a file or an owned string.
+ * the tokens, the AST and the errors refer to the text by string_view, so the buffer is never
+ * copied and has to outlive them
+ */
+class SourceBuffer
+{
+public:
+  /**
+   * @brief map the file at `path` to the memory. a file which cannot be mapped, like a pipe, is
+   * read into a string instead
+   * @return nullopt if the file cannot be opened or read
+   */
+  static auto open(const std::string & path) -> std::optional<SourceBuffer>;
+
+  explicit SourceBuffer(std::string text);
+
+  SourceBuffer(SourceBuffer && other) noexcept;
+  SourceBuffer(const SourceBuffer &) = delete;
+  SourceBuffer & operator=(const SourceBuffer &) = delete;
+  SourceBuffer & operator=(SourceBuffer &&) = delete;
+  ~SourceBuffer();
+
+  auto view() const noexcept -> std::string_view { return view_; }
+
+  /**
+   * @brief check if the text is mapped from a file rather than owned
+   */
+  auto is_mapped() const noexcept -> bool { return mapping_ != nullptr; }
+
+private:
+  SourceBuffer(void * mapping, const size_t size);
+
+  std::string text_;         //!< the storage of the text if it is not mapped
+  void * mapping_{nullptr};  //!< the address of the mapping, or null
+  size_t mapping_size_{0};
+  std::string_view view_;
+};
+
+}  // namespace source
+}  // namespace lox
@@ -1,9 +1,13 @@
 #pragma once
+#include <cpplox/arena.hpp>
 #include <cpplox/expression.hpp>
 
-#include <boost/variant/recursive_variant.hpp>
+#include <boost/variant.hpp>
 
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -15,12 +19,12 @@ inline namespace stmt
 
 struct ExprStmt
 {
-  const Expr expression;
+  Expr expression;
 };
 
 struct PrintStmt
 {
-  const Expr expression;
+  Expr expression;
 };
 
 struct Block;
@@ -37,73 +41,125 @@ struct ContinueStmt;
 
 struct ReturnStmt
 {
-  const std::optional<Expr> expr;
+  std::optional<Expr> expr;
 };
 
 using Stmt = boost::variant<
-  ExprStmt, PrintStmt, boost::recursive_wrapper<Block>, boost::recursive_wrapper<IfBlock>,
-  boost::recursive_wrapper<WhileStmt>, boost::recursive_wrapper<ForStmt>, BreakStmt, ContinueStmt,
-  ReturnStmt>;
+  ExprStmt, PrintStmt, Ref<Block>, Ref<IfBlock>, Ref<WhileStmt>, Ref<ForStmt>, BreakStmt,
+  ContinueStmt, ReturnStmt>;
 
 struct VarDecl
 {
-  const Token name;
-  const std::optional<Expr> initializer;
+  Token name;
+  std::optional<Expr> initializer;
+  mutable size_t slot{0};  //!< annotated by the resolver
+  /**
+   * @brief annotated by the resolver if the variable is local, then `slot` is the index in the
+   * frame of the function instead of the global Environment
+   */
+  mutable bool on_stack{false};
 };
 
 struct FuncDecl;
 
 struct ClassDecl;
 
-using Declaration = boost::variant<
-  VarDecl, Stmt, boost::recursive_wrapper<FuncDecl>, boost::recursive_wrapper<ClassDecl>>;
+using Declaration = boost::variant<VarDecl, Stmt, Ref<FuncDecl>, Ref<ClassDecl>>;
 
 struct Block
 {
   std::vector<Declaration> declarations;
+  /**
+   * @brief annotated by the resolver if a variable of the block is captured by a closure. it is
+   * the first slot of the frame used by the block, and the upvalues at or above it are closed when
+   * the block exits. the upvalues of the body of a function are closed by its return instead
+   */
+  mutable std::optional<size_t> captured_base{std::nullopt};
+};
+
+/**
+ * @brief the body of a function which is only brace-matched by the pre-parse. it is parsed and
+ * resolved on the first call by `materialize_body()`
+ */
+struct LazyBody
+{
+  std::string_view source;              //!< the text from '{' to '}'
+  uint32_t line;                        //!< the line of '{'
+  std::weak_ptr<Arena> arena;           //!< the storage of the nodes of the body
+  std::vector<std::string_view> names;  //!< the identifiers in the body without duplicates
+  /**
+   * @brief the variables in `names` which are declared in the enclosing scopes, either the global
+   * ones or the local ones captured as the upvalues of the function. annotated by the resolver at
+   * the declaration
+   */
+  std::unordered_map<std::string_view, VariableLocation> captures{};
+};
+
+/**
+ * @brief where a closure takes its upvalue from when it is created
+ */
+struct UpvalueRef
+{
+  size_t index;   //!< the slot of the frame of the enclosing function, or its upvalue
+  bool is_local;  //!< true if `index` is the slot of the frame
 };
 
 struct FuncDecl
 {
-  const Token name;
-  const Tokens parameters;
-  const Block body;
+  Token name;
+  Tokens parameters;
+  mutable Block body;                               //!< empty until materialized if `lazy` is set
+  mutable size_t slot{0};                           //!< annotated by the resolver
+  mutable std::vector<size_t> parameter_slots{};    //!< annotated by the resolver
+  mutable std::shared_ptr<LazyBody> lazy{nullptr};  //!< set while the body is not parsed
+  mutable bool on_stack{false};  //!< the same as VarDecl::on_stack for the name of the function
+  mutable size_t frame_size{0};  //!< the number of the slots of the frame of a call
+  mutable std::vector<UpvalueRef> upvalues{};  //!< annotated by the resolver
 };
 
 struct ClassDecl
 {
-  const Token name;
-  const std::unordered_map<std::string_view, FuncDecl> methods;
+  Token name;
+  std::unordered_map<std::string_view, FuncDecl> methods;
+  mutable size_t slot{0};  //!< the slot in the global scope, annotated by the resolver
 };
 
 struct BranchClause
 {
-  const std::optional<VarDecl> declaration;
-  const Expr cond;
-  const Block body;
+  std::optional<VarDecl> declaration;
+  Expr cond;
+  Block body;
+  /**
+   * @brief the same as Block for `declaration`
+   */
+  mutable std::optional<size_t> captured_base{std::nullopt};
 };
 
 struct IfBlock
 {
-  const BranchClause if_clause;
-  const std::vector<BranchClause> elseif_clauses;
-  const std::optional<Block> else_body;
+  BranchClause if_clause;
+  std::vector<BranchClause> elseif_clauses;
+  std::optional<Block> else_body;
 };
 
 struct WhileStmt
 {
-  const Token while_token;
-  const Expr cond;
-  const Block body;
+  Token while_token;
+  Expr cond;
+  Block body;
 };
 
 struct ForStmt
 {
-  const Token for_token;
-  const std::optional<std::variant<VarDecl, ExprStmt>> init_stmt;
-  const std::optional<Expr> cond;
-  const std::optional<Expr> next;
-  const Block body;
+  Token for_token;
+  std::optional<std::variant<VarDecl, ExprStmt>> init_stmt;
+  std::optional<Expr> cond;
+  std::optional<Expr> next;
+  Block body;
+  /**
+   * @brief the same as Block for `init_stmt`
+   */
+  mutable std::optional<size_t> captured_base{std::nullopt};
 };
 
 struct BreakStmt
@@ -114,7 +170,29 @@ struct ContinueStmt
 {
 };
 
-using Program = std::vector<Declaration>;
+/**
+ * @brief a global variable declared by a program, and its slot in the global Environment
+ */
+struct GlobalSlot
+{
+  std::string_view name;
+  size_t slot;
+};
+
+struct Program
+{
+  std::vector<Declaration> declarations;
+  std::shared_ptr<const Arena> arena;  //!< owns the nodes referred from `declarations`
+  /**
+   * @brief set if the nodes are already annotated by the resolver from an empty global scope, like
+   * a program loaded from a cache. then the resolution only restores these global variables
+   */
+  std::optional<std::vector<GlobalSlot>> resolved_globals{std::nullopt};
+  /**
+   * @brief the number of the slots of the frame of the top-level code, annotated by the resolver
+   */
+  mutable size_t frame_size{0};
+};
 
 }  // namespace stmt
 }  // namespace lox
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace lox
+{
+
+inline namespace string
+{
+
+/**
+ * @brief immutable and reference-counted string value. copying a String only copies a pointer, and
+ * its hash is computed once on construction. the interned Strings with the same contents share the
+ * same object, so they are compared by pointer
+ */
+class String
+{
+public:
+  String() : String(std::string{}) {}
+
+  explicit String(std::string value);
+
+  /**
+   * @brief return the interned String of `value`, which is created on the first call
+   * @note the interned strings are kept until the end of the process, so this is meant for the
+   * literals of the program
+   */
+  static auto intern(const std::string_view value) -> String;
+
+  auto str() const noexcept -> const std::string & { return impl_->value; }
+
+  auto view() const noexcept -> std::string_view { return impl_->value; }
+
+  auto hash() const noexcept -> size_t { return impl_->hash; }
+
+  auto is_interned() const noexcept -> bool { return impl_->interned; }
+
+  friend auto operator==(const String & left, const String & right) noexcept -> bool
+  {
+    if (left.impl_ == right.impl_) {
+      return true;
+    }
+    if ((left.is_interned() && right.is_interned()) || left.hash() != right.hash()) {
+      return false;
+    }
+    return left.str() == right.str();
+  }
+
+  friend auto operator!=(const String & left, const String & right) noexcept -> bool
+  {
+    return !(left == right);
+  }
+
+  friend auto operator==(const String & left, const std::string_view right) noexcept -> bool
+  {
+    return left.view() == right;
+  }
+
+  friend auto operator==(const std::string_view left, const String & right) noexcept -> bool
+  {
+    return left == right.view();
+  }
+
+  friend auto operator+(const String & left, const String & right) -> String
+  {
+    std::string value;
+    value.reserve(left.str().size() + right.str().size());
+    value.append(left.str()).append(right.str());
+    return String(std::move(value));
+  }
+
+  friend auto operator<<(std::ostream & os, const String & str) -> std::ostream &
+  {
+    return os << str.str();
+  }
+
+private:
+  struct Impl
+  {
+    const std::string value;
+    const size_t hash;
+    const bool interned;
+  };
+
+  explicit String(std::shared_ptr<const Impl> impl) : impl_(std::move(impl)) {}
+
+  std::shared_ptr<const Impl> impl_;
+};
+
+}  // namespace string
+}  // namespace lox
+
+namespace std
+{
+template <>
+struct hash<lox::String>
+{
+  size_t operator()(const lox::String & str) const noexcept { return str.hash(); }
+};
+}  // namespace std
@@ -2,9 +2,18 @@
 
 #include <cpplox/position.hpp>
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <iterator>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace lox
@@ -13,7 +22,7 @@ namespace lox
 inline namespace token
 {
 
-enum class TokenType {
+enum class TokenType : uint8_t {
   // single token
   LeftParen,   // (
   RightParen,  // )
@@ -65,8 +74,16 @@ enum class TokenType {
   Eof,
 };
 
+namespace perfect_hash
+{
+struct Keyword
+{
+  std::string_view text;
+  TokenType type;
+};
+
 // clang-format off
-static const std::unordered_map<std::string_view, TokenType> keyword_map = {
+static constexpr Keyword keywords[] = {
   {"and", TokenType::And},
   {"break", TokenType::Break},
   {"class", TokenType::Class},
@@ -86,43 +103,172 @@ static const std::unordered_map<std::string_view, TokenType> keyword_map = {
   {"var", TokenType::Var},
   {"while", TokenType::While},
 };
-
 // clang-format on
 
-inline auto is_keyword(const std::string_view & str) -> bool
+static constexpr size_t KeywordCount = std::size(keywords);
+static constexpr size_t KeywordTableSize = 32;
+
+/**
+ * @brief the length of the longest keyword if `longest`, otherwise of the shortest keyword
+ */
+constexpr auto keyword_length(const bool longest) noexcept -> size_t
 {
-  return keyword_map.find(str) != keyword_map.end();
+  size_t length = keywords[0].text.size();
+  for (const auto & keyword : keywords) {
+    const auto size = keyword.text.size();
+    length = longest ? std::max(length, size) : std::min(length, size);
+  }
+  return length;
+}
+
+static constexpr size_t KeywordMinLength = keyword_length(false);
+static constexpr size_t KeywordMaxLength = keyword_length(true);
+
+/**
+ * @brief hash a word of [KeywordMinLength, KeywordMaxLength] characters by its first and last
+ * characters and its length
+ */
+constexpr auto keyword_hash(const std::string_view & str, const size_t seed) noexcept -> size_t
+{
+  return (static_cast<unsigned char>(str.front()) * seed +
+          static_cast<unsigned char>(str.back()) + str.size()) %
+         KeywordTableSize;
 }
 
+/**
+ * @brief find the smallest seed with which no keywords collide, or 0 if there is none
+ */
+constexpr auto find_keyword_seed() noexcept -> size_t
+{
+  for (size_t seed = 1; seed < 256; ++seed) {
+    bool used[KeywordTableSize] = {};
+    bool collided = false;
+    for (const auto & keyword : keywords) {
+      const auto h = keyword_hash(keyword.text, seed);
+      collided = collided or used[h];
+      used[h] = true;
+    }
+    if (!collided) {
+      return seed;
+    }
+  }
+  return 0;
+}
+
+static constexpr size_t KeywordSeed = find_keyword_seed();
+static_assert(KeywordSeed != 0, "no perfect hash for the keywords, enlarge KeywordTableSize");
+
+/**
+ * @brief the index to `keywords` plus 1 for each hash value, or 0 for an empty slot
+ */
+constexpr auto make_keyword_table() noexcept -> std::array<uint8_t, KeywordTableSize>
+{
+  std::array<uint8_t, KeywordTableSize> table{};
+  for (size_t i = 0; i < KeywordCount; ++i) {
+    table[keyword_hash(keywords[i].text, KeywordSeed)] = static_cast<uint8_t>(i + 1);
+  }
+  return table;
+}
+
+static constexpr std::array<uint8_t, KeywordTableSize> keyword_table = make_keyword_table();
+}  // namespace perfect_hash
+
+/**
+ * @brief get the type of the keyword `str` by the perfect hash built at compile time, which costs
+ * a single string comparison and no allocation
+ * @return nullopt if `str` is not a keyword
+ */
+constexpr auto keyword_type(const std::string_view & str) noexcept -> std::optional<TokenType>
+{
+  using namespace perfect_hash;
+  if (str.size() < KeywordMinLength or KeywordMaxLength < str.size()) {
+    return std::nullopt;
+  }
+  const auto slot = keyword_table[keyword_hash(str, KeywordSeed)];
+  if (slot == 0 or keywords[slot - 1].text != str) {
+    return std::nullopt;
+  }
+  return keywords[slot - 1].type;
+}
+
+constexpr auto is_keyword(const std::string_view & str) noexcept -> bool
+{
+  return keyword_type(str).has_value();
+}
+
+static_assert(keyword_type("continue") == TokenType::Continue);
+static_assert(!is_keyword("fn"));
+
+using Number = std::variant<int64_t, double>;
+
+/**
+ * @brief convert the lexeme of a number token without exceptions. the lexeme is int64_t if it does
+ * not contain '.', otherwise double
+ * @return nullopt if the whole lexeme cannot be interpreted as a number
+ */
+inline auto parse_number(const std::string_view & lexeme) noexcept -> std::optional<Number>
+{
+  const auto * const first = lexeme.data();
+  const auto * const last = lexeme.data() + lexeme.size();
+  double d = 0.0;
+  const auto [ptr_d, ec_d] = std::from_chars(first, last, d);
+  if (ec_d != std::errc{} or ptr_d != last) {
+    return std::nullopt;
+  }
+  if (lexeme.find('.') != std::string_view::npos) {
+    return Number{d};
+  }
+  int64_t i = 0;
+  const auto [ptr_i, ec_i] = std::from_chars(first, last, i);
+  if (ec_i == std::errc{} and ptr_i == last) {
+    return Number{i};
+  }
+  // like "1e3", which is an integer written in the exponent form
+  if (d < -9.2e18 or 9.2e18 < d) {
+    return std::nullopt;
+  }
+  return Number{static_cast<int64_t>(d)};
+}
+
+/**
+ * @brief a token refers to its lexeme on the source and keeps only the line number, so that it is
+ * 24 bytes and copied without touching any reference count. the column is looked up from the
+ * LineTable of the source when it is needed
+ */
 class Token
 {
 public:
-  Token(
-    const TokenType type, const std::string_view & lexeme, const std::shared_ptr<Line> line,
-    const size_t start_index)
-  : type(type), lexeme(lexeme), line(line), start_index(start_index)
+  Token() = default;
+
+  Token(const TokenType type, const std::string_view & lexeme, const size_t line)
+  : lexeme(lexeme), line(static_cast<uint32_t>(line)), type(type)
   {
   }
 
-  Token(const Token & other)
-  : type(other.type), lexeme(other.lexeme), line(other.line), start_index(other.start_index)
+  bool operator==(const Token & other) const
   {
+    return type == other.type && lexeme == other.lexeme && lexeme.data() == other.lexeme.data();
   }
 
-  bool operator==(const Token & other) const
+  /**
+   * @brief get the index of lexeme[0] on the source
+   */
+  auto get_start_index(const LineTable & lines) const noexcept -> size_t
   {
-    return type == other.type && lexeme == other.lexeme && start_index == other.start_index;
+    return lines.offset(lexeme);
   }
 
   /**
    * @brief get the column number on its line, starting from 1
    */
-  auto get_lexical_column() const noexcept -> size_t { return start_index - line->start_index + 1; }
+  auto get_lexical_column(const LineTable & lines) const -> size_t
+  {
+    return get_start_index(lines) - lines.start_index(line) + 1;
+  }
 
-  const TokenType type;
-  const std::string_view lexeme;  //<! lexeme has the length information
-  const std::shared_ptr<Line> line;
-  const size_t start_index;  //!< the index of lexeme[0]
+  std::string_view lexeme;  //<! lexeme has the length information
+  uint32_t line{0};         //!< the line number starting from 1
+  TokenType type{TokenType::Eof};
 };
 
 using Tokens = std::vector<Token>;
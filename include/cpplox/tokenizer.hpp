@@ -2,9 +2,11 @@
 #include <cpplox/error.hpp>
 #include <cpplox/token.hpp>
 
+#include <array>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -17,20 +19,29 @@ inline namespace tokenizer
 class Tokenizer
 {
 public:
-  explicit Tokenizer(const std::string & source);
+  /**
+   * @param first_line the line number of the beginning of `source`, which is not 1 if `source` is
+   * a part of a larger source
+   * @note the tokens refer to `source`, so it has to outlive them
+   */
+  explicit Tokenizer(const std::string_view source, const size_t first_line = 1);
 
   auto is_at_end() const noexcept -> bool;
 
   /**
-   * @brief return the internal stored tokens to caller
-   * @post internal stored tokens get empty
+   * @brief scan the whole source and return all the tokens
    */
   auto take_tokens() -> std::variant<Tokens, SyntaxError>;
 
+  /**
+   * @brief scan the next token on demand, without storing it
+   * @return the next token, nullopt at the end of the source, or SyntaxError
+   */
+  auto next_token() -> std::variant<std::optional<Token>, SyntaxError>;
+
 private:
-  const std::string & source_;
-  Tokens tokens_;
-  std::vector<std::shared_ptr<Line>> lines_;
+  std::string_view source_;
+  std::optional<Token> scanned_;  //!< the token found by the last scan_new_token(), if any
 
   /**
    * @brief get current peek() character and then increment the cursor
@@ -79,7 +90,18 @@ private:
   auto add_identifier_token() -> std::optional<SyntaxError>;
 
   /**
-   * @brief increment line number and reset column number
+   * @brief skip ' ', '\r', '\t' and '\n' from the current cursor, and count the lines
+   * @post current cursor points to a non-whitespace character or the end
+   */
+  auto skip_whitespace() -> void;
+
+  /**
+   * @brief skip [a-zA-Z0-9_] from the current cursor
+   */
+  auto skip_identifier() -> void;
+
+  /**
+   * @brief increment line number
    */
   auto handle_newline() -> void;
 
@@ -93,23 +115,93 @@ private:
    */
   auto get_token_start_column() const noexcept -> size_t;
 
-  auto get_next_newline_or_eof() const noexcept -> size_t;
-
   auto create_error(const SyntaxErrorKind kind) -> SyntaxError;
 
   size_t current_ctx_start_cursor_{0};  //!< save the start of a token while scanning the token
                                         //!< to the end
   size_t current_cursor_{0};            //!< the current position of scanner
   size_t line_{1};  //!< the current line number (number of '\n' so far) starting from 1
-  size_t current_line_start_index_{0};  //!< the start index of current line
+  size_t current_ctx_start_line_{1};  //!< the line number of current_ctx_start_cursor_
+};
+
+/**
+ * @brief the tokens of a source which are scanned on demand. only the tokens within the lookahead
+ * window are kept in a ring buffer, so the memory does not grow with the length of the source. the
+ * stream ends with EOF forever, which is placed right after the last token
+ */
+class TokenStream
+{
+public:
+  static constexpr size_t Lookahead = 4;
+  static_assert((Lookahead & (Lookahead - 1)) == 0, "Lookahead must be a power of 2");
+
+  /**
+   * @brief scan `source` lazily
+   * @param first_line the line number of the beginning of `source`
+   * @note the tokens refer to `source`, so it has to outlive them
+   */
+  explicit TokenStream(const std::string_view source, const size_t first_line = 1);
+
+  /**
+   * @brief yield the tokens which are already scanned
+   */
+  explicit TokenStream(Tokens tokens);
+
+  /**
+   * @brief get the k-th token ahead of the current one, no consumption
+   * @pre k < Lookahead
+   */
+  auto peek(const size_t k = 0) -> const Token &;
+
+  /**
+   * @brief get the current token and consume it. EOF is never consumed
+   */
+  auto advance() -> Token;
+
+  /**
+   * @brief the error of the tokenizer. the stream yields EOF after an error
+   */
+  auto error() const noexcept -> const std::optional<SyntaxError> & { return error_; }
+
+  /**
+   * @brief scan the rest of the source without keeping the tokens, to find an error of the
+   * tokenizer after the current position
+   */
+  auto drain() -> const std::optional<SyntaxError> &;
+
+private:
+  /**
+   * @brief get the token after the last one in the ring buffer
+   */
+  auto next() -> Token;
+
+  std::optional<Tokenizer> tokenizer_;  //!< null if the tokens are already scanned
+  Tokens replayed_;
+  size_t replayed_index_{0};
+
+  std::array<Token, Lookahead> ring_;
+  size_t head_{0};  //!< the index of the current token on ring_
+  size_t size_{0};  //!< the number of the tokens in ring_
+
+  std::optional<Token> last_;  //!< the last token before EOF
+  std::optional<Token> eof_;   //!< set once the end of the tokens is reached
+  std::optional<SyntaxError> error_;
 };
 
-auto is_digit(const char c) -> bool
+/**
+ * @brief tokenize `source` on `n_threads` threads (all the cores if 0). the source is split at the
+ * newlines outside of the string literals, and the tokens of the chunks are concatenated, so that
+ * the result is identical to `Tokenizer(source).take_tokens()`
+ */
+auto take_tokens_parallel(const std::string_view source, const size_t n_threads = 0)
+  -> std::variant<Tokens, SyntaxError>;
+
+inline auto is_digit(const char c) -> bool
 {
   return c >= '0' and c <= '9';
 }
 
-auto is_alpha(const char c) -> bool
+inline auto is_alpha(const char c) -> bool
 {
   return (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z') or c == '_';
 }
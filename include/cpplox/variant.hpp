@@ -1,4 +1,5 @@
 #pragma once
+#include <cpplox/arena.hpp>
 
 #include <boost/variant.hpp>
 
@@ -70,8 +71,9 @@ struct is_variant<
   struct check<T, Variant<Head, Tail...>>
   : std::conditional_t<
       std::disjunction<
-        std::is_same<T, Head>,                           //<! normal case OR
-        std::is_same<boost::recursive_wrapper<T>, Head>  //<! recursive variant
+        std::is_same<T, Head>,                            //<! normal case OR
+        std::is_same<boost::recursive_wrapper<T>, Head>,  //<! recursive variant OR
+        std::is_same<Ref<T>, Head>                        //<! node in Arena
         >::value,
       std::true_type, check<T, Variant<Tail...>>>
   {
@@ -81,8 +83,9 @@ struct is_variant<
   struct check<T, Variant<Head>>
   : std::conditional_t<
       std::disjunction<
-        std::is_same<T, Head>,                           //<! normal case OR
-        std::is_same<boost::recursive_wrapper<T>, Head>  //<! recursive variant
+        std::is_same<T, Head>,                            //<! normal case OR
+        std::is_same<boost::recursive_wrapper<T>, Head>,  //<! recursive variant OR
+        std::is_same<Ref<T>, Head>                        //<! node in Arena
         >::value,
       std::true_type, std::false_type>
   {
@@ -95,6 +98,19 @@ struct is_variant<
 template <typename T, typename V>
 static constexpr bool is_within = is_variant<V>::template is_within<T>;
 
+/**
+ * @brief check if the boost::variant holds T as Ref<T>
+ */
+template <typename T, typename V>
+struct is_ref_within : std::false_type
+{
+};
+
+template <typename T, typename... Ts>
+struct is_ref_within<T, boost::variant<Ts...>> : std::disjunction<std::is_same<Ref<T>, Ts>...>
+{
+};
+
 }  // namespace detail
 
 /**
@@ -110,7 +126,11 @@ auto is_variant_v(const V & v) ->
     return std::holds_alternative<T>(v);
   }
   if constexpr (detail::checker_for_boost<typename std::decay_t<V>>::value) {
-    return boost::get<T>(&v) != nullptr;
+    if constexpr (detail::is_ref_within<T, typename std::decay_t<V>>::value) {
+      return boost::get<Ref<T>>(&v) != nullptr;
+    } else {
+      return boost::get<T>(&v) != nullptr;
+    }
   }
 }
 
@@ -127,13 +147,18 @@ auto as_variant(V && v) ->
     return std::get<T>(std::forward<V>(v));
   }
   if constexpr (detail::checker_for_boost<typename std::decay_t<V>>::value) {
-    return boost::get<T>(std::forward<V>(v));
+    if constexpr (detail::is_ref_within<T, typename std::decay_t<V>>::value) {
+      return boost::get<Ref<T>>(v).get();
+    } else {
+      return boost::get<T>(std::forward<V>(v));
+    }
   }
 }
 
 /**
  * @brief statically check if the specified type is the candidate of the given variant and return
  * the reference to the internal hold data as specified type
+ * @note the nodes in Arena are immutable, so they are not accessible by this function
  */
 template <typename T, typename V>
 auto as_variant_mut(V && v) ->
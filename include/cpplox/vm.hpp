@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cpplox/chunk.hpp>
+#include <cpplox/compiler.hpp>
+#include <cpplox/error.hpp>
+#include <cpplox/object.hpp>
+#include <cpplox/statement.hpp>
+#include <cpplox/system.hpp>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lox
+{
+
+namespace vm
+{
+
+/**
+ * @brief stack-based virtual machine which executes the program compiled by Compiler. the
+ * semantics follows the tree-walking interpreter, which is the reference engine
+ */
+class VM
+{
+public:
+  static constexpr size_t max_call_depth = max_recursion_limit;
+
+  VM() = default;
+
+  /**
+   * @brief resolve, compile and execute the given program
+   */
+  [[nodiscard]] auto execute(const Program & program) -> std::optional<RuntimeError>;
+
+  auto get_variable(const Token & token) const -> std::optional<Value>;
+
+private:
+  struct CallFrame
+  {
+    Closure * closure;  //!< kept alive by the stack slot 0 of this frame
+    const uint8_t * ip;
+    size_t base;  //!< the stack index of slot 0 of this frame
+  };
+
+  Scope global_scope_;  //!< the global variables known to the resolver
+  GlobalTable global_table_;
+  std::vector<Value> globals_;
+  std::vector<bool> defined_;
+  std::vector<Value> stack_;
+  std::vector<CallFrame> frames_;
+  std::vector<std::shared_ptr<Upvalue>> open_upvalues_;  //!< sorted by slot in ascending order
+  std::vector<std::shared_ptr<const Arena>> arenas_;  //!< the nodes referred by the compiled code
+
+  auto run() -> std::optional<RuntimeError>;
+
+  auto capture_upvalue(const size_t slot) -> std::shared_ptr<Upvalue>;
+
+  /**
+   * @brief close all the open upvalues which refer to the slots at or above `slot`
+   */
+  auto close_upvalues(const size_t slot) -> void;
+
+  /**
+   * @brief discard the execution state after an error
+   */
+  auto reset() -> void;
+};
+
+}  // namespace vm
+}  // namespace lox
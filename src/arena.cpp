@@ -0,0 +1,36 @@
+#include <cpplox/arena.hpp>
+
+#include <algorithm>
+
+namespace lox
+{
+
+inline namespace arena
+{
+
+Arena::~Arena()
+{
+  // destruct in the reverse order of the construction
+  for (auto it = destructors_.rbegin(); it != destructors_.rend(); ++it) {
+    it->second(it->first);
+  }
+}
+
+auto Arena::allocate(const size_t size, const size_t align) -> void *
+{
+  const size_t offset = (offset_ + align - 1) / align * align;
+  if (chunks_.empty() || offset + size > capacity_) {
+    // NOTE: operator new[] returns the storage aligned for any fundamental type
+    const size_t capacity = std::max(ChunkSize, size);
+    chunks_.emplace_back(new std::byte[capacity]);
+    capacity_ = capacity;
+    reserved_bytes_ += capacity;
+    offset_ = size;
+    return chunks_.back().get();
+  }
+  offset_ = offset + size;
+  return chunks_.back().get() + offset;
+}
+
+}  // namespace arena
+}  // namespace lox
@@ -0,0 +1,894 @@
+#include <cpplox/cache.hpp>
+#include <cpplox/source.hpp>
+#include <cpplox/variant.hpp>
+
+#include <boost/variant.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+namespace lox
+{
+
+inline namespace cache
+{
+
+namespace
+{
+
+constexpr char Magic[4] = {'L', 'O', 'X', 'C'};
+
+/**
+ * @brief the header of a cache file, which is followed by `payload_size` bytes of the payload
+ */
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t parse_mode;
+  uint64_t source_size;
+  uint64_t source_hash;
+  uint64_t payload_size;
+  uint64_t payload_hash;
+};
+
+/**
+ * @brief the tags of the literal constants
+ */
+enum class ConstantTag : uint8_t { Nil, Bool, Int, Double, String };
+
+/**
+ * @brief encode the nodes in the pre-order. a variant is written as its index followed by the
+ * alternative, and an optional is written as a flag followed by the value
+ */
+class Writer : public boost::static_visitor<void>
+{
+public:
+  explicit Writer(const std::string_view source) : source_(source) {}
+
+  auto take() -> std::string { return std::move(out_); }
+
+  void u8(const uint8_t value) { out_.push_back(static_cast<char>(value)); }
+
+  void u32(const uint32_t value) { raw(&value, sizeof(value)); }
+
+  void u64(const uint64_t value) { raw(&value, sizeof(value)); }
+
+  void raw(const void * data, const size_t size)
+  {
+    out_.append(static_cast<const char *>(data), size);
+  }
+
+  /**
+   * @brief write a part of the source as its position
+   */
+  void text(const std::string_view text)
+  {
+    u32(static_cast<uint32_t>(text.data() - source_.data()));
+    u32(static_cast<uint32_t>(text.size()));
+  }
+
+  void token(const Token & token)
+  {
+    u8(static_cast<uint8_t>(token.type));
+    text(token.lexeme);
+    u32(token.line);
+  }
+
+  void tokens(const Tokens & tokens)
+  {
+    u32(static_cast<uint32_t>(tokens.size()));
+    for (const auto & token : tokens) {
+      this->token(token);
+    }
+  }
+
+  void constant(const Constant & constant)
+  {
+    if (std::holds_alternative<bool>(constant)) {
+      u8(static_cast<uint8_t>(ConstantTag::Bool));
+      u8(std::get<bool>(constant));
+    } else if (std::holds_alternative<int64_t>(constant)) {
+      u8(static_cast<uint8_t>(ConstantTag::Int));
+      u64(static_cast<uint64_t>(std::get<int64_t>(constant)));
+    } else if (std::holds_alternative<double>(constant)) {
+      u8(static_cast<uint8_t>(ConstantTag::Double));
+      const auto value = std::get<double>(constant);
+      raw(&value, sizeof(value));
+    } else if (std::holds_alternative<String>(constant)) {
+      u8(static_cast<uint8_t>(ConstantTag::String));
+      const auto str = std::get<String>(constant).view();
+      u32(static_cast<uint32_t>(str.size()));
+      raw(str.data(), str.size());
+    } else {
+      u8(static_cast<uint8_t>(ConstantTag::Nil));
+    }
+  }
+
+  void location(const VariableLocation & location)
+  {
+    u8(static_cast<uint8_t>(location.storage));
+    u64(location.slot);
+  }
+
+  void location(const std::optional<VariableLocation> & location)
+  {
+    u8(location.has_value());
+    if (location) {
+      this->location(location.value());
+    }
+  }
+
+  void captured_base(const std::optional<size_t> & base)
+  {
+    u8(base.has_value());
+    if (base) {
+      u64(base.value());
+    }
+  }
+
+  void expr(const Expr & expr)
+  {
+    u8(static_cast<uint8_t>(expr.which()));
+    boost::apply_visitor(*this, expr);
+  }
+
+  void expr(const std::optional<Expr> & expr)
+  {
+    u8(expr.has_value());
+    if (expr) {
+      this->expr(expr.value());
+    }
+  }
+
+  void stmt(const Stmt & stmt)
+  {
+    u8(static_cast<uint8_t>(stmt.which()));
+    boost::apply_visitor(*this, stmt);
+  }
+
+  void declaration(const Declaration & declaration)
+  {
+    u8(static_cast<uint8_t>(declaration.which()));
+    // NOTE: Stmt is not visited as a declaration, since Ref<Block> also converts to Stmt
+    if (const auto stmt = boost::get<Stmt>(&declaration)) {
+      this->stmt(*stmt);
+    } else if (const auto var_decl = boost::get<VarDecl>(&declaration)) {
+      (*this)(*var_decl);
+    } else if (const auto func_decl = boost::get<Ref<FuncDecl>>(&declaration)) {
+      (*this)(func_decl->get());
+    } else {
+      (*this)(boost::get<Ref<ClassDecl>>(declaration).get());
+    }
+  }
+
+  void block(const Block & block)
+  {
+    u32(static_cast<uint32_t>(block.declarations.size()));
+    for (const auto & declaration : block.declarations) {
+      this->declaration(declaration);
+    }
+    captured_base(block.captured_base);
+  }
+
+  void branch_clause(const BranchClause & clause)
+  {
+    u8(clause.declaration.has_value());
+    if (clause.declaration) {
+      (*this)(clause.declaration.value());
+    }
+    expr(clause.cond);
+    block(clause.body);
+    captured_base(clause.captured_base);
+  }
+
+  // expressions
+  void operator()(const Literal & literal)
+  {
+    token(literal);
+    constant(literal.constant);
+  }
+
+  void operator()(const Unary & unary)
+  {
+    token(unary.op);
+    expr(unary.expr);
+  }
+
+  void operator()(const Binary & binary)
+  {
+    expr(binary.left);
+    token(binary.op);
+    expr(binary.right);
+  }
+
+  void operator()(const Group & group)
+  {
+    token(group.left_paren);
+    expr(group.expr);
+    token(group.right_paren);
+  }
+
+  void operator()(const Variable & variable)
+  {
+    token(variable.name);
+    location(variable.location);
+  }
+
+  void operator()(const Assign & assign)
+  {
+    token(assign.name);
+    expr(assign.expr);
+    location(assign.location);
+  }
+
+  void operator()(const Logical & logical)
+  {
+    expr(logical.left);
+    token(logical.op);
+    expr(logical.right);
+  }
+
+  void operator()(const Call & call)
+  {
+    expr(call.callee);
+    u32(static_cast<uint32_t>(call.arguments.size()));
+    for (const auto & argument : call.arguments) {
+      expr(argument);
+    }
+  }
+
+  void operator()(const ReadProperty & property)
+  {
+    expr(property.base);
+    token(property.prop);
+  }
+
+  void operator()(const SetProperty & property)
+  {
+    expr(property.base);
+    token(property.prop);
+    expr(property.value);
+  }
+
+  // statements
+  void operator()(const ExprStmt & stmt) { expr(stmt.expression); }
+
+  void operator()(const PrintStmt & stmt) { expr(stmt.expression); }
+
+  void operator()(const Block & block) { this->block(block); }
+
+  void operator()(const IfBlock & stmt)
+  {
+    branch_clause(stmt.if_clause);
+    u32(static_cast<uint32_t>(stmt.elseif_clauses.size()));
+    for (const auto & clause : stmt.elseif_clauses) {
+      branch_clause(clause);
+    }
+    u8(stmt.else_body.has_value());
+    if (stmt.else_body) {
+      block(stmt.else_body.value());
+    }
+  }
+
+  void operator()(const WhileStmt & stmt)
+  {
+    token(stmt.while_token);
+    expr(stmt.cond);
+    block(stmt.body);
+  }
+
+  void operator()(const ForStmt & stmt)
+  {
+    token(stmt.for_token);
+    u8(stmt.init_stmt ? static_cast<uint8_t>(stmt.init_stmt->index() + 1) : 0);
+    if (stmt.init_stmt) {
+      std::visit(*this, stmt.init_stmt.value());
+    }
+    expr(stmt.cond);
+    expr(stmt.next);
+    block(stmt.body);
+    captured_base(stmt.captured_base);
+  }
+
+  void operator()(const BreakStmt &) {}
+
+  void operator()(const ContinueStmt &) {}
+
+  void operator()(const ReturnStmt & stmt) { expr(stmt.expr); }
+
+  // declarations
+  void operator()(const VarDecl & var_decl)
+  {
+    token(var_decl.name);
+    expr(var_decl.initializer);
+    u64(var_decl.slot);
+    u8(var_decl.on_stack);
+  }
+
+  void lazy_body(const LazyBody & lazy)
+  {
+    text(lazy.source);
+    u32(lazy.line);
+    u32(static_cast<uint32_t>(lazy.names.size()));
+    for (const auto name : lazy.names) {
+      text(name);
+    }
+    u32(static_cast<uint32_t>(lazy.captures.size()));
+    for (const auto & [name, location] : lazy.captures) {
+      text(name);
+      this->location(location);
+    }
+  }
+
+  void operator()(const FuncDecl & func_decl)
+  {
+    token(func_decl.name);
+    tokens(func_decl.parameters);
+    u8(func_decl.lazy != nullptr);
+    if (func_decl.lazy) {
+      lazy_body(*func_decl.lazy);
+    } else {
+      block(func_decl.body);
+    }
+    u64(func_decl.slot);
+    u32(static_cast<uint32_t>(func_decl.parameter_slots.size()));
+    for (const auto slot : func_decl.parameter_slots) {
+      u64(slot);
+    }
+    u8(func_decl.on_stack);
+    u64(func_decl.frame_size);
+    u32(static_cast<uint32_t>(func_decl.upvalues.size()));
+    for (const auto & upvalue : func_decl.upvalues) {
+      u64(upvalue.index);
+      u8(upvalue.is_local);
+    }
+  }
+
+  void operator()(const ClassDecl & class_decl)
+  {
+    token(class_decl.name);
+    u32(static_cast<uint32_t>(class_decl.methods.size()));
+    for (const auto & [name, method] : class_decl.methods) {
+      (*this)(method);
+    }
+    u64(class_decl.slot);
+  }
+
+private:
+  std::string_view source_;
+  std::string out_;
+};
+
+/**
+ * @brief decode the nodes written by Writer into `arena`. once the data turns out to be broken,
+ * every read fails and returns a dummy value, which is checked by `failed()` at the end
+ */
+class Reader
+{
+public:
+  Reader(
+    const std::string_view data, const std::string_view source,
+    const std::shared_ptr<Arena> & arena)
+  : data_(data), source_(source), arena_(*arena), arena_ptr_(arena)
+  {
+  }
+
+  auto failed() const noexcept -> bool { return failed_; }
+
+  auto at_end() const noexcept -> bool { return cursor_ == data_.size(); }
+
+  auto u8() -> uint8_t
+  {
+    uint8_t value = 0;
+    raw(&value, sizeof(value));
+    return value;
+  }
+
+  auto u32() -> uint32_t
+  {
+    uint32_t value = 0;
+    raw(&value, sizeof(value));
+    return value;
+  }
+
+  auto u64() -> uint64_t
+  {
+    uint64_t value = 0;
+    raw(&value, sizeof(value));
+    return value;
+  }
+
+  /**
+   * @brief read a count of the elements, each of which takes at least `min_size` bytes
+   */
+  auto count(const size_t min_size = 1) -> uint32_t
+  {
+    const auto n = u32();
+    return check(static_cast<uint64_t>(n) * min_size <= data_.size() - cursor_) ? n : 0;
+  }
+
+  auto text() -> std::string_view
+  {
+    const auto offset = u32();
+    const auto size = u32();
+    if (!check(offset <= source_.size() and size <= source_.size() - offset)) {
+      return std::string_view();
+    }
+    return source_.substr(offset, size);
+  }
+
+  auto token() -> Token
+  {
+    const auto type = u8();
+    const auto lexeme = text();
+    const auto line = u32();
+    if (!check(type <= static_cast<uint8_t>(TokenType::Eof))) {
+      return Token{};
+    }
+    return Token{static_cast<TokenType>(type), lexeme, line};
+  }
+
+  auto tokens() -> Tokens
+  {
+    Tokens tokens;
+    const auto n = count(13);
+    tokens.reserve(n);
+    for (uint32_t i = 0; i < n; ++i) {
+      tokens.push_back(token());
+    }
+    return tokens;
+  }
+
+  auto constant() -> Constant
+  {
+    switch (static_cast<ConstantTag>(u8())) {
+      case ConstantTag::Nil:
+        return Nil{};
+      case ConstantTag::Bool:
+        return u8() != 0;
+      case ConstantTag::Int:
+        return static_cast<int64_t>(u64());
+      case ConstantTag::Double: {
+        double value = 0.0;
+        raw(&value, sizeof(value));
+        return value;
+      }
+      case ConstantTag::String: {
+        const auto size = count();
+        const auto str = data_.substr(cursor_, size);
+        cursor_ += size;
+        return String::intern(str);
+      }
+    }
+    check(false);
+    return Nil{};
+  }
+
+  auto location() -> VariableLocation
+  {
+    const auto storage = u8();
+    check(storage <= static_cast<uint8_t>(Storage::Upvalue));
+    return VariableLocation{static_cast<Storage>(storage), u64()};
+  }
+
+  auto optional_location() -> std::optional<VariableLocation>
+  {
+    if (!flag()) {
+      return std::nullopt;
+    }
+    return location();
+  }
+
+  auto captured_base() -> std::optional<size_t>
+  {
+    if (!flag()) {
+      return std::nullopt;
+    }
+    return u64();
+  }
+
+  auto flag() -> bool
+  {
+    const auto value = u8();
+    check(value <= 1);
+    return value == 1;
+  }
+
+  auto expr() -> Expr
+  {
+    switch (u8()) {
+      case 0: {
+        const auto token = this->token();
+        return Literal{token, constant()};
+      }
+      case 1: {
+        auto op = token();
+        return arena_.make<Unary>(op, expr());
+      }
+      case 2: {
+        auto left = expr();
+        auto op = token();
+        return arena_.make<Binary>(std::move(left), op, expr());
+      }
+      case 3: {
+        auto left_paren = token();
+        auto inner = expr();
+        return arena_.make<Group>(left_paren, std::move(inner), token());
+      }
+      case 4: {
+        auto name = token();
+        return arena_.make<Variable>(name, optional_location());
+      }
+      case 5: {
+        auto name = token();
+        auto value = expr();
+        return arena_.make<Assign>(name, std::move(value), optional_location());
+      }
+      case 6: {
+        auto left = expr();
+        auto op = token();
+        return arena_.make<Logical>(std::move(left), op, expr());
+      }
+      case 7: {
+        auto callee = expr();
+        std::vector<Expr> arguments;
+        const auto n = count();
+        arguments.reserve(n);
+        for (uint32_t i = 0; i < n; ++i) {
+          arguments.push_back(expr());
+        }
+        return arena_.make<Call>(std::move(callee), std::move(arguments));
+      }
+      case 8: {
+        auto base = expr();
+        return arena_.make<ReadProperty>(std::move(base), token());
+      }
+      case 9: {
+        auto base = expr();
+        auto prop = token();
+        return arena_.make<SetProperty>(std::move(base), prop, expr());
+      }
+    }
+    check(false);
+    return Literal{Token{}, Nil{}};
+  }
+
+  auto optional_expr() -> std::optional<Expr>
+  {
+    if (!flag()) {
+      return std::nullopt;
+    }
+    return expr();
+  }
+
+  auto block() -> Block
+  {
+    Block block;
+    const auto n = count();
+    block.declarations.reserve(n);
+    for (uint32_t i = 0; i < n; ++i) {
+      block.declarations.push_back(declaration());
+    }
+    block.captured_base = captured_base();
+    return block;
+  }
+
+  auto branch_clause() -> BranchClause
+  {
+    std::optional<VarDecl> declaration = std::nullopt;
+    if (flag()) {
+      declaration = var_decl();
+    }
+    auto cond = expr();
+    auto body = block();
+    return BranchClause{
+      std::move(declaration), std::move(cond), std::move(body), captured_base()};
+  }
+
+  auto expr_stmt() -> ExprStmt { return ExprStmt{expr()}; }
+
+  auto stmt() -> Stmt
+  {
+    switch (u8()) {
+      case 0:
+        return expr_stmt();
+      case 1:
+        return PrintStmt{expr()};
+      case 2:
+        return arena_.make<Block>(block());
+      case 3: {
+        auto if_clause = branch_clause();
+        std::vector<BranchClause> elseif_clauses;
+        const auto n = count();
+        elseif_clauses.reserve(n);
+        for (uint32_t i = 0; i < n; ++i) {
+          elseif_clauses.push_back(branch_clause());
+        }
+        std::optional<Block> else_body = std::nullopt;
+        if (flag()) {
+          else_body = block();
+        }
+        return arena_.make<IfBlock>(
+          std::move(if_clause), std::move(elseif_clauses), std::move(else_body));
+      }
+      case 4: {
+        auto while_token = token();
+        auto cond = expr();
+        return arena_.make<WhileStmt>(while_token, std::move(cond), block());
+      }
+      case 5: {
+        auto for_token = token();
+        std::optional<std::variant<VarDecl, ExprStmt>> init_stmt = std::nullopt;
+        switch (u8()) {
+          case 0:
+            break;
+          case 1:
+            init_stmt = var_decl();
+            break;
+          case 2:
+            init_stmt = expr_stmt();
+            break;
+          default:
+            check(false);
+        }
+        auto cond = optional_expr();
+        auto next = optional_expr();
+        auto body = block();
+        return arena_.make<ForStmt>(
+          for_token, std::move(init_stmt), std::move(cond), std::move(next), std::move(body),
+          captured_base());
+      }
+      case 6:
+        return BreakStmt{};
+      case 7:
+        return ContinueStmt{};
+      case 8:
+        return ReturnStmt{optional_expr()};
+    }
+    check(false);
+    return BreakStmt{};
+  }
+
+  auto var_decl() -> VarDecl
+  {
+    auto name = token();
+    auto initializer = optional_expr();
+    const auto slot = u64();
+    return VarDecl{name, std::move(initializer), slot, flag()};
+  }
+
+  auto lazy_body() -> std::shared_ptr<LazyBody>
+  {
+    auto lazy = std::make_shared<LazyBody>();
+    lazy->source = text();
+    lazy->line = u32();
+    lazy->arena = arena_ptr_;
+    const auto n_names = count(8);
+    lazy->names.reserve(n_names);
+    for (uint32_t i = 0; i < n_names; ++i) {
+      lazy->names.push_back(text());
+    }
+    const auto n_captures = count(17);
+    for (uint32_t i = 0; i < n_captures; ++i) {
+      const auto name = text();
+      lazy->captures.emplace(name, location());
+    }
+    return lazy;
+  }
+
+  auto func_decl() -> FuncDecl
+  {
+    auto name = token();
+    auto parameters = tokens();
+    std::shared_ptr<LazyBody> lazy = nullptr;
+    Block body;
+    if (flag()) {
+      lazy = lazy_body();
+    } else {
+      body = block();
+    }
+    const auto slot = u64();
+    std::vector<size_t> parameter_slots;
+    const auto n = count(8);
+    parameter_slots.reserve(n);
+    for (uint32_t i = 0; i < n; ++i) {
+      parameter_slots.push_back(u64());
+    }
+    const auto on_stack = flag();
+    const auto frame_size = u64();
+    std::vector<UpvalueRef> upvalues;
+    const auto n_upvalues = count(9);
+    upvalues.reserve(n_upvalues);
+    for (uint32_t i = 0; i < n_upvalues; ++i) {
+      const auto index = u64();
+      upvalues.push_back(UpvalueRef{index, flag()});
+    }
+    return FuncDecl{
+      name, std::move(parameters), std::move(body), slot, std::move(parameter_slots),
+      std::move(lazy), on_stack, frame_size, std::move(upvalues)};
+  }
+
+  auto declaration() -> Declaration
+  {
+    switch (u8()) {
+      case 0:
+        return var_decl();
+      case 1:
+        return stmt();
+      case 2:
+        return arena_.make<FuncDecl>(func_decl());
+      case 3: {
+        auto name = token();
+        std::unordered_map<std::string_view, FuncDecl> methods;
+        const auto n = count();
+        for (uint32_t i = 0; i < n; ++i) {
+          auto method = func_decl();
+          const auto method_name = method.name.lexeme;
+          methods.emplace(method_name, std::move(method));
+        }
+        return arena_.make<ClassDecl>(name, std::move(methods), u64());
+      }
+    }
+    check(false);
+    return Stmt{BreakStmt{}};
+  }
+
+private:
+  /**
+   * @brief mark the data as broken unless `condition` holds
+   */
+  auto check(const bool condition) -> bool
+  {
+    failed_ = failed_ or !condition;
+    return !failed_;
+  }
+
+  void raw(void * out, const size_t size)
+  {
+    if (check(size <= data_.size() - cursor_)) {
+      std::memcpy(out, data_.data() + cursor_, size);
+      cursor_ += size;
+    }
+  }
+
+  std::string_view data_;
+  std::string_view source_;
+  Arena & arena_;
+  std::weak_ptr<Arena> arena_ptr_;  //!< referred from the functions parsed lazily
+  size_t cursor_{0};
+  bool failed_{false};
+};
+
+}  // namespace
+
+auto content_hash(const std::string_view data) noexcept -> uint64_t
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (const auto c : data) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+auto serialize_program(const Program & program, const std::string_view source, const ParseMode mode)
+  -> std::string
+{
+  Writer writer(source);
+  const auto & globals = program.resolved_globals.value();
+  writer.u32(static_cast<uint32_t>(globals.size()));
+  for (const auto & global : globals) {
+    writer.token(Token{TokenType::Identifier, global.name, 0});
+    writer.u64(global.slot);
+  }
+  writer.u64(program.frame_size);
+  writer.u32(static_cast<uint32_t>(program.declarations.size()));
+  for (const auto & declaration : program.declarations) {
+    writer.declaration(declaration);
+  }
+  const auto payload = writer.take();
+
+  Header header{};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = CacheVersion;
+  header.parse_mode = static_cast<uint64_t>(mode);
+  header.source_size = source.size();
+  header.source_hash = content_hash(source);
+  header.payload_size = payload.size();
+  header.payload_hash = content_hash(payload);
+  std::string data(reinterpret_cast<const char *>(&header), sizeof(header));
+  return data + payload;
+}
+
+auto deserialize_program(
+  const std::string_view data, const std::string_view source, const ParseMode mode)
+  -> std::optional<Program>
+{
+  Header header{};
+  if (data.size() < sizeof(header)) {
+    return std::nullopt;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  const auto payload = data.substr(sizeof(header));
+  if (
+    std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 or header.version != CacheVersion or
+    header.parse_mode != static_cast<uint64_t>(mode) or header.source_size != source.size() or
+    header.payload_size != payload.size() or header.payload_hash != content_hash(payload) or
+    header.source_hash != content_hash(source)) {
+    return std::nullopt;
+  }
+
+  auto arena = std::make_shared<Arena>();
+  Reader reader(payload, source, arena);
+  std::vector<GlobalSlot> globals;
+  const auto n_globals = reader.count(21);
+  globals.reserve(n_globals);
+  for (uint32_t i = 0; i < n_globals; ++i) {
+    const auto name = reader.token();
+    globals.push_back(GlobalSlot{name.lexeme, reader.u64()});
+  }
+  const auto frame_size = reader.u64();
+  std::vector<Declaration> declarations;
+  const auto n_declarations = reader.count();
+  declarations.reserve(n_declarations);
+  for (uint32_t i = 0; i < n_declarations and !reader.failed(); ++i) {
+    declarations.push_back(reader.declaration());
+  }
+  if (reader.failed() or !reader.at_end()) {
+    return std::nullopt;
+  }
+  return Program{std::move(declarations), std::move(arena), std::move(globals), frame_size};
+}
+
+auto cache_path_of(
+  const std::string & path, const std::string_view source,
+  const std::optional<std::string> & cache_dir) -> std::string
+{
+  if (!cache_dir) {
+    return path + "c";
+  }
+  char name[32];
+  std::snprintf(
+    name, sizeof(name), "%016llx.loxc", static_cast<unsigned long long>(content_hash(source)));
+  return cache_dir.value() + "/" + name;
+}
+
+auto load_cache(const std::string & cache_path, const std::string_view source, const ParseMode mode)
+  -> std::optional<Program>
+{
+  const auto buffer = SourceBuffer::open(cache_path);
+  if (!buffer) {
+    return std::nullopt;
+  }
+  // NOTE: the program does not refer to the buffer, because the strings are interned
+  return deserialize_program(buffer->view(), source, mode);
+}
+
+auto save_cache(
+  const std::string & cache_path, const Program & program, const std::string_view source,
+  const ParseMode mode) -> bool
+{
+  const auto data = serialize_program(program, source, mode);
+  const auto temporary = cache_path + ".tmp" + std::to_string(::getpid());
+  {
+    std::ofstream ofs(temporary, std::ios::binary | std::ios::trunc);
+    if (!ofs or !ofs.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temporary.c_str(), cache_path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace cache
+}  // namespace lox
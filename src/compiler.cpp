@@ -0,0 +1,635 @@
+#include <cpplox/compiler.hpp>
+#include <cpplox/variant.hpp>
+
+#include <cassert>
+#include <limits>
+
+namespace lox
+{
+
+namespace vm
+{
+
+auto Compiler::compile(const Program & program) -> std::shared_ptr<const Function>
+{
+  FunctionState script{nullptr, std::make_shared<Function>()};
+  // slot 0 is occupied by the running closure itself
+  script.locals.push_back(Local{"", 0});
+  current_ = &script;
+  for (const auto & declaration : program.declarations) {
+    this->declaration(declaration);
+  }
+  chunk().write(OpCode::Nil);
+  chunk().write(OpCode::Return);
+  current_ = nullptr;
+  return script.function;
+}
+
+auto Compiler::chunk() -> Chunk &
+{
+  return current_->function->chunk;
+}
+
+auto Compiler::expression(const Expr & expr) -> void
+{
+  CompileExprVisitor visitor(*this);
+  boost::apply_visitor(visitor, expr);
+}
+
+auto Compiler::declaration(const Declaration & declaration) -> void
+{
+  CompileDeclVisitor visitor(*this);
+  boost::apply_visitor(visitor, declaration);
+}
+
+auto Compiler::block(const Block & block) -> void
+{
+  begin_scope();
+  for (const auto & declaration : block.declarations) {
+    this->declaration(declaration);
+  }
+  end_scope();
+}
+
+auto Compiler::function(const FuncDecl & func_decl, FunctionState * enclosing)
+  -> std::pair<std::shared_ptr<const Function>, std::vector<UpvalueRef>>
+{
+  FunctionState state{enclosing, std::make_shared<Function>()};
+  state.function->name = func_decl.name.lexeme;
+  state.function->arity = func_decl.parameters.size();
+  state.function->declaration = &func_decl;
+  // NOTE: parameters and the body share the same scope like the tree-walking interpreter, and the
+  // locals of a function are discarded by Return at once, so this scope is never closed
+  state.scope_depth = 1;
+  state.locals.push_back(Local{"", 0});
+
+  auto * outer = current_;
+  current_ = &state;
+  for (const auto & parameter : func_decl.parameters) {
+    add_local(parameter.lexeme);
+  }
+  // NOTE: the captured variables of a closure are known only from its body, so a function parsed
+  // lazily is materialized when it is compiled rather than on its first call
+  if (auto err = materialize_body(func_decl); err && !error_) {
+    error_.emplace(std::move(err.value()));
+  }
+  for (const auto & declaration : func_decl.body.declarations) {
+    this->declaration(declaration);
+  }
+  // reaching the end of the body means the function did not return
+  chunk().write(OpCode::NoReturn);
+  current_ = outer;
+
+  state.function->upvalue_count = state.upvalues.size();
+  return {state.function, state.upvalues};
+}
+
+auto Compiler::emit_closure(
+  const std::shared_ptr<const Function> & function, const std::vector<UpvalueRef> & upvalues)
+  -> void
+{
+  const auto index = static_cast<uint32_t>(chunk().functions.size());
+  chunk().functions.push_back(function);
+  chunk().write(OpCode::Closure);
+  chunk().write_u32(index);
+  for (const auto & upvalue : upvalues) {
+    chunk().write_u8(upvalue.is_local ? 1 : 0);
+    chunk().write_u16(upvalue.index);
+  }
+}
+
+auto Compiler::add_constant(const Value & value) -> uint32_t
+{
+  chunk().constants.push_back(value);
+  return static_cast<uint32_t>(chunk().constants.size() - 1);
+}
+
+auto Compiler::add_site(const Site & site) -> uint32_t
+{
+  chunk().sites.push_back(site);
+  return static_cast<uint32_t>(chunk().sites.size() - 1);
+}
+
+auto Compiler::emit_jump(const OpCode op) -> size_t
+{
+  chunk().write(op);
+  chunk().write_u32(0);
+  return chunk().code.size() - 4;
+}
+
+auto Compiler::patch_jump(const size_t operand_offset) -> void
+{
+  const auto offset = chunk().code.size() - (operand_offset + 4);
+  chunk().patch_u32(operand_offset, static_cast<uint32_t>(offset));
+}
+
+auto Compiler::emit_loop(const size_t loop_start) -> void
+{
+  chunk().write(OpCode::Loop);
+  const auto offset = chunk().code.size() + 4 - loop_start;
+  chunk().write_u32(static_cast<uint32_t>(offset));
+}
+
+auto Compiler::begin_scope() -> void
+{
+  current_->scope_depth++;
+}
+
+auto Compiler::end_scope() -> void
+{
+  current_->scope_depth--;
+  auto & locals = current_->locals;
+  while (!locals.empty() && locals.back().depth > current_->scope_depth) {
+    chunk().write(locals.back().is_captured ? OpCode::CloseUpvalue : OpCode::Pop);
+    locals.pop_back();
+  }
+}
+
+auto Compiler::emit_discard_locals(const size_t local_count) -> void
+{
+  const auto & locals = current_->locals;
+  for (size_t i = locals.size(); i > local_count; --i) {
+    chunk().write(locals.at(i - 1).is_captured ? OpCode::CloseUpvalue : OpCode::Pop);
+  }
+}
+
+auto Compiler::add_local(const std::string_view & name) -> uint16_t
+{
+  assert(current_->locals.size() < std::numeric_limits<uint16_t>::max());
+  current_->locals.push_back(Local{name, current_->scope_depth});
+  return static_cast<uint16_t>(current_->locals.size() - 1);
+}
+
+auto Compiler::define_variable(const Token & name) -> void
+{
+  if (current_->scope_depth == 0) {
+    chunk().write(OpCode::DefineGlobal);
+    chunk().write_u32(globals_.declare(name.lexeme));
+    return;
+  }
+  add_local(name.lexeme);
+}
+
+auto Compiler::emit_get_variable(const Variable & variable) -> void
+{
+  const auto & name = variable.name;
+  const Site site = &variable;
+  // the variable which the resolver could not find is an error at runtime, like the tree-walking
+  // interpreter
+  if (!variable.location) {
+    chunk().write(OpCode::Undefined);
+    chunk().write_u32(add_site(site));
+    return;
+  }
+  if (const auto slot = resolve_local(*current_, name.lexeme); slot) {
+    chunk().write(OpCode::GetLocal);
+    chunk().write_u16(slot.value());
+    return;
+  }
+  if (const auto index = resolve_upvalue(*current_, name.lexeme); index) {
+    chunk().write(OpCode::GetUpvalue);
+    chunk().write_u16(index.value());
+    return;
+  }
+  if (const auto global = globals_.find(name.lexeme); global) {
+    chunk().write(OpCode::GetGlobal);
+    chunk().write_u32(global.value());
+    chunk().write_u32(add_site(site));
+    return;
+  }
+  chunk().write(OpCode::Undefined);
+  chunk().write_u32(add_site(site));
+}
+
+auto Compiler::emit_set_variable(const Assign & assign) -> void
+{
+  const auto & name = assign.name;
+  const Site site = &assign;
+  if (!assign.location) {
+    chunk().write(OpCode::Undefined);
+    chunk().write_u32(add_site(site));
+    return;
+  }
+  if (const auto slot = resolve_local(*current_, name.lexeme); slot) {
+    chunk().write(OpCode::SetLocal);
+    chunk().write_u16(slot.value());
+    return;
+  }
+  if (const auto index = resolve_upvalue(*current_, name.lexeme); index) {
+    chunk().write(OpCode::SetUpvalue);
+    chunk().write_u16(index.value());
+    return;
+  }
+  if (const auto global = globals_.find(name.lexeme); global) {
+    chunk().write(OpCode::SetGlobal);
+    chunk().write_u32(global.value());
+    chunk().write_u32(add_site(site));
+    return;
+  }
+  chunk().write(OpCode::Undefined);
+  chunk().write_u32(add_site(site));
+}
+
+auto Compiler::resolve_local(const FunctionState & state, const std::string_view & name)
+  -> std::optional<uint16_t>
+{
+  for (size_t i = state.locals.size(); i > 0; --i) {
+    if (state.locals.at(i - 1).name == name) {
+      return static_cast<uint16_t>(i - 1);
+    }
+  }
+  return std::nullopt;
+}
+
+auto Compiler::resolve_upvalue(FunctionState & state, const std::string_view & name)
+  -> std::optional<uint16_t>
+{
+  if (state.enclosing == nullptr) {
+    return std::nullopt;
+  }
+  if (const auto slot = resolve_local(*state.enclosing, name); slot) {
+    state.enclosing->locals.at(slot.value()).is_captured = true;
+    return add_upvalue(state, slot.value(), true);
+  }
+  if (const auto index = resolve_upvalue(*state.enclosing, name); index) {
+    return add_upvalue(state, index.value(), false);
+  }
+  return std::nullopt;
+}
+
+auto Compiler::add_upvalue(FunctionState & state, const uint16_t index, const bool is_local)
+  -> uint16_t
+{
+  for (size_t i = 0; i < state.upvalues.size(); ++i) {
+    const auto & upvalue = state.upvalues.at(i);
+    if (upvalue.index == index && upvalue.is_local == is_local) {
+      return static_cast<uint16_t>(i);
+    }
+  }
+  state.upvalues.push_back(UpvalueRef{index, is_local});
+  return static_cast<uint16_t>(state.upvalues.size() - 1);
+}
+
+void CompileExprVisitor::operator()(const Literal & literal)
+{
+  auto & chunk = compiler.chunk();
+  if (literal.type == TokenType::Nil) {
+    chunk.write(OpCode::Nil);
+    return;
+  }
+  if (literal.type == TokenType::False) {
+    chunk.write(OpCode::False);
+    return;
+  }
+  if (literal.type == TokenType::True) {
+    chunk.write(OpCode::True);
+    return;
+  }
+  if (literal.type == TokenType::String) {
+    const auto index = compiler.add_constant(
+      make_object<StringObject>(std::get<String>(literal.constant)));
+    chunk.write(OpCode::Constant);
+    chunk.write_u32(index);
+    return;
+  }
+  if (literal.type == TokenType::Number) {
+    const auto index = std::holds_alternative<int64_t>(literal.constant)
+                         ? compiler.add_constant(std::get<int64_t>(literal.constant))
+                         : compiler.add_constant(std::get<double>(literal.constant));
+    chunk.write(OpCode::Constant);
+    chunk.write_u32(index);
+    return;
+  }
+
+  // this is unreachable actually
+  assert(false);  // LCOV_EXCL_LINE
+}
+
+void CompileExprVisitor::operator()(const Unary & unary)
+{
+  compiler.expression(unary.expr);
+  auto & chunk = compiler.chunk();
+  if (unary.op.type == TokenType::Minus) {
+    const auto site = compiler.add_site(&unary);
+    chunk.write(OpCode::Negate);
+    chunk.write_u32(site);
+    return;
+  }
+  if (unary.op.type == TokenType::Bang) {
+    chunk.write(OpCode::Not);
+    return;
+  }
+
+  // this is unreachable actually
+  assert(false);  // LCOV_EXCL_LINE
+}
+
+void CompileExprVisitor::operator()(const Binary & binary)
+{
+  compiler.expression(binary.left);
+  compiler.expression(binary.right);
+  auto & chunk = compiler.chunk();
+  const auto type = binary.op.type;
+  if (type == TokenType::EqualEqual) {
+    chunk.write(OpCode::Equal);
+    return;
+  }
+  if (type == TokenType::BangEqual) {
+    chunk.write(OpCode::NotEqual);
+    return;
+  }
+  const auto site = compiler.add_site(&binary);
+  if (type == TokenType::Star) {
+    chunk.write(OpCode::Multiply);
+  } else if (type == TokenType::Slash) {
+    chunk.write(OpCode::Divide);
+  } else if (type == TokenType::Minus) {
+    chunk.write(OpCode::Subtract);
+  } else if (type == TokenType::Plus) {
+    chunk.write(OpCode::Add);
+  } else if (type == TokenType::Greater) {
+    chunk.write(OpCode::Greater);
+  } else if (type == TokenType::GreaterEqual) {
+    chunk.write(OpCode::GreaterEqual);
+  } else if (type == TokenType::Less) {
+    chunk.write(OpCode::Less);
+  } else if (type == TokenType::LessEqual) {
+    chunk.write(OpCode::LessEqual);
+  } else {
+    // this is unreachable actually
+    assert(false);  // LCOV_EXCL_LINE
+  }
+  chunk.write_u32(site);
+}
+
+void CompileExprVisitor::operator()(const Group & group)
+{
+  compiler.expression(group.expr);
+}
+
+void CompileExprVisitor::operator()(const Variable & variable)
+{
+  compiler.emit_get_variable(variable);
+}
+
+void CompileExprVisitor::operator()(const Assign & assign)
+{
+  compiler.expression(assign.expr);
+  compiler.emit_set_variable(assign);
+}
+
+void CompileExprVisitor::operator()(const Logical & logical)
+{
+  // NOTE: like the tree-walking interpreter, logical operators evaluate to bool, not to operands
+  compiler.expression(logical.left);
+  const auto short_circuit = compiler.emit_jump(
+    logical.op.type == TokenType::And ? OpCode::JumpIfFalse : OpCode::JumpIfTrue);
+  compiler.expression(logical.right);
+  compiler.chunk().write(OpCode::Truthy);
+  const auto end = compiler.emit_jump(OpCode::Jump);
+  compiler.patch_jump(short_circuit);
+  compiler.chunk().write(logical.op.type == TokenType::And ? OpCode::False : OpCode::True);
+  compiler.patch_jump(end);
+}
+
+void CompileExprVisitor::operator()(const Call & call)
+{
+  compiler.expression(call.callee);
+  for (const auto & argument : call.arguments) {
+    compiler.expression(argument);
+  }
+  const auto site = compiler.add_site(&call);
+  auto & chunk = compiler.chunk();
+  chunk.write(OpCode::Call);
+  chunk.write_u8(static_cast<uint8_t>(call.arguments.size()));
+  chunk.write_u32(site);
+}
+
+void CompileExprVisitor::operator()(const ReadProperty & property)
+{
+  compiler.expression(property.base);
+  const auto site = compiler.add_site(&property);
+  compiler.chunk().write(OpCode::GetProperty);
+  compiler.chunk().write_u32(site);
+}
+
+void CompileExprVisitor::operator()(const SetProperty & property)
+{
+  compiler.expression(property.base);
+  compiler.expression(property.value);
+  const auto site = compiler.add_site(&property);
+  compiler.chunk().write(OpCode::SetProperty);
+  compiler.chunk().write_u32(site);
+}
+
+void CompileStmtVisitor::operator()(const ExprStmt & stmt)
+{
+  compiler.expression(stmt.expression);
+  compiler.chunk().write(OpCode::Pop);
+}
+
+void CompileStmtVisitor::operator()(const PrintStmt & stmt)
+{
+  compiler.expression(stmt.expression);
+  compiler.chunk().write(OpCode::Print);
+}
+
+void CompileStmtVisitor::operator()(const Block & block)
+{
+  compiler.block(block);
+}
+
+void CompileStmtVisitor::operator()(const IfBlock & if_block)
+{
+  const auto local_count = compiler.current_->locals.size();
+  size_t n_nest_scope = 0;
+  std::vector<size_t> end_jumps;
+  auto compile_branch_clause = [&](const BranchClause & clause) {
+    compiler.begin_scope();
+    n_nest_scope++;
+    if (clause.declaration) {
+      CompileDeclVisitor decl_visitor(compiler);
+      decl_visitor(clause.declaration.value());
+    }
+    compiler.expression(clause.cond);
+    const auto next_clause = compiler.emit_jump(OpCode::JumpIfFalse);
+    compiler.block(clause.body);
+    // the scopes of the clauses are left at once after the body is executed
+    compiler.emit_discard_locals(local_count);
+    end_jumps.push_back(compiler.emit_jump(OpCode::Jump));
+    compiler.patch_jump(next_clause);
+  };
+
+  compile_branch_clause(if_block.if_clause);
+  for (const auto & elseif_clause : if_block.elseif_clauses) {
+    compile_branch_clause(elseif_clause);
+  }
+  if (if_block.else_body) {
+    compiler.block(if_block.else_body.value());
+  }
+  for (unsigned i = 1; i <= n_nest_scope; ++i) {
+    compiler.end_scope();
+  }
+  for (const auto end_jump : end_jumps) {
+    compiler.patch_jump(end_jump);
+  }
+}
+
+void CompileStmtVisitor::operator()(const WhileStmt & while_stmt)
+{
+  auto & chunk = compiler.chunk();
+  compiler.begin_scope();
+  // hidden local counting the iterations for MaxLoopError
+  chunk.write(OpCode::Constant);
+  chunk.write_u32(compiler.add_constant(int64_t{0}));
+  const auto counter = compiler.add_local("");
+  const auto site = compiler.add_site(&while_stmt);
+
+  const auto loop_start = chunk.code.size();
+  chunk.write(OpCode::LoopGuard);
+  chunk.write_u16(counter);
+  chunk.write_u32(site);
+  compiler.expression(while_stmt.cond);
+  const auto exit_jump = compiler.emit_jump(OpCode::JumpIfFalse);
+
+  compiler.current_->loops.push_back({loop_start, compiler.current_->locals.size(), {}});
+  compiler.block(while_stmt.body);
+  compiler.emit_loop(loop_start);
+  compiler.patch_jump(exit_jump);
+  for (const auto break_jump : compiler.current_->loops.back().break_jumps) {
+    compiler.patch_jump(break_jump);
+  }
+  compiler.current_->loops.pop_back();
+  compiler.end_scope();
+}
+
+void CompileStmtVisitor::operator()(const ForStmt & for_stmt)
+{
+  auto & chunk = compiler.chunk();
+  compiler.begin_scope();
+  if (for_stmt.init_stmt) {
+    const auto & init_stmt = for_stmt.init_stmt.value();
+    if (is_variant_v<VarDecl>(init_stmt)) {
+      CompileDeclVisitor decl_visitor(compiler);
+      decl_visitor(as_variant<VarDecl>(init_stmt));
+    } else {
+      (*this)(as_variant<ExprStmt>(init_stmt));
+    }
+  }
+  // hidden local counting the iterations for MaxLoopError
+  chunk.write(OpCode::Constant);
+  chunk.write_u32(compiler.add_constant(int64_t{0}));
+  const auto counter = compiler.add_local("");
+  const auto site = compiler.add_site(&for_stmt);
+
+  const auto loop_start = chunk.code.size();
+  chunk.write(OpCode::LoopGuard);
+  chunk.write_u16(counter);
+  chunk.write_u32(site);
+  std::optional<size_t> exit_jump{std::nullopt};
+  if (for_stmt.cond) {
+    compiler.expression(for_stmt.cond.value());
+    exit_jump.emplace(compiler.emit_jump(OpCode::JumpIfFalse));
+  }
+
+  compiler.current_->loops.push_back({loop_start, compiler.current_->locals.size(), {}});
+  compiler.block(for_stmt.body);
+  if (for_stmt.next) {
+    compiler.expression(for_stmt.next.value());
+    chunk.write(OpCode::Pop);
+  }
+  compiler.emit_loop(loop_start);
+  if (exit_jump) {
+    compiler.patch_jump(exit_jump.value());
+  }
+  for (const auto break_jump : compiler.current_->loops.back().break_jumps) {
+    compiler.patch_jump(break_jump);
+  }
+  compiler.current_->loops.pop_back();
+  compiler.end_scope();
+}
+
+void CompileStmtVisitor::operator()([[maybe_unused]] const BreakStmt & break_stmt)
+{
+  // NOTE: break outside of loop is ignored
+  if (compiler.current_->loops.empty()) {
+    return;
+  }
+  auto & loop = compiler.current_->loops.back();
+  compiler.emit_discard_locals(loop.local_count);
+  loop.break_jumps.push_back(compiler.emit_jump(OpCode::Jump));
+}
+
+void CompileStmtVisitor::operator()([[maybe_unused]] const ContinueStmt & continue_stmt)
+{
+  // NOTE: continue outside of loop is ignored
+  if (compiler.current_->loops.empty()) {
+    return;
+  }
+  const auto & loop = compiler.current_->loops.back();
+  compiler.emit_discard_locals(loop.local_count);
+  compiler.emit_loop(loop.start);
+}
+
+void CompileStmtVisitor::operator()(const ReturnStmt & return_stmt)
+{
+  if (return_stmt.expr) {
+    compiler.expression(return_stmt.expr.value());
+  } else {
+    compiler.chunk().write(OpCode::Nil);
+  }
+  compiler.chunk().write(OpCode::Return);
+}
+
+void CompileDeclVisitor::operator()(const VarDecl & var_decl)
+{
+  if (var_decl.initializer) {
+    compiler.expression(var_decl.initializer.value());
+  } else {
+    compiler.chunk().write(OpCode::Nil);
+  }
+  compiler.define_variable(var_decl.name);
+}
+
+void CompileDeclVisitor::operator()(const Stmt & stmt)
+{
+  CompileStmtVisitor visitor(compiler);
+  boost::apply_visitor(visitor, stmt);
+}
+
+void CompileDeclVisitor::operator()(const FuncDecl & func_decl)
+{
+  // the name is declared before the body is compiled so that the function can call itself
+  if (compiler.current_->scope_depth == 0) {
+    const auto global = compiler.globals_.declare(func_decl.name.lexeme);
+    const auto [function, upvalues] = compiler.function(func_decl, compiler.current_);
+    compiler.emit_closure(function, upvalues);
+    compiler.chunk().write(OpCode::DefineGlobal);
+    compiler.chunk().write_u32(global);
+    return;
+  }
+  compiler.add_local(func_decl.name.lexeme);
+  const auto [function, upvalues] = compiler.function(func_decl, compiler.current_);
+  compiler.emit_closure(function, upvalues);
+}
+
+void CompileDeclVisitor::operator()(const ClassDecl & class_decl)
+{
+  const auto global = compiler.globals_.declare(class_decl.name.lexeme);
+  ClassProto proto{&class_decl, {}};
+  for (const auto & [name, method] : class_decl.methods) {
+    const auto [function, upvalues] = compiler.function(method, nullptr);
+    assert(upvalues.empty());
+    proto.methods.emplace_back(name, static_cast<uint32_t>(compiler.chunk().functions.size()));
+    compiler.chunk().functions.push_back(function);
+  }
+  auto & chunk = compiler.chunk();
+  chunk.classes.push_back(std::move(proto));
+  chunk.write(OpCode::Class);
+  chunk.write_u32(static_cast<uint32_t>(chunk.classes.size() - 1));
+  chunk.write(OpCode::DefineGlobal);
+  chunk.write_u32(global);
+}
+
+}  // namespace vm
+}  // namespace lox
@@ -19,8 +19,34 @@ public:
 
   void operator()(const Literal & literal) { ss << literal.lexeme; }
 
+  /**
+   * @brief print the value instead of the subtree if it is folded by the optimizer
+   */
+  auto print_folded(const std::optional<Constant> & folded) -> bool
+  {
+    if (!folded) {
+      return false;
+    }
+    std::visit(
+      [&](const auto & value) {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, Nil>) {
+          ss << "nil";
+        } else if constexpr (std::is_same_v<T, bool>) {
+          ss << (value ? "true" : "false");
+        } else {
+          ss << value;
+        }
+      },
+      folded.value());
+    return true;
+  }
+
   void operator()(const Unary & unary)
   {
+    if (print_folded(unary.folded)) {
+      return;
+    }
     ss << "(" << unary.op.lexeme << " ";
     boost::apply_visitor(*this, unary.expr);
     ss << ")";
@@ -28,6 +54,9 @@ public:
 
   void operator()(const Binary & binary)
   {
+    if (print_folded(binary.folded)) {
+      return;
+    }
     ss << "(" << binary.op.lexeme << " ";
     boost::apply_visitor(*this, binary.left);
     ss << " ";
@@ -37,6 +66,9 @@ public:
 
   void operator()(const Group & group)
   {
+    if (print_folded(group.folded)) {
+      return;
+    }
     ss << "(group ";
     boost::apply_visitor(*this, group.expr);
     ss << ")";
@@ -53,6 +85,9 @@ public:
 
   void operator()(const Logical & logical)
   {
+    if (print_folded(logical.folded)) {
+      return;
+    }
     if (logical.op.type == TokenType::And) {
       ss << "(and ";
     } else if (logical.op.type == TokenType::Or) {
@@ -97,37 +132,201 @@ auto to_lisp_repr(const Expr & expr) -> std::string
   return visitor.ss.str();
 }
 
+class LispReprDeclVisitor;
+
+class LispReprStmtVisitor : boost::static_visitor<void>
+{
+public:
+  std::stringstream & ss;
+
+  explicit LispReprStmtVisitor(std::stringstream & ss) : ss(ss) {}
+
+  void operator()(const ExprStmt & stmt) { ss << to_lisp_repr(stmt.expression); }
+
+  void operator()(const PrintStmt & stmt)
+  {
+    ss << "(print " << to_lisp_repr(stmt.expression) << ")";
+  }
+
+  void operator()(const Block & block);
+
+  void operator()(const IfBlock & stmt)
+  {
+    auto print_branch_clause = [&](const char * name, const BranchClause & clause) {
+      ss << "(" << name << " ";
+      if (clause.declaration) {
+        print_declaration(clause.declaration.value());
+        ss << " ";
+      }
+      ss << to_lisp_repr(clause.cond) << " ";
+      (*this)(clause.body);
+    };
+    print_branch_clause("if", stmt.if_clause);
+    for (const auto & elseif_clause : stmt.elseif_clauses) {
+      ss << " ";
+      print_branch_clause("elif", elseif_clause);
+      ss << ")";
+    }
+    if (stmt.else_body) {
+      ss << " (else ";
+      (*this)(stmt.else_body.value());
+      ss << ")";
+    }
+    ss << ")";
+  }
+
+  void operator()(const WhileStmt & stmt)
+  {
+    ss << "(while " << to_lisp_repr(stmt.cond) << " ";
+    (*this)(stmt.body);
+    ss << ")";
+  }
+
+  void operator()(const ForStmt & stmt)
+  {
+    ss << "(for ";
+    if (!stmt.init_stmt) {
+      ss << "()";
+    } else if (is_variant_v<VarDecl>(stmt.init_stmt.value())) {
+      print_declaration(as_variant<VarDecl>(stmt.init_stmt.value()));
+    } else {
+      (*this)(as_variant<ExprStmt>(stmt.init_stmt.value()));
+    }
+    ss << " " << (stmt.cond ? to_lisp_repr(stmt.cond.value()) : "()");
+    ss << " " << (stmt.next ? to_lisp_repr(stmt.next.value()) : "()") << " ";
+    (*this)(stmt.body);
+    ss << ")";
+  }
+
+  void operator()(const BreakStmt &) { ss << "(break)"; }
+
+  void operator()(const ContinueStmt &) { ss << "(continue)"; }
+
+  void operator()(const ReturnStmt & stmt)
+  {
+    if (stmt.expr) {
+      ss << "(return " << to_lisp_repr(stmt.expr.value()) << ")";
+    } else {
+      ss << "(return)";
+    }
+  }
+
+private:
+  void print_declaration(const Declaration & declaration);
+};
+
+class LispReprDeclVisitor : boost::static_visitor<void>
+{
+public:
+  std::stringstream & ss;
+
+  explicit LispReprDeclVisitor(std::stringstream & ss) : ss(ss) {}
+
+  void operator()(const VarDecl & var_decl)
+  {
+    ss << "(var " << var_decl.name.lexeme;
+    if (var_decl.initializer) {
+      ss << " " << to_lisp_repr(var_decl.initializer.value());
+    }
+    ss << ")";
+  }
+
+  void operator()(const Stmt & stmt)
+  {
+    LispReprStmtVisitor stmt_visitor(ss);
+    boost::apply_visitor(stmt_visitor, stmt);
+  }
+
+  void operator()(const FuncDecl & func_decl)
+  {
+    ss << "(fun " << func_decl.name.lexeme << " (";
+    for (size_t i = 0; i < func_decl.parameters.size(); ++i) {
+      ss << (i == 0 ? "" : " ") << func_decl.parameters.at(i).lexeme;
+    }
+    ss << ") ";
+    if (func_decl.lazy) {
+      ss << "<lazy>";
+    } else {
+      LispReprStmtVisitor stmt_visitor(ss);
+      stmt_visitor(func_decl.body);
+    }
+    ss << ")";
+  }
+
+  void operator()(const ClassDecl & class_decl)
+  {
+    ss << "(class " << class_decl.name.lexeme;
+    for (const auto & [name, method] : class_decl.methods) {
+      ss << " ";
+      (*this)(method);
+    }
+    ss << ")";
+  }
+};
+
+void LispReprStmtVisitor::operator()(const Block & block)
+{
+  ss << "(block";
+  for (const auto & declaration : block.declarations) {
+    ss << " ";
+    print_declaration(declaration);
+  }
+  ss << ")";
+}
+
+void LispReprStmtVisitor::print_declaration(const Declaration & declaration)
+{
+  LispReprDeclVisitor decl_visitor(ss);
+  boost::apply_visitor(decl_visitor, declaration);
+}
+
+auto to_lisp_repr(const Program & program) -> std::string
+{
+  std::stringstream ss;
+  LispReprDeclVisitor visitor(ss);
+  for (const auto & declaration : program.declarations) {
+    boost::apply_visitor(visitor, declaration);
+    ss << std::endl;
+  }
+  return ss.str();
+}
+
 }  // namespace debug
 
 inline namespace error
 {
 
-auto SyntaxError::get_line_string(const size_t offset) const -> std::string
+auto SyntaxError::get_line_string(const LineTable & lines, const size_t offset) const
+  -> std::string
 {
   std::stringstream ss;
   if (offset > 0) {
     ss << std::string(offset, ' ');
   }
-  ss << "SyntaxError: " << magic_enum::enum_name(kind) << " at line " << line->number << ", column "
-     << (ctx_start_index - line->start_index) << std::endl;
+  ss << "SyntaxError: " << magic_enum::enum_name(kind) << " at line " << line << ", column "
+     << (lines.offset(ctx) - lines.start_index(line)) << std::endl;
   return ss.str();
 }
 
-auto SyntaxError::get_visualization_string(
-  const std::string_view & source, const size_t offset) const -> std::string
+auto SyntaxError::get_visualization_string(const LineTable & lines, const size_t offset) const
+  -> std::string
 {
   std::stringstream ss;
   if (offset > 0) {
     ss << std::string(offset, ' ');
   }
-  ss << debug::Thin << source.substr(line->start_index, ctx_start_index - line->start_index)
+  const auto source = lines.source();
+  const auto line_start_index = lines.start_index(line);
+  const auto line_end_index = lines.end_index(line);
+  const auto ctx_start_index = lines.offset(ctx);
+  ss << debug::Thin << source.substr(line_start_index, ctx_start_index - line_start_index)
      << debug::Reset;
   ss << debug::Bold << debug::Red << debug::Underline
-     << source.substr(ctx_start_index, line->end_index - ctx_start_index + 1) << debug::Reset;
-  if (source.at(line->end_index) != '\n') {
+     << source.substr(ctx_start_index, line_end_index - ctx_start_index + 1) << debug::Reset;
+  if (source.at(line_end_index) != '\n') {
     ss << std::endl;
   }
-  ss << std::string(offset + ctx_start_index - line->start_index, ' ') << "^" << std::endl;
+  ss << std::string(offset + ctx_start_index - line_start_index, ' ') << "^" << std::endl;
   return ss.str();
 }
 
@@ -196,8 +395,12 @@ public:
   }
 };
 
-auto get_line_string(const RuntimeError & error, const size_t offset) -> std::string
+auto get_line_string(const LineTable & lines, const RuntimeError & error, const size_t offset)
+  -> std::string
 {
+  if (is_variant_v<SyntaxError>(error)) {
+    return as_variant<SyntaxError>(error).get_line_string(lines, offset);
+  }
   std::stringstream ss;
   if (offset > 0) {
     ss << std::string(offset, ' ');
@@ -205,41 +408,42 @@ auto get_line_string(const RuntimeError & error, const size_t offset) -> std::st
   ss << "RuntimeError: ";
   if (is_variant_v<TypeError>(error)) {
     const auto & err = as_variant<TypeError>(error);
-    ss << "TypeError at line " << err.op.line->number << ", column "
-       << (err.op.start_index + err.op.lexeme.size() - err.op.line->start_index + 1) << std::endl;
+    const auto op_index = err.op.get_start_index(lines);
+    ss << "TypeError at line " << err.op.line << ", column "
+       << (op_index + err.op.lexeme.size() - lines.start_index(err.op.line) + 1) << std::endl;
     return ss.str();
   }
   if (is_variant_v<UndefinedVariableError>(error)) {
     const auto & err = as_variant<UndefinedVariableError>(error);
-    ss << "undefined variable '" << err.variable.lexeme << "' at line " << err.variable.line->number
+    ss << "undefined variable '" << err.variable.lexeme << "' at line " << err.variable.line
        << ", column "
-       << (err.variable.start_index + err.variable.lexeme.size() - err.variable.line->number + 1)
+       << (err.variable.get_start_index(lines) + err.variable.lexeme.size() - err.variable.line + 1)
        << std::endl;
     return ss.str();
   }
   if (is_variant_v<MaxLoopError>(error)) {
     const auto & err = as_variant<MaxLoopError>(error);
     ss << "exceeded maximum loop limit from '" << err.token.lexeme << "' statement at "
-       << err.token.line->number << ", column "
-       << (err.token.start_index + err.token.lexeme.size() - err.token.line->number + 1)
+       << err.token.line << ", column "
+       << (err.token.get_start_index(lines) + err.token.lexeme.size() - err.token.line + 1)
        << std::endl;
     return ss.str();
   }
   if (is_variant_v<NotInvocableError>(error)) {
     const auto & err = as_variant<NotInvocableError>(error);
     const auto [start, end] = boost::apply_visitor(ExprRangeVisitor(), err.callee);
-    ss << "could not call " << start.lexeme << " statement at " << start.line->number << ", column "
-       << (start.start_index + start.lexeme.size() - start.line->number + 1) << " because "
+    ss << "could not call " << start.lexeme << " statement at " << start.line << ", column "
+       << (start.get_start_index(lines) + start.lexeme.size() - start.line + 1) << " because "
        << err.desc << std::endl;
     return ss.str();
   }
   if (is_variant_v<NoReturnFromFunction>(error)) {
     const auto & err = as_variant<NoReturnFromFunction>(error);
     const auto func_name_decl = err.callee.definition->name;
-    ss << "function " << func_name_decl.lexeme << " define at line " << func_name_decl.line->number
+    ss << "function " << func_name_decl.lexeme << " define at line " << func_name_decl.line
        << ", column "
-       << (func_name_decl.start_index + func_name_decl.lexeme.size() -
-           func_name_decl.line->start_index + 1)
+       << (func_name_decl.get_start_index(lines) + func_name_decl.lexeme.size() -
+           lines.start_index(func_name_decl.line) + 1)
        << " does not return" << std::endl;
     return ss.str();
   }
@@ -247,106 +451,112 @@ auto get_line_string(const RuntimeError & error, const size_t offset) -> std::st
 }
 
 static auto get_visualization_string_expr(
-  const std::string & source, const Token & op, const Expr & expr,
-  const size_t offset) -> std::string
+  const LineTable & lines, const Token & op, const Expr & expr, const size_t offset) -> std::string
 {
   std::stringstream ss;
   if (offset > 0) {
     ss << std::string(offset, ' ');
   }
+  const auto source = lines.source();
   const auto [expr_start, expr_end] = boost::apply_visitor(ExprRangeVisitor(), expr);
-  // source(expr_start.line->start_index ~ expr_start.start_index): Thin
-  // source(expr_start.start_index+1 ~ op.start_index-1): underline
-  // source(op.start_index ~ op.start_index + op.lexeme.size()): red bold underline
-  // source(op.start_index + lexeme.size() + 1, expr_end.start_index + expr_end.lexeme.size()):
-  // underline source(expr_end.start_index + expr_end.lexeme.size() + 1,
-  // expr_end.line->end_index): Thin
+  const auto expr_start_index = expr_start.get_start_index(lines);
+  const auto expr_end_index = expr_end.get_start_index(lines);
+  const auto op_start_index = op.get_start_index(lines);
+  const auto expr_line_start_index = lines.start_index(expr_start.line);
+  const auto expr_line_end_index = lines.end_index(expr_end.line);
+  // source(expr_line_start_index ~ expr_start_index): Thin
+  // source(expr_start_index+1 ~ op_start_index-1): underline
+  // source(op_start_index ~ op_start_index + op.lexeme.size()): red bold underline
+  // source(op_start_index + lexeme.size() + 1, expr_end_index + expr_end.lexeme.size()):
+  // underline source(expr_end_index + expr_end.lexeme.size() + 1,
+  // expr_line_end_index): Thin
   ss << debug::Thin
-     << source.substr(
-          expr_start.line->start_index, expr_start.start_index - expr_start.line->start_index)
+     << source.substr(expr_line_start_index, expr_start_index - expr_line_start_index)
      << debug::Reset;
-  ss << debug::Underline
-     << source.substr(expr_start.start_index, op.start_index - (expr_start.start_index))
+  ss << debug::Underline << source.substr(expr_start_index, op_start_index - expr_start_index)
      << debug::Reset;
   ss << debug::Underline << debug::Red << debug::Bold
-     << source.substr(op.start_index, op.lexeme.size()) << debug::Reset;
+     << source.substr(op_start_index, op.lexeme.size()) << debug::Reset;
   ss << debug::Underline
      << source.substr(
-          op.start_index + op.lexeme.size(),
-          expr_end.start_index + expr_end.lexeme.size() - (op.start_index + op.lexeme.size()) + 1)
+          op_start_index + op.lexeme.size(),
+          expr_end_index + expr_end.lexeme.size() - (op_start_index + op.lexeme.size()) + 1)
      << debug::Reset;
   ss << debug::Thin
      << source.substr(
-          expr_end.start_index + expr_end.lexeme.size() + 1,
-          expr_end.line->end_index - (expr_end.start_index + expr_end.lexeme.size()))
+          expr_end_index + expr_end.lexeme.size() + 1,
+          expr_line_end_index - (expr_end_index + expr_end.lexeme.size()))
      << debug::Reset;
-  if (source.at(expr_end.line->end_index) != '\n') {
+  if (source.at(expr_line_end_index) != '\n') {
     ss << std::endl;
   }
-  ss << std::string(offset + (op.start_index - op.line->start_index), ' ') << "^" << std::endl;
+  ss << std::string(offset + (op_start_index - lines.start_index(op.line)), ' ') << "^"
+     << std::endl;
   return ss.str();
 }
 
 auto get_visualization_string(
-  const std::string_view & source, const Token & from, const Token & to,
-  const size_t offset) -> std::string
+  const LineTable & lines, const Token & from, const Token & to, const size_t offset) -> std::string
 {
   std::stringstream ss;
   if (offset > 0) {
     ss << std::string(offset, ' ');
   }
-  ss << debug::Thin
-     << source.substr(from.line->start_index, from.start_index - from.line->start_index)
+  const auto source = lines.source();
+  const auto from_index = from.get_start_index(lines);
+  const auto to_index = to.get_start_index(lines);
+  const auto from_line_start_index = lines.start_index(from.line);
+  ss << debug::Thin << source.substr(from_line_start_index, from_index - from_line_start_index)
      << debug::Reset;
   ss << debug::Underline << debug::Red << debug::Bold
-     << source.substr(from.start_index, to.start_index - from.start_index + to.lexeme.size())
-     << debug::Reset;
+     << source.substr(from_index, to_index - from_index + to.lexeme.size()) << debug::Reset;
   ss << debug::Thin
      << source.substr(
-          to.start_index + to.lexeme.size(),
-          to.line->end_index - (to.start_index + to.lexeme.size()))
+          to_index + to.lexeme.size(),
+          lines.end_index(to.line) - (to_index + to.lexeme.size()))
      << debug::Reset;
   ss << std::endl;
-  ss << std::string(offset + (from.start_index - from.line->start_index), ' ')
-     << std::string(to.start_index - from.start_index + to.lexeme.size(), '^') << std::endl;
+  ss << std::string(offset + (from_index - from_line_start_index), ' ')
+     << std::string(to_index - from_index + to.lexeme.size(), '^') << std::endl;
   return ss.str();
 }
 
 auto get_visualization_string(
-  const std::string & source, const RuntimeError & error, const size_t offset) -> std::string
+  const LineTable & lines, const RuntimeError & error, const size_t offset) -> std::string
 {
+  if (is_variant_v<SyntaxError>(error)) {
+    return as_variant<SyntaxError>(error).get_visualization_string(lines, offset);
+  }
   std::stringstream ss;
   if (offset > 0) {
     ss << std::string(offset, ' ');
   }
   if (is_variant_v<TypeError>(error)) {
     const auto & err = as_variant<TypeError>(error);
-    const auto [expr_start, expr_end] = boost::apply_visitor(ExprRangeVisitor(), err.expr);
-    return get_visualization_string_expr(source, err.op, err.expr, offset);
+    return get_visualization_string_expr(lines, err.op, err.expr, offset);
   }
   if (is_variant_v<UndefinedVariableError>(error)) {
     const auto & err = as_variant<UndefinedVariableError>(error);
-    const auto [expr_start, expr_end] = boost::apply_visitor(ExprRangeVisitor(), err.expr);
-    return get_visualization_string_expr(source, err.variable, err.expr, offset);
+    return get_visualization_string_expr(lines, err.variable, err.expr, offset);
   }
   if (is_variant_v<MaxLoopError>(error)) {
     const auto & err = as_variant<MaxLoopError>(error);
     if (err.cond) {
       const auto [expr_start, expr_end] =
         boost::apply_visitor(ExprRangeVisitor(), err.cond.value());
-      return get_visualization_string(source, err.token, expr_end, offset);
+      return get_visualization_string(lines, err.token, expr_end, offset);
     }
-    return get_visualization_string(source, err.token, err.token, offset);
+    return get_visualization_string(lines, err.token, err.token, offset);
   }
   if (is_variant_v<NotInvocableError>(error)) {
     const auto & err = as_variant<NotInvocableError>(error);
     const auto [start, end] = boost::apply_visitor(ExprRangeVisitor(), err.callee);
-    return get_visualization_string(source, start, end, offset);
+    return get_visualization_string(lines, start, end, offset);
   }
   if (is_variant_v<NoReturnFromFunction>(error)) {
     const auto & err = as_variant<NoReturnFromFunction>(error);
     return get_visualization_string(
-      source, err.callee.definition->name, err.callee.definition->name, offset);
+      lines, err.callee.definition->name, err.callee.definition->name, offset);
   }
   assert(false);
 }
@@ -378,8 +588,9 @@ void PrintResolveExprVisitor::operator()(const Group & expr)
 
 void PrintResolveExprVisitor::operator()(const Variable & expr)
 {
-  if (const auto it = lookup.find(expr.name); it != lookup.end()) {
-    ss << expr.name.lexeme << "(" << it->second << "), ";
+  if (const auto & location = expr.location; location) {
+    ss << expr.name.lexeme << "(" << magic_enum::enum_name(location->storage) << " "
+       << location->slot << "), ";
   } else {
     ss << expr.name.lexeme << "(failed to resolve), ";
   }
@@ -387,8 +598,9 @@ void PrintResolveExprVisitor::operator()(const Variable & expr)
 
 void PrintResolveExprVisitor::operator()(const Assign & expr)
 {
-  if (const auto it = lookup.find(expr.name); it != lookup.end()) {
-    ss << expr.name.lexeme << "(" << it->second << "), ";
+  if (const auto & location = expr.location; location) {
+    ss << expr.name.lexeme << "(" << magic_enum::enum_name(location->storage) << " "
+       << location->slot << "), ";
   } else {
     ss << "assign target '" << expr.name.lexeme << "'(failed to resolve), ";
   }
@@ -424,14 +636,14 @@ void PrintResolveExprVisitor::operator()(const SetProperty & property)
 
 void PrintResolveStmtVisitor::operator()(const ExprStmt & stmt)
 {
-  PrintResolveExprVisitor expr_visitor(lookup);
+  PrintResolveExprVisitor expr_visitor;
   boost::apply_visitor(expr_visitor, stmt.expression);
   ss << std::string(offset, ' ') << "| " << expr_visitor.ss.str() << std::endl;
 }
 
 void PrintResolveStmtVisitor::operator()(const PrintStmt & stmt)
 {
-  PrintResolveExprVisitor expr_visitor(lookup);
+  PrintResolveExprVisitor expr_visitor;
   boost::apply_visitor(expr_visitor, stmt.expression);
   ss << std::string(offset, ' ') << "| " << expr_visitor.ss.str() << std::endl;
 }
@@ -440,7 +652,7 @@ void PrintResolveStmtVisitor::operator()(const Block & stmt)
 {
   ss << std::string(offset, ' ') << "| <-- begin block -->" << std::endl;
   for (const auto & declaration : stmt.declarations) {
-    PrintResolveDeclVisitor decl_visitor(offset + skip, lookup);
+    PrintResolveDeclVisitor decl_visitor(offset + skip);
     boost::apply_visitor(decl_visitor, declaration);
     ss << decl_visitor.ss.str();
   }
@@ -453,19 +665,19 @@ void PrintResolveStmtVisitor::operator()(const IfBlock & stmt)
   size_t next_offset = offset + skip;
   auto process_branch_clause = [&](const BranchClause & branch_clause) {
     if (branch_clause.declaration) {
-      PrintResolveDeclVisitor decl_visitor(next_offset, lookup);
-      boost::apply_visitor(decl_visitor, Declaration{branch_clause.declaration.value()});
+      PrintResolveDeclVisitor decl_visitor(next_offset);
+      decl_visitor(branch_clause.declaration.value());
       ss << decl_visitor.ss.str();
     }
     {
-      PrintResolveExprVisitor expr_visitor(lookup);
+      PrintResolveExprVisitor expr_visitor;
       boost::apply_visitor(expr_visitor, branch_clause.cond);
       ss << std::string(offset, ' ') << "| " << expr_visitor.ss.str() << std::endl;
     }
     {
-      PrintResolveDeclVisitor decl_visitor(next_offset, lookup);
-      boost::apply_visitor(decl_visitor, Declaration{branch_clause.body});
-      ss << decl_visitor.ss.str();
+      PrintResolveStmtVisitor stmt_visitor(next_offset);
+      stmt_visitor(branch_clause.body);
+      ss << stmt_visitor.ss.str();
     }
   };
 
@@ -478,9 +690,9 @@ void PrintResolveStmtVisitor::operator()(const IfBlock & stmt)
 
   if (stmt.else_body) {
     next_offset += skip;
-    PrintResolveDeclVisitor decl_visitor(next_offset, lookup);
-    boost::apply_visitor(decl_visitor, Declaration{stmt.else_body.value()});
-    ss << decl_visitor.ss.str();
+    PrintResolveStmtVisitor stmt_visitor(next_offset);
+    stmt_visitor(stmt.else_body.value());
+    ss << stmt_visitor.ss.str();
   }
   ss << std::string(offset, ' ') << "| <-- end if -->" << std::endl;
 }
@@ -488,13 +700,13 @@ void PrintResolveStmtVisitor::operator()(const IfBlock & stmt)
 void PrintResolveStmtVisitor::operator()(const WhileStmt & stmt)
 {
   ss << std::string(offset, ' ') << "| <-- in while -->" << std::endl;
-  PrintResolveExprVisitor expr_visitor(lookup);
+  PrintResolveExprVisitor expr_visitor;
   boost::apply_visitor(expr_visitor, stmt.cond);
   ss << std::string(offset, ' ') << "| " << expr_visitor.ss.str() << std::endl;
 
-  PrintResolveDeclVisitor decl_visitor(offset, lookup);
-  boost::apply_visitor(decl_visitor, Stmt{stmt.body});
-  ss << decl_visitor.ss.str();
+  PrintResolveStmtVisitor stmt_visitor(offset);
+  stmt_visitor(stmt.body);
+  ss << stmt_visitor.ss.str();
   ss << std::string(offset, ' ') << "| <-- end while -->" << std::endl;
 }
 
@@ -505,29 +717,29 @@ void PrintResolveStmtVisitor::operator()(const ForStmt & stmt)
     const auto & init_stmt = stmt.init_stmt.value();
     if (is_variant_v<VarDecl>(init_stmt)) {
       const auto & decl = as_variant<VarDecl>(init_stmt);
-      PrintResolveDeclVisitor decl_visitor(offset + skip, lookup);
-      boost::apply_visitor(decl_visitor, Declaration{decl});
+      PrintResolveDeclVisitor decl_visitor(offset + skip);
+      decl_visitor(decl);
       ss << decl_visitor.ss.str();
     } else if (is_variant_v<ExprStmt>(init_stmt)) {
       const auto & expr_stmt = as_variant<ExprStmt>(init_stmt);
-      PrintResolveExprVisitor expr_visitor(lookup);
+      PrintResolveExprVisitor expr_visitor;
       boost::apply_visitor(expr_visitor, expr_stmt.expression);
       ss << std::string(offset, ' ') << "| " << expr_visitor.ss.str() << std::endl;
     }
   }
   if (stmt.cond) {
-    PrintResolveExprVisitor expr_visitor(lookup);
+    PrintResolveExprVisitor expr_visitor;
     boost::apply_visitor(expr_visitor, stmt.cond.value());
     ss << std::string(offset, ' ') << "| " << expr_visitor.ss.str() << std::endl;
   }
   if (stmt.next) {
-    PrintResolveExprVisitor expr_visitor(lookup);
+    PrintResolveExprVisitor expr_visitor;
     boost::apply_visitor(expr_visitor, stmt.next.value());
     ss << std::string(offset, ' ') << "| " << expr_visitor.ss.str() << std::endl;
   }
-  PrintResolveDeclVisitor decl_visitor(offset + skip, lookup);
-  boost::apply_visitor(decl_visitor, Declaration{stmt.body});
-  ss << decl_visitor.ss.str();
+  PrintResolveStmtVisitor stmt_visitor(offset + skip);
+  stmt_visitor(stmt.body);
+  ss << stmt_visitor.ss.str();
   ss << std::string(offset, ' ') << "| <-- end for -->" << std::endl;
 }
 
@@ -543,7 +755,7 @@ void PrintResolveStmtVisitor::operator()(const ReturnStmt & stmt)
 {
   if (stmt.expr) {
     ss << std::string(offset, ' ') << "| <-- in return -->" << std::endl;
-    PrintResolveExprVisitor expr_visitor(lookup);
+    PrintResolveExprVisitor expr_visitor;
     boost::apply_visitor(expr_visitor, stmt.expr.value());
     ss << std::string(offset, ' ') << "| " << expr_visitor.ss.str() << std::endl;
     ss << std::string(offset, ' ') << "| <-- end return -->" << std::endl;
@@ -558,7 +770,7 @@ void PrintResolveDeclVisitor::operator()(const VarDecl & var_decl)
 
 void PrintResolveDeclVisitor::operator()(const Stmt & stmt)
 {
-  PrintResolveStmtVisitor stmt_visitor(offset, lookup);
+  PrintResolveStmtVisitor stmt_visitor(offset);
   boost::apply_visitor(stmt_visitor, stmt);
   ss << stmt_visitor.ss.str();
 }
@@ -567,8 +779,8 @@ void PrintResolveDeclVisitor::operator()(const FuncDecl & func_decl)
 {
   ss << std::string(offset, ' ') << "| <-- in function '" << func_decl.name.lexeme << "' -->"
      << std::endl;
-  PrintResolveStmtVisitor stmt_visitor(offset, lookup);
-  boost::apply_visitor(stmt_visitor, Stmt{func_decl.body});
+  PrintResolveStmtVisitor stmt_visitor(offset);
+  stmt_visitor(func_decl.body);
   ss << stmt_visitor.ss.str();
   ss << std::string(offset, ' ') << "| <-- end function -->" << std::endl;
 }
@@ -578,8 +790,8 @@ void PrintResolveDeclVisitor::operator()(const ClassDecl & class_decl)
   ss << std::string(offset, ' ') << "| <-- in class '" << class_decl.name.lexeme << "' -->"
      << std::endl;
   for (const auto & [name, method] : class_decl.methods) {
-    PrintResolveDeclVisitor decl_visitor(offset + skip, lookup);
-    boost::apply_visitor(decl_visitor, Declaration{method});
+    PrintResolveDeclVisitor decl_visitor(offset + skip);
+    decl_visitor(method);
     ss << decl_visitor.ss.str();
   }
   ss << std::string(offset, ' ') << "| <-- end function -->" << std::endl;
@@ -1,4 +1,5 @@
 #include <cpplox/environment.hpp>
+#include <cpplox/heap.hpp>
 
 namespace lox
 {
@@ -6,66 +7,33 @@ namespace lox
 inline namespace environment
 {
 
-/*
-auto Environment::assign(const Token & var, const Value & var_value) -> std::optional<RuntimeError>
+auto Environment::define(const size_t slot, const Value & var_value, Heap & heap) -> void
 {
-if (const auto it = values_.find(var.lexeme); it != values_.end()) {
-  values_[var.lexeme] = var_value;
-  return std::nullopt;
-}
-if (enclosing_) {
-  return enclosing_->assign(var, var_value);
-}
-return UndefinedVariableError{var, Literal{var.type, var.lexeme, var.line, var.start_index}};
+  if (slot >= values_.size()) {
+    values_.resize(slot + 1);
+  }
+  heap.write_barrier(this, values_[slot] ? &values_[slot].value() : nullptr, var_value);
+  values_[slot] = var_value;
 }
-*/
 
-auto Environment::assign_deBruijn(const Token & var, const Value & var_value, const size_t depth)
+auto Environment::assign(const Token & var, const Value & var_value, const size_t slot, Heap & heap)
   -> std::optional<RuntimeError>
 {
-  if (depth == 0) {
-    if (const auto it = values_.find(var.lexeme); it != values_.end()) {
-      values_[var.lexeme] = var_value;
-      return std::nullopt;
-    }
-    return UndefinedVariableError{var, Literal{var.type, var.lexeme, var.line, var.start_index}};
-  }
-  if (!enclosing_) {
-    return UndefinedVariableError{var, Literal{var.type, var.lexeme, var.line, var.start_index}};
+  if (slot >= values_.size() || !values_[slot]) {
+    return UndefinedVariableError{var, Literal{var.type, var.lexeme, var.line}};
   }
-  return enclosing_->assign_deBruijn(var, var_value, depth - 1);
-}
-
-/*
-auto Environment::get(const Token & name) const -> std::variant<Value, RuntimeError>
-{
-if (const auto it = values_.find(name.lexeme); it != values_.end()) {
-  return it->second;
-} else if (enclosing_) {
-  return enclosing_->get(name);
-} else {
-  return UndefinedVariableError{
-    name, Literal{name.type, name.lexeme, name.line, name.start_index}};
-}
+  heap.write_barrier(this, &values_[slot].value(), var_value);
+  values_[slot] = var_value;
+  return std::nullopt;
 }
-*/
 
-auto Environment::get_deBruijn(const Token & name, const size_t depth) const
+auto Environment::get(const Token & name, const size_t slot) const
   -> std::variant<Value, RuntimeError>
 {
-  if (depth == 0) {
-    if (const auto it = values_.find(name.lexeme); it != values_.end()) {
-      return it->second;
-    } else {
-      return UndefinedVariableError{
-        name, Literal{name.type, name.lexeme, name.line, name.start_index}};
-    }
-  }
-  if (!enclosing_) {
-    return UndefinedVariableError{
-      name, Literal{name.type, name.lexeme, name.line, name.start_index}};
+  if (slot >= values_.size() || !values_[slot]) {
+    return UndefinedVariableError{name, Literal{name.type, name.lexeme, name.line}};
   }
-  return enclosing_->get_deBruijn(name, depth - 1);
+  return values_[slot].value();
 }
 
 }  // namespace environment
@@ -35,7 +35,7 @@ auto is_equal(const Value & left, const Value & right) -> bool
     return as_variant<double>(left) == as_variant<double>(right);
   }
   if (helper::is_str(left) && helper::is_str(right)) {
-    return as_variant<std::string>(left) == as_variant<std::string>(right);
+    return as_variant<String>(left) == as_variant<String>(right);
   }
   return false;
 }
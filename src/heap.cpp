@@ -0,0 +1,555 @@
+#include <cpplox/heap.hpp>
+
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace lox
+{
+
+inline namespace gc
+{
+
+namespace
+{
+class MarkValueVisitor : public boost::static_visitor<GcObject *>
+{
+public:
+  GcObject * operator()(const Callable & callable) const { return callable.closure; }
+
+  GcObject * operator()(const Class & cls) const { return cls; }
+
+  GcObject * operator()(const Instance & instance) const { return instance; }
+
+  template <typename T>
+  GcObject * operator()(const T &) const
+  {
+    return nullptr;
+  }
+};
+
+constexpr auto align_up(const size_t offset, const size_t align) -> size_t
+{
+  return (offset + align - 1) / align * align;
+}
+
+constexpr size_t ChunkHeaderSize = align_up(2 * sizeof(size_t), alignof(std::max_align_t));
+
+/**
+ * @brief the gray objects of a marker thread. the owner takes the last one, and the other threads
+ * steal the first one when they run out of their own
+ */
+struct MarkQueue
+{
+  std::mutex mutex;
+  std::deque<GcObject *> objects;
+};
+
+/**
+ * @brief call the destructor of the object, and free it if it is allocated by `new`
+ */
+template <typename T>
+auto dispose(GcObject * object) -> void
+{
+  auto * typed = static_cast<T *>(object);
+  if (object->chunked) {
+    typed->~T();
+  } else {
+    delete typed;
+  }
+}
+}  // namespace
+
+/**
+ * @brief the marker threads which are parked between the collections, so that a parallel marking
+ * does not pay for starting them
+ */
+class Heap::MarkerPool
+{
+public:
+  /**
+   * @brief start `threads` - 1 workers, as the caller of run() is the first marker
+   */
+  explicit MarkerPool(const size_t threads)
+  {
+    for (size_t id = 1; id < threads; ++id) {
+      workers_.emplace_back([this, id] { loop(id); });
+    }
+  }
+
+  MarkerPool(const MarkerPool &) = delete;
+
+  auto operator=(const MarkerPool &) -> MarkerPool & = delete;
+
+  ~MarkerPool()
+  {
+    {
+      const std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (auto & worker : workers_) {
+      worker.join();
+    }
+  }
+
+  /**
+   * @brief the number of the markers including the caller of run()
+   */
+  auto size() const noexcept -> size_t { return workers_.size() + 1; }
+
+  /**
+   * @brief call `job` with the id of each marker, where the caller is 0, and wait for all of them
+   */
+  auto run(const std::function<void(size_t)> & job) -> void
+  {
+    {
+      const std::lock_guard<std::mutex> lock(mutex_);
+      job_ = &job;
+      generation_++;
+      running_ = workers_.size();
+    }
+    start_.notify_all();
+    job(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return running_ == 0; });
+    job_ = nullptr;
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable start_;  //!< notified when a job is given or the pool is stopped
+  std::condition_variable done_;   //!< notified when the last worker finishes the job
+  const std::function<void(size_t)> * job_{nullptr};
+  size_t generation_{0};  //!< the number of the jobs given so far
+  size_t running_{0};     //!< the workers which have not finished the job
+  bool stop_{false};
+  std::vector<std::thread> workers_;
+
+  auto loop(const size_t id) -> void
+  {
+    size_t done_generation = 0;
+    for (;;) {
+      const std::function<void(size_t)> * job = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [&] { return stop_ || generation_ != done_generation; });
+        if (stop_) {
+          return;
+        }
+        done_generation = generation_;
+        job = job_;
+      }
+      (*job)(id);
+      const std::lock_guard<std::mutex> lock(mutex_);
+      if (--running_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+};
+
+Heap::Heap(const size_t threshold, const size_t nursery_size)
+: threshold_(threshold), nursery_size_(std::min(nursery_size, threshold))
+{
+  stats_.next_collection = threshold;
+}
+
+Heap::~Heap()
+{
+  for (auto * list : {young_objects_, old_objects_}) {
+    while (list) {
+      auto * next = list->next;
+      release(list);
+      list = next;
+    }
+  }
+  for (auto * chunk : free_chunks_) {
+    std::free(chunk);
+  }
+  std::free(current_);
+}
+
+auto Heap::use_parallel_marking(const size_t threads) -> void
+{
+  const auto markers = std::max<size_t>(threads, 1);
+  if (markers == (marker_pool_ ? marker_pool_->size() : 1)) {
+    return;
+  }
+  marker_pool_.reset();
+  if (markers > 1) {
+    marker_pool_ = std::make_unique<MarkerPool>(markers);
+  }
+}
+
+auto Heap::collect() -> void
+{
+  const Pause pause(*this);
+  minor_ = false;
+  // NOTE: if the incremental marking is in progress, the rest of its gray objects are traced here
+  mark_roots();
+  drain();
+  sweep_all();
+}
+
+auto Heap::collect_minor() -> void
+{
+  if (marking_) {
+    // the young objects are in the snapshot of the marking, so they are swept by finishing it
+    collect();
+    return;
+  }
+  const Pause pause(*this);
+  minor_ = true;
+  mark_roots();
+  drain();
+  const auto old_bytes = stats_.bytes - stats_.young_bytes;
+  const auto promoted_bytes = sweep(young_objects_);
+  minor_ = false;
+  stats_.bytes = old_bytes + promoted_bytes;
+  stats_.young_bytes = 0;
+  stats_.collections++;
+  stats_.minor_collections++;
+  // NOTE: a chunk is pinned by its promoted objects, so the reserved chunks beyond the nursery
+  // count as the old objects
+  const auto chunk_bytes = stats_.chunks * ChunkSize;
+  const auto pinned_bytes = chunk_bytes - std::min(chunk_bytes, nursery_size_);
+  if (std::max(stats_.bytes, pinned_bytes) > stats_.next_collection) {
+    collect_major();
+  }
+
+  // keep the free chunks for the next cycle of the nursery
+  while (free_chunks_.size() > nursery_size_ / ChunkSize + 1) {
+    std::free(free_chunks_.back());
+    free_chunks_.pop_back();
+    stats_.chunks--;
+  }
+}
+
+auto Heap::mark_roots() -> void
+{
+  for (const auto & root : roots_) {
+    if (std::holds_alternative<Environment * const *>(root)) {
+      mark(*std::get<Environment * const *>(root));
+    } else if (std::holds_alternative<const Value *>(root)) {
+      mark(*std::get<const Value *>(root));
+    } else if (std::holds_alternative<const std::vector<Value> *>(root)) {
+      for (const auto & value : *std::get<const std::vector<Value> *>(root)) {
+        mark(value);
+      }
+    } else {
+      for (auto * upvalue : *std::get<const std::vector<UpvalueObject *> *>(root)) {
+        mark(upvalue);
+      }
+    }
+  }
+  for (auto * object : remembered_) {
+    // the old objects are not marked by a minor collection, so their young references are traced
+    // from here
+    if (minor_) {
+      trace(object, gray_);
+    }
+    object->remembered = false;
+  }
+  remembered_.clear();
+}
+
+auto Heap::collect_major() -> void
+{
+  if (!incremental_) {
+    collect();
+    return;
+  }
+  if (!marking_) {
+    const Pause pause(*this);
+    minor_ = false;
+    mark_roots();
+    marking_ = true;
+    return;
+  }
+  // the execution allocates faster than the marking
+  if (stats_.bytes > stats_.next_collection * GrowthFactor) {
+    collect();
+  }
+}
+
+auto Heap::mark_step() -> void
+{
+  const Pause pause(*this);
+  stats_.mark_steps++;
+  for (size_t i = 0; i < MarkStepBudget && !gray_.empty(); ++i) {
+    const auto * object = gray_.back();
+    gray_.pop_back();
+    trace(object, gray_);
+  }
+  if (gray_.empty()) {
+    sweep_all();
+  }
+}
+
+auto Heap::drain() -> void
+{
+  if (marker_pool_ && !minor_ && stats_.objects >= ParallelMarkThreshold) {
+    drain_parallel();
+    return;
+  }
+  while (!gray_.empty()) {
+    const auto * object = gray_.back();
+    gray_.pop_back();
+    trace(object, gray_);
+  }
+}
+
+auto Heap::drain_parallel() -> void
+{
+  std::vector<MarkQueue> queues(marker_pool_->size());
+  for (size_t i = 0; i < gray_.size(); ++i) {
+    queues[i % queues.size()].objects.push_back(gray_[i]);
+  }
+  // the number of the objects which are pushed to the queues and not traced yet
+  std::atomic<size_t> pending{gray_.size()};
+  gray_.clear();
+
+  const std::function<void(size_t)> worker = [&](const size_t id) {
+    std::vector<GcObject *> found;
+    for (;;) {
+      GcObject * object = nullptr;
+      for (size_t k = 0; !object && k < queues.size(); ++k) {
+        auto & queue = queues[(id + k) % queues.size()];
+        const std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.objects.empty()) {
+          continue;
+        }
+        if (k == 0) {
+          object = queue.objects.back();
+          queue.objects.pop_back();
+        } else {
+          object = queue.objects.front();
+          queue.objects.pop_front();
+        }
+      }
+      if (!object) {
+        if (pending.load(std::memory_order_acquire) == 0) {
+          return;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      trace(object, found);
+      if (!found.empty()) {
+        pending.fetch_add(found.size(), std::memory_order_relaxed);
+        auto & queue = queues[id];
+        const std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.objects.insert(queue.objects.end(), found.begin(), found.end());
+        found.clear();
+      }
+      pending.fetch_sub(1, std::memory_order_release);
+    }
+  };
+  marker_pool_->run(worker);
+}
+
+auto Heap::sweep_all() -> void
+{
+  const auto old_bytes = sweep(old_objects_);
+  const auto promoted_bytes = sweep(young_objects_);
+  stats_.bytes = old_bytes + promoted_bytes;
+  stats_.young_bytes = 0;
+  stats_.next_collection = std::max(threshold_, stats_.bytes * GrowthFactor);
+  stats_.collections++;
+  marking_ = false;
+}
+
+auto Heap::record_pause(const double pause) -> void
+{
+  stats_.pauses++;
+  if (pauses_.size() < PauseWindow) {
+    pauses_.push_back(pause);
+    return;
+  }
+  pauses_[next_pause_] = pause;
+  next_pause_ = (next_pause_ + 1) % PauseWindow;
+}
+
+auto Heap::pause_percentile(const double percentile) const -> double
+{
+  if (pauses_.empty()) {
+    return 0.0;
+  }
+  // NOTE: the window is bounded, so selecting the rank from its copy is cheap
+  auto window = pauses_;
+  const auto rank = static_cast<size_t>(std::ceil(percentile / 100.0 * window.size()));
+  const auto nth = window.begin() + (std::clamp<size_t>(rank, 1, window.size()) - 1);
+  std::nth_element(window.begin(), nth, window.end());
+  return *nth;
+}
+
+auto Heap::sweep(GcObject *& list) -> size_t
+{
+  size_t live_bytes = 0;
+  auto * object = list;
+  list = nullptr;
+  while (object) {
+    auto * next = object->next;
+    if (!object->marked.load(std::memory_order_relaxed)) {
+      release(object);
+    } else {
+      object->marked.store(false, std::memory_order_relaxed);
+      if (object->young) {
+        object->young = false;
+        stats_.promoted++;
+      }
+      live_bytes += size_of(object);
+      object->next = old_objects_;
+      old_objects_ = object;
+    }
+    object = next;
+  }
+  return live_bytes;
+}
+
+auto Heap::bump(const size_t size, const size_t align) -> void *
+{
+  if (current_) {
+    const auto offset = align_up(current_->used, align);
+    if (offset + size <= ChunkSize) {
+      current_->used = offset + size;
+      current_->live++;
+      return reinterpret_cast<std::byte *>(current_) + offset;
+    }
+    // the chunk is reused once all its objects are released
+  }
+  if (!free_chunks_.empty()) {
+    current_ = free_chunks_.back();
+    free_chunks_.pop_back();
+  } else {
+    current_ = static_cast<Chunk *>(std::aligned_alloc(ChunkSize, ChunkSize));
+    if (!current_) {
+      throw std::bad_alloc();
+    }
+    current_->used = ChunkHeaderSize;
+    current_->live = 0;
+    stats_.chunks++;
+  }
+  return bump(size, align);
+}
+
+auto Heap::remember(GcObject * owner, const Value & value) -> void
+{
+  const auto * referent = boost::apply_visitor(MarkValueVisitor(), value);
+  if (referent && referent->young) {
+    owner->remembered = true;
+    remembered_.push_back(owner);
+  }
+}
+
+auto Heap::release(GcObject * object) -> void
+{
+  const bool chunked = object->chunked;
+  auto * chunk = reinterpret_cast<Chunk *>(
+    reinterpret_cast<std::uintptr_t>(object) & ~static_cast<std::uintptr_t>(ChunkSize - 1));
+  destroy(object);
+  stats_.objects--;
+  stats_.freed++;
+  if (chunked && --chunk->live == 0) {
+    chunk->used = ChunkHeaderSize;
+    if (chunk != current_) {
+      free_chunks_.push_back(chunk);
+    }
+  }
+}
+
+auto Heap::mark(const Value & value) -> void
+{
+  mark(boost::apply_visitor(MarkValueVisitor(), value));
+}
+
+auto Heap::trace(const GcObject * object, std::vector<GcObject *> & gray) const -> void
+{
+  switch (object->kind) {
+    case GcKind::Environment: {
+      const auto * env = static_cast<const Environment *>(object);
+      for (const auto & value : env->values_) {
+        if (value) {
+          mark(boost::apply_visitor(MarkValueVisitor(), value.value()), gray);
+        }
+      }
+      return;
+    }
+    case GcKind::Class:
+      for (const auto & [name, method] : static_cast<const ClassTemplate *>(object)->methods) {
+        mark(method.closure, gray);
+      }
+      return;
+    case GcKind::Instance: {
+      const auto * instance = static_cast<const InstanceObject *>(object);
+      mark(instance->cls, gray);
+      for (const auto & [name, value] : instance->fields) {
+        mark(boost::apply_visitor(MarkValueVisitor(), value), gray);
+      }
+      return;
+    }
+    case GcKind::Upvalue: {
+      // NOTE: the value of an open upvalue is in the ValueStack, which is a root
+      const auto & closed = static_cast<const UpvalueObject *>(object)->closed;
+      mark(boost::apply_visitor(MarkValueVisitor(), closed), gray);
+      return;
+    }
+    case GcKind::Closure:
+      for (auto * upvalue : static_cast<const ClosureObject *>(object)->upvalues) {
+        mark(upvalue, gray);
+      }
+      return;
+  }
+}
+
+auto Heap::size_of(const GcObject * object) -> size_t
+{
+  // NOTE: a node of unordered_map is counted as the entry and two pointers
+  switch (object->kind) {
+    case GcKind::Environment:
+      return sizeof(Environment) + static_cast<const Environment *>(object)->values_.capacity() *
+                                     sizeof(std::optional<Value>);
+    case GcKind::Class:
+      return sizeof(ClassTemplate) + static_cast<const ClassTemplate *>(object)->methods.size() *
+                                       (sizeof(std::pair<std::string_view, Callable>) + 16);
+    case GcKind::Instance:
+      return sizeof(InstanceObject) + static_cast<const InstanceObject *>(object)->fields.size() *
+                                        (sizeof(std::pair<std::string_view, Value>) + 16);
+    case GcKind::Upvalue:
+      return sizeof(UpvalueObject);
+    case GcKind::Closure:
+      return sizeof(ClosureObject) + static_cast<const ClosureObject *>(object)->upvalues.size() *
+                                       sizeof(UpvalueObject *);
+  }
+  return 0;
+}
+
+auto Heap::destroy(GcObject * object) -> void
+{
+  switch (object->kind) {
+    case GcKind::Environment:
+      dispose<Environment>(object);
+      return;
+    case GcKind::Class:
+      dispose<ClassTemplate>(object);
+      return;
+    case GcKind::Instance:
+      dispose<InstanceObject>(object);
+      return;
+    case GcKind::Upvalue:
+      dispose<UpvalueObject>(object);
+      return;
+    case GcKind::Closure:
+      dispose<ClosureObject>(object);
+      return;
+  }
+}
+
+}  // namespace gc
+}  // namespace lox
@@ -1,11 +1,11 @@
 #include <cpplox/debug.hpp>
 #include <cpplox/environment.hpp>
 #include <cpplox/interpreter.hpp>
-
-#include <boost/lexical_cast.hpp>
+#include <cpplox/optimizer.hpp>
 
 #include <functional>
 #include <iostream>
+#include <iterator>
 
 namespace lox
 {
@@ -13,16 +13,45 @@ namespace lox
 inline namespace interpreter
 {
 
+auto ValueStack::capture(const size_t slot) -> UpvalueObject *
+{
+  const auto index = base_ + slot;
+  // NOTE: the upvalues of the running frame are at the end, so they are searched from there
+  auto it = open_upvalues_.end();
+  while (it != open_upvalues_.begin() && (*std::prev(it))->slot >= index) {
+    --it;
+    if ((*it)->slot == index) {
+      return *it;
+    }
+  }
+  const auto position = it - open_upvalues_.begin();
+  auto * upvalue = heap_.make<UpvalueObject>(index);
+  open_upvalues_.insert(open_upvalues_.begin() + position, upvalue);
+  return upvalue;
+}
+
+auto ValueStack::close(const size_t index) -> void
+{
+  while (!open_upvalues_.empty() && open_upvalues_.back()->slot >= index) {
+    auto * upvalue = open_upvalues_.back();
+    const auto & value = values_[upvalue->slot];
+    heap_.write_barrier(upvalue, &upvalue->closed, value);
+    upvalue->closed = value;
+    upvalue->is_open = false;
+    open_upvalues_.pop_back();
+  }
+}
+
 auto Interpreter::evaluate_expr(const Expr & expr) -> std::variant<Value, RuntimeError>
 {
-  return impl::evaluate_expr_impl(expr, lookup_, global_env_, global_env_);
+  return impl::evaluate_expr_impl(expr, nullptr, global_env_, heap_, stack_);
 }  // LCOV_EXCL_LINE
 
 auto Interpreter::execute_declaration(const Declaration & declaration)
   -> std::optional<RuntimeError>
 {
   std::optional<ControlFlowKind> procedure{std::nullopt};
-  impl::ExecuteDeclarationVisitor executor(lookup_, global_env_, global_env_, procedure);
+  impl::ExecuteDeclarationVisitor executor(nullptr, global_env_, heap_, stack_, procedure);
   return boost::apply_visitor(executor, declaration);
 }
 
@@ -31,7 +60,14 @@ auto Interpreter::execute(const Program & program) -> std::optional<RuntimeError
   if (const auto resolve_opt = resolve(program); resolve_opt) {
     return resolve_opt.value();
   }
-  for (const auto & declaration : program) {
+  optimize_program(program);
+  if (program.arena && (arenas_.empty() || arenas_.back() != program.arena)) {
+    arenas_.push_back(program.arena);
+  }
+  // the local variables of the top-level code
+  ValueStack::Frame frame(stack_, program.frame_size);
+  frame.enter();
+  for (const auto & declaration : program.declarations) {
     const std::optional<RuntimeError> result = execute_declaration(declaration);
     if (result) {
       return result.value();
@@ -42,16 +78,7 @@ auto Interpreter::execute(const Program & program) -> std::optional<RuntimeError
 
 auto Interpreter::resolve(const Program & program) -> std::optional<CompileError>
 {
-  ScopeChain scope_chain;
-  scope_chain.push_back({});
-  DeclResolver resolver(scope_chain, lookup_);
-  for (const auto & declaration : program) {
-    const auto err = boost::apply_visitor(resolver, declaration);
-    if (err) {
-      return err;
-    }
-  }
-  return std::nullopt;
+  return resolve_program(program, global_scope_);
 }
 
 // LCOV_EXCL_START
@@ -60,8 +87,8 @@ auto Interpreter::print_resolve(const Program & program) -> void
   if (const auto resolve_result = resolve(program); resolve_result) {
     std::cout << "failed to resolve" << std::endl;
   } else {
-    for (const auto & declaration : program) {
-      PrintResolveDeclVisitor decl_visitor(0, lookup_);
+    for (const auto & declaration : program.declarations) {
+      PrintResolveDeclVisitor decl_visitor(0);
       boost::apply_visitor(decl_visitor, declaration);
       std::cout << decl_visitor.ss.str();
     }
@@ -72,8 +99,8 @@ auto Interpreter::print_resolve(const Program & program) -> void
 
 auto Interpreter::get_variable(const Token & token) const -> std::optional<Value>
 {
-  if (const auto it = global_env_->get_deBruijn(token, 0); is_variant_v<Value>(it) == true) {
-    return as_variant<Value>(it);
+  if (const auto it = global_scope_.find(token.lexeme); it != global_scope_.end()) {
+    return global_env_->get(it->second.slot);
   }
   return std::nullopt;
 }
@@ -114,36 +141,21 @@ auto apply_binary_op_bool(const Value & left_numeric, const Value & right_numeri
                F<double>()(as_variant<double>(left_numeric), as_variant<double>(right_numeric)))};
 }
 
-std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Literal & literal)
+static auto to_value(const Constant & constant) -> Value
 {
-  if (literal.type == TokenType::Nil) {
-    return expression::Nil{};
-  }
-  if (literal.type == TokenType::False) {
-    return false;
-  }
-  if (literal.type == TokenType::True) {
-    return true;
-  }
-  if (literal.type == TokenType::String) {
-    return std::string(literal.lexeme);
-  }
-  if (literal.type == TokenType::Number) {
-    const double d = boost::lexical_cast<double>(literal.lexeme);
-    if (literal.lexeme.find('.') != std::string::npos) {
-      return d;
-    }
-    Value v = static_cast<int64_t>(d);
-    return v;
-  }
+  return std::visit([](const auto & value) -> Value { return value; }, constant);
+}
 
-  // this is unreachable actually
-  assert(false);  // LCOV_EXCL_LINE
-  return expression::Nil{};
+std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Literal & literal)
+{
+  return to_value(literal.constant);
 }
 
 std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Unary & unary)
 {
+  if (unary.folded) {
+    return to_value(unary.folded.value());
+  }
   const auto right = boost::apply_visitor(*this, unary.expr);
   if (is_variant_v<RuntimeError>(right)) {
     return right;
@@ -167,10 +179,14 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Unary &
 
 std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary & binary)
 {
+  if (binary.folded) {
+    return to_value(binary.folded.value());
+  }
   const auto left_opt = boost::apply_visitor(*this, binary.left);
   if (is_variant_v<RuntimeError>(left_opt)) {
     return left_opt;
   }
+  const Heap::Root left_root(heap, as_variant<Value>(left_opt));
   const auto right_opt = boost::apply_visitor(*this, binary.right);
   if (is_variant_v<RuntimeError>(right_opt)) {
     return right_opt;
@@ -181,7 +197,7 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary &
   // A * B
   if (binary.op.type == TokenType::Star) {
     if (!helper::is_numeric(left) || !helper::is_numeric(right)) {
-      return TypeError{binary.op, binary};
+      return TypeError{binary.op, Ref(&binary)};
     }
     return apply_binary_op_scalar<std::multiplies>(left, right);
   }
@@ -189,7 +205,7 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary &
   // A / B
   if (binary.op.type == TokenType::Slash) {
     if (!helper::is_numeric(left) || !helper::is_numeric(right)) {
-      return TypeError{binary.op, binary};
+      return TypeError{binary.op, Ref(&binary)};
     }
     // TODO(soblin): ZeroDivisionError
     return apply_binary_op_scalar<std::divides>(left, right);
@@ -198,7 +214,7 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary &
   // A - B
   if (binary.op.type == TokenType::Minus) {
     if (!helper::is_numeric(left) || !helper::is_numeric(right)) {
-      return TypeError{binary.op, binary};
+      return TypeError{binary.op, Ref(&binary)};
     }
     return apply_binary_op_scalar<std::minus>(left, right);
   }
@@ -209,9 +225,9 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary &
       return apply_binary_op_scalar<std::plus>(left, right);
     }
     if (helper::is_str(left) && helper::is_str(right)) {
-      return as_variant<std::string>(left) + as_variant<std::string>(right);
+      return as_variant<String>(left) + as_variant<String>(right);
     }
-    return TypeError{binary.op, binary};
+    return TypeError{binary.op, Ref(&binary)};
   }
 
   // A > B
@@ -219,7 +235,7 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary &
     if (helper::is_numeric(left) && helper::is_numeric(right)) {
       return apply_binary_op_bool<std::greater>(left, right);
     }
-    return TypeError{binary.op, binary};
+    return TypeError{binary.op, Ref(&binary)};
   }
 
   // A >= B
@@ -227,7 +243,7 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary &
     if (helper::is_numeric(left) && helper::is_numeric(right)) {
       return apply_binary_op_bool<std::greater_equal>(left, right);
     }
-    return TypeError{binary.op, binary};
+    return TypeError{binary.op, Ref(&binary)};
   }
 
   // A < B
@@ -235,7 +251,7 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary &
     if (helper::is_numeric(left) && helper::is_numeric(right)) {
       return apply_binary_op_bool<std::less>(left, right);
     }
-    return TypeError{binary.op, binary};
+    return TypeError{binary.op, Ref(&binary)};
   }
 
   // A <= B
@@ -243,7 +259,7 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary &
     if (helper::is_numeric(left) && helper::is_numeric(right)) {
       return apply_binary_op_bool<std::less_equal>(left, right);
     }
-    return TypeError{binary.op, binary};
+    return TypeError{binary.op, Ref(&binary)};
   }
 
   // A == B
@@ -263,25 +279,31 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Binary &
 
 std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Group & group)
 {
+  if (group.folded) {
+    return to_value(group.folded.value());
+  }
   return boost::apply_visitor(*this, group.expr);
 }
 
 std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Variable & variable)
 {
-  if (const auto it = lookup_.find(variable.name); it != lookup_.end()) {
-    // const auto & var = variable.name;
-    /*
-    std::cout << var.lexeme << " at line " << var.line->number << ", column "
-              << var.get_lexical_column() << " has depth " << it->second << std::endl;
-    */
-    return env->get_deBruijn(variable.name, it->second);
+  if (const auto & location = variable.location; location) {
+    switch (location->storage) {
+      case Storage::Local:
+        return stack.local(location->slot);
+      case Storage::Upvalue:
+        return stack.get(*closure->upvalues[location->slot]);
+      case Storage::Global:
+        break;
+    }
+    return global_env->get(variable.name, location->slot);
   } else {
     const auto & var = variable.name;
     /*
-    std::cout << var.lexeme << " at line " << var.line->number << ", column "
-              << var.get_lexical_column() << " could not find depth " << std::endl;
+    std::cout << var.lexeme << " at line " << var.line << ", column "
+              << var.get_lexical_column(lines) << " could not find depth " << std::endl;
     */
-    return UndefinedVariableError{var, Literal{var.type, var.lexeme, var.line, var.start_index}};
+    return UndefinedVariableError{var, Literal{var.type, var.lexeme, var.line}};
   }
 }
 
@@ -292,8 +314,18 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Assign &
     return as_variant<RuntimeError>(rvalue_opt);
   }
   const auto & rvalue = as_variant<Value>(rvalue_opt);
-  if (const auto it = lookup_.find(assign.name); it != lookup_.end()) {
-    const auto assign_err = env->assign_deBruijn(assign.name, rvalue, it->second);
+  if (const auto & location = assign.location; location) {
+    switch (location->storage) {
+      case Storage::Local:
+        stack.local(location->slot) = rvalue;
+        return rvalue;
+      case Storage::Upvalue:
+        stack.set(closure->upvalues[location->slot], rvalue);
+        return rvalue;
+      case Storage::Global:
+        break;
+    }
+    const auto assign_err = global_env->assign(assign.name, rvalue, location->slot, heap);
     if (assign_err) {
       // NOTE: returned value from env does not contain expr information
       return UndefinedVariableError{assign.name, assign.expr};
@@ -306,6 +338,9 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Assign &
 
 std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Logical & logical)
 {
+  if (logical.folded) {
+    return to_value(logical.folded.value());
+  }
   const auto left_value_opt = boost::apply_visitor(*this, logical.left);
   if (is_variant_v<RuntimeError>(left_value_opt)) {
     return as_variant<RuntimeError>(left_value_opt);
@@ -349,10 +384,10 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Call & c
   if (!is_variant_v<Callable>(callee_value) && !is_variant_v<Class>(callee_value)) {
     return NotInvocableError{call.callee, "operand is not callable"};
   }
+  const Heap::Root callee_root(heap, callee_value);
 
   if (is_variant_v<Class>(callee_value)) {
-    const auto & cls = as_variant<Class>(callee_value);
-    return Instance{cls, std::make_shared<std::unordered_map<std::string_view, Value>>()};
+    return Value{heap.make<InstanceObject>(as_variant<Class>(callee_value))};
   }
 
   const auto & callee = as_variant<Callable>(callee_value);
@@ -361,21 +396,30 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const Call & c
   if (parameters.size() != arguments.size()) {
     return NotInvocableError{call.callee, "parameter and argument size do not match"};
   }
-  auto function_scope = std::make_shared<Environment>(callee.closure);
+  if (callee.definition->lazy) {
+    if (const auto err = materialize_body(callee.definition); err) {
+      return err.value();
+    }
+    optimize_function(callee.definition);
+  }
+  const auto & definition = callee.definition.get();
+  // the captured parameters and variables are closed when the frame is popped
+  ValueStack::Frame frame(stack, definition.frame_size);
   for (unsigned i = 0; i < parameters.size(); ++i) {
-    // evaluate argument using current environment
-    const auto arg_opt = evaluate_expr_impl(arguments.at(i), lookup_, env, global_env);
+    // evaluate argument using current closure and frame
+    const auto arg_opt = evaluate_expr_impl(arguments.at(i), closure, global_env, heap, stack);
     if (is_variant_v<RuntimeError>(arg_opt)) {
       return as_variant<RuntimeError>(arg_opt);
     }
-    function_scope->define(parameters.at(i), as_variant<Value>(arg_opt));
+    frame.local(definition.parameter_slots.at(i)) = as_variant<Value>(arg_opt);
   }
+  frame.enter();
   std::optional<ControlFlowKind> procedure;
-  // NOTE: function_scope is already defined, so if execute_stmt_impl is called against
+  // NOTE: the parameters are already in the frame, so if execute_stmt_impl is called against
   // callee.definition->body, which is a Block, it unintentionally adds a new scope.
   for (const auto & declaration : callee.definition->body.declarations) {
     const auto exec_err = boost::apply_visitor(
-      ExecuteDeclarationVisitor(lookup_, function_scope, global_env, procedure), declaration);
+      ExecuteDeclarationVisitor(callee.closure, global_env, heap, stack, procedure), declaration);
     if (exec_err) {
       return exec_err.value();
     }
@@ -399,10 +443,10 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const ReadProp
   if (!is_variant_v<Instance>(base)) {
     return NotInstanceError{property.base, property.prop};
   }
-  const auto & base_instance = as_variant<Instance>(base);
-  const auto it_field = base_instance.fields->find(property.prop.lexeme);
-  if (it_field == base_instance.fields->end()) {
-    const auto & methods = base_instance.cls->methods;
+  const auto * base_instance = as_variant<Instance>(base);
+  const auto it_field = base_instance->fields.find(property.prop.lexeme);
+  if (it_field == base_instance->fields.end()) {
+    const auto & methods = base_instance->cls->methods;
     const auto it_method = methods.find(property.prop.lexeme);
     if (it_method == methods.end()) {
       return InvalidAttributeError{property};
@@ -414,35 +458,39 @@ std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const ReadProp
 
 std::variant<Value, RuntimeError> EvaluateExprVisitor::operator()(const SetProperty & property)
 {
-  auto base_opt = boost::apply_visitor(*this, property.base);
+  const auto base_opt = boost::apply_visitor(*this, property.base);
   if (is_variant_v<RuntimeError>(base_opt)) {
     return as_variant<RuntimeError>(base_opt);
   }
-  auto & base = as_variant_mut<Value>(base_opt);
+  const auto & base = as_variant<Value>(base_opt);
   if (!is_variant_v<Instance>(base)) {
     return NotInstanceError{property.base, property.prop};
   }
-  const auto rvalue_opt = impl::evaluate_expr_impl(property.value, lookup_, env, global_env);
+  const Heap::Root base_root(heap, base);
+  const auto rvalue_opt =
+    impl::evaluate_expr_impl(property.value, closure, global_env, heap, stack);
   if (is_variant_v<RuntimeError>(rvalue_opt)) {
     return as_variant<RuntimeError>(rvalue_opt);
   }
   const auto & rvalue = as_variant<Value>(rvalue_opt);
-  auto & base_instance = as_variant_mut<Instance>(base);
-  base_instance.fields->operator[](property.prop.lexeme) = rvalue;
+  auto * instance = as_variant<Instance>(base);
+  auto & field = instance->fields[property.prop.lexeme];
+  heap.write_barrier(instance, &field, rvalue);
+  field = rvalue;
   return rvalue;
 }
 
 auto evaluate_expr_impl(
-  const Expr & expr, const ScopeLookup & lookup, std::shared_ptr<Environment> env,
-  std::shared_ptr<Environment> global_env) -> std::variant<Value, RuntimeError>
+  const Expr & expr, ClosureObject * closure, Environment * global_env, Heap & heap,
+  ValueStack & stack) -> std::variant<Value, RuntimeError>
 {
-  auto evaluator = EvaluateExprVisitor(lookup, env, global_env);
+  auto evaluator = EvaluateExprVisitor(closure, global_env, heap, stack);
   return boost::apply_visitor(evaluator, expr);
 }
 
 std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const ExprStmt & stmt)
 {
-  const auto eval_opt = impl::evaluate_expr_impl(stmt.expression, lookup_, env, global_env);
+  const auto eval_opt = impl::evaluate_expr_impl(stmt.expression, closure, global_env, heap, stack);
   if (is_variant_v<RuntimeError>(eval_opt)) {
     return as_variant<RuntimeError>(eval_opt);
   }
@@ -451,7 +499,7 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const ExprStmt & stmt
 
 std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const PrintStmt & stmt)
 {
-  const auto eval_opt = impl::evaluate_expr_impl(stmt.expression, lookup_, env, global_env);
+  const auto eval_opt = impl::evaluate_expr_impl(stmt.expression, closure, global_env, heap, stack);
   if (is_variant_v<RuntimeError>(eval_opt)) {
     return as_variant<RuntimeError>(eval_opt);
   }
@@ -465,16 +513,18 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const Block & block)
 {
   /**
    * how it works:
-   * when a Block-statement is found, a inner env is created, and it is passed to
-   * ExecuteDeclarationVisitor, which may process a Stmt-declaration, and the Stmt-declaration maybe
-   * a Block-statement, thus a inner-inner env is created.
+   * the variables of a Block-statement are in the slots of the frame assigned by the resolver, and
+   * its declarations are processed by ExecuteDeclarationVisitor, which may process a
+   * Stmt-declaration, and the Stmt-declaration maybe a Block-statement in the following slots.
    *
    * Block is neutral against break/continue/return and keep it as it
+   *
+   * if a variable of the block is captured, its upvalue is closed on every exit of the block
    */
-  auto sub_scope_env = std::make_shared<Environment>(env);
+  const ValueStack::ScopeExit scope_exit(stack, block.captured_base);
   for (const auto & declaration : block.declarations) {
     const auto eval_opt = boost::apply_visitor(
-      ExecuteDeclarationVisitor(lookup_, sub_scope_env, global_env, procedure), declaration);
+      ExecuteDeclarationVisitor(closure, global_env, heap, stack, procedure), declaration);
     if (eval_opt) {
       return eval_opt;
     }
@@ -493,7 +543,8 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const WhileStmt & whi
     if (cnt > MaxLoopError::Limit) {
       return MaxLoopError{while_stmt.while_token, while_stmt.cond};
     }
-    const auto eval_cond_opt = impl::evaluate_expr_impl(while_stmt.cond, lookup_, env, global_env);
+    const auto eval_cond_opt =
+      impl::evaluate_expr_impl(while_stmt.cond, closure, global_env, heap, stack);
     if (is_variant_v<RuntimeError>(eval_cond_opt)) {
       return as_variant<RuntimeError>(eval_cond_opt);
     }
@@ -501,8 +552,8 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const WhileStmt & whi
     if (!is_truthy(cond)) {
       return std::nullopt;
     }
-    const auto exec_opt = boost::apply_visitor(
-      ExecuteStmtVisitor(lookup_, env, global_env, procedure), Stmt{while_stmt.body});
+    const auto exec_opt =
+      ExecuteStmtVisitor(closure, global_env, heap, stack, procedure)(while_stmt.body);
     if (exec_opt) {
       return exec_opt;
     }
@@ -530,24 +581,23 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const WhileStmt & whi
 }
 
 std::variant<bool, RuntimeError> ExecuteStmtVisitor::execute_branch_clause(
-  const BranchClause & clause, std::shared_ptr<Environment> if_scope_env)
+  const BranchClause & clause)
 {
   if (clause.declaration) {
-    const auto var_decl_opt = boost::apply_visitor(
-      ExecuteDeclarationVisitor(lookup_, if_scope_env, global_env, procedure),
-      Declaration{clause.declaration.value()});
+    const auto var_decl_opt = ExecuteDeclarationVisitor(
+      closure, global_env, heap, stack, procedure)(clause.declaration.value());
     if (var_decl_opt) {
       return var_decl_opt.value();
     }
   }
-  const auto cond_opt = impl::evaluate_expr_impl(clause.cond, lookup_, if_scope_env, global_env);
+  const auto cond_opt = impl::evaluate_expr_impl(clause.cond, closure, global_env, heap, stack);
   if (is_variant_v<RuntimeError>(cond_opt)) {
     return as_variant<RuntimeError>(cond_opt);
   }
   const auto & cond = as_variant<Value>(cond_opt);
   if (is_truthy(cond)) {
-    const auto exec_opt = boost::apply_visitor(
-      ExecuteStmtVisitor(lookup_, if_scope_env, global_env, procedure), Stmt{clause.body});
+    const auto exec_opt =
+      ExecuteStmtVisitor(closure, global_env, heap, stack, procedure)(clause.body);
     if (exec_opt) {
       return exec_opt.value();
     }
@@ -569,12 +619,19 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const IfBlock & if_bl
    */
 
   /**
-   * first, top-level if scope environment is created
-   * this scope is local variable in this function and will be "forgotten"
+   * the declarations of the clauses are in the frame, and each scope of the elseif clauses encloses
+   * the previous one. so the upvalues of all of them are closed at once from the outermost scope
+   * which has a captured variable
    */
-  auto top_if_scope_env = std::make_shared<Environment>(env);
+  auto captured_base = if_block.if_clause.captured_base;
+  for (const auto & elseif_clause : if_block.elseif_clauses) {
+    if (!captured_base) {
+      captured_base = elseif_clause.captured_base;
+    }
+  }
+  const ValueStack::ScopeExit scope_exit(stack, captured_base);
 
-  const auto execute_if_opt = execute_branch_clause(if_block.if_clause, top_if_scope_env);
+  const auto execute_if_opt = execute_branch_clause(if_block.if_clause);
   if (is_variant_v<RuntimeError>(execute_if_opt)) {
     return as_variant<RuntimeError>(execute_if_opt);
   }
@@ -583,10 +640,8 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const IfBlock & if_bl
     return std::nullopt;
   }
   // execute either of the elseif
-  std::vector<std::shared_ptr<Environment>> envs{top_if_scope_env};
   for (const auto & elseif_clause : if_block.elseif_clauses) {
-    envs.push_back(std::make_shared<Environment>(envs.back()));
-    const auto execute_elseif_opt = execute_branch_clause(elseif_clause, envs.back());
+    const auto execute_elseif_opt = execute_branch_clause(elseif_clause);
     if (is_variant_v<RuntimeError>(execute_elseif_opt)) {
       return as_variant<RuntimeError>(execute_elseif_opt);
     }
@@ -597,11 +652,9 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const IfBlock & if_bl
     }
   }
   if (if_block.else_body) {
-    // auto else_scope_env = std::make_shared<Environment>(envs.back());
     // execute the last else
-    const auto exec_else_opt = boost::apply_visitor(
-      ExecuteStmtVisitor(lookup_, envs.back(), global_env, procedure),
-      Stmt{if_block.else_body.value()});
+    const auto exec_else_opt = ExecuteStmtVisitor(
+      closure, global_env, heap, stack, procedure)(if_block.else_body.value());
     if (exec_else_opt) {
       return exec_else_opt;
     }
@@ -611,14 +664,14 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const IfBlock & if_bl
 
 std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const ForStmt & for_stmt)
 {
-  // initialization
-  auto sub_for_env = std::make_shared<Environment>(env);
+  // initialization. the loop variable is shared by the iterations, so it is closed after the loop
+  const ValueStack::ScopeExit scope_exit(stack, for_stmt.captured_base);
   if (for_stmt.init_stmt) {
     const auto & init_stmt = for_stmt.init_stmt.value();
     if (is_variant_v<VarDecl>(init_stmt)) {
       const auto & init_var_stmt = as_variant<VarDecl>(init_stmt);
-      impl::ExecuteDeclarationVisitor executor(lookup_, sub_for_env, global_env, procedure);
-      const auto exec = boost::apply_visitor(executor, Declaration{init_var_stmt});
+      impl::ExecuteDeclarationVisitor executor(closure, global_env, heap, stack, procedure);
+      const auto exec = executor(init_var_stmt);
       assert(!procedure);  //!< only var_decl/expr_statement is called, so there is no chance of
                            //!< break/continue
       if (exec) {
@@ -627,7 +680,7 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const ForStmt & for_s
     } else {
       const auto & init_var_stmt = as_variant<ExprStmt>(init_stmt);
       const auto exec =
-        impl::execute_stmt_impl(init_var_stmt, lookup_, sub_for_env, global_env, procedure);
+        impl::execute_stmt_impl(init_var_stmt, closure, global_env, heap, stack, procedure);
       if (exec) {
         return exec;
       }
@@ -639,7 +692,7 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const ForStmt & for_s
       return true;
     }
     const auto cond_opt =
-      impl::evaluate_expr_impl(for_stmt.cond.value(), lookup_, sub_for_env, global_env);
+      impl::evaluate_expr_impl(for_stmt.cond.value(), closure, global_env, heap, stack);
     if (is_variant_v<RuntimeError>(cond_opt)) {
       return as_variant<RuntimeError>(cond_opt);
     }
@@ -652,7 +705,7 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const ForStmt & for_s
       return std::nullopt;
     }
     const auto exec =
-      impl::evaluate_expr_impl(for_stmt.next.value(), lookup_, sub_for_env, global_env);
+      impl::evaluate_expr_impl(for_stmt.next.value(), closure, global_env, heap, stack);
     if (is_variant_v<RuntimeError>(exec)) {
       return as_variant<RuntimeError>(exec);
     }
@@ -673,8 +726,8 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const ForStmt & for_s
       break;
     }
     // do the body
-    const auto exec_opt = boost::apply_visitor(
-      ExecuteStmtVisitor(lookup_, sub_for_env, global_env, procedure), Stmt{for_stmt.body});
+    const auto exec_opt =
+      ExecuteStmtVisitor(closure, global_env, heap, stack, procedure)(for_stmt.body);
     if (exec_opt) {
       return exec_opt;
     }
@@ -724,7 +777,8 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const ReturnStmt & re
 {
   std::optional<Value> value_opt{std::nullopt};
   if (return_stmt.expr) {
-    const auto value = impl::evaluate_expr_impl(return_stmt.expr.value(), lookup_, env, global_env);
+    const auto value =
+      impl::evaluate_expr_impl(return_stmt.expr.value(), closure, global_env, heap, stack);
     if (is_variant_v<RuntimeError>(value)) {
       return as_variant<RuntimeError>(value);
     }
@@ -735,11 +789,10 @@ std::optional<RuntimeError> ExecuteStmtVisitor::operator()(const ReturnStmt & re
 }
 
 auto execute_stmt_impl(
-  const Stmt & stmt, const ScopeLookup & lookup, std::shared_ptr<Environment> env,
-  std::shared_ptr<Environment> global_env,
-  std::optional<ControlFlowKind> & procedure) -> std::optional<RuntimeError>
+  const Stmt & stmt, ClosureObject * closure, Environment * global_env, Heap & heap,
+  ValueStack & stack, std::optional<ControlFlowKind> & procedure) -> std::optional<RuntimeError>
 {
-  impl::ExecuteStmtVisitor executor(lookup, env, global_env, procedure);
+  impl::ExecuteStmtVisitor executor(closure, global_env, heap, stack, procedure);
   return boost::apply_visitor(executor, stmt);
 }
 
@@ -747,47 +800,61 @@ std::optional<RuntimeError> ExecuteDeclarationVisitor::operator()(const VarDecl
 {
   if (decl.initializer) {
     const auto eval_opt =
-      impl::evaluate_expr_impl(decl.initializer.value(), lookup_, env, global_env);
+      impl::evaluate_expr_impl(decl.initializer.value(), closure, global_env, heap, stack);
     if (is_variant_v<RuntimeError>(eval_opt)) {
       return as_variant<RuntimeError>(eval_opt);
     }
-    env->define(decl.name, as_variant<Value>(eval_opt));
+    define(decl.on_stack, decl.slot, as_variant<Value>(eval_opt));
   } else {
-    env->define(decl.name, Nil{});
+    define(decl.on_stack, decl.slot, Nil{});
   }
   return std::nullopt;
 }
 
 std::optional<RuntimeError> ExecuteDeclarationVisitor::operator()(const Stmt & stmt)
 {
-  return execute_stmt_impl(stmt, lookup_, env, global_env, procedure);
+  return execute_stmt_impl(stmt, closure, global_env, heap, stack, procedure);
 }  // LCOV_EXCL_LINE
 
 std::optional<RuntimeError> ExecuteDeclarationVisitor::operator()(const FuncDecl & func_decl)
 {
-  // functions defined in global scope refer to global_scope
-  // functions defined in local scope(closure) refer to current scope and is regsitered in current
-  // scope
-  if (env == global_env) {
-    global_env->define(
-      func_decl.name, Callable{std::make_shared<const FuncDecl>(func_decl), global_env});
-  } else {
-    env->define(func_decl.name, Callable{std::make_shared<const FuncDecl>(func_decl), env});
+  // functions capture the local variables of the running frame and the upvalues of the running
+  // closure which they refer to. the functions which capture nothing share no closure
+  ClosureObject * function_closure = nullptr;
+  if (!func_decl.upvalues.empty()) {
+    std::vector<UpvalueObject *> upvalues;
+    upvalues.reserve(func_decl.upvalues.size());
+    for (const auto & upvalue : func_decl.upvalues) {
+      // NOTE: the open upvalues are rooted by the stack, and the others by the running closure
+      upvalues.push_back(
+        upvalue.is_local ? stack.capture(upvalue.index) : closure->upvalues[upvalue.index]);
+    }
+    function_closure = heap.make<ClosureObject>(std::move(upvalues));
   }
+  define(func_decl.on_stack, func_decl.slot, Callable{Ref(&func_decl), function_closure});
   return std::nullopt;
 }  // LCOV_EXCL_LINE
 
+auto ExecuteDeclarationVisitor::define(const bool on_stack, const size_t slot, const Value & value)
+  -> void
+{
+  if (on_stack) {
+    stack.local(slot) = value;
+  } else {
+    global_env->define(slot, value, heap);
+  }
+}
+
 std::optional<RuntimeError> ExecuteDeclarationVisitor::operator()(const ClassDecl & class_decl)
 {
   std::unordered_map<std::string_view, Callable> methods;
   // TODO(soblin): define "this" here
-  auto class_env = std::make_shared<Environment>(global_env);
+  // NOTE: the methods refer only to the global variables, so they capture nothing
   for (const auto & [name, decl] : class_decl.methods) {
-    methods.emplace(name, Callable{std::make_shared<FuncDecl>(decl), class_env});
+    methods.emplace(name, Callable{Ref(&decl), nullptr});
   }
   global_env->define(
-    class_decl.name,
-    std::make_shared<ClassTemplate>(std::make_shared<const ClassDecl>(class_decl), methods));
+    class_decl.slot, heap.make<ClassTemplate>(Ref(&class_decl), std::move(methods)), heap);
   return std::nullopt;
 }
 
@@ -1,21 +1,30 @@
+#include <cpplox/cache.hpp>
+#include <cpplox/debug.hpp>
 #include <cpplox/error.hpp>
 #include <cpplox/expression.hpp>
 #include <cpplox/interpreter.hpp>
+#include <cpplox/optimizer.hpp>
 #include <cpplox/parser.hpp>
+#include <cpplox/resolver.hpp>
+#include <cpplox/source.hpp>
 #include <cpplox/tokenizer.hpp>
 #include <cpplox/variant.hpp>
+#include <cpplox/vm.hpp>
 
 #include <boost/program_options.hpp>
 
 #include <readline/history.h>
 #include <readline/readline.h>
 
+#include <cstdio>
 #include <cstdlib>
-#include <fstream>
+#include <filesystem>
 #include <iostream>
 #include <optional>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
 
 #include <magic_enum.hpp>
 
@@ -50,49 +59,165 @@ private:
   char * input_{nullptr};
 };
 
-auto run(lox::Interpreter & interpreter, const std::string & program)
+/**
+ * @param jobs the number of the threads to tokenize `source` (all the cores if 0). if it is 1, the
+ * tokens are scanned on demand without keeping all of them
+ * @param mode whether the function bodies are parsed on their first calls
+ */
+auto parse(
+  const std::string_view source, const size_t jobs = 1,
+  const lox::ParseMode mode = lox::ParseMode::Eager) -> std::variant<lox::Program, lox::SyntaxError>
+{
+  auto token_stream = [&]() -> std::variant<lox::TokenStream, lox::SyntaxError> {
+    if (jobs == 1) {
+      return lox::TokenStream(source);
+    }
+    auto tokens = lox::take_tokens_parallel(source, jobs);
+    if (lox::is_variant_v<lox::SyntaxError>(tokens)) {
+      return lox::as_variant<lox::SyntaxError>(tokens);
+    }
+    return lox::TokenStream(std::move(lox::as_variant_mut<lox::Tokens>(tokens)));
+  }();
+  if (lox::is_variant_v<lox::SyntaxError>(token_stream)) {
+    return lox::as_variant<lox::SyntaxError>(token_stream);
+  }
+  auto parser = lox::Parser(std::move(lox::as_variant_mut<lox::TokenStream>(token_stream)), mode);
+  return parser.program();
+}
+
+/**
+ * @brief Engine is either lox::Interpreter or lox::vm::VM
+ */
+template <typename Engine>
+auto execute(Engine & engine, const lox::Program & program)
   -> std::variant<std::monostate, lox::SyntaxError, lox::RuntimeError>
 {
-  auto tokenizer = lox::Tokenizer(program);
-  const auto result = tokenizer.take_tokens();
-  if (lox::is_variant_v<lox::SyntaxError>(result)) {
-    return lox::as_variant<lox::SyntaxError>(result);
+  const auto exec_opt = engine.execute(program);
+  if (exec_opt) {
+    return exec_opt.value();
   }
-  const auto & tokens = lox::as_variant<lox::Tokens>(result);
-  auto parser = lox::Parser(tokens);
-  const auto program_result = parser.program();
+  return std::monostate{};
+}
+
+template <typename Engine>
+auto run(
+  Engine & engine, const std::string_view source, const size_t jobs = 1,
+  const lox::ParseMode mode = lox::ParseMode::Eager)
+  -> std::variant<std::monostate, lox::SyntaxError, lox::RuntimeError>
+{
+  const auto program_result = parse(source, jobs, mode);
   if (lox::is_variant_v<lox::SyntaxError>(program_result)) {
     return lox::as_variant<lox::SyntaxError>(program_result);
   }
-  const auto exec_opt =
-    interpreter.execute(lox::as_variant<std::vector<lox::Declaration>>(program_result));
-  if (exec_opt) {
-    return exec_opt.value();
+  return execute(engine, lox::as_variant<lox::Program>(program_result));
+}
+
+struct RunOptions
+{
+  size_t jobs{1};  //!< the number of the threads to tokenize the file
+  lox::ParseMode mode{lox::ParseMode::Eager};
+  bool cache{false};  //!< load the resolved program from the cache, or save it after parsing
+  std::optional<std::string> cache_dir{std::nullopt};  //!< put the cache next to the file if null
+  size_t gc_threads{1};  //!< the number of the threads to mark the heap of the tree-walk engine
+  bool gc_incremental{false};  //!< mark the heap in slices between the allocations
+  bool gc_stats{false};        //!< print the statistics of the heap after the execution
+};
+
+/**
+ * @brief print the collections and the percentiles of their recent pauses to stderr
+ */
+auto print_gc_stats(const lox::Heap & heap) -> void
+{
+  const auto & stats = heap.stats();
+  std::fprintf(
+    stderr,
+    "[gc] collections = %zu (minor = %zu, major = %zu, mark steps = %zu), allocated = %zu, "
+    "freed = %zu, promoted = %zu\n",
+    stats.collections, stats.minor_collections, stats.collections - stats.minor_collections,
+    stats.mark_steps, stats.allocated, stats.freed, stats.promoted);
+  std::fprintf(
+    stderr, "[gc] heap = %zu [KiB], peak = %zu [KiB], objects = %zu, chunks = %zu\n",
+    stats.bytes / 1024, stats.peak_bytes / 1024, stats.objects, stats.chunks);
+  std::fprintf(
+    stderr, "[gc] pauses = %zu, p50 = %.1f [us], p99 = %.1f [us], max = %.1f [us]\n",
+    stats.pauses, heap.pause_percentile(50), heap.pause_percentile(99),
+    heap.pause_percentile(100));
+}
+
+/**
+ * @brief load the program of `source` from its cache, or parse it and save the cache if the cache
+ * is missing or stale
+ */
+auto parse_with_cache(
+  const std::string & path, const std::string_view source, const RunOptions & options)
+  -> std::variant<lox::Program, lox::SyntaxError>
+{
+  const auto cache_path = lox::cache_path_of(path, source, options.cache_dir);
+  if (auto cached = lox::load_cache(cache_path, source, options.mode); cached) {
+    return std::move(cached.value());
   }
-  return std::monostate{};
+  auto program_result = parse(source, options.jobs, options.mode);
+  if (lox::is_variant_v<lox::SyntaxError>(program_result)) {
+    return program_result;
+  }
+  auto & program = lox::as_variant_mut<lox::Program>(program_result);
+  // NOTE: a program which fails to be resolved is not cached, and the engine reports the error
+  if (lox::Scope globals; !lox::resolve_program(program, globals)) {
+    program.resolved_globals = lox::to_global_slots(globals);
+    if (options.cache_dir) {
+      std::error_code err;
+      std::filesystem::create_directories(options.cache_dir.value(), err);
+    }
+    // the program still runs without the cache, but every run would parse it again silently
+    if (!lox::save_cache(cache_path, program, source, options.mode)) {
+      std::cerr << "[cache] failed to write " << cache_path << std::endl;
+    }
+  }
+  return program_result;
 }
 
-auto runFile(const char * path) -> int
+template <typename Engine>
+auto runFile(const std::string & path, const RunOptions & options) -> int
 {
-  std::ifstream ifs(path);
-  if (!ifs) {
+  // NOTE: the tokens and the errors refer to this buffer
+  const auto buffer = lox::SourceBuffer::open(path);
+  if (!buffer) {
     std::cerr << path << " does not exist" << std::endl;
     return 1;
   }
-  std::stringstream ss;
-  ss << ifs.rdbuf();
-  lox::Interpreter interpreter;
-  const auto exec_opt = run(interpreter, ss.str());
+  const auto source = buffer->view();
+  Engine engine;
+  if constexpr (std::is_same_v<Engine, lox::Interpreter>) {
+    engine.heap().use_parallel_marking(options.gc_threads);
+    engine.heap().use_incremental_marking(options.gc_incremental);
+  }
+  const auto exec_opt = [&]() -> std::variant<std::monostate, lox::SyntaxError, lox::RuntimeError> {
+    if (!options.cache) {
+      return run(engine, source, options.jobs, options.mode);
+    }
+    const auto program_result = parse_with_cache(path, source, options);
+    if (lox::is_variant_v<lox::SyntaxError>(program_result)) {
+      return lox::as_variant<lox::SyntaxError>(program_result);
+    }
+    return execute(engine, lox::as_variant<lox::Program>(program_result));
+  }();
+  if constexpr (std::is_same_v<Engine, lox::Interpreter>) {
+    if (options.gc_stats) {
+      print_gc_stats(engine.heap());
+    }
+  }
   if (lox::is_variant_v<lox::SyntaxError>(exec_opt)) {
     const auto & err = lox::as_variant<lox::SyntaxError>(exec_opt);
-    std::cout << err.get_line_string(2);
-    std::cout << err.get_visualization_string(ss.str(), 4);
+    const auto lines = lox::LineTable(source, path);
+    std::cout << err.get_line_string(lines, 2);
+    std::cout << err.get_visualization_string(lines, 4);
     return 1;
   }
   if (lox::is_variant_v<lox::RuntimeError>(exec_opt)) {
     const auto & exec = lox::as_variant<lox::RuntimeError>(exec_opt);
-    std::cout << lox::get_line_string(exec, 2);
-    std::cout << lox::get_visualization_string(ss.str(), exec, 4);
+    const auto lines = lox::LineTable(source, path);
+    std::cout << lox::get_line_string(lines, exec, 2);
+    std::cout << lox::get_visualization_string(lines, exec, 4);
     return 1;
   }
   return 0;
@@ -100,29 +225,20 @@ auto runFile(const char * path) -> int
 
 auto runScopeAnalysisFile(const char * path) -> int
 {
-  std::ifstream ifs(path);
-  if (!ifs) {
+  // NOTE: the tokens and the errors refer to this buffer
+  const auto buffer = lox::SourceBuffer::open(path);
+  if (!buffer) {
     std::cerr << path << " does not exist" << std::endl;
     return 1;
   }
-  std::stringstream ss;
-  ss << ifs.rdbuf();
-  const auto & source = ss.str();
-  auto tokenizer = lox::Tokenizer(source);
-  const auto result = tokenizer.take_tokens();
-  if (lox::is_variant_v<lox::SyntaxError>(result)) {
-    const auto & exec = lox::as_variant<lox::SyntaxError>(result);
-    std::cout << exec.get_line_string(2);
-    std::cout << exec.get_visualization_string(ss.str(), 4);
-    return 1;
-  }
-  const auto & tokens = lox::as_variant<lox::Tokens>(result);
-  auto parser = lox::Parser(tokens);
+  const auto source = buffer->view();
+  auto parser = lox::Parser(lox::TokenStream(source));
   const auto program_result = parser.program();
   if (lox::is_variant_v<lox::SyntaxError>(program_result)) {
     const auto & exec = lox::as_variant<lox::SyntaxError>(program_result);
-    std::cout << exec.get_line_string(2);
-    std::cout << exec.get_visualization_string(ss.str(), 4);
+    const auto lines = lox::LineTable(source, path);
+    std::cout << exec.get_line_string(lines, 2);
+    std::cout << exec.get_visualization_string(lines, 4);
     return 1;
   }
   const auto & program = lox::as_variant<lox::Program>(program_result);
@@ -131,6 +247,34 @@ auto runScopeAnalysisFile(const char * path) -> int
   return 0;
 }
 
+auto runDumpOptimizedFile(const char * path) -> int
+{
+  // NOTE: the tokens and the errors refer to this buffer
+  const auto buffer = lox::SourceBuffer::open(path);
+  if (!buffer) {
+    std::cerr << path << " does not exist" << std::endl;
+    return 1;
+  }
+  const auto source = buffer->view();
+  const auto program_result = parse(source);
+  if (lox::is_variant_v<lox::SyntaxError>(program_result)) {
+    const auto & exec = lox::as_variant<lox::SyntaxError>(program_result);
+    const auto lines = lox::LineTable(source, path);
+    std::cout << exec.get_line_string(lines, 2);
+    std::cout << exec.get_visualization_string(lines, 4);
+    return 1;
+  }
+  const auto & program = lox::as_variant<lox::Program>(program_result);
+  lox::Interpreter interpreter;
+  if (interpreter.resolve(program)) {
+    std::cout << "failed to resolve" << std::endl;
+    return 1;
+  }
+  lox::optimize_program(program);
+  std::cout << lox::to_lisp_repr(program);
+  return 0;
+}
+
 auto runPrompt() -> int
 {
   // NOTE: if this interpreter is instantiated in each cycle, it will "forget" the prior
@@ -146,13 +290,15 @@ auto runPrompt() -> int
       const auto exec_opt = run(interpreter, prompt);
       if (lox::is_variant_v<lox::SyntaxError>(exec_opt)) {
         const auto & exec = lox::as_variant<lox::SyntaxError>(exec_opt);
-        std::cout << exec.get_line_string(2);
-        std::cout << exec.get_visualization_string(prompt, 4);
+        const auto lines = lox::LineTable(prompt);
+        std::cout << exec.get_line_string(lines, 2);
+        std::cout << exec.get_visualization_string(lines, 4);
       }
       if (lox::is_variant_v<lox::RuntimeError>(exec_opt)) {
         const auto & exec = lox::as_variant<lox::RuntimeError>(exec_opt);
-        std::cout << lox::get_line_string(exec, 2);
-        std::cout << lox::get_visualization_string(prompt, exec, 4);
+        const auto lines = lox::LineTable(prompt);
+        std::cout << lox::get_line_string(lines, exec, 2);
+        std::cout << lox::get_visualization_string(lines, exec, 4);
       }
     }
   }
@@ -168,7 +314,20 @@ auto REPL(int argc, char ** argv) -> int
   argparse::options_description options("options");
   options.add_options()("help,h", "show help")  // -h [ --help ]
     ("scope", "show scope analysis")            // -scope
-    ("file,f", argparse::value<std::string>(), "relative path to source file");
+    ("dump-optimized", "show the program after constant folding")  // --dump-optimized
+    ("file,f", argparse::value<std::string>(), "relative path to source file")  // -f
+    ("engine", argparse::value<std::string>()->default_value("tree"),
+     "execution engine, either tree or vm")  // --engine
+    ("jobs,j", argparse::value<size_t>()->default_value(1),
+     "number of threads to tokenize the file, or 0 to use all the cores")  // -j
+    ("lazy", "parse the body of each function on its first call")         // --lazy
+    ("cache", "load the parsed file from its cache, or save the cache")    // --cache
+    ("cache-dir", argparse::value<std::string>(),
+     "directory of the caches, which is created if missing")  // --cache-dir
+    ("gc-threads", argparse::value<size_t>()->default_value(1),
+     "number of threads to mark the heap of the tree engine")  // --gc-threads
+    ("gc-incremental", "mark the heap of the tree engine incrementally")  // --gc-incremental
+    ("gc-stats", "show the collections and their pause percentiles");    // --gc-stats
 
   argparse::variables_map args_opt;
   argparse::store(argparse::parse_command_line(argc, argv, options), args_opt);
@@ -189,7 +348,30 @@ auto REPL(int argc, char ** argv) -> int
   if (args_opt.count("scope")) {
     return runScopeAnalysisFile(file.c_str());
   }
-  return runFile(file.c_str());
+  if (args_opt.count("dump-optimized")) {
+    return runDumpOptimizedFile(file.c_str());
+  }
+  const std::string engine = args_opt["engine"].as<std::string>();
+  RunOptions run_options;
+  run_options.jobs = args_opt["jobs"].as<size_t>();
+  if (args_opt.count("lazy")) {
+    run_options.mode = lox::ParseMode::Lazy;
+  }
+  run_options.cache = args_opt.count("cache") or args_opt.count("cache-dir");
+  if (args_opt.count("cache-dir")) {
+    run_options.cache_dir = args_opt["cache-dir"].as<std::string>();
+  }
+  run_options.gc_threads = args_opt["gc-threads"].as<size_t>();
+  run_options.gc_incremental = args_opt.count("gc-incremental");
+  run_options.gc_stats = args_opt.count("gc-stats");
+  if (engine == "vm") {
+    return runFile<lox::vm::VM>(file, run_options);
+  }
+  if (engine != "tree") {
+    std::cout << "unknown engine: " << engine << std::endl;
+    return 1;
+  }
+  return runFile<lox::Interpreter>(file, run_options);
 }
 
 auto main(int argc, char ** argv) -> int
@@ -0,0 +1,90 @@
+#include <cpplox/chunk.hpp>
+#include <cpplox/object.hpp>
+
+namespace lox
+{
+
+namespace vm
+{
+
+auto free_object(Object * object) -> void
+{
+  switch (object->kind) {
+    case ObjectKind::String:
+      delete static_cast<StringObject *>(object);
+      return;
+    case ObjectKind::Closure:
+      delete static_cast<Closure *>(object);
+      return;
+    case ObjectKind::Class:
+      delete static_cast<ClassObject *>(object);
+      return;
+    case ObjectKind::Instance:
+      delete static_cast<InstanceObject *>(object);
+      return;
+  }
+}
+
+auto is_truthy(const Value & value) -> bool
+{
+  if (value.is_nil()) {
+    return false;
+  }
+  if (value.is_bool()) {
+    return value.as_bool();
+  }
+  return true;
+}
+
+auto is_equal(const Value & left, const Value & right) -> bool
+{
+  // NOTE: like lox::is_equal, only the scalars and the strings of the same type can be equal
+  if (left.tag() != right.tag()) {
+    return false;
+  }
+  switch (left.tag()) {
+    case Value::Tag::Nil:
+      return true;
+    case Value::Tag::Bool:
+      return left.as_bool() == right.as_bool();
+    case Value::Tag::Int:
+      return left.as_int() == right.as_int();
+    case Value::Tag::Double:
+      return left.as_double() == right.as_double();
+    case Value::Tag::Object:
+      return left.is_object(ObjectKind::String) && right.is_object(ObjectKind::String) &&
+             left.as<StringObject>()->value == right.as<StringObject>()->value;
+  }
+  return false;
+}
+
+auto stringify(const Value & value) -> std::string
+{
+  switch (value.tag()) {
+    case Value::Tag::Nil:
+      return "nil";
+    case Value::Tag::Bool:
+      return value.as_bool() ? "true" : "false";
+    case Value::Tag::Int:
+      return std::to_string(value.as_int());
+    case Value::Tag::Double:
+      return std::to_string(value.as_double());
+    case Value::Tag::Object:
+      break;
+  }
+  if (value.is_object(ObjectKind::String)) {
+    return value.as<StringObject>()->value.str();
+  }
+  if (value.is_object(ObjectKind::Closure)) {
+    return "<fn " + std::string(value.as<Closure>()->function->name) + " >";
+  }
+  if (value.is_object(ObjectKind::Class)) {
+    return "<class definition " + std::string(value.as<ClassObject>()->declaration->name.lexeme) +
+           " >";
+  }
+  const auto & cls = value.as<InstanceObject>()->cls;
+  return "<instance " + std::string(cls.as<ClassObject>()->declaration->name.lexeme) + ">";
+}
+
+}  // namespace vm
+}  // namespace lox
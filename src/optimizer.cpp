@@ -0,0 +1,270 @@
+#include <cpplox/interpreter.hpp>
+#include <cpplox/optimizer.hpp>
+
+#include <limits>
+
+namespace lox
+{
+inline namespace optimizer
+{
+
+namespace
+{
+class ToConstantVisitor : public boost::static_visitor<std::optional<Constant>>
+{
+public:
+  std::optional<Constant> operator()(const Nil & value) const { return value; }
+
+  std::optional<Constant> operator()(const bool value) const { return value; }
+
+  std::optional<Constant> operator()(const int64_t value) const { return value; }
+
+  std::optional<Constant> operator()(const double value) const { return value; }
+
+  std::optional<Constant> operator()(const String & value) const
+  {
+    // the folded string is a literal of the program as well
+    return String::intern(value.view());
+  }
+
+  template <typename T>
+  std::optional<Constant> operator()(const T &) const
+  {
+    return std::nullopt;
+  }
+};
+
+/**
+ * @brief evaluate a node whose operands are constant, and annotate it with the value
+ * @return false if the evaluation fails, then the error is left to the runtime
+ */
+template <typename Node>
+auto fold(const Node & node) -> bool
+{
+  // NOTE: a constant subtree neither refers to the environments nor allocates on the heap
+  Heap heap;
+  ValueStack stack(heap);
+  impl::EvaluateExprVisitor evaluator(nullptr, nullptr, heap, stack);
+  const auto result = evaluator(node);
+  if (is_variant_v<RuntimeError>(result)) {
+    return false;
+  }
+  node.folded = boost::apply_visitor(ToConstantVisitor(), as_variant<Value>(result));
+  return node.folded.has_value();
+}
+
+/**
+ * @brief the value of an expression which is already known to be constant
+ */
+auto constant_value(const Expr & expr) -> Value
+{
+  Heap heap;
+  ValueStack stack(heap);
+  return as_variant<Value>(impl::evaluate_expr_impl(expr, nullptr, nullptr, heap, stack));
+}
+}  // namespace
+
+bool FoldExprVisitor::operator()(const Literal & literal)
+{
+  return true;
+}
+
+bool FoldExprVisitor::operator()(const Unary & unary)
+{
+  return boost::apply_visitor(*this, unary.expr) && fold(unary);
+}
+
+bool FoldExprVisitor::operator()(const Binary & binary)
+{
+  const bool is_left_constant = boost::apply_visitor(*this, binary.left);
+  const bool is_right_constant = boost::apply_visitor(*this, binary.right);
+  if (!is_left_constant || !is_right_constant) {
+    return false;
+  }
+  if (binary.op.type == TokenType::Slash) {
+    // NOTE: the integer division by zero or the overflow traps, so it is kept for the runtime
+    const auto left = constant_value(binary.left);
+    const auto right = constant_value(binary.right);
+    if (helper::is_long(left) && helper::is_long(right)) {
+      const auto divisor = as_variant<int64_t>(right);
+      if (
+        divisor == 0 ||
+        (divisor == -1 && as_variant<int64_t>(left) == std::numeric_limits<int64_t>::min())) {
+        return false;
+      }
+    }
+  }
+  return fold(binary);
+}
+
+bool FoldExprVisitor::operator()(const Group & group)
+{
+  return boost::apply_visitor(*this, group.expr) && fold(group);
+}
+
+bool FoldExprVisitor::operator()(const Variable & variable)
+{
+  return false;
+}
+
+bool FoldExprVisitor::operator()(const Assign & assign)
+{
+  boost::apply_visitor(*this, assign.expr);
+  return false;
+}
+
+bool FoldExprVisitor::operator()(const Logical & logical)
+{
+  const bool is_left_constant = boost::apply_visitor(*this, logical.left);
+  const bool is_right_constant = boost::apply_visitor(*this, logical.right);
+  if (!is_left_constant) {
+    return false;
+  }
+  // `false and x` and `true or x` do not evaluate x
+  const bool is_left_true = is_truthy(constant_value(logical.left));
+  const bool short_circuit = (logical.op.type == TokenType::And && !is_left_true) ||
+                             (logical.op.type == TokenType::Or && is_left_true);
+  return (short_circuit || is_right_constant) && fold(logical);
+}
+
+bool FoldExprVisitor::operator()(const Call & call)
+{
+  boost::apply_visitor(*this, call.callee);
+  for (const auto & argument : call.arguments) {
+    boost::apply_visitor(*this, argument);
+  }
+  return false;
+}
+
+bool FoldExprVisitor::operator()(const ReadProperty & property)
+{
+  boost::apply_visitor(*this, property.base);
+  return false;
+}
+
+bool FoldExprVisitor::operator()(const SetProperty & property)
+{
+  boost::apply_visitor(*this, property.base);
+  boost::apply_visitor(*this, property.value);
+  return false;
+}
+
+void FoldStmtVisitor::operator()(const ExprStmt & stmt)
+{
+  boost::apply_visitor(FoldExprVisitor(), stmt.expression);
+}
+
+void FoldStmtVisitor::operator()(const PrintStmt & stmt)
+{
+  boost::apply_visitor(FoldExprVisitor(), stmt.expression);
+}
+
+void FoldStmtVisitor::operator()(const Block & block)
+{
+  FoldDeclVisitor decl_visitor;
+  for (const auto & declaration : block.declarations) {
+    boost::apply_visitor(decl_visitor, declaration);
+  }
+}
+
+void FoldStmtVisitor::operator()(const IfBlock & stmt)
+{
+  auto fold_branch_clause = [&](const BranchClause & clause) {
+    if (clause.declaration) {
+      FoldDeclVisitor()(clause.declaration.value());
+    }
+    boost::apply_visitor(FoldExprVisitor(), clause.cond);
+    (*this)(clause.body);
+  };
+  fold_branch_clause(stmt.if_clause);
+  for (const auto & elseif_clause : stmt.elseif_clauses) {
+    fold_branch_clause(elseif_clause);
+  }
+  if (stmt.else_body) {
+    (*this)(stmt.else_body.value());
+  }
+}
+
+void FoldStmtVisitor::operator()(const WhileStmt & stmt)
+{
+  boost::apply_visitor(FoldExprVisitor(), stmt.cond);
+  (*this)(stmt.body);
+}
+
+void FoldStmtVisitor::operator()(const ForStmt & stmt)
+{
+  if (stmt.init_stmt) {
+    const auto & init_stmt = stmt.init_stmt.value();
+    if (is_variant_v<VarDecl>(init_stmt)) {
+      FoldDeclVisitor()(as_variant<VarDecl>(init_stmt));
+    } else {
+      (*this)(as_variant<ExprStmt>(init_stmt));
+    }
+  }
+  if (stmt.cond) {
+    boost::apply_visitor(FoldExprVisitor(), stmt.cond.value());
+  }
+  if (stmt.next) {
+    boost::apply_visitor(FoldExprVisitor(), stmt.next.value());
+  }
+  (*this)(stmt.body);
+}
+
+void FoldStmtVisitor::operator()(const BreakStmt & stmt)
+{
+}
+
+void FoldStmtVisitor::operator()(const ContinueStmt & stmt)
+{
+}
+
+void FoldStmtVisitor::operator()(const ReturnStmt & stmt)
+{
+  if (stmt.expr) {
+    boost::apply_visitor(FoldExprVisitor(), stmt.expr.value());
+  }
+}
+
+void FoldDeclVisitor::operator()(const VarDecl & var_decl)
+{
+  if (var_decl.initializer) {
+    boost::apply_visitor(FoldExprVisitor(), var_decl.initializer.value());
+  }
+}
+
+void FoldDeclVisitor::operator()(const Stmt & stmt)
+{
+  FoldStmtVisitor stmt_visitor;
+  boost::apply_visitor(stmt_visitor, stmt);
+}
+
+void FoldDeclVisitor::operator()(const FuncDecl & func_decl)
+{
+  optimize_function(func_decl);
+}
+
+void FoldDeclVisitor::operator()(const ClassDecl & class_decl)
+{
+  for (const auto & [name, method] : class_decl.methods) {
+    optimize_function(method);
+  }
+}
+
+auto optimize_program(const Program & program) -> void
+{
+  FoldDeclVisitor decl_visitor;
+  for (const auto & declaration : program.declarations) {
+    boost::apply_visitor(decl_visitor, declaration);
+  }
+}
+
+auto optimize_function(const FuncDecl & func_decl) -> void
+{
+  if (func_decl.lazy) {
+    return;
+  }
+  FoldStmtVisitor()(func_decl.body);
+}
+
+}  // namespace optimizer
+}  // namespace lox
@@ -3,6 +3,7 @@
 
 #include <boost/variant.hpp>
 
+#include <algorithm>
 #include <cassert>
 
 namespace lox
@@ -11,86 +12,118 @@ namespace lox
 inline namespace parser
 {
 
-Parser::Parser(const Tokens & tokens) : tokens_(tokens)
+Parser::Parser(Tokens tokens, const ParseMode mode) : Parser(TokenStream(std::move(tokens)), mode)
 {
-  if (tokens_.empty() or tokens_.back().type != TokenType::Eof) {
-    tokens_.emplace_back(TokenType::Eof, "<EOF>", nullptr, 0);
+}
+
+Parser::Parser(TokenStream tokens, const ParseMode mode)
+: Parser(std::move(tokens), mode, std::make_shared<Arena>())
+{
+}
+
+Parser::Parser(TokenStream tokens, const ParseMode mode, std::shared_ptr<Arena> arena)
+: tokens_(std::move(tokens)), arena_(std::move(arena)), mode_(mode)
+{
+}
+
+auto Parser::parse_body(const FuncDecl & func_decl) -> std::optional<SyntaxError>
+{
+  const auto & lazy = *func_decl.lazy;
+  auto arena = lazy.arena.lock();
+  assert(arena && "the program of a lazy function has been released");
+  auto block_opt = parse_skipped(lazy, ParseMode::Lazy, std::move(arena));
+  if (is_variant_v<SyntaxError>(block_opt)) {
+    return as_variant<SyntaxError>(block_opt);
   }
-  assert(tokens_.size() >= 1);
+  func_decl.body = std::move(as_variant_mut<Block>(block_opt));
+  return std::nullopt;
+}
+
+auto Parser::parse_skipped(
+  const LazyBody & lazy, const ParseMode mode, std::shared_ptr<Arena> arena)
+  -> std::variant<Block, SyntaxError>
+{
+  // NOTE: the text ends at the '}' matching the first '{', so block() consumes all of it
+  Parser parser(TokenStream(lazy.source, lazy.line), mode, std::move(arena));
+  return parser.block();
 }
 
 auto Parser::program() -> std::variant<Program, SyntaxError>
 {
-  Program statements;
+  std::vector<Declaration> statements;
   while (!is_at_end()) {
-    const auto declaration_opt = declaration();
+    auto declaration_opt = declaration();
     if (is_variant_v<SyntaxError>(declaration_opt)) {
+      // as if the whole source was scanned before parsing, an error of the tokenizer comes first
+      if (const auto & error = tokens_.drain(); error) {
+        return error.value();
+      }
       return as_variant<SyntaxError>(declaration_opt);
     }
-    statements.push_back(as_variant<Declaration>(declaration_opt));
+    statements.push_back(std::move(as_variant_mut<Declaration>(declaration_opt)));
   }
-  return statements;
+  if (const auto & error = tokens_.error(); error) {
+    return error.value();
+  }
+  return Program{std::move(statements), arena_};
 }
 
 auto Parser::declaration() -> std::variant<Declaration, SyntaxError>
 {
   // <var_decl>
   if (match(TokenType::Var)) {
-    const auto var_declaration = var_decl();
+    auto var_declaration = var_decl();
     if (is_variant_v<SyntaxError>(var_declaration)) {
       return as_variant<SyntaxError>(var_declaration);
     }
-    return as_variant<VarDecl>(var_declaration);
+    return std::move(as_variant_mut<VarDecl>(var_declaration));
   }
 
   // <func_decl>
   if (match(TokenType::Fun)) {
-    const auto func_decl_opt = func_decl();
+    auto func_decl_opt = func_decl();
     if (is_variant_v<SyntaxError>(func_decl_opt)) {
       return as_variant<SyntaxError>(func_decl_opt);
     }
-    return as_variant<FuncDecl>(func_decl_opt);
+    return arena_->make<FuncDecl>(std::move(as_variant_mut<FuncDecl>(func_decl_opt)));
   }
 
   // <class_decl>
   if (match(TokenType::Class)) {
-    const auto class_decl_opt = class_decl();
+    auto class_decl_opt = class_decl();
     if (is_variant_v<SyntaxError>(class_decl_opt)) {
       return as_variant<SyntaxError>(class_decl_opt);
     }
-    return as_variant<ClassDecl>(class_decl_opt);
+    return arena_->make<ClassDecl>(std::move(as_variant_mut<ClassDecl>(class_decl_opt)));
   }
 
-  const auto statement_opt = statement();
+  auto statement_opt = statement();
   if (is_variant_v<SyntaxError>(statement_opt)) {
     return as_variant<SyntaxError>(statement_opt);
   }
-  const auto & stmt = as_variant<Stmt>(statement_opt);
-  Declaration decl = stmt;
-  return decl;
+  return Declaration{std::move(as_variant_mut<Stmt>(statement_opt))};
 }
 
 auto Parser::var_decl() -> std::variant<VarDecl, SyntaxError>
 {
   advance();  // just consume 'var'
-  const auto var_decl_ctx = current_;
+  const auto var_decl_ctx = peek();
   if (!match(TokenType::Identifier)) {
     return create_error(SyntaxErrorKind::MissingValidIdentifierDecl, var_decl_ctx);
   }
-  const auto & name = peek();  // save identifier
-  advance();                   // consume IDENTIFIER
+  const auto name = peek();  // save identifier
+  advance();                 // consume IDENTIFIER
   if (match(TokenType::Equal)) {
     advance();  // consume '='
-    const auto right_expr_opt = expression();
+    auto right_expr_opt = expression();
     if (is_variant_v<SyntaxError>(right_expr_opt)) {
       return as_variant<SyntaxError>(right_expr_opt);
     }
-    const auto initializer = as_variant<Expr>(right_expr_opt);
     if (!match(TokenType::Semicolun)) {
       return create_error(SyntaxErrorKind::StmtWithoutSemicolun, var_decl_ctx);
     }
     advance();  // consume ';'
-    return VarDecl{name, std::make_optional<Expr>(initializer)};
+    return VarDecl{name, std::move(as_variant_mut<Expr>(right_expr_opt))};
   }
   if (!match(TokenType::Semicolun)) {
     return create_error(SyntaxErrorKind::StmtWithoutSemicolun, var_decl_ctx);
@@ -104,88 +137,88 @@ auto Parser::statement() -> std::variant<Stmt, SyntaxError>
   // <print_stmt>
   if (match(TokenType::Print)) {
     advance();  // consumme 'print'
-    const auto print_stmt_opt = print_statement();
+    auto print_stmt_opt = print_statement();
     if (is_variant_v<SyntaxError>(print_stmt_opt)) {
       return as_variant<SyntaxError>(print_stmt_opt);
     }
-    return as_variant<PrintStmt>(print_stmt_opt);
+    return std::move(as_variant_mut<PrintStmt>(print_stmt_opt));
   }
 
   // <block>
   if (match(TokenType::LeftBrace)) {
-    const auto block_opt = block();
+    auto block_opt = block();
     if (is_variant_v<SyntaxError>(block_opt)) {
       return as_variant<SyntaxError>(block_opt);
     }
-    return as_variant<Block>(block_opt);
+    return arena_->make<Block>(std::move(as_variant_mut<Block>(block_opt)));
   }
 
   // <if_block>
-  const auto if_start_ctx = current_;
+  const auto if_start_ctx = peek();
   if (match(TokenType::If)) {
     advance();  // consume "if"
-    const auto if_block_opt = if_block(if_start_ctx);
+    auto if_block_opt = if_block(if_start_ctx);
     if (is_variant_v<SyntaxError>(if_block_opt)) {
       return as_variant<SyntaxError>(if_block_opt);
     }
-    return as_variant<IfBlock>(if_block_opt);
+    return arena_->make<IfBlock>(std::move(as_variant_mut<IfBlock>(if_block_opt)));
   }
 
   // <while_stmt>
   if (match(TokenType::While)) {
-    const auto while_start_ctx = current_;
+    const auto while_start_ctx = peek();
     advance();  // consume "while"
-    const auto while_block_opt = while_stmt(while_start_ctx);
+    auto while_block_opt = while_stmt(while_start_ctx);
     if (is_variant_v<SyntaxError>(while_block_opt)) {
       return as_variant<SyntaxError>(while_block_opt);
     }
-    return as_variant<WhileStmt>(while_block_opt);
+    return arena_->make<WhileStmt>(std::move(as_variant_mut<WhileStmt>(while_block_opt)));
   }
 
   // <for_stmt>
   if (match(TokenType::For)) {
-    const auto for_start_ctx = current_;
+    const auto for_start_ctx = peek();
     advance();  // consume "for"
-    const auto for_stmt_opt = for_stmt(for_start_ctx);
+    auto for_stmt_opt = for_stmt(for_start_ctx);
     if (is_variant_v<SyntaxError>(for_stmt_opt)) {
       return as_variant<SyntaxError>(for_stmt_opt);
     }
-    return as_variant<ForStmt>(for_stmt_opt);
+    return arena_->make<ForStmt>(std::move(as_variant_mut<ForStmt>(for_stmt_opt)));
   }
 
   // <break_stmt>
   if (match(TokenType::Break)) {
-    const auto stmt_opt = break_stmt();
+    auto stmt_opt = break_stmt();
     if (is_variant_v<SyntaxError>(stmt_opt)) {
       return as_variant<SyntaxError>(stmt_opt);
     }
-    return as_variant<BreakStmt>(stmt_opt);
+    return std::move(as_variant_mut<BreakStmt>(stmt_opt));
   }
 
   // <continue_stmt>
   if (match(TokenType::Continue)) {
-    const auto stmt_opt = continue_stmt();
+    auto stmt_opt = continue_stmt();
     if (is_variant_v<SyntaxError>(stmt_opt)) {
       return as_variant<SyntaxError>(stmt_opt);
     }
-    return as_variant<ContinueStmt>(stmt_opt);
+    return std::move(as_variant_mut<ContinueStmt>(stmt_opt));
   }
 
   // <return_stmt>
   if (match(TokenType::Return)) {
-    const auto stmt_opt = return_stmt();
+    auto stmt_opt = return_stmt();
     if (is_variant_v<SyntaxError>(stmt_opt)) {
       return as_variant<SyntaxError>(stmt_opt);
     }
-    return as_variant<ReturnStmt>(stmt_opt);
+    return std::move(as_variant_mut<ReturnStmt>(stmt_opt));
   }
 
   // <expr_stmt>
-  const auto expr_stmt_opt = expr_statement();
+  auto expr_stmt_opt = expr_statement();
   if (is_variant_v<SyntaxError>(expr_stmt_opt)) {
     return as_variant<SyntaxError>(expr_stmt_opt);
   }
-  return as_variant<ExprStmt>(expr_stmt_opt);
+  return std::move(as_variant_mut<ExprStmt>(expr_stmt_opt));
 }
 
 auto Parser::func_decl() -> std::variant<FuncDecl, SyntaxError>
@@ -193,7 +226,7 @@ auto Parser::func_decl() -> std::variant<FuncDecl, SyntaxError>
   advance();                 // consume "fun"
   const auto name = peek();  // function name after "fun"
   advance();                 // consume function name
-  const auto fun_ctx = current_;
+  const auto fun_ctx = peek();
   if (!match(TokenType::LeftParen)) {
     return create_error(SyntaxErrorKind::MissingFuncParameterDecl, fun_ctx);
   }
@@ -204,7 +237,7 @@ auto Parser::func_decl() -> std::variant<FuncDecl, SyntaxError>
       break;
     }
     if (!match(TokenType::Identifier)) {
-      return create_error(SyntaxErrorKind::InvalidParameterDecl, current_);
+      return create_error(SyntaxErrorKind::InvalidParameterDecl, peek());
     }
     parameters.push_back(advance());
     if (match(TokenType::Comma)) {
@@ -218,13 +251,67 @@ auto Parser::func_decl() -> std::variant<FuncDecl, SyntaxError>
   }
   advance();  // consume ')'
   if (!match(TokenType::LeftBrace)) {
-    return create_error(SyntaxErrorKind::MissingFuncBodyDecl, current_);
+    return create_error(SyntaxErrorKind::MissingFuncBodyDecl, peek());
+  }
+  if (mode_ == ParseMode::Lazy) {
+    auto body_opt = skip_body();
+    if (is_variant_v<SyntaxError>(body_opt)) {
+      return as_variant<SyntaxError>(body_opt);
+    }
+    if (is_variant_v<Block>(body_opt)) {
+      return FuncDecl{name, std::move(parameters), std::move(as_variant_mut<Block>(body_opt))};
+    }
+    auto & lazy = as_variant_mut<std::shared_ptr<LazyBody>>(body_opt);
+    return FuncDecl{name, std::move(parameters), Block{}, 0, {}, std::move(lazy)};
   }
-  const auto block_opt = block();
+  auto block_opt = block();
   if (is_variant_v<SyntaxError>(block_opt)) {
     return as_variant<SyntaxError>(block_opt);
   }
-  return FuncDecl{name, parameters, as_variant<Block>(block_opt)};
+  return FuncDecl{name, std::move(parameters), std::move(as_variant_mut<Block>(block_opt))};
+}
+
+auto Parser::skip_body() -> std::variant<std::shared_ptr<LazyBody>, Block, SyntaxError>
+{
+  const auto brace_ctx = peek();
+  auto lazy = std::make_shared<LazyBody>();
+  lazy->line = brace_ctx.line;
+  lazy->arena = arena_;
+  bool has_class = false;
+  size_t depth = 0;
+  const char * end = brace_ctx.lexeme.data();
+  do {
+    if (is_at_end()) {
+      return create_error(SyntaxErrorKind::UnmatchedBraceError, brace_ctx);
+    }
+    const auto token = advance();
+    if (token.type == TokenType::LeftBrace) {
+      depth++;
+    } else if (token.type == TokenType::RightBrace) {
+      depth--;
+    } else if (token.type == TokenType::Identifier) {
+      lazy->names.push_back(token.lexeme);
+    } else if (token.type == TokenType::Class) {
+      has_class = true;
+    }
+    end = token.lexeme.data() + token.lexeme.size();
+  } while (depth > 0);
+  lazy->source = std::string_view(brace_ctx.lexeme.data(), end - brace_ctx.lexeme.data());
+
+  auto & names = lazy->names;
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+
+  if (has_class) {
+    // NOTE: a class in the body takes a global slot at the resolution of the program, so the body
+    // is parsed now. the tokens are not kept by the stream, so the recorded text is parsed again
+    auto block_opt = parse_skipped(*lazy, mode_, arena_);
+    if (is_variant_v<SyntaxError>(block_opt)) {
+      return as_variant<SyntaxError>(block_opt);
+    }
+    return std::move(as_variant_mut<Block>(block_opt));
+  }
+  return lazy;
 }
 
 auto Parser::class_decl() -> std::variant<ClassDecl, SyntaxError>
@@ -232,7 +319,7 @@ auto Parser::class_decl() -> std::variant<ClassDecl, SyntaxError>
   advance();  // consume "class"
   const auto name = peek();
   advance();  // consume class-name
-  const auto class_ctx = current_;
+  const auto class_ctx = peek();
   if (!match(TokenType::LeftBrace)) {
     return create_error(SyntaxErrorKind::MissingClassBodyDecl, class_ctx);
   }
@@ -243,38 +330,39 @@ auto Parser::class_decl() -> std::variant<ClassDecl, SyntaxError>
       advance();  // consume "}"
       break;
     }
-    const auto method_opt = func_decl();
+    auto method_opt = func_decl();
     if (is_variant_v<SyntaxError>(method_opt)) {
       return as_variant<SyntaxError>(method_opt);
     }
-    const auto & method = as_variant<FuncDecl>(method_opt);
+    auto & method = as_variant_mut<FuncDecl>(method_opt);
     // TODO(soblin): deal with overloads
-    methods.emplace(method.name.lexeme, method);
+    const auto method_name = method.name.lexeme;
+    methods.emplace(method_name, std::move(method));
   }
-  return ClassDecl{name, methods};
+  return ClassDecl{name, std::move(methods)};
 }
 
 auto Parser::expr_statement() -> std::variant<ExprStmt, SyntaxError>
 {
-  const auto expr_ctx = current_;
-  const auto expr_opt = expression();
+  const auto expr_ctx = peek();
+  auto expr_opt = expression();
   if (is_variant_v<SyntaxError>(expr_opt)) {
     return as_variant<SyntaxError>(expr_opt);
   }
   if (match(TokenType::Semicolun)) {
     advance();  // just consime ';'
-    return ExprStmt{as_variant<Expr>(expr_opt)};
+    return ExprStmt{std::move(as_variant_mut<Expr>(expr_opt))};
   }
   return create_error(SyntaxErrorKind::StmtWithoutSemicolun, expr_ctx);
 }
 
 auto Parser::print_statement() -> std::variant<PrintStmt, SyntaxError>
 {
-  const auto print_ctx = current_;
-  const auto expr_opt = expression();
+  const auto print_ctx = peek();
+  auto expr_opt = expression();
   if (match(TokenType::Semicolun)) {
     advance();  // just consume ';'
-    return PrintStmt{as_variant<Expr>(expr_opt)};
+    return PrintStmt{std::move(as_variant_mut<Expr>(expr_opt))};
   } else {
     return create_error(SyntaxErrorKind::StmtWithoutSemicolun, print_ctx);
   }
@@ -282,21 +370,20 @@ auto Parser::print_statement() -> std::variant<PrintStmt, SyntaxError>
 
 auto Parser::block() -> std::variant<Block, SyntaxError>
 {
-  const auto brace_ctx = current_;
+  const auto brace_ctx = peek();
   advance();  // consume '{'
   std::vector<Declaration> declarations;
 
   // TODO(soblin): nice way to handle empty Block
   if (match(TokenType::RightBrace)) {
     advance();  // consume '}'
-    return Block{declarations};
+    return Block{std::move(declarations)};
   }
 
   while (!is_at_end()) {
-    const auto decl_opt = declaration();
+    auto decl_opt = declaration();
     if (is_variant_v<Declaration>(decl_opt)) {
-      const auto & decl = as_variant<Declaration>(decl_opt);
-      declarations.push_back(decl);
+      declarations.push_back(std::move(as_variant_mut<Declaration>(decl_opt)));
       if (match(TokenType::RightBrace)) {
         break;
       }
@@ -308,20 +395,20 @@ auto Parser::block() -> std::variant<Block, SyntaxError>
     return create_error(SyntaxErrorKind::UnmatchedBraceError, brace_ctx);
   }
   advance();  // consume '}'
-  return Block{declarations};
+  return Block{std::move(declarations)};
 }
 
-auto Parser::if_block(const size_t if_start_ctx) -> std::variant<IfBlock, SyntaxError>
+auto Parser::if_block(const Token & if_start_ctx) -> std::variant<IfBlock, SyntaxError>
 {
-  const auto branch_clause_opt = branch_clause(if_start_ctx);
+  auto branch_clause_opt = branch_clause(if_start_ctx);
   if (is_variant_v<SyntaxError>(branch_clause_opt)) {
     return as_variant<SyntaxError>(branch_clause_opt);
   }
-  const auto & if_clause = as_variant<BranchClause>(branch_clause_opt);
+  auto & if_clause = as_variant_mut<BranchClause>(branch_clause_opt);
   std::vector<BranchClause> elseif_clauses;
   std::optional<Block> else_body;
   while (!is_at_end()) {
-    const auto else_start_ctx = current_;
+    const auto else_start_ctx = peek();
     if (!match(TokenType::Else)) {
       // end
       break;
@@ -331,11 +418,11 @@ auto Parser::if_block(const size_t if_start_ctx) -> std::variant<IfBlock, Syntax
     // "else if () {}"
     if (match(TokenType::If)) {
       advance();  // consume "if"
-      const auto elseif_branch_clause_opt = branch_clause(else_start_ctx);
+      auto elseif_branch_clause_opt = branch_clause(else_start_ctx);
       if (is_variant_v<SyntaxError>(elseif_branch_clause_opt)) {
         return as_variant<SyntaxError>(elseif_branch_clause_opt);
       }
-      elseif_clauses.push_back(as_variant<BranchClause>(elseif_branch_clause_opt));
+      elseif_clauses.push_back(std::move(as_variant_mut<BranchClause>(elseif_branch_clause_opt)));
       continue;
     }
 
@@ -343,27 +430,27 @@ auto Parser::if_block(const size_t if_start_ctx) -> std::variant<IfBlock, Syntax
     if (!match(TokenType::LeftBrace)) {
       return create_error(SyntaxErrorKind::UnmatchedBraceError, else_start_ctx);
     }
-    const auto else_body_opt = block();
+    auto else_body_opt = block();
     if (is_variant_v<SyntaxError>(else_body_opt)) {
       return as_variant<SyntaxError>(else_body_opt);
     }
-    else_body.emplace(as_variant<Block>(else_body_opt));
+    else_body.emplace(std::move(as_variant_mut<Block>(else_body_opt)));
     break;
   }
-  return IfBlock{if_clause, elseif_clauses, else_body};
+  return IfBlock{std::move(if_clause), std::move(elseif_clauses), std::move(else_body)};
 }
 
-auto Parser::while_stmt(const size_t while_start_ctx) -> std::variant<WhileStmt, SyntaxError>
+auto Parser::while_stmt(const Token & while_start_ctx) -> std::variant<WhileStmt, SyntaxError>
 {
   if (!match(TokenType::LeftParen)) {
-    return create_error(SyntaxErrorKind::MissingWhileConditon, current_);
+    return create_error(SyntaxErrorKind::MissingWhileConditon, peek());
   }
   advance();  // consume '('
-  const auto cond_opt = expression();
+  auto cond_opt = expression();
   if (is_variant_v<SyntaxError>(cond_opt)) {
     return as_variant<SyntaxError>(cond_opt);
   }
-  const auto & cond = as_variant<Expr>(cond_opt);
+  auto & cond = as_variant_mut<Expr>(cond_opt);
   if (!match(TokenType::RightParen)) {
     return create_error(SyntaxErrorKind::UnmatchedParenError, while_start_ctx);
   }
@@ -371,17 +458,18 @@ auto Parser::while_stmt(const size_t while_start_ctx) -> std::variant<WhileStmt,
   if (!match(TokenType::LeftBrace)) {
     return create_error(SyntaxErrorKind::MissingWhileBody, while_start_ctx);
   }
-  const auto block_opt = block();
+  auto block_opt = block();
   if (is_variant_v<SyntaxError>(block_opt)) {
     return as_variant<SyntaxError>(block_opt);
   }
-  return WhileStmt{tokens_.at(while_start_ctx), cond, as_variant<Block>(block_opt)};
+  return WhileStmt{
+    while_start_ctx, std::move(cond), std::move(as_variant_mut<Block>(block_opt))};
 }
 
-auto Parser::for_stmt(const size_t for_start_ctx) -> std::variant<ForStmt, SyntaxError>
+auto Parser::for_stmt(const Token & for_start_ctx) -> std::variant<ForStmt, SyntaxError>
 {
   if (!match(TokenType::LeftParen)) {
-    return create_error(SyntaxErrorKind::MissingForCondition, current_);
+    return create_error(SyntaxErrorKind::MissingForCondition, peek());
   }
   advance();  // consume '('
 
@@ -390,25 +478,25 @@ auto Parser::for_stmt(const size_t for_start_ctx) -> std::variant<ForStmt, Synta
     advance();  // consume ';'
     // do nothing
   } else if (match(TokenType::Var)) {
-    const auto var_decl_opt = var_decl();
+    auto var_decl_opt = var_decl();
     if (is_variant_v<SyntaxError>(var_decl_opt)) {
       return as_variant<SyntaxError>(var_decl_opt);
     }
-    init_stmt.emplace(as_variant<VarDecl>(var_decl_opt));
+    init_stmt.emplace(std::move(as_variant_mut<VarDecl>(var_decl_opt)));
   } else {
-    const auto expr_stmt_opt = expr_statement();
+    auto expr_stmt_opt = expr_statement();
     if (is_variant_v<SyntaxError>(expr_stmt_opt)) {
       return as_variant<SyntaxError>(expr_stmt_opt);
     }
-    init_stmt.emplace(as_variant<ExprStmt>(expr_stmt_opt));
+    init_stmt.emplace(std::move(as_variant_mut<ExprStmt>(expr_stmt_opt)));
   }
 
   std::optional<Expr> cond{std::nullopt};
   if (match(TokenType::Semicolun)) {
     advance();  // consume ';'
   } else {
-    const auto expr_ctx = current_;
-    const auto expr_opt = expression();
+    const auto expr_ctx = peek();
+    auto expr_opt = expression();
     if (is_variant_v<SyntaxError>(expr_opt)) {
       return as_variant<SyntaxError>(expr_opt);
     }
@@ -416,15 +504,15 @@ auto Parser::for_stmt(const size_t for_start_ctx) -> std::variant<ForStmt, Synta
       return create_error(SyntaxErrorKind::StmtWithoutSemicolun, expr_ctx);
     }
     advance();  // consume ';'
-    cond.emplace(as_variant<Expr>(expr_opt));
+    cond.emplace(std::move(as_variant_mut<Expr>(expr_opt)));
   }
 
   std::optional<Expr> next{std::nullopt};
   if (match(TokenType::RightParen)) {
     advance();  // consume ')'
   } else {
-    const auto expr_ctx = current_;
-    const auto expr_opt = expression();
+    const auto expr_ctx = peek();
+    auto expr_opt = expression();
     if (is_variant_v<SyntaxError>(expr_opt)) {
       return as_variant<SyntaxError>(expr_opt);
     }
@@ -432,22 +520,24 @@ auto Parser::for_stmt(const size_t for_start_ctx) -> std::variant<ForStmt, Synta
       return create_error(SyntaxErrorKind::UnmatchedParenError, expr_ctx);
     }
     advance();  // consume ')'
-    next.emplace(as_variant<Expr>(expr_opt));
+    next.emplace(std::move(as_variant_mut<Expr>(expr_opt)));
   }
 
   if (!match(TokenType::LeftBrace)) {
-    return create_error(SyntaxErrorKind::MissingForBody, current_);
+    return create_error(SyntaxErrorKind::MissingForBody, peek());
   }
-  const auto block_opt = block();
+  auto block_opt = block();
   if (is_variant_v<SyntaxError>(block_opt)) {
     return as_variant<SyntaxError>(block_opt);
   }
-  return ForStmt{tokens_.at(for_start_ctx), init_stmt, cond, next, as_variant<Block>(block_opt)};
+  return ForStmt{
+    for_start_ctx, std::move(init_stmt), std::move(cond), std::move(next),
+    std::move(as_variant_mut<Block>(block_opt))};
 }
 
 auto Parser::break_stmt() -> std::variant<BreakStmt, SyntaxError>
 {
-  const size_t ctx = current_;
+  const auto ctx = peek();
   advance();  // consume "break"
   if (!match(TokenType::Semicolun)) {
     return create_error(SyntaxErrorKind::StmtWithoutSemicolun, ctx);
@@ -458,7 +548,7 @@ auto Parser::break_stmt() -> std::variant<BreakStmt, SyntaxError>
 
 auto Parser::continue_stmt() -> std::variant<ContinueStmt, SyntaxError>
 {
-  const size_t ctx = current_;
+  const auto ctx = peek();
   advance();  // consume "continue"
   if (!match(TokenType::Semicolun)) {
     return create_error(SyntaxErrorKind::StmtWithoutSemicolun, ctx);
@@ -469,13 +559,13 @@ auto Parser::continue_stmt() -> std::variant<ContinueStmt, SyntaxError>
 
 auto Parser::return_stmt() -> std::variant<ReturnStmt, SyntaxError>
 {
-  const auto return_ctx = current_;
+  const auto return_ctx = peek();
   advance();  // consume "return"
   if (match(TokenType::Semicolun)) {
     advance();  // consume ";'"
     return ReturnStmt{std::nullopt};
   }
-  const auto expr_opt = expression();
+  auto expr_opt = expression();
   if (is_variant_v<SyntaxError>(expr_opt)) {
     return as_variant<SyntaxError>(expr_opt);
   }
@@ -483,28 +573,28 @@ auto Parser::return_stmt() -> std::variant<ReturnStmt, SyntaxError>
     return create_error(SyntaxErrorKind::StmtWithoutSemicolun, return_ctx);
   }
   advance();  // consume ';'
-  return ReturnStmt{as_variant<Expr>(expr_opt)};
+  return ReturnStmt{std::move(as_variant_mut<Expr>(expr_opt))};
 }
 
-auto Parser::branch_clause(const size_t if_start_ctx) -> std::variant<BranchClause, SyntaxError>
+auto Parser::branch_clause(const Token & if_start_ctx) -> std::variant<BranchClause, SyntaxError>
 {
   if (!match(TokenType::LeftParen)) {
-    return create_error(SyntaxErrorKind::MissingIfConditon, current_);
+    return create_error(SyntaxErrorKind::MissingIfConditon, peek());
   }
   advance();  // consume '('
   std::optional<VarDecl> decl = std::nullopt;
   if (match(TokenType::Var)) {
-    const auto & var_decl_opt = var_decl();
+    auto var_decl_opt = var_decl();
     if (is_variant_v<SyntaxError>(var_decl_opt)) {
       return as_variant<SyntaxError>(var_decl_opt);
     }
-    decl.emplace(as_variant<VarDecl>(var_decl_opt));
+    decl.emplace(std::move(as_variant_mut<VarDecl>(var_decl_opt)));
   }
-  const auto cond_opt = expression();
+  auto cond_opt = expression();
   if (is_variant_v<SyntaxError>(cond_opt)) {
     return as_variant<SyntaxError>(cond_opt);
   }
-  const auto & cond = as_variant<Expr>(cond_opt);
+  auto & cond = as_variant_mut<Expr>(cond_opt);
   if (!match(TokenType::RightParen)) {
     return create_error(SyntaxErrorKind::UnmatchedParenError, if_start_ctx);
   }
@@ -512,11 +602,12 @@ auto Parser::branch_clause(const size_t if_start_ctx) -> std::variant<BranchClau
   if (!match(TokenType::LeftBrace)) {
     return create_error(SyntaxErrorKind::MissingIfBody, if_start_ctx);
   }
-  const auto block_opt = block();
+  auto block_opt = block();
   if (is_variant_v<SyntaxError>(block_opt)) {
     return as_variant<SyntaxError>(block_opt);
   }
-  return BranchClause{decl, cond, as_variant<Block>(block_opt)};
+  return BranchClause{
+    std::move(decl), std::move(cond), std::move(as_variant_mut<Block>(block_opt))};
 }
 
 auto Parser::expression() -> std::variant<Expr, SyntaxError>
@@ -526,8 +617,8 @@ auto Parser::expression() -> std::variant<Expr, SyntaxError>
 
 auto Parser::assignment() -> std::variant<Expr, SyntaxError>
 {
-  const auto error_ctx_assign_target = current_;
-  const auto left_expr_opt = logic_or();
+  const auto error_ctx_assign_target = peek();
+  auto left_expr_opt = recursive_descent_ ? logic_or() : binary(Precedence::Or);
   if (is_variant_v<SyntaxError>(left_expr_opt)) {
     return as_variant<SyntaxError>(left_expr_opt);
   }
@@ -537,197 +628,215 @@ auto Parser::assignment() -> std::variant<Expr, SyntaxError>
       return create_error(SyntaxErrorKind::InvalidAssignmentTarget, error_ctx_assign_target);
     }
     advance();  // consume '='
-    const auto rvalue_expr = assignment();
+    auto rvalue_expr = assignment();
     if (is_variant_v<SyntaxError>(rvalue_expr)) {
       return as_variant<SyntaxError>(rvalue_expr);
     }
-    const auto & rvalue = as_variant<Expr>(rvalue_expr);
+    auto & rvalue = as_variant_mut<Expr>(rvalue_expr);
     if (is_variant_v<Variable>(lvalue_expr)) {
       const auto & lvalue = as_variant<Variable>(lvalue_expr);
-      return Assign{lvalue.name, rvalue};
+      return arena_->make<Assign>(lvalue.name, std::move(rvalue));
     } else {
       const auto & lvalue = as_variant<ReadProperty>(lvalue_expr);
-      return SetProperty{lvalue.base, lvalue.prop, rvalue};
+      return arena_->make<SetProperty>(lvalue.base, lvalue.prop, std::move(rvalue));
     }
   }
   return left_expr_opt;
 }
 
+auto Parser::binary(const Precedence min_precedence) -> std::variant<Expr, SyntaxError>
+{
+  auto left_opt = unary();
+  if (is_variant_v<SyntaxError>(left_opt)) {
+    return left_opt;
+  }
+  auto & left = as_variant_mut<Expr>(left_opt);
+  for (;;) {
+    const auto precedence = binary_precedence(peek().type);
+    if (precedence == Precedence::None or precedence < min_precedence) {
+      break;
+    }
+    const auto op = advance();
+    // all the binary operators are left-associative, so the right operand binds tighter
+    auto right_opt = binary(static_cast<Precedence>(static_cast<uint8_t>(precedence) + 1));
+    if (is_variant_v<SyntaxError>(right_opt)) {
+      return right_opt;
+    }
+    auto & right = as_variant_mut<Expr>(right_opt);
+    if (precedence <= Precedence::And) {
+      left = arena_->make<Logical>(std::move(left), op, std::move(right));
+    } else {
+      left = arena_->make<Binary>(std::move(left), op, std::move(right));
+    }
+  }
+  return left_opt;
+}
+
 auto Parser::logic_or() -> std::variant<Expr, SyntaxError>
 {
-  const auto logic_and_opt = logic_and();
-  if (is_variant_v<SyntaxError>(logic_and_opt)) {
-    return as_variant<SyntaxError>(logic_and_opt);
+  auto left_opt = logic_and();
+  if (is_variant_v<SyntaxError>(left_opt)) {
+    return left_opt;
   }
-  const auto & left = as_variant<Expr>(logic_and_opt);
-  std::vector<Expr> exprs{left};
+  auto & left = as_variant_mut<Expr>(left_opt);
   while (match(TokenType::Or)) {
     const auto & op = advance();
-    const auto next_logic_and_opt = logic_and();
-    if (is_variant_v<SyntaxError>(next_logic_and_opt)) {
-      return as_variant<SyntaxError>(next_logic_and_opt);
+    auto right_opt = logic_and();
+    if (is_variant_v<SyntaxError>(right_opt)) {
+      return right_opt;
     }
-    const auto logical = Logical{exprs.back(), op, as_variant<Expr>(next_logic_and_opt)};
-    exprs.push_back(logical);
+    left = arena_->make<Logical>(std::move(left), op, std::move(as_variant_mut<Expr>(right_opt)));
   }
-  return exprs.back();
+  return left_opt;
 }
 
 auto Parser::logic_and() -> std::variant<Expr, SyntaxError>
 {
-  const auto eq_opt = equality();
-  if (is_variant_v<SyntaxError>(eq_opt)) {
-    return as_variant<SyntaxError>(eq_opt);
+  auto left_opt = equality();
+  if (is_variant_v<SyntaxError>(left_opt)) {
+    return left_opt;
   }
-  const auto & eq = as_variant<Expr>(eq_opt);
-  std::vector<Expr> exprs{eq};
+  auto & left = as_variant_mut<Expr>(left_opt);
   while (match(TokenType::And)) {
     const auto & op = advance();
-    const auto next_eq_opt = equality();
-    if (is_variant_v<SyntaxError>(next_eq_opt)) {
-      return as_variant<SyntaxError>(next_eq_opt);
+    auto right_opt = equality();
+    if (is_variant_v<SyntaxError>(right_opt)) {
+      return right_opt;
     }
-    const auto logical = Logical{exprs.back(), op, as_variant<Expr>(next_eq_opt)};
-    exprs.push_back(logical);
+    left = arena_->make<Logical>(std::move(left), op, std::move(as_variant_mut<Expr>(right_opt)));
   }
-  return exprs.back();
+  return left_opt;
 }
 
 auto Parser::equality() -> std::variant<Expr, SyntaxError>
 {
-  const auto expr_opt = comparison();
-  if (is_variant_v<SyntaxError>(expr_opt)) {
-    return expr_opt;
+  auto left_opt = comparison();
+  if (is_variant_v<SyntaxError>(left_opt)) {
+    return left_opt;
   }
-  std::vector<Expr> exprs{as_variant<Expr>(expr_opt)};
+  auto & left = as_variant_mut<Expr>(left_opt);
   while (match(TokenType::BangEqual, TokenType::EqualEqual)) {
     const auto & op = advance();
-    const auto right_opt = comparison();
+    auto right_opt = comparison();
     if (is_variant_v<SyntaxError>(right_opt)) {
       return right_opt;
     }
-    const auto binary = Binary{exprs.back(), op, as_variant<Expr>(right_opt)};
-    exprs.push_back(binary);
+    left = arena_->make<Binary>(std::move(left), op, std::move(as_variant_mut<Expr>(right_opt)));
   }
-  return exprs.back();
+  return left_opt;
 }
 
 auto Parser::comparison() -> std::variant<Expr, SyntaxError>
 {
-  const auto expr_opt = term();
-  if (is_variant_v<SyntaxError>(expr_opt)) {
-    return expr_opt;
+  auto left_opt = term();
+  if (is_variant_v<SyntaxError>(left_opt)) {
+    return left_opt;
   }
-  std::vector<Expr> exprs{as_variant<Expr>(expr_opt)};
+  auto & left = as_variant_mut<Expr>(left_opt);
   while (
     match(TokenType::Greater, TokenType::GreaterEqual, TokenType::Less, TokenType::LessEqual)) {
     const auto & op = advance();
-    const auto right_opt = term();
+    auto right_opt = term();
     if (is_variant_v<SyntaxError>(right_opt)) {
       return right_opt;
     }
-    const auto binary = Binary{exprs.back(), op, as_variant<Expr>(right_opt)};
-    exprs.push_back(binary);
+    left = arena_->make<Binary>(std::move(left), op, std::move(as_variant_mut<Expr>(right_opt)));
   }
-  return exprs.back();
+  return left_opt;
 }
 
 auto Parser::term() -> std::variant<Expr, SyntaxError>
 {
-  const auto factor_opt = factor();
-  if (is_variant_v<SyntaxError>(factor_opt)) {
-    return factor_opt;
+  auto left_opt = factor();
+  if (is_variant_v<SyntaxError>(left_opt)) {
+    return left_opt;
   }
-  std::vector<Expr> exprs{as_variant<Expr>(factor_opt)};
+  auto & left = as_variant_mut<Expr>(left_opt);
   while (match(TokenType::Plus, TokenType::Minus)) {
     const auto & op = advance();
-    const auto right_opt = factor();
+    auto right_opt = factor();
     if (is_variant_v<SyntaxError>(right_opt)) {
       return right_opt;
     }
-    const auto binary = Binary{exprs.back(), op, as_variant<Expr>(right_opt)};
-    exprs.push_back(binary);
+    left = arena_->make<Binary>(std::move(left), op, std::move(as_variant_mut<Expr>(right_opt)));
   }
-  return exprs.back();
+  return left_opt;
 }
 
 auto Parser::factor() -> std::variant<Expr, SyntaxError>
 {
-  const auto unary_opt = unary();
-  if (is_variant_v<SyntaxError>(unary_opt)) {
-    return unary_opt;
+  auto left_opt = unary();
+  if (is_variant_v<SyntaxError>(left_opt)) {
+    return left_opt;
   }
-  std::vector<Expr> exprs{as_variant<Expr>(unary_opt)};
+  auto & left = as_variant_mut<Expr>(left_opt);
   while (match(TokenType::Slash, TokenType::Star)) {
     const auto & op = advance();
-    const auto right_opt = unary();
+    auto right_opt = unary();
     if (is_variant_v<SyntaxError>(right_opt)) {
       return right_opt;
     }
-    const auto binary = Binary{exprs.back(), op, as_variant<Expr>(right_opt)};
-    exprs.push_back(binary);
+    left = arena_->make<Binary>(std::move(left), op, std::move(as_variant_mut<Expr>(right_opt)));
   }
-  return exprs.back();
+  return left_opt;
 }
 
 auto Parser::unary() -> std::variant<Expr, SyntaxError>
 {
   if (match(TokenType::Bang, TokenType::Minus)) {
     const auto & op = advance();
-    const auto unary_next_opt = unary();
+    auto unary_next_opt = unary();
     if (is_variant_v<SyntaxError>(unary_next_opt)) {
       return unary_next_opt;
     }
-    return Unary{op, as_variant<Expr>(unary_next_opt)};
+    return arena_->make<Unary>(op, std::move(as_variant_mut<Expr>(unary_next_opt)));
   }
   return call();
 }
 
 auto Parser::call() -> std::variant<Expr, SyntaxError>
 {
-  const auto primary_opt = primary();
+  auto primary_opt = primary();
   if (is_variant_v<SyntaxError>(primary_opt)) {
-    return as_variant<SyntaxError>(primary_opt);
+    return primary_opt;
   }
-  const auto & prim = as_variant<Expr>(primary_opt);
-  std::vector<Expr> exprs{prim};
+  auto & callee = as_variant_mut<Expr>(primary_opt);
   while (true) {
     if (match(TokenType::LeftParen)) {
-      const auto paren_ctx = current_;
+      const auto paren_ctx = peek();
       advance();  // consume '('
-      const auto arguments_opt = arguments();
+      auto arguments_opt = arguments();
       if (is_variant_v<SyntaxError>(arguments_opt)) {
         return as_variant<SyntaxError>(arguments_opt);
       }
-      const auto caller = Call{exprs.back(), as_variant<std::vector<Expr>>(arguments_opt)};
       if (!match(TokenType::RightParen)) {
         create_error(SyntaxErrorKind::UnmatchedParenError, paren_ctx);
       }
-      exprs.push_back(caller);
+      callee = arena_->make<Call>(
+        std::move(callee), std::move(as_variant_mut<std::vector<Expr>>(arguments_opt)));
       advance();  // consume ')'
     } else if (match(TokenType::Dot)) {
       advance();  // consume '.'
-      const auto r_prop = ReadProperty{exprs.back(), peek()};
+      callee = arena_->make<ReadProperty>(std::move(callee), peek());
       advance();  // consume property-name after '.'
-      exprs.push_back(r_prop);
     } else {
       break;
     }
   }
-  return exprs.back();
+  return primary_opt;
 }
 
 auto Parser::arguments() -> std::variant<std::vector<Expr>, SyntaxError>
 {
   std::vector<Expr> args;
-  const auto args_ctx = current_;
+  const auto args_ctx = peek();
   if (!match(TokenType::RightParen)) {
     while (true) {
-      const auto arg_opt = expression();
+      auto arg_opt = expression();
       if (is_variant_v<SyntaxError>(arg_opt)) {
         return as_variant<SyntaxError>(arg_opt);
       }
-      args.push_back(as_variant<Expr>(arg_opt));
+      args.push_back(std::move(as_variant_mut<Expr>(arg_opt)));
       if (!match(TokenType::Comma)) {
         break;
       } else {
@@ -741,68 +850,84 @@ auto Parser::arguments() -> std::variant<std::vector<Expr>, SyntaxError>
   return args;
 }
 
+/**
+ * @brief convert the literal token to its value
+ * @pre the number token has been validated by the tokenizer
+ */
+static auto to_constant(const Token & token) -> Constant
+{
+  switch (token.type) {
+    case TokenType::True:
+      return true;
+    case TokenType::False:
+      return false;
+    case TokenType::String:
+      return String::intern(token.lexeme);
+    case TokenType::Number: {
+      const auto number = parse_number(token.lexeme);
+      assert(number.has_value());
+      return std::visit([](const auto n) -> Constant { return n; }, number.value());
+    }
+    default:
+      return Nil{};
+  }
+}
+
 auto Parser::primary() -> std::variant<Expr, SyntaxError>
 {
-  const auto error_ctx_primary = current_;
+  const auto error_ctx_primary = peek();
   if (match(
         TokenType::Number, TokenType::String, TokenType::True, TokenType::False, TokenType::Nil)) {
     const auto & token = advance();
-    return Literal{token.type, token.lexeme, token.line, token.start_index};
+    return Literal{token, to_constant(token)};
   }
   if (match(TokenType::Identifier)) {
     const auto & token = advance();
-    return Variable{token};
+    return arena_->make<Variable>(token);
   }
   if (match(TokenType::LeftParen)) {
     const auto left_paren = peek();
-    const auto error_ctx_paren = current_;
+    const auto error_ctx_paren = peek();
     const auto left_anchor = peek();
     advance();  // just consume '('
-    const auto expr_opt = expression();
+    auto expr_opt = expression();
     if (is_variant_v<SyntaxError>(expr_opt)) {
       return expr_opt;
     }
     if (match(TokenType::RightParen)) {
       const auto right_paren = peek();
       advance();  // just consume ')'
-      return Group{left_paren, as_variant<Expr>(expr_opt), right_paren};
+      return arena_->make<Group>(
+        left_paren, std::move(as_variant_mut<Expr>(expr_opt)), right_paren);
     }
     return create_error(SyntaxErrorKind::UnmatchedParenError, error_ctx_paren);
   }
   return create_error(SyntaxErrorKind::InvalidLiteralError, error_ctx_primary);
 }
 
-auto Parser::is_at_end() const noexcept -> bool
+auto Parser::is_at_end() -> bool
 {
   /**
-     NOTE: not check by `current_ == tokens_.size()`, because otherwise 'EOF' is evaluated as
-     primary() which is troublesome
+     NOTE: EOF is not consumed, because otherwise 'EOF' is evaluated as primary() which is
+     troublesome
   */
-  if (current_ == (tokens_.size() - 1)) {
-    assert(peek().type == TokenType::Eof);
-    return true;
-  }
-  return false;
+  return peek().type == TokenType::Eof;
 }
 
-auto Parser::peek() const -> const Token &
+auto Parser::peek() -> const Token &
 {
-  return tokens_.at(current_);
+  return tokens_.peek();
 }
 
-auto Parser::advance() -> const Token &
+auto Parser::advance() -> Token
 {
-  if (!is_at_end()) {
-    current_++;
-  }
-  return tokens_.at(current_ - 1);
+  return tokens_.advance();
 }
 
-auto Parser::create_error(const SyntaxErrorKind & kind, const size_t error_ctx) const -> SyntaxError
+auto Parser::create_error(const SyntaxErrorKind & kind, const Token & error_ctx) const
+  -> SyntaxError
 {
-  const auto ctx_token = tokens_.at(error_ctx);
-  return SyntaxError{
-    kind, ctx_token.line, ctx_token.start_index, ctx_token.start_index + ctx_token.lexeme.size()};
+  return SyntaxError{kind, error_ctx.line, error_ctx.lexeme};
 }
 
 }  // namespace parser
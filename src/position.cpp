@@ -0,0 +1,36 @@
+#include <cpplox/position.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace lox
+{
+
+inline namespace position
+{
+
+LineTable::LineTable(const std::string_view source, std::optional<std::string> filename)
+: source_(source), filename_(std::move(filename)), start_indices_{0}
+{
+  for (size_t i = source.find('\n'); i != std::string_view::npos; i = source.find('\n', i + 1)) {
+    start_indices_.push_back(i + 1);
+  }
+}
+
+auto LineTable::end_index(const size_t number) const -> size_t
+{
+  if (number < start_indices_.size()) {
+    return start_indices_.at(number) - 1;
+  }
+  return source_.empty() ? 0 : source_.size() - 1;
+}
+
+auto LineTable::line_number(const size_t offset) const -> size_t
+{
+  // the first line whose start is after `offset` is the next line
+  const auto it = std::upper_bound(start_indices_.begin(), start_indices_.end(), offset);
+  return static_cast<size_t>(it - start_indices_.begin());
+}
+
+}  // namespace position
+}  // namespace lox
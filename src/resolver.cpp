@@ -1,54 +1,122 @@
+#include <cpplox/parser.hpp>
 #include <cpplox/resolver.hpp>
 
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
 namespace lox
 {
 inline namespace resolver
 {
 
+namespace
+{
+/**
+ * @brief the index of the upvalue taken from `source` by the function at the nesting level
+ * `function`, which is added unless it is already captured
+ */
+auto add_upvalue(ScopeChain & chain, const size_t function, const UpvalueRef source) -> size_t
+{
+  auto & upvalues = *chain.functions.at(function);
+  for (size_t i = 0; i < upvalues.size(); ++i) {
+    if (upvalues[i].index == source.index && upvalues[i].is_local == source.is_local) {
+      return i;
+    }
+  }
+  upvalues.push_back(source);
+  return upvalues.size() - 1;
+}
+
+/**
+ * @brief find the innermost declaration of `name` in `chain` from the innermost function. if it is
+ * a local variable of an enclosing function, it is captured as an upvalue by each function between
+ * them
+ */
+auto find_variable(ScopeChain & chain, const std::string_view name)
+  -> std::optional<VariableLocation>
+{
+  const auto function = chain.scopes.back().function;
+  for (auto it = chain.scopes.rbegin(); it != chain.scopes.rend(); ++it) {
+    const auto entry = it->variables.find(name);
+    if (entry == it->variables.end()) {
+      continue;
+    }
+    auto & variable = entry->second;
+    if (!it->local && !variable.upvalue) {
+      // NOTE: the names in the other outer scopes, like the methods of a class, are not variables
+      if (std::next(it) == chain.scopes.rend()) {
+        return VariableLocation{Storage::Global, variable.slot};
+      }
+      return std::nullopt;
+    }
+    if (it->function == function) {
+      return VariableLocation{Storage::Local, variable.slot};
+    }
+    variable.captured = true;
+    auto level = it->function + 1;
+    auto index = variable.upvalue ? variable.slot
+                                  : add_upvalue(chain, level, UpvalueRef{variable.slot, true});
+    for (++level; level <= function; ++level) {
+      index = add_upvalue(chain, level, UpvalueRef{index, false});
+    }
+    return VariableLocation{Storage::Upvalue, index};
+  }
+  return std::nullopt;
+}
+
+/**
+ * @brief the global scope, or the scopes enclosing a function resolved later
+ */
+auto outer_scope(Scope variables) -> LexicalScope
+{
+  const auto size = variables.size();
+  return LexicalScope{std::move(variables), 0, false, size};
+}
+}  // namespace
+
 std::optional<CompileError> StmtResolver::operator()(const ExprStmt & stmt)
 {
-  ExprResolver resolver(scopes, lookup);
+  ExprResolver resolver(chain);
   return boost::apply_visitor(resolver, stmt.expression);
 }
 
 std::optional<CompileError> StmtResolver::operator()(const PrintStmt & stmt)
 {
-  ExprResolver resolver(scopes, lookup);
+  ExprResolver resolver(chain);
   return boost::apply_visitor(resolver, stmt.expression);
 }
 
 std::optional<CompileError> StmtResolver::operator()(const Block & block)
 {
   begin_scope();
-  DeclResolver decl_resolver(scopes, lookup);
+  DeclResolver decl_resolver(chain);
   for (const auto & declaration : block.declarations) {
     if (const auto err = boost::apply_visitor(decl_resolver, declaration); err) {
       return err;
     }
   }
-  end_scope();
+  end_scope(block.captured_base);
   return std::nullopt;
 }
 
 std::optional<CompileError> StmtResolver::operator()(const IfBlock & stmt)
 {
-  size_t n_nest_call = 0;
+  std::vector<const BranchClause *> nested_clauses;
   auto resolve_branch_clause = [&](const BranchClause & clause) -> std::optional<CompileError> {
     begin_scope();
-    n_nest_call++;
+    nested_clauses.push_back(&clause);
     if (clause.declaration) {
-      DeclResolver resolver(scopes, lookup);
-      if (const auto err = boost::apply_visitor(resolver, Declaration{clause.declaration.value()});
-          err) {
+      DeclResolver resolver(chain);
+      if (const auto err = resolver(clause.declaration.value()); err) {
         return err;
       }
     }
-    ExprResolver resolver(scopes, lookup);
+    ExprResolver resolver(chain);
     if (const auto err = boost::apply_visitor(resolver, clause.cond); err) {
       return err;
     }
-    const auto body_resolve_opt = boost::apply_visitor(*this, Stmt{clause.body});
-    return body_resolve_opt;
+    return (*this)(clause.body);
   };
 
   // for if
@@ -62,25 +130,25 @@ std::optional<CompileError> StmtResolver::operator()(const IfBlock & stmt)
   }
   if (stmt.else_body) {
     // NOTE: for else, nest is not added
-    if (const auto err = boost::apply_visitor(*this, Stmt{stmt.else_body.value()}); err) {
+    if (const auto err = (*this)(stmt.else_body.value()); err) {
       return err;
     }
   }
-  for (unsigned i = 1; i <= n_nest_call; ++i) {
-    end_scope();
+  for (auto it = nested_clauses.rbegin(); it != nested_clauses.rend(); ++it) {
+    end_scope((*it)->captured_base);
   }
   return std::nullopt;
 }
 
 std::optional<CompileError> StmtResolver::operator()(const WhileStmt & stmt)
 {
-  ExprResolver expr_resolver(scopes, lookup);
+  ExprResolver expr_resolver(chain);
   if (const auto err = boost::apply_visitor(expr_resolver, stmt.cond); err) {
     return err;
   }
   // NOTE: begin_scope is unnecessary because body is Block
-  StmtResolver stmt_resolver(scopes, lookup);
-  if (const auto err = boost::apply_visitor(stmt_resolver, Stmt{stmt.body}); err) {
+  StmtResolver stmt_resolver(chain);
+  if (const auto err = stmt_resolver(stmt.body); err) {
     return err;
   }
   return std::nullopt;
@@ -93,34 +161,33 @@ std::optional<CompileError> StmtResolver::operator()(const ForStmt & stmt)
     const auto & init_stmt = stmt.init_stmt.value();
     if (is_variant_v<VarDecl>(init_stmt)) {
       const auto & var_stmt = as_variant<VarDecl>(init_stmt);
-      DeclResolver resolver(scopes, lookup);
-      if (const auto err = boost::apply_visitor(resolver, Declaration{var_stmt}); err) {
+      DeclResolver resolver(chain);
+      if (const auto err = resolver(var_stmt); err) {
         return err;
       }
     } else if (is_variant_v<ExprStmt>(init_stmt)) {
       const auto & expr_stmt = as_variant<ExprStmt>(init_stmt);
-      ExprResolver expr_resolver(scopes, lookup);
-      if (const auto err = boost::apply_visitor(*this, Stmt{expr_stmt}); err) {
+      if (const auto err = (*this)(expr_stmt); err) {
         return err;
       }
     }
   }
   if (stmt.cond) {
-    ExprResolver resolver(scopes, lookup);
+    ExprResolver resolver(chain);
     if (const auto err = boost::apply_visitor(resolver, stmt.cond.value()); err) {
       return err;
     }
   }
   if (stmt.next) {
-    ExprResolver resolver(scopes, lookup);
+    ExprResolver resolver(chain);
     if (const auto err = boost::apply_visitor(resolver, stmt.next.value()); err) {
       return err;
     }
   }
-  if (const auto err = boost::apply_visitor(*this, Stmt{stmt.body}); err) {
+  if (const auto err = (*this)(stmt.body); err) {
     return err;
   }
-  end_scope();
+  end_scope(stmt.captured_base);
 
   return std::nullopt;
 }
@@ -138,7 +205,7 @@ std::optional<CompileError> StmtResolver::operator()(const ContinueStmt & stmt)
 std::optional<CompileError> StmtResolver::operator()(const ReturnStmt & stmt)
 {
   if (stmt.expr) {
-    ExprResolver resolver(scopes, lookup);
+    ExprResolver resolver(chain);
     if (const auto err = boost::apply_visitor(resolver, stmt.expr.value()); err) {
       return err;
     }
@@ -148,19 +215,28 @@ std::optional<CompileError> StmtResolver::operator()(const ReturnStmt & stmt)
 
 void StmtResolver::begin_scope()
 {
-  scopes.push_back({});
+  const auto function = chain.scopes.back().function;
+  chain.scopes.push_back(LexicalScope{{}, function, true, 0, chain.stack_size});
 }
 
-void StmtResolver::end_scope()
+void StmtResolver::end_scope(std::optional<size_t> & captured_base)
 {
-  scopes.pop_back();
+  const auto & scope = chain.scopes.back();
+  const auto captured = std::any_of(
+    scope.variables.begin(), scope.variables.end(),
+    [](const auto & variable) { return variable.second.captured; });
+  captured_base = captured ? std::optional<size_t>(scope.stack_base) : std::nullopt;
+  // NOTE: the slots of the frame are reused by the following scopes, once their upvalues are closed
+  chain.stack_size = scope.stack_base;
+  chain.scopes.pop_back();
 }
 
 std::optional<CompileError> DeclResolver::operator()(const VarDecl & var_decl)
 {
-  declare(var_decl.name);
+  var_decl.slot = declare(var_decl.name);
+  var_decl.on_stack = chain.scopes.back().local;
   if (var_decl.initializer) {
-    ExprResolver expr_resolver(scopes, lookup);
+    ExprResolver expr_resolver(chain);
     if (const auto err = boost::apply_visitor(expr_resolver, var_decl.initializer.value()); err) {
       return err;
     }
@@ -171,67 +247,102 @@ std::optional<CompileError> DeclResolver::operator()(const VarDecl & var_decl)
 
 std::optional<CompileError> DeclResolver::operator()(const Stmt & stmt)
 {
-  StmtResolver resolver(scopes, lookup);
+  StmtResolver resolver(chain);
   return boost::apply_visitor(resolver, stmt);
 }
 
 std::optional<CompileError> DeclResolver::operator()(const FuncDecl & func_decl)
 {
-  declare(func_decl.name);
+  func_decl.slot = declare(func_decl.name);
+  func_decl.on_stack = chain.scopes.back().local;
   define(func_decl.name);
 
-  begin_scope();
-  for (const auto & param : func_decl.parameters) {
-    declare(param);
-    define(param);
-  }
-  DeclResolver body_resolver(scopes, lookup);
-  for (const auto & declaration : func_decl.body.declarations) {
-    if (const auto err = boost::apply_visitor(body_resolver, declaration); err) {
-      return err;
+  // the frame of the enclosing function is resumed after the body
+  const auto stack_size = std::exchange(chain.stack_size, 0);
+  const auto frame_size = std::exchange(chain.frame_size, 0);
+  const auto function = chain.scopes.back().function + 1;
+  func_decl.upvalues.clear();
+  chain.functions.push_back(&func_decl.upvalues);
+  chain.scopes.push_back(LexicalScope{{}, function});
+  const auto err = [&]() -> std::optional<CompileError> {
+    if (func_decl.lazy) {
+      // NOTE: the body is resolved on the first call, where the scopes at this point are gone. so
+      // the variables which the body may refer to are looked up now, and the local ones are
+      // captured in case
+      auto & captures = func_decl.lazy->captures;
+      captures.clear();
+      for (const auto & name : func_decl.lazy->names) {
+        if (const auto location = find_variable(chain, name); location) {
+          captures.emplace(name, location.value());
+        }
+      }
+      return std::nullopt;
     }
-  }
-  end_scope();
-  return std::nullopt;
+    func_decl.parameter_slots.clear();
+    for (const auto & param : func_decl.parameters) {
+      func_decl.parameter_slots.push_back(declare(param));
+      define(param);
+    }
+    DeclResolver body_resolver(chain);
+    for (const auto & declaration : func_decl.body.declarations) {
+      if (const auto err = boost::apply_visitor(body_resolver, declaration); err) {
+        return err;
+      }
+    }
+    return std::nullopt;
+  }();
+  func_decl.frame_size = chain.frame_size;
+  chain.scopes.pop_back();
+  chain.functions.pop_back();
+  chain.stack_size = stack_size;
+  chain.frame_size = frame_size;
+  return err;
 }
 
 std::optional<CompileError> DeclResolver::operator()(const ClassDecl & class_decl)
 {
-  declare(class_decl.name);
-  define(class_decl.name);
+  // NOTE: classes are always defined in the global scope by the interpreter
+  auto & global_scope = chain.scopes.front();
+  const auto it = global_scope.variables.try_emplace(class_decl.name.lexeme, ScopeEntry{true, 0});
+  if (it.second) {
+    it.first->second.slot = global_scope.environment_size++;
+  }
+  it.first->second.defined = true;
+  class_decl.slot = it.first->second.slot;
 
+  // NOTE: the methods are enclosed by the scope of the class and then by the global scope, so they
+  // capture nothing
+  ScopeChain method_chain{{outer_scope(global_scope.variables), outer_scope(Scope{})}};
+  DeclResolver method_resolver(method_chain);
   for (const auto & [name, method] : class_decl.methods) {
-    if (const auto err = boost::apply_visitor(DeclResolver(scopes, lookup), Declaration{method});
-        err)
+    if (const auto err = method_resolver(method); err) {
       return err;
+    }
   }
   return std::nullopt;
 }
 
-void DeclResolver::begin_scope()
-{
-  scopes.push_back({});
-}
-
-void DeclResolver::end_scope()
-{
-  scopes.pop_back();
-}
-
-void DeclResolver::declare(const Token & name)
-{
-  if (scopes.empty()) {
-    return;
+auto DeclResolver::declare(const Token & name) -> size_t
+{
+  auto & scope = chain.scopes.back();
+  // NOTE: redeclaration in the same scope reuses the slot
+  const auto [it, inserted] = scope.variables.try_emplace(name.lexeme, ScopeEntry{false, 0});
+  auto & entry = it->second;
+  if (inserted) {
+    if (scope.local) {
+      entry.slot = chain.stack_size++;
+      chain.frame_size = std::max(chain.frame_size, chain.stack_size);
+    } else {
+      entry.slot = scope.environment_size++;
+    }
   }
-  scopes.back()[name.lexeme] = false;
+  entry.defined = false;
+  return entry.slot;
 }
 
 void DeclResolver::define(const Token & name)
 {
-  if (scopes.empty()) {
-    return;
-  }
-  scopes.back()[name.lexeme] = true;
+  chain.scopes.back().variables.at(name.lexeme).defined = true;
 }
 
 std::optional<CompileError> ExprResolver::operator()(const Literal & literal)
@@ -259,18 +370,13 @@ std::optional<CompileError> ExprResolver::operator()(const Group & group)
 
 std::optional<CompileError> ExprResolver::operator()(const Variable & expr)
 {
-  if (!scopes.empty()) {
-    const auto it = scopes.back().find(expr.name.lexeme);
-    if (it != scopes.back().end() && it->second == false) {
-      return UndefVariableError{expr.name};
-    }
+  const auto & variables = chain.scopes.back().variables;
+  const auto it = variables.find(expr.name.lexeme);
+  if (it != variables.end() && !it->second.defined) {
+    return UndefVariableError{expr.name};
   }
 
-  if (scopes.empty()) {
-    return std::nullopt;
-  }
-
-  resolve_local(expr.name);
+  expr.location = resolve_local(expr.name);
   return std::nullopt;
 }
 
@@ -279,7 +385,7 @@ std::optional<CompileError> ExprResolver::operator()(const Assign & assign)
   if (const auto err = boost::apply_visitor(*this, assign.expr); err) {
     return err;
   }
-  resolve_local(assign.name);
+  assign.location = resolve_local(assign.name);
   return std::nullopt;
 }
 
@@ -327,15 +433,78 @@ std::optional<CompileError> ExprResolver::operator()(const SetProperty & propert
   return std::nullopt;
 }
 
-void ExprResolver::resolve_local(const Token & name)
+auto ExprResolver::resolve_local(const Token & name) -> std::optional<VariableLocation>
+{
+  return find_variable(chain, name.lexeme);
+}
+
+auto resolve_program(const Program & program, Scope & global_scope) -> std::optional<CompileError>
 {
-  for (int i = scopes.size() - 1; i >= 0; i--) {
-    if (const auto it = scopes.at(i).find(name.lexeme); it != scopes.at(i).end()) {
-      // if depth == 0, do not traverse enclosing
-      lookup[name] = scopes.size() - 1 - i;
-      return;
+  if (program.resolved_globals and global_scope.empty()) {
+    for (const auto & global : program.resolved_globals.value()) {
+      global_scope.emplace(global.name, ScopeEntry{true, global.slot});
     }
+    return std::nullopt;
   }
+  ScopeChain chain{{outer_scope(global_scope)}};
+  DeclResolver resolver(chain);
+  for (const auto & declaration : program.declarations) {
+    const auto err = boost::apply_visitor(resolver, declaration);
+    if (err) {
+      return err;
+    }
+  }
+  program.frame_size = chain.frame_size;
+  global_scope = std::move(chain.scopes.front().variables);
+  return std::nullopt;
+}
+
+auto to_global_slots(const Scope & global_scope) -> std::vector<GlobalSlot>
+{
+  std::vector<GlobalSlot> globals;
+  globals.reserve(global_scope.size());
+  for (const auto & [name, entry] : global_scope) {
+    globals.push_back(GlobalSlot{name, entry.slot});
+  }
+  std::sort(globals.begin(), globals.end(), [](const auto & a, const auto & b) {
+    return a.slot < b.slot;
+  });
+  return globals;
+}
+
+auto materialize_body(const FuncDecl & func_decl) -> std::optional<RuntimeError>
+{
+  if (!func_decl.lazy) {
+    return std::nullopt;
+  }
+  if (const auto err = Parser::parse_body(func_decl); err) {
+    return err.value();
+  }
+  const auto lazy = std::move(func_decl.lazy);
+
+  // NOTE: the captured variables are placed in the scope enclosing the function, so that the
+  // locations are resolved as if the body were resolved at the declaration. the upvalues of the
+  // function are already fixed by its closures
+  const auto slot = func_decl.slot;
+  const auto on_stack = func_decl.on_stack;
+  const auto upvalues = func_decl.upvalues;
+  ScopeChain chain{{outer_scope(Scope{})}};
+  for (const auto & [name, location] : lazy->captures) {
+    ScopeEntry entry{true, location.slot};
+    entry.upvalue = location.storage == Storage::Upvalue;
+    chain.scopes.front().variables.emplace(name, entry);
+  }
+  const auto err = DeclResolver(chain)(func_decl);
+  func_decl.slot = slot;
+  func_decl.on_stack = on_stack;
+  func_decl.upvalues = upvalues;
+  if (err) {
+    // the function is materialized again on the next call, and fails again
+    func_decl.body = Block{};
+    func_decl.lazy = lazy;
+    return err.value();
+  }
+  return std::nullopt;
 }
 
 }  // namespace resolver
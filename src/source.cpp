@@ -0,0 +1,92 @@
+#include <cpplox/source.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace lox
+{
+
+inline namespace source
+{
+
+namespace
+{
+/**
+ * @brief read the rest of `fd` into a string
+ * @return nullopt on a read error
+ */
+auto read_all(const int fd) -> std::optional<std::string>
+{
+  std::string text;
+  char chunk[64 * 1024];
+  for (;;) {
+    const auto n = ::read(fd, chunk, sizeof(chunk));
+    if (n == 0) {
+      return text;
+    }
+    if (n < 0) {
+      return std::nullopt;
+    }
+    text.append(chunk, static_cast<size_t>(n));
+  }
+}
+}  // namespace
+
+auto SourceBuffer::open(const std::string & path) -> std::optional<SourceBuffer>
+{
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) == 0 and S_ISREG(st.st_mode) and st.st_size > 0) {
+    const auto size = static_cast<size_t>(st.st_size);
+    void * mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      // the tokenizer scans the text from the beginning to the end only once
+      ::madvise(mapping, size, MADV_SEQUENTIAL);
+      ::close(fd);
+      return SourceBuffer(mapping, size);
+    }
+  }
+  // an empty file cannot be mapped, and neither can a pipe
+  auto text = read_all(fd);
+  ::close(fd);
+  if (!text) {
+    return std::nullopt;
+  }
+  return SourceBuffer(std::move(text.value()));
+}
+
+SourceBuffer::SourceBuffer(std::string text) : text_(std::move(text)), view_(text_)
+{
+}
+
+SourceBuffer::SourceBuffer(void * mapping, const size_t size)
+: mapping_(mapping), mapping_size_(size), view_(static_cast<const char *>(mapping), size)
+{
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer && other) noexcept
+: text_(std::move(other.text_)), mapping_(other.mapping_), mapping_size_(other.mapping_size_)
+{
+  // NOTE: a short string moves its characters, so the view has to be taken again
+  view_ = mapping_ ? other.view_ : std::string_view(text_);
+  other.mapping_ = nullptr;
+  other.mapping_size_ = 0;
+  other.view_ = std::string_view();
+}
+
+SourceBuffer::~SourceBuffer()
+{
+  if (mapping_) {
+    ::munmap(mapping_, mapping_size_);
+  }
+}
+
+}  // namespace source
+}  // namespace lox
@@ -0,0 +1,31 @@
+#include <cpplox/string.hpp>
+
+#include <unordered_map>
+
+namespace lox
+{
+
+inline namespace string
+{
+
+String::String(std::string value)
+{
+  const auto hash = std::hash<std::string_view>()(value);
+  impl_ = std::make_shared<const Impl>(Impl{std::move(value), hash, false});
+}
+
+auto String::intern(const std::string_view value) -> String
+{
+  // NOTE: the key refers to the buffer of the interned string itself
+  static std::unordered_map<std::string_view, std::shared_ptr<const Impl>> table;
+  if (const auto it = table.find(value); it != table.end()) {
+    return String(it->second);
+  }
+  auto impl = std::make_shared<const Impl>(
+    Impl{std::string(value), std::hash<std::string_view>()(value), true});
+  table.emplace(impl->value, impl);
+  return String(std::move(impl));
+}
+
+}  // namespace string
+}  // namespace lox
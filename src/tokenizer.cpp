@@ -1,9 +1,20 @@
 #include <cpplox/tokenizer.hpp>
 #include <cpplox/variant.hpp>
 
-#include <boost/lexical_cast.hpp>
-
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace lox
 {
@@ -11,11 +22,294 @@ namespace lox
 inline namespace tokenizer
 {
 
-Tokenizer::Tokenizer(const std::string & source) : source_(source)
+namespace
+{
+
+enum class CharClass : uint8_t {
+  Invalid,
+  Blank,     //!< ' ', '\r', '\t'
+  Newline,   //!< '\n'
+  Single,    //!< the characters which are a token by themselves
+  Slash,     //!< '/' or the beginning of a comment
+  Operator,  //!< '!', '=', '>', '<' which may be followed by '='
+  Quote,     //!< '"'
+  Digit,
+  Alpha,
+};
+
+constexpr auto to_index(const char c) -> size_t
+{
+  return static_cast<unsigned char>(c);
+}
+
+constexpr auto make_char_classes() -> std::array<CharClass, 256>
+{
+  std::array<CharClass, 256> table{};
+  for (const char c : {' ', '\r', '\t'}) {
+    table[to_index(c)] = CharClass::Blank;
+  }
+  table[to_index('\n')] = CharClass::Newline;
+  for (const char c : {'(', ')', '{', '}', ',', '.', '-', '+', ';', '*'}) {
+    table[to_index(c)] = CharClass::Single;
+  }
+  table[to_index('/')] = CharClass::Slash;
+  for (const char c : {'!', '=', '>', '<'}) {
+    table[to_index(c)] = CharClass::Operator;
+  }
+  table[to_index('"')] = CharClass::Quote;
+  for (char c = '0'; c <= '9'; ++c) {
+    table[to_index(c)] = CharClass::Digit;
+  }
+  for (char c = 'a'; c <= 'z'; ++c) {
+    table[to_index(c)] = CharClass::Alpha;
+  }
+  for (char c = 'A'; c <= 'Z'; ++c) {
+    table[to_index(c)] = CharClass::Alpha;
+  }
+  table[to_index('_')] = CharClass::Alpha;
+  return table;
+}
+
+/**
+ * @brief the token of a Single/Slash/Operator character, and the token of an Operator character
+ * followed by '='
+ */
+constexpr auto make_char_tokens(const bool followed_by_equal) -> std::array<TokenType, 256>
+{
+  std::array<TokenType, 256> table{};
+  table[to_index('(')] = TokenType::LeftParen;
+  table[to_index(')')] = TokenType::RightParen;
+  table[to_index('{')] = TokenType::LeftBrace;
+  table[to_index('}')] = TokenType::RightBrace;
+  table[to_index(',')] = TokenType::Comma;
+  table[to_index('.')] = TokenType::Dot;
+  table[to_index('-')] = TokenType::Minus;
+  table[to_index('+')] = TokenType::Plus;
+  table[to_index(';')] = TokenType::Semicolun;
+  table[to_index('*')] = TokenType::Star;
+  table[to_index('/')] = TokenType::Slash;
+  table[to_index('!')] = followed_by_equal ? TokenType::BangEqual : TokenType::Bang;
+  table[to_index('=')] = followed_by_equal ? TokenType::EqualEqual : TokenType::Equal;
+  table[to_index('>')] = followed_by_equal ? TokenType::GreaterEqual : TokenType::Greater;
+  table[to_index('<')] = followed_by_equal ? TokenType::LessEqual : TokenType::Less;
+  return table;
+}
+
+constexpr auto char_classes = make_char_classes();
+constexpr auto char_tokens = make_char_tokens(false);
+constexpr auto char_equal_tokens = make_char_tokens(true);
+
+constexpr auto class_of(const char c) -> CharClass
+{
+  return char_classes[to_index(c)];
+}
+
+constexpr auto is_whitespace(const char c) -> bool
+{
+  return class_of(c) == CharClass::Blank or class_of(c) == CharClass::Newline;
+}
+
+constexpr auto is_identifier_char(const char c) -> bool
+{
+  return class_of(c) == CharClass::Alpha or class_of(c) == CharClass::Digit;
+}
+
+#if defined(__AVX2__)
+/**
+ * @brief the 32 bytes of the source which are classified at once. each method returns the bitmask
+ * of the matching bytes
+ */
+struct Avx2Chunk
+{
+  static constexpr size_t Width = 32;
+  static constexpr uint32_t All = 0xffffffff;
+
+  explicit Avx2Chunk(const char * ptr)
+  : x(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr)))
+  {
+  }
+
+  auto eq(const char c) const -> uint32_t
+  {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(c))));
+  }
+
+  /**
+   * @brief the bytes in [lo, hi]. the range is shifted to start at -128 so that a signed comparison
+   * can check it
+   */
+  auto in_range(const char lo, const char hi) const -> uint32_t
+  {
+    const auto shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(static_cast<char>(lo + 128)));
+    const auto limit = _mm256_set1_epi8(static_cast<char>(-128 + (hi - lo) + 1));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(limit, shifted)));
+  }
+
+  __m256i x;
+};
+#endif
+
+#if defined(__SSE2__)
+/**
+ * @brief the 16 bytes version of Avx2Chunk
+ */
+struct Sse2Chunk
+{
+  static constexpr size_t Width = 16;
+  static constexpr uint32_t All = 0xffff;
+
+  explicit Sse2Chunk(const char * ptr) : x(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr)))
+  {
+  }
+
+  auto eq(const char c) const -> uint32_t
+  {
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(c))));
+  }
+
+  auto in_range(const char lo, const char hi) const -> uint32_t
+  {
+    const auto shifted = _mm_sub_epi8(x, _mm_set1_epi8(static_cast<char>(lo + 128)));
+    const auto limit = _mm_set1_epi8(static_cast<char>(-128 + (hi - lo) + 1));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmplt_epi8(shifted, limit)));
+  }
+
+  __m128i x;
+};
+#endif
+
+/**
+ * @brief skip the whitespaces in [first, last) by chunks, and count the '\n' in them
+ * @return the first non-whitespace character, or the beginning of the remainder which is shorter
+ * than a chunk
+ */
+template <typename Chunk>
+auto skip_whitespace_by_chunk(const char * first, const char * last, size_t & newlines)
+  -> const char *
+{
+  for (; static_cast<size_t>(last - first) >= Chunk::Width; first += Chunk::Width) {
+    const Chunk chunk(first);
+    const auto newline = chunk.eq('\n');
+    const auto blank = chunk.eq(' ') | chunk.eq('\t') | chunk.eq('\r') | newline;
+    if (const auto stop = ~blank & Chunk::All; stop != 0) {
+      const auto n = static_cast<unsigned>(__builtin_ctz(stop));
+      newlines += static_cast<size_t>(__builtin_popcount(newline & ((1u << n) - 1)));
+      return first + n;
+    }
+    newlines += static_cast<size_t>(__builtin_popcount(newline));
+  }
+  return first;
+}
+
+/**
+ * @brief skip [a-zA-Z0-9_] in [first, last) by chunks
+ */
+template <typename Chunk>
+auto skip_identifier_by_chunk(const char * first, const char * last) -> const char *
+{
+  for (; static_cast<size_t>(last - first) >= Chunk::Width; first += Chunk::Width) {
+    const Chunk chunk(first);
+    const auto identifier = chunk.in_range('a', 'z') | chunk.in_range('A', 'Z') |
+                            chunk.in_range('0', '9') | chunk.eq('_');
+    if (const auto stop = ~identifier & Chunk::All; stop != 0) {
+      return first + __builtin_ctz(stop);
+    }
+  }
+  return first;
+}
+
+auto find_non_whitespace(const char * first, const char * last, size_t & newlines) -> const char *
+{
+#if defined(__AVX2__)
+  first = skip_whitespace_by_chunk<Avx2Chunk>(first, last, newlines);
+#endif
+#if defined(__SSE2__)
+  first = skip_whitespace_by_chunk<Sse2Chunk>(first, last, newlines);
+#endif
+  for (; first != last and is_whitespace(*first); ++first) {
+    newlines += (*first == '\n');
+  }
+  return first;
+}
+
+auto find_non_identifier(const char * first, const char * last) -> const char *
+{
+#if defined(__AVX2__)
+  first = skip_identifier_by_chunk<Avx2Chunk>(first, last);
+#endif
+#if defined(__SSE2__)
+  first = skip_identifier_by_chunk<Sse2Chunk>(first, last);
+#endif
+  for (; first != last and is_identifier_char(*first); ++first) {
+  }
+  return first;
+}
+
+/**
+ * @brief find `c` in [first, last) with memchr, which is vectorized by the C library
+ * @return `last` if not found
+ */
+auto find_char(const char * first, const char * last, const char c) -> const char *
+{
+  const auto * found = std::memchr(first, c, static_cast<size_t>(last - first));
+  return found ? static_cast<const char *>(found) : last;
+}
+
+/**
+ * @brief a part of a source, which starts at `offset` on the line `line`
+ */
+struct Chunk
+{
+  size_t offset;
+  size_t line;
+};
+
+/**
+ * @brief split `source` into the chunks of about `chunk_size` bytes. each chunk starts right after
+ * a '\n' which is not in a string literal, so that no token spans two chunks. the '\n' in a
+ * comment is fine because it ends the comment. this is a far cheaper scan than tokenizing, as it
+ * only looks at '"', "//" and '\n'
+ */
+auto split_into_chunks(const std::string_view source, const size_t chunk_size)
+  -> std::vector<Chunk>
+{
+  std::vector<Chunk> chunks{Chunk{0, 1}};
+  const auto * const first = source.data();
+  const auto * const last = source.data() + source.size();
+  const auto * next_split = first + std::min(chunk_size, source.size());
+  size_t line = 1;
+  for (const auto * it = first; it != last;) {
+    switch (*it) {
+      case '"': {
+        const auto * end = find_char(it + 1, last, '"');
+        line += static_cast<size_t>(std::count(it + 1, end, '\n'));
+        // NOTE: the tokenizer fails at a non-terminated string, so it is the last chunk
+        it = (end == last) ? last : end + 1;
+        break;
+      }
+      case '/':
+        it = (it + 1 != last and it[1] == '/') ? find_char(it + 2, last, '\n') : it + 1;
+        break;
+      case '\n':
+        ++it;
+        ++line;
+        if (next_split <= it and it != last) {
+          chunks.push_back(Chunk{static_cast<size_t>(it - first), line});
+          next_split = it + std::min(chunk_size, static_cast<size_t>(last - it));
+        }
+        break;
+      default:
+        ++it;
+    }
+  }
+  return chunks;
+}
+
+}  // namespace
+
+Tokenizer::Tokenizer(const std::string_view source, const size_t first_line)
+: source_(source), line_(first_line), current_ctx_start_line_(first_line)
 {
-  const size_t end = get_next_newline_or_eof();
-  lines_.emplace_back(std::make_shared<Line>(std::nullopt, 1, current_cursor_, end));
-  assert(!lines_.empty());
 }
 
 auto Tokenizer::is_at_end() const noexcept -> bool
@@ -25,20 +319,43 @@ auto Tokenizer::is_at_end() const noexcept -> bool
 
 auto Tokenizer::take_tokens() -> std::variant<Tokens, SyntaxError>
 {
-  while (!is_at_end()) {
+  Tokens tokens;
+  for (;;) {
+    auto result = next_token();
+    if (is_variant_v<SyntaxError>(result)) {
+      return as_variant<SyntaxError>(result);
+    }
+    const auto & token = as_variant<std::optional<Token>>(result);
+    if (!token) {
+      return tokens;
+    }
+    tokens.push_back(token.value());
+  }
+}
+
+auto Tokenizer::next_token() -> std::variant<std::optional<Token>, SyntaxError>
+{
+  scanned_.reset();
+  // a comment is scanned without yielding a token
+  while (!scanned_) {
+    skip_whitespace();
+    if (is_at_end()) {
+      return std::optional<Token>{std::nullopt};
+    }
     current_ctx_start_cursor_ = current_cursor_;
+    current_ctx_start_line_ = line_;
     auto err_opt = scan_new_token();
     if (err_opt) {
       return err_opt.value();
     }
   }
-  return std::move(tokens_);
+  return scanned_;
 }
 
 auto Tokenizer::advance() noexcept -> std::optional<char>
 {
   if (!is_at_end()) {
-    auto c = source_.at(current_cursor_);
+    auto c = source_[current_cursor_];
     advance_cursor();
     return c;
   } else {
@@ -53,12 +370,15 @@ auto Tokenizer::add_token(const TokenType & token_type) -> void
   const auto len = (token_type == TokenType::String)
                      ? (current_cursor_ - current_ctx_start_cursor_ - 2)
                      : (current_cursor_ - current_ctx_start_cursor_);
-  const auto text = std::string_view(source_).substr(start, len);
-  if (token_type == TokenType::Identifier and is_keyword(text)) {
-    tokens_.emplace_back(keyword_map.find(text)->second, text, lines_.back(), start);
-    return;
+  const auto text = source_.substr(start, len);
+  // NOTE: a keyword consists of lowercase letters only
+  if (token_type == TokenType::Identifier and 'a' <= text[0]) {
+    if (const auto keyword = keyword_type(text); keyword) {
+      scanned_.emplace(keyword.value(), text, current_ctx_start_line_);
+      return;
+    }
   }
-  tokens_.emplace_back(token_type, text, lines_.back(), start);
+  scanned_.emplace(token_type, text, current_ctx_start_line_);
 }
 
 auto Tokenizer::scan_new_token() -> std::optional<SyntaxError>
@@ -69,104 +389,36 @@ auto Tokenizer::scan_new_token() -> std::optional<SyntaxError>
     return std::nullopt;        // LCOV_EXCL_LINE
   }
   const auto c = c_opt.value();
-  if (c == '(') {
-    add_token(TokenType::LeftParen);
-    return std::nullopt;
-  }
-  if (c == ')') {
-    add_token(TokenType::RightParen);
-    return std::nullopt;
-  }
-  if (c == '{') {
-    add_token(TokenType::LeftBrace);
-    return std::nullopt;
-  }
-  if (c == '}') {
-    add_token(TokenType::RightBrace);
-    return std::nullopt;
-  }
-  if (c == ',') {
-    add_token(TokenType::Comma);
-    return std::nullopt;
-  }
-  if (c == '.') {
-    add_token(TokenType::Dot);
-    return std::nullopt;
-  }
-  if (c == '-') {
-    add_token(TokenType::Minus);
-    return std::nullopt;
-  }
-  if (c == '+') {
-    add_token(TokenType::Plus);
-    return std::nullopt;
-  }
-  if (c == ';') {
-    add_token(TokenType::Semicolun);
-    return std::nullopt;
-  }
-  if (c == '/') {
-    if (match('/')) {
-      while (peek() != '\n'    // while the comment body ends
-             and !is_at_end()  // in case the source file ends with comment
-      ) {
-        advance();
-      }
-      advance();
+  switch (class_of(c)) {
+    case CharClass::Blank:
+      return std::nullopt;
+    case CharClass::Newline:
       handle_newline();
       return std::nullopt;
-    } else {
+    case CharClass::Single:
+      add_token(char_tokens[to_index(c)]);
+      return std::nullopt;
+    case CharClass::Slash:
+      if (match('/')) {
+        // the comment body ends before '\n', which is counted by skip_whitespace()
+        const auto * first = source_.data() + current_cursor_;
+        const auto * last = source_.data() + source_.size();
+        current_cursor_ += static_cast<size_t>(find_char(first, last, '\n') - first);
+        return std::nullopt;
+      }
       add_token(TokenType::Slash);
       return std::nullopt;
-    }
-  }
-  if (c == '*') {
-    add_token(TokenType::Star);
-    return std::nullopt;
-  }
-  if (c == '!') {
-    add_token(match('=') ? TokenType::BangEqual : TokenType::Bang);
-    return std::nullopt;
-  }
-  if (c == '=') {
-    add_token(match('=') ? TokenType::EqualEqual : TokenType::Equal);
-    return std::nullopt;
-  }
-  if (c == '>') {
-    add_token(match('=') ? TokenType::GreaterEqual : TokenType::Greater);
-    return std::nullopt;
-  }
-  if (c == '<') {
-    add_token(match('=') ? TokenType::LessEqual : TokenType::Less);
-    return std::nullopt;
-  }
-  if (c == ' ' or c == '\r' or c == '\t') {
-    return std::nullopt;
-  }
-  if (c == '\n') {
-    handle_newline();
-    return std::nullopt;
-  }
-  if (c == '"') {
-    auto err_opt = add_string_token();
-    if (err_opt) {
-      return std::move(err_opt.value());
-    }
-    return std::nullopt;
-  }
-  if (is_digit(c)) {
-    auto err_opt = add_number_token();
-    if (err_opt) {
-      return std::move(err_opt.value());
-    }
-    return std::nullopt;
-  }
-  if (is_alpha(c)) {
-    auto err_opt = add_identifier_token();
-    if (err_opt) {
-      return std::move(err_opt.value());
-    }
-    return std::nullopt;
+    case CharClass::Operator:
+      add_token(match('=') ? char_equal_tokens[to_index(c)] : char_tokens[to_index(c)]);
+      return std::nullopt;
+    case CharClass::Quote:
+      return add_string_token();
+    case CharClass::Digit:
+      return add_number_token();
+    case CharClass::Alpha:
+      return add_identifier_token();
+    case CharClass::Invalid:
+      break;
   }
   return create_error(SyntaxErrorKind::InvalidCharacterError);
 }
@@ -176,7 +428,7 @@ auto Tokenizer::match(const char expected) noexcept -> bool
   if (is_at_end()) {
     return false;
   }
-  if (source_.at(current_cursor_) != expected) {
+  if (source_[current_cursor_] != expected) {
     return false;
   }
   advance_cursor();
@@ -188,7 +440,7 @@ auto Tokenizer::peek() noexcept -> char
   if (is_at_end()) {
     return '\0';
   }
-  return source_.at(current_cursor_);
+  return source_[current_cursor_];
 }
 
 auto Tokenizer::peek_next() const noexcept -> char
@@ -196,17 +448,16 @@ auto Tokenizer::peek_next() const noexcept -> char
   if (current_cursor_ + 1 >= source_.size()) {
     return '\0';  // LCOV_EXCL_LINE
   }
-  return source_.at(current_cursor_ + 1);
+  return source_[current_cursor_ + 1];
 }
 
 auto Tokenizer::add_string_token() -> std::optional<SyntaxError>
 {
-  while (peek() != '"' and !is_at_end()) {
-    if (peek() == '\n') {
-      handle_newline();
-    }
-    advance();
-  }
+  const auto * first = source_.data() + current_cursor_;
+  const auto * last = source_.data() + source_.size();
+  const auto * quote = find_char(first, last, '"');
+  line_ += static_cast<size_t>(std::count(first, quote, '\n'));
+  current_cursor_ += static_cast<size_t>(quote - first);
   if (is_at_end()) {
     return create_error(SyntaxErrorKind::NonTerminatedStringError);
   } else {
@@ -218,78 +469,48 @@ auto Tokenizer::add_string_token() -> std::optional<SyntaxError>
 
 auto Tokenizer::add_number_token() -> std::optional<SyntaxError>
 {
-  auto is_convertible = [](const std::string_view & str) {
-    try {
-      [[maybe_unused]] const double d = boost::lexical_cast<double>(str);
-      return true;
-    } catch (...) {
-      return false;
-    }
-  };
-
-  while ((is_digit(peek()) or is_alpha(peek())) and !is_at_end()) {
-    advance();
-  }
-  if (is_at_end()) {
-    if (is_convertible(std::string_view(source_).substr(
-          current_ctx_start_cursor_, current_cursor_ - current_ctx_start_cursor_))) {
-      add_token(TokenType::Number);
-      return std::nullopt;
-    } else {
-      return create_error(SyntaxErrorKind::InvalidNumberError);
-    }
-  }
-  if (peek() == '.') {
+  skip_identifier();
+  if (!is_at_end() and peek() == '.') {
     if (!is_digit(peek_next())) {
       return create_error(SyntaxErrorKind::InvalidNumberError);
     }
     advance();  // consume '.'
-    while ((is_digit(peek()) or is_alpha(peek())) and !is_at_end()) {
-      advance();
-    }
-    if (is_at_end()) {
-      if (is_convertible(std::string_view(source_).substr(
-            current_ctx_start_cursor_, current_cursor_ - current_ctx_start_cursor_))) {
-        add_token(TokenType::Number);
-        return std::nullopt;
-      } else {
-        return create_error(SyntaxErrorKind::InvalidNumberError);
-      }
-    }
+    skip_identifier();
   }
 
-  if (is_convertible(std::string_view(source_).substr(
-        current_ctx_start_cursor_, current_cursor_ - current_ctx_start_cursor_))) {
-    add_token(TokenType::Number);
-    return std::nullopt;
-  } else {
+  const auto lexeme =
+    source_.substr(current_ctx_start_cursor_, current_cursor_ - current_ctx_start_cursor_);
+  if (!parse_number(lexeme)) {
     return create_error(SyntaxErrorKind::InvalidNumberError);
   }
+  add_token(TokenType::Number);
+  return std::nullopt;
 }
 
 auto Tokenizer::add_identifier_token() -> std::optional<SyntaxError>
 {
-  auto is_alpha_or_digit = [](const auto c) { return is_alpha(c) or is_digit(c); };
-  while (is_alpha_or_digit(peek()) and !is_at_end()) {
-    advance();
-  }
-  if (is_at_end()) {
-    add_token(TokenType::Identifier);
-    return std::nullopt;
-  }
+  skip_identifier();
   add_token(TokenType::Identifier);
   return std::nullopt;
 }
 
+auto Tokenizer::skip_whitespace() -> void
+{
+  const auto * first = source_.data() + current_cursor_;
+  const auto * last = source_.data() + source_.size();
+  current_cursor_ += static_cast<size_t>(find_non_whitespace(first, last, line_) - first);
+}
+
+auto Tokenizer::skip_identifier() -> void
+{
+  const auto * first = source_.data() + current_cursor_;
+  const auto * last = source_.data() + source_.size();
+  current_cursor_ += static_cast<size_t>(find_non_identifier(first, last) - first);
+}
+
 auto Tokenizer::handle_newline() -> void
 {
   line_++;
-  current_line_start_index_ = current_cursor_;
-  const auto line_end = get_next_newline_or_eof();
-  if (current_line_start_index_ < line_end) {
-    lines_.emplace_back(
-      std::make_shared<Line>(std::nullopt, line_, current_line_start_index_, line_end));
-  }
 }
 
 auto Tokenizer::advance_cursor() -> void
@@ -297,21 +518,130 @@ auto Tokenizer::advance_cursor() -> void
   current_cursor_++;
 }
 
-auto Tokenizer::get_next_newline_or_eof() const noexcept -> size_t
+auto Tokenizer::create_error(const SyntaxErrorKind kind) -> SyntaxError
 {
-  for (size_t i = current_cursor_; i < source_.size(); ++i) {
-    const auto c = source_.at(i);
-    if (c == '\n' || c == '\0' || c == std::char_traits<char>::eof()) {
-      return i;
+  return SyntaxError{
+    kind, current_ctx_start_line_,
+    source_.substr(current_ctx_start_cursor_, current_cursor_ - current_ctx_start_cursor_)};
+}  // LCOV_EXCL_LINE
+
+auto take_tokens_parallel(const std::string_view source, const size_t n_threads)
+  -> std::variant<Tokens, SyntaxError>
+{
+  // NOTE: a smaller chunk does not pay for starting a thread
+  static constexpr size_t MinChunkSize = 256 * 1024;
+  const size_t n_workers =
+    (n_threads > 0) ? n_threads : std::max(1u, std::thread::hardware_concurrency());
+  if (n_workers == 1 or source.size() < 2 * MinChunkSize) {
+    return Tokenizer(source).take_tokens();
+  }
+  // a few chunks per thread, so that a slow chunk does not keep the others waiting
+  const auto chunk_size = std::max(MinChunkSize, source.size() / (4 * n_workers));
+  const auto chunks = split_into_chunks(source, chunk_size);
+
+  std::vector<std::optional<std::variant<Tokens, SyntaxError>>> results(chunks.size());
+  std::atomic<size_t> next_chunk{0};
+  const auto work = [&]() {
+    for (auto i = next_chunk++; i < chunks.size(); i = next_chunk++) {
+      const auto end = (i + 1 < chunks.size()) ? chunks[i + 1].offset : source.size();
+      const auto part = source.substr(chunks[i].offset, end - chunks[i].offset);
+      results[i].emplace(Tokenizer(part, chunks[i].line).take_tokens());
     }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < std::min(n_workers, chunks.size()); ++i) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto & worker : workers) {
+    worker.join();
+  }
+
+  size_t n_tokens = 0;
+  for (const auto & result : results) {
+    if (is_variant_v<SyntaxError>(result.value())) {
+      // the first error on the source is the one which the sequential tokenizer finds
+      return as_variant<SyntaxError>(result.value());
+    }
+    n_tokens += as_variant<Tokens>(result.value()).size();
+  }
+  Tokens tokens;
+  tokens.reserve(n_tokens);
+  for (const auto & result : results) {
+    const auto & part = as_variant<Tokens>(result.value());
+    tokens.insert(tokens.end(), part.begin(), part.end());
   }
-  return source_.size() - 1;
+  return tokens;
 }
 
-auto Tokenizer::create_error(const SyntaxErrorKind kind) -> SyntaxError
+TokenStream::TokenStream(const std::string_view source, const size_t first_line)
+: tokenizer_(std::in_place, source, first_line)
 {
-  return SyntaxError{kind, lines_.back(), current_ctx_start_cursor_, current_cursor_};
-}  // LCOV_EXCL_LINE
+}
+
+TokenStream::TokenStream(Tokens tokens) : replayed_(std::move(tokens))
+{
+}
+
+auto TokenStream::peek(const size_t k) -> const Token &
+{
+  assert(k < Lookahead);
+  while (size_ <= k) {
+    ring_[(head_ + size_) & (Lookahead - 1)] = next();
+    size_++;
+  }
+  return ring_[(head_ + k) & (Lookahead - 1)];
+}
+
+auto TokenStream::advance() -> Token
+{
+  const auto token = peek();
+  if (token.type != TokenType::Eof) {
+    head_ = (head_ + 1) & (Lookahead - 1);
+    size_--;
+  }
+  return token;
+}
+
+auto TokenStream::drain() -> const std::optional<SyntaxError> &
+{
+  while (!eof_) {
+    next();
+  }
+  return error_;
+}
+
+auto TokenStream::next() -> Token
+{
+  if (eof_) {
+    return eof_.value();
+  }
+  if (tokenizer_) {
+    auto result = tokenizer_->next_token();
+    if (is_variant_v<SyntaxError>(result)) {
+      error_.emplace(as_variant<SyntaxError>(result));
+    } else if (const auto & token = as_variant<std::optional<Token>>(result); token) {
+      last_ = token;
+      return token.value();
+    }
+  } else if (replayed_index_ < replayed_.size()) {
+    const auto & token = replayed_[replayed_index_++];
+    if (token.type != TokenType::Eof) {
+      last_ = token;
+      return token;
+    }
+    eof_ = token;
+    return token;
+  }
+  if (!last_) {
+    eof_.emplace(TokenType::Eof, "<EOF>", 1);
+  } else {
+    // EOF is placed right after the last token so that it has a valid position on the source
+    const auto & last = last_->lexeme;
+    eof_.emplace(TokenType::Eof, std::string_view(last.data() + last.size(), 0), last_->line);
+  }
+  return eof_.value();
+}
 
 }  // namespace tokenizer
 }  // namespace lox
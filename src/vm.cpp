@@ -0,0 +1,462 @@
+#include <cpplox/resolver.hpp>
+#include <cpplox/vm.hpp>
+
+#include <functional>
+#include <iostream>
+
+namespace lox
+{
+
+namespace vm
+{
+
+namespace
+{
+
+/**
+ * @brief same as the tree-walking interpreter, int64_t is promoted to double if either is double
+ */
+template <template <typename> class F>
+auto apply_binary_op_scalar(const Value & left, const Value & right) -> Value
+{
+  if (left.is_int() && right.is_int()) {
+    return static_cast<int64_t>(F<int64_t>()(left.as_int(), right.as_int()));
+  }
+  return static_cast<double>(F<double>()(left.to_double(), right.to_double()));
+}
+
+template <template <typename> class F>
+auto apply_binary_op_bool(const Value & left, const Value & right) -> Value
+{
+  if (left.is_int() && right.is_int()) {
+    return static_cast<bool>(F<int64_t>()(left.as_int(), right.as_int()));
+  }
+  return static_cast<bool>(F<double>()(left.to_double(), right.to_double()));
+}
+
+auto undefined_variable_error(const Site & site) -> RuntimeError
+{
+  if (std::holds_alternative<const Variable *>(site)) {
+    const auto & var = std::get<const Variable *>(site)->name;
+    return UndefinedVariableError{var, Literal{var.type, var.lexeme, var.line}};
+  }
+  const auto * assign = std::get<const Assign *>(site);
+  return UndefinedVariableError{assign->name, assign->expr};
+}
+
+auto max_loop_error(const Site & site) -> RuntimeError
+{
+  if (std::holds_alternative<const WhileStmt *>(site)) {
+    const auto * while_stmt = std::get<const WhileStmt *>(site);
+    return MaxLoopError{while_stmt->while_token, while_stmt->cond};
+  }
+  const auto * for_stmt = std::get<const ForStmt *>(site);
+  return MaxLoopError{for_stmt->for_token, for_stmt->cond};
+}
+
+auto type_error(const Site & site) -> RuntimeError
+{
+  if (std::holds_alternative<const Unary *>(site)) {
+    const auto * unary = std::get<const Unary *>(site);
+    return TypeError{unary->op, unary->expr};
+  }
+  const auto * binary = std::get<const Binary *>(site);
+  return TypeError{binary->op, Ref(binary)};
+}
+
+}  // namespace
+
+auto VM::execute(const Program & program) -> std::optional<RuntimeError>
+{
+  if (const auto resolve_opt = resolve_program(program, global_scope_); resolve_opt) {
+    return resolve_opt.value();
+  }
+  if (program.arena && (arenas_.empty() || arenas_.back() != program.arena)) {
+    arenas_.push_back(program.arena);
+  }
+  Compiler compiler(global_table_);
+  const auto function = compiler.compile(program);
+  globals_.resize(global_table_.names.size(), Nil{});
+  defined_.resize(global_table_.names.size(), false);
+  if (compiler.error()) {
+    return compiler.error().value();
+  }
+
+  auto script = make_object<Closure>(function);
+  frames_.push_back(CallFrame{script.as<Closure>(), function->chunk.code.data(), 0});
+  stack_.push_back(std::move(script));
+  return run();
+}
+
+auto VM::get_variable(const Token & token) const -> std::optional<Value>
+{
+  if (const auto global = global_table_.find(token.lexeme); global && defined_.at(global.value())) {
+    return globals_.at(global.value());
+  }
+  return std::nullopt;
+}
+
+auto VM::run() -> std::optional<RuntimeError>
+{
+  auto * frame = &frames_.back();
+  const auto * chunk = &frame->closure->function->chunk;
+  const auto * ip = frame->ip;
+
+  auto fail = [&](RuntimeError && error) -> std::optional<RuntimeError> {
+    reset();
+    return std::move(error);
+  };
+
+  auto reload_frame = [&]() {
+    frame = &frames_.back();
+    chunk = &frame->closure->function->chunk;
+    ip = frame->ip;
+  };
+
+  while (true) {
+    const auto op = static_cast<OpCode>(*ip++);
+    switch (op) {
+      case OpCode::Constant: {
+        stack_.push_back(chunk->constants[read_u32(ip)]);
+        ip += 4;
+        break;
+      }
+      case OpCode::Nil: {
+        stack_.emplace_back(Nil{});
+        break;
+      }
+      case OpCode::True: {
+        stack_.emplace_back(true);
+        break;
+      }
+      case OpCode::False: {
+        stack_.emplace_back(false);
+        break;
+      }
+      case OpCode::Pop: {
+        stack_.pop_back();
+        break;
+      }
+      case OpCode::GetLocal: {
+        const auto slot = read_u16(ip);
+        ip += 2;
+        stack_.push_back(stack_[frame->base + slot]);
+        break;
+      }
+      case OpCode::SetLocal: {
+        const auto slot = read_u16(ip);
+        ip += 2;
+        stack_[frame->base + slot] = stack_.back();
+        break;
+      }
+      case OpCode::GetUpvalue: {
+        const auto & upvalue = *frame->closure->upvalues[read_u16(ip)];
+        ip += 2;
+        stack_.push_back(upvalue.is_open ? stack_[upvalue.slot] : upvalue.closed);
+        break;
+      }
+      case OpCode::SetUpvalue: {
+        auto & upvalue = *frame->closure->upvalues[read_u16(ip)];
+        ip += 2;
+        (upvalue.is_open ? stack_[upvalue.slot] : upvalue.closed) = stack_.back();
+        break;
+      }
+      case OpCode::DefineGlobal: {
+        const auto global = read_u32(ip);
+        ip += 4;
+        globals_[global] = std::move(stack_.back());
+        defined_[global] = true;
+        stack_.pop_back();
+        break;
+      }
+      case OpCode::GetGlobal: {
+        const auto global = read_u32(ip);
+        const auto site = read_u32(ip + 4);
+        ip += 8;
+        if (!defined_[global]) {
+          return fail(undefined_variable_error(chunk->sites[site]));
+        }
+        stack_.push_back(globals_[global]);
+        break;
+      }
+      case OpCode::SetGlobal: {
+        const auto global = read_u32(ip);
+        const auto site = read_u32(ip + 4);
+        ip += 8;
+        if (!defined_[global]) {
+          return fail(undefined_variable_error(chunk->sites[site]));
+        }
+        globals_[global] = stack_.back();
+        break;
+      }
+      case OpCode::Undefined: {
+        return fail(undefined_variable_error(chunk->sites[read_u32(ip)]));
+      }
+      case OpCode::GetProperty: {
+        const auto * property = std::get<const ReadProperty *>(chunk->sites[read_u32(ip)]);
+        ip += 4;
+        auto & base = stack_.back();
+        if (!base.is_object(ObjectKind::Instance)) {
+          return fail(NotInstanceError{property->base, property->prop});
+        }
+        const auto * instance = base.as<InstanceObject>();
+        if (const auto it = instance->fields.find(property->prop.lexeme);
+            it != instance->fields.end()) {
+          base = it->second;
+          break;
+        }
+        const auto & methods = instance->cls.as<ClassObject>()->methods;
+        if (const auto it = methods.find(property->prop.lexeme); it != methods.end()) {
+          base = it->second;
+          break;
+        }
+        return fail(InvalidAttributeError{*property});
+      }
+      case OpCode::SetProperty: {
+        const auto * property = std::get<const SetProperty *>(chunk->sites[read_u32(ip)]);
+        ip += 4;
+        auto & base = stack_[stack_.size() - 2];
+        if (!base.is_object(ObjectKind::Instance)) {
+          return fail(NotInstanceError{property->base, property->prop});
+        }
+        base.as<InstanceObject>()->fields[property->prop.lexeme] = stack_.back();
+        base = std::move(stack_.back());
+        stack_.pop_back();
+        break;
+      }
+      case OpCode::Equal:
+      case OpCode::NotEqual: {
+        const auto equal = is_equal(stack_[stack_.size() - 2], stack_.back());
+        stack_.pop_back();
+        stack_.back() = (op == OpCode::Equal) ? equal : !equal;
+        break;
+      }
+      case OpCode::Greater:
+      case OpCode::GreaterEqual:
+      case OpCode::Less:
+      case OpCode::LessEqual:
+      case OpCode::Subtract:
+      case OpCode::Multiply:
+      case OpCode::Divide: {
+        const auto site = read_u32(ip);
+        ip += 4;
+        auto & left = stack_[stack_.size() - 2];
+        const auto & right = stack_.back();
+        if (!left.is_numeric() || !right.is_numeric()) {
+          return fail(type_error(chunk->sites[site]));
+        }
+        if (op == OpCode::Greater) {
+          left = apply_binary_op_bool<std::greater>(left, right);
+        } else if (op == OpCode::GreaterEqual) {
+          left = apply_binary_op_bool<std::greater_equal>(left, right);
+        } else if (op == OpCode::Less) {
+          left = apply_binary_op_bool<std::less>(left, right);
+        } else if (op == OpCode::LessEqual) {
+          left = apply_binary_op_bool<std::less_equal>(left, right);
+        } else if (op == OpCode::Subtract) {
+          left = apply_binary_op_scalar<std::minus>(left, right);
+        } else if (op == OpCode::Multiply) {
+          left = apply_binary_op_scalar<std::multiplies>(left, right);
+        } else {
+          // TODO(soblin): ZeroDivisionError
+          left = apply_binary_op_scalar<std::divides>(left, right);
+        }
+        stack_.pop_back();
+        break;
+      }
+      case OpCode::Add: {
+        const auto site = read_u32(ip);
+        ip += 4;
+        auto & left = stack_[stack_.size() - 2];
+        const auto & right = stack_.back();
+        if (left.is_numeric() && right.is_numeric()) {
+          left = apply_binary_op_scalar<std::plus>(left, right);
+        } else if (left.is_object(ObjectKind::String) && right.is_object(ObjectKind::String)) {
+          left = make_object<StringObject>(
+            left.as<StringObject>()->value + right.as<StringObject>()->value);
+        } else {
+          return fail(type_error(chunk->sites[site]));
+        }
+        stack_.pop_back();
+        break;
+      }
+      case OpCode::Not: {
+        stack_.back() = !is_truthy(stack_.back());
+        break;
+      }
+      case OpCode::Negate: {
+        const auto site = read_u32(ip);
+        ip += 4;
+        auto & value = stack_.back();
+        // NOTE: the tree-walking interpreter yields double for the negation of int64_t too
+        if (value.is_numeric()) {
+          value = -1.0 * value.to_double();
+        } else {
+          return fail(type_error(chunk->sites[site]));
+        }
+        break;
+      }
+      case OpCode::Truthy: {
+        stack_.back() = is_truthy(stack_.back());
+        break;
+      }
+      case OpCode::Print: {
+        std::cout << stringify(stack_.back()) << '\n';
+        stack_.pop_back();
+        break;
+      }
+      case OpCode::Jump: {
+        const auto offset = read_u32(ip);
+        ip += 4 + offset;
+        break;
+      }
+      case OpCode::JumpIfFalse: {
+        const auto offset = read_u32(ip);
+        ip += 4;
+        if (!is_truthy(stack_.back())) {
+          ip += offset;
+        }
+        stack_.pop_back();
+        break;
+      }
+      case OpCode::JumpIfTrue: {
+        const auto offset = read_u32(ip);
+        ip += 4;
+        if (is_truthy(stack_.back())) {
+          ip += offset;
+        }
+        stack_.pop_back();
+        break;
+      }
+      case OpCode::Loop: {
+        const auto offset = read_u32(ip);
+        ip += 4;
+        ip -= offset;
+        break;
+      }
+      case OpCode::LoopGuard: {
+        const auto slot = read_u16(ip);
+        const auto site = read_u32(ip + 2);
+        ip += 6;
+        auto & counter = stack_[frame->base + slot];
+        counter = counter.as_int() + 1;
+        if (static_cast<size_t>(counter.as_int()) > MaxLoopError::Limit) {
+          return fail(max_loop_error(chunk->sites[site]));
+        }
+        break;
+      }
+      case OpCode::Call: {
+        const auto argc = *ip;
+        const auto * call = std::get<const Call *>(chunk->sites[read_u32(ip + 1)]);
+        ip += 5;
+        const auto callee_slot = stack_.size() - argc - 1;
+        const auto & callee = stack_[callee_slot];
+        if (callee.is_object(ObjectKind::Closure)) {
+          auto * closure = callee.as<Closure>();
+          if (closure->function->arity != argc) {
+            return fail(
+              NotInvocableError{call->callee, "parameter and argument size do not match"});
+          }
+          if (frames_.size() >= max_call_depth) {
+            return fail(NotInvocableError{call->callee, "maximum recursion depth exceeded"});
+          }
+          frame->ip = ip;
+          const auto * code = closure->function->chunk.code.data();
+          frames_.push_back(CallFrame{closure, code, callee_slot});
+          reload_frame();
+          break;
+        }
+        if (callee.is_object(ObjectKind::Class)) {
+          auto instance = make_object<InstanceObject>(callee);
+          stack_.resize(callee_slot);
+          stack_.push_back(std::move(instance));
+          break;
+        }
+        return fail(NotInvocableError{call->callee, "operand is not callable"});
+      }
+      case OpCode::Closure: {
+        const auto & function = chunk->functions[read_u32(ip)];
+        ip += 4;
+        auto value = make_object<Closure>(function);
+        auto * closure = value.as<Closure>();
+        closure->upvalues.reserve(function->upvalue_count);
+        for (size_t i = 0; i < function->upvalue_count; ++i) {
+          const auto is_local = ip[0] == 1;
+          const auto index = read_u16(ip + 1);
+          ip += 3;
+          closure->upvalues.push_back(
+            is_local ? capture_upvalue(frame->base + index) : frame->closure->upvalues[index]);
+        }
+        stack_.push_back(std::move(value));
+        break;
+      }
+      case OpCode::CloseUpvalue: {
+        close_upvalues(stack_.size() - 1);
+        stack_.pop_back();
+        break;
+      }
+      case OpCode::Class: {
+        const auto & proto = chunk->classes[read_u32(ip)];
+        ip += 4;
+        auto cls = make_object<ClassObject>(proto.declaration);
+        for (const auto & [name, index] : proto.methods) {
+          cls.as<ClassObject>()->methods.emplace(
+            name, make_object<Closure>(chunk->functions[index]));
+        }
+        stack_.push_back(std::move(cls));
+        break;
+      }
+      case OpCode::Return: {
+        auto result = std::move(stack_.back());
+        stack_.pop_back();
+        close_upvalues(frame->base);
+        stack_.resize(frame->base);
+        frames_.pop_back();
+        if (frames_.empty()) {
+          return std::nullopt;
+        }
+        stack_.push_back(std::move(result));
+        reload_frame();
+        break;
+      }
+      case OpCode::NoReturn: {
+        const auto * declaration = frame->closure->function->declaration;
+        return fail(NoReturnFromFunction{Callable{Ref(declaration), nullptr}});
+      }
+    }
+  }
+}
+
+auto VM::capture_upvalue(const size_t slot) -> std::shared_ptr<Upvalue>
+{
+  auto it = open_upvalues_.begin();
+  for (; it != open_upvalues_.end(); ++it) {
+    if ((*it)->slot == slot) {
+      return *it;
+    }
+    if ((*it)->slot > slot) {
+      break;
+    }
+  }
+  return *open_upvalues_.insert(it, std::make_shared<Upvalue>(Upvalue{slot}));
+}
+
+auto VM::close_upvalues(const size_t slot) -> void
+{
+  while (!open_upvalues_.empty() && open_upvalues_.back()->slot >= slot) {
+    auto & upvalue = *open_upvalues_.back();
+    upvalue.closed = std::move(stack_[upvalue.slot]);
+    upvalue.is_open = false;
+    open_upvalues_.pop_back();
+  }
+}
+
+auto VM::reset() -> void
+{
+  stack_.clear();
+  frames_.clear();
+  open_upvalues_.clear();
+}
+
+}  // namespace vm
+}  // namespace lox
@@ -59,7 +59,7 @@ void test_as(
   } else if (type_index == lox::helper::double_Index) {
     ASSERT_NO_FATAL_FAILURE(test_as_t<double>(value_opt, lox::as_variant<double>(test)));
   } else if (type_index == lox::helper::str_Index) {
-    ASSERT_NO_FATAL_FAILURE(test_as_t<std::string>(value_opt, lox::as_variant<std::string>(test)));
+    ASSERT_NO_FATAL_FAILURE(test_as_t<lox::String>(value_opt, lox::as_variant<lox::String>(test)));
   }
 }
 
@@ -187,7 +187,7 @@ INSTANTIATE_TEST_SUITE_P(
      * String
      */
     TestExprValueParam{
-      R"("abc" + "def" + "ghi")", lox::helper::str_Index, std::string("abcdefghi")}));
+      R"("abc" + "def" + "ghi")", lox::helper::str_Index, lox::String("abcdefghi")}));
 
 int main(int argc, char ** argv)
 {
@@ -63,8 +63,8 @@ a = foo.a;
 
   const auto a_opt = interpreter.get_variable(tokens[1]);
   EXPECT_EQ(a_opt.has_value(), true);
-  EXPECT_EQ(lox::is_variant_v<std::string>(a_opt.value()), true);
-  EXPECT_EQ(lox::as_variant<std::string>(a_opt.value()), "Hello World!");
+  EXPECT_EQ(lox::is_variant_v<lox::String>(a_opt.value()), true);
+  EXPECT_EQ(lox::as_variant<lox::String>(a_opt.value()), "Hello World!");
 }
 
 TEST(Class, check_method_without_this)
@@ -96,8 +96,8 @@ a = foo.bar("Hello World");
 
   const auto a_opt = interpreter.get_variable(tokens[1]);
   EXPECT_EQ(a_opt.has_value(), true);
-  EXPECT_EQ(lox::is_variant_v<std::string>(a_opt.value()), true);
-  EXPECT_EQ(lox::as_variant<std::string>(a_opt.value()), "Hello World from Foo::bar");
+  EXPECT_EQ(lox::is_variant_v<lox::String>(a_opt.value()), true);
+  EXPECT_EQ(lox::as_variant<lox::String>(a_opt.value()), "Hello World from Foo::bar");
 }
 
 int main(int argc, char ** argv)
@@ -0,0 +1,227 @@
+#include <cpplox/debug.hpp>
+#include <cpplox/interpreter.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/resolver.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace
+{
+auto parse(const std::string & source, const lox::ParseMode mode = lox::ParseMode::Eager)
+  -> lox::Program
+{
+  auto parser = lox::Parser(lox::TokenStream(source), mode);
+  auto result = parser.program();
+  EXPECT_TRUE(lox::is_variant_v<lox::Program>(result)) << source;
+  return lox::as_variant<lox::Program>(result);
+}
+
+auto get(const lox::Interpreter & interpreter, const std::string & name) -> lox::Value
+{
+  const auto value =
+    interpreter.get_variable(lox::Token(lox::TokenType::Identifier, std::string_view(name), 0));
+  EXPECT_TRUE(value.has_value()) << name;
+  return value.value_or(lox::Nil{});
+}
+
+/**
+ * @brief the values of `names` after running `source`, which has to succeed
+ */
+auto run(
+  const std::string & source, const std::vector<std::string> & names,
+  const lox::ParseMode mode = lox::ParseMode::Eager) -> std::vector<std::string>
+{
+  // NOTE: the heap is collected on every allocation so that the values in the frames and in the
+  // upvalues are checked to be traced
+  lox::Interpreter interpreter(1, 0);
+  const auto err = interpreter.execute(parse(source, mode));
+  EXPECT_FALSE(err.has_value()) << source;
+  std::vector<std::string> values;
+  for (const auto & name : names) {
+    values.push_back(lox::stringify(get(interpreter, name)));
+  }
+  return values;
+}
+}  // namespace
+
+TEST(EscapeAnalysis, annotation)
+{
+  const std::string source = R"(
+fun outer(a, b) {
+  var c = a + b;
+  {
+    var d = c * 2;
+    c = d;
+  }
+  {
+    var e = 1;
+    fun get() { return e; }
+  }
+  fun inner() { return b + c; }
+  return inner;
+}
+fun f(x) {
+  fun g() {
+    fun h() { return x; }
+    return h;
+  }
+  return g;
+}
+)";
+  const auto program = parse(source);
+  lox::Scope globals;
+  ASSERT_FALSE(lox::resolve_program(program, globals).has_value());
+  const auto & outer = boost::get<lox::Ref<lox::FuncDecl>>(program.declarations.at(0)).get();
+  EXPECT_FALSE(outer.on_stack);  // a global variable
+  EXPECT_EQ(outer.parameter_slots, (std::vector<size_t>{0, 1}));
+  EXPECT_TRUE(outer.upvalues.empty());
+
+  // all the local variables are in the frame, and only the blocks with a captured variable close
+  // their upvalues
+  const auto & declarations = outer.body.declarations;
+  const auto & c = boost::get<lox::VarDecl>(declarations.at(0));
+  EXPECT_TRUE(c.on_stack);
+  EXPECT_EQ(c.slot, 2);
+  const auto & block =
+    boost::get<lox::Ref<lox::Block>>(boost::get<lox::Stmt>(declarations.at(1))).get();
+  EXPECT_FALSE(block.captured_base.has_value());
+  EXPECT_EQ(boost::get<lox::VarDecl>(block.declarations.at(0)).slot, 3);
+  const auto & captured_block =
+    boost::get<lox::Ref<lox::Block>>(boost::get<lox::Stmt>(declarations.at(2))).get();
+  EXPECT_EQ(captured_block.captured_base, 3);
+
+  // `inner` reuses the slot of `d` and `e` after the blocks, and captures only `b` and `c`
+  const auto & inner = boost::get<lox::Ref<lox::FuncDecl>>(declarations.at(3)).get();
+  EXPECT_TRUE(inner.on_stack);
+  EXPECT_EQ(inner.slot, 3);
+  ASSERT_EQ(inner.upvalues.size(), 2);
+  EXPECT_EQ(inner.upvalues.at(0).index, 1);
+  EXPECT_TRUE(inner.upvalues.at(0).is_local);
+  EXPECT_EQ(inner.upvalues.at(1).index, 2);
+  EXPECT_TRUE(inner.upvalues.at(1).is_local);
+  EXPECT_EQ(outer.frame_size, 5);
+  EXPECT_EQ(inner.frame_size, 0);
+
+  // `x` is passed through the upvalue of `g` to `h`
+  const auto & f = boost::get<lox::Ref<lox::FuncDecl>>(program.declarations.at(1)).get();
+  const auto & g = boost::get<lox::Ref<lox::FuncDecl>>(f.body.declarations.at(0)).get();
+  const auto & h = boost::get<lox::Ref<lox::FuncDecl>>(g.body.declarations.at(0)).get();
+  ASSERT_EQ(g.upvalues.size(), 1);
+  EXPECT_EQ(g.upvalues.at(0).index, 0);
+  EXPECT_TRUE(g.upvalues.at(0).is_local);
+  ASSERT_EQ(h.upvalues.size(), 1);
+  EXPECT_EQ(h.upvalues.at(0).index, 0);
+  EXPECT_FALSE(h.upvalues.at(0).is_local);
+}
+
+TEST(EscapeAnalysis, closure)
+{
+  const std::string source = R"(
+fun make_counter(step) {
+  var count = 0;
+  var unused = step * 2;
+  fun counter() {
+    count = count + step;
+    return count;
+  }
+  return counter;
+}
+var counter = make_counter(3);
+counter();
+var a = counter();
+
+// the loop variable is shared by the closures of the iterations
+var b = 0;
+{
+  var fs = nil;
+  for (var i = 0; i < 3; i = i + 1) {
+    var j = i * 10;
+    fun f() { return i + j; }
+    if (i == 0) { fs = f; }
+  }
+  b = fs();
+}
+
+// a local function which calls itself is captured by itself
+var c = 0;
+{
+  fun fib(n) {
+    if (n < 2) { return n; }
+    return fib(n - 1) + fib(n - 2);
+  }
+  c = fib(10);
+}
+
+// the closures keep sharing the variable after its scope exits
+var add = nil;
+var get = nil;
+{
+  var shared = 1;
+  fun add_to(n) {
+    shared = shared + n;
+    return shared;
+  }
+  fun read() { return shared; }
+  add = add_to;
+  get = read;
+}
+add(10);
+var d = get();
+
+// the upvalue is passed through the functions between the owner and the closure
+fun f(x) {
+  fun g() {
+    fun h() {
+      x = x + 1;
+      return x;
+    }
+    return h;
+  }
+  return g;
+}
+var h = f(1)();
+h();
+var e = h();
+)";
+  const std::vector<std::string> names{"a", "b", "c", "d", "e"};
+  const std::vector<std::string> expected{"6", "3", "55", "11", "3"};
+  EXPECT_EQ(run(source, names), expected);
+  EXPECT_EQ(run(source, names, lox::ParseMode::Lazy), expected);
+}
+
+TEST(EscapeAnalysis, frame)
+{
+  const std::string source = R"(
+class Box {}
+fun sum(n) {
+  var total = 0;
+  for (var i = 0; i < n; i = i + 1) {
+    var box = Box();
+    box.value = i;
+    { var shadow = box.value; total = total + shadow; }
+    { var other = Box(); other.value = 0; total = total + other.value; }
+  }
+  return total;
+}
+var a = sum(10) + sum(5);
+
+// the sibling blocks share the slots of the frame
+var b = 0;
+{
+  { var x = 1; var y = 2; b = b + x + y; }
+  { var z; b = b + 10; if (z == nil) { b = b + 100; } }
+}
+)";
+  EXPECT_EQ(run(source, {"a", "b"}), (std::vector<std::string>{"55", "113"}));
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,266 @@
+#include <cpplox/debug.hpp>
+#include <cpplox/interpreter.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/resolver.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/vm.hpp>
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace
+{
+auto parse(const std::string & source, const lox::ParseMode mode) -> lox::Program
+{
+  auto parser = lox::Parser(lox::TokenStream(source), mode);
+  auto result = parser.program();
+  EXPECT_TRUE(lox::is_variant_v<lox::Program>(result)) << source;
+  return lox::as_variant<lox::Program>(result);
+}
+
+auto identifier(const std::string & name) -> lox::Token
+{
+  return lox::Token(lox::TokenType::Identifier, std::string_view(name), 0);
+}
+
+/**
+ * @brief the error kind and the values of `names` after running `program` on Engine
+ */
+template <typename Engine>
+auto run(const lox::Program & program, const std::vector<std::string> & names)
+  -> std::pair<std::optional<size_t>, std::vector<std::string>>
+{
+  Engine engine;
+  const auto err = engine.execute(program);
+  std::vector<std::string> values;
+  for (const auto & name : names) {
+    const auto value = engine.get_variable(identifier(name));
+    if (!value) {
+      values.push_back("<undefined>");
+    } else if constexpr (std::is_same_v<Engine, lox::vm::VM>) {
+      values.push_back(lox::vm::stringify(value.value()));
+    } else {
+      values.push_back(lox::stringify(value.value()));
+    }
+  }
+  return {err ? std::make_optional(err->index()) : std::nullopt, values};
+}
+
+/**
+ * @brief check that `source` runs the same whether the function bodies are parsed lazily or not
+ */
+void expect_same_as_eager(const std::string & source, const std::vector<std::string> & names)
+{
+  const auto eager = parse(source, lox::ParseMode::Eager);
+  const auto lazy = parse(source, lox::ParseMode::Lazy);
+  EXPECT_EQ(run<lox::Interpreter>(lazy, names), run<lox::Interpreter>(eager, names)) << source;
+
+  const auto lazy_for_vm = parse(source, lox::ParseMode::Lazy);
+  EXPECT_EQ(run<lox::vm::VM>(lazy_for_vm, names), run<lox::vm::VM>(eager, names)) << source;
+}
+}  // namespace
+
+TEST(LazyFunction, pre_parse)
+{
+  const std::string source = R"(
+var base = 10;
+fun add(a, b) {
+  if (a > b) { return a + b + base; }
+  return a - b;
+}
+)";
+  const auto program = parse(source, lox::ParseMode::Lazy);
+  ASSERT_EQ(program.declarations.size(), 2);
+  const auto & func_decl = boost::get<lox::Ref<lox::FuncDecl>>(program.declarations.at(1)).get();
+  EXPECT_EQ(func_decl.name.lexeme, "add");
+  EXPECT_EQ(func_decl.parameters.size(), 2);
+  EXPECT_TRUE(func_decl.body.declarations.empty());
+  ASSERT_NE(func_decl.lazy, nullptr);
+  EXPECT_EQ(func_decl.lazy->source.front(), '{');
+  EXPECT_EQ(func_decl.lazy->source.back(), '}');
+  EXPECT_EQ(func_decl.lazy->line, 3);
+  EXPECT_EQ(func_decl.lazy->names, (std::vector<std::string_view>{"a", "b", "base"}));
+
+  lox::Scope globals;
+  ASSERT_FALSE(lox::resolve_program(program, globals).has_value());
+  // only the global variable is found at the declaration, the parameters are not yet
+  ASSERT_EQ(func_decl.lazy->captures.size(), 1);
+  EXPECT_EQ(func_decl.lazy->captures.at("base").storage, lox::Storage::Global);
+
+  ASSERT_FALSE(lox::materialize_body(func_decl).has_value());
+  EXPECT_EQ(func_decl.lazy, nullptr);
+  EXPECT_EQ(func_decl.body.declarations.size(), 2);
+  EXPECT_EQ(func_decl.parameter_slots, (std::vector<size_t>{0, 1}));
+}
+
+TEST(LazyFunction, same_as_eager)
+{
+  // closures and recursion
+  expect_same_as_eager(
+    R"(
+fun fib(n) {
+  if (n < 2) { return n; }
+  return fib(n - 1) + fib(n - 2);
+}
+fun make_counter(step) {
+  var count = 0;
+  fun counter() {
+    count = count + step;
+    return count;
+  }
+  return counter;
+}
+var counter = make_counter(3);
+counter();
+var a = counter();
+var b = fib(15);
+)",
+    {"a", "b"});
+
+  // the variables declared after the function are not visible from it
+  expect_same_as_eager(
+    R"(
+fun f() { return g(); }
+fun g() { return 1; }
+var a = f();
+)",
+    {"a"});
+  expect_same_as_eager(
+    R"(
+var a = 0;
+{
+  var x = 1;
+  fun f() { return x + y; }
+  var y = 2;
+  a = f();
+}
+)",
+    {"a"});
+
+  // shadowing and nested blocks in the body
+  expect_same_as_eager(
+    R"(
+var x = "global";
+fun f(x) {
+  var result = x;
+  {
+    var x = "inner";
+    result = result + x;
+  }
+  for (var i = 0; i < 2; i = i + 1) {
+    result = result + x;
+  }
+  return result;
+}
+var a = f("param");
+)",
+    {"a", "x"});
+
+  // methods
+  expect_same_as_eager(
+    R"(
+var total = 0;
+class Acc {
+  fun add(n) {
+    total = total + n;
+    return total;
+  }
+}
+var acc = Acc();
+acc.add(2);
+var a = acc.add(5);
+)",
+    {"a", "total"});
+}
+
+TEST(LazyFunction, body_with_class)
+{
+  // a class in a body is declared as a global at the resolution, so the body is parsed eagerly
+  const std::string source = R"(
+fun f() {
+  class A {
+    fun g() { return 1; }
+  }
+  return A;
+}
+)";
+  const auto program = parse(source, lox::ParseMode::Lazy);
+  const auto & func_decl = boost::get<lox::Ref<lox::FuncDecl>>(program.declarations.at(0)).get();
+  EXPECT_EQ(func_decl.lazy, nullptr);
+  EXPECT_EQ(func_decl.body.declarations.size(), 2);
+
+  lox::Scope globals;
+  ASSERT_FALSE(lox::resolve_program(program, globals).has_value());
+  EXPECT_EQ(globals.count("A"), 1);
+}
+
+TEST(LazyFunction, syntax_error_on_call)
+{
+  const std::string source = R"(
+fun unused() { return 1 +; }
+fun broken(a) { var = a; }
+var a = 1;
+var b = broken(a);
+var c = 2;
+)";
+  // the eager parser rejects the program
+  {
+    auto parser = lox::Parser(lox::TokenStream(source));
+    EXPECT_TRUE(lox::is_variant_v<lox::SyntaxError>(parser.program()));
+  }
+  // the unbalanced braces are still an error of the pre-parse
+  {
+    auto parser = lox::Parser(lox::TokenStream("fun f() { { }"), lox::ParseMode::Lazy);
+    const auto result = parser.program();
+    ASSERT_TRUE(lox::is_variant_v<lox::SyntaxError>(result));
+    EXPECT_EQ(
+      lox::as_variant<lox::SyntaxError>(result).kind, lox::SyntaxErrorKind::UnmatchedBraceError);
+  }
+
+  const auto program = parse(source, lox::ParseMode::Lazy);
+  lox::Interpreter interpreter;
+  const auto err = interpreter.execute(program);
+  ASSERT_TRUE(err.has_value());
+  ASSERT_TRUE(lox::is_variant_v<lox::SyntaxError>(err.value()));
+  EXPECT_EQ(
+    lox::as_variant<lox::SyntaxError>(err.value()).kind,
+    lox::SyntaxErrorKind::MissingValidIdentifierDecl);
+  EXPECT_TRUE(interpreter.get_variable(identifier("a")).has_value());
+  EXPECT_FALSE(interpreter.get_variable(identifier("c")).has_value());
+
+  // the VM compiles every body before running
+  lox::vm::VM vm;
+  const auto vm_err = vm.execute(parse(source, lox::ParseMode::Lazy));
+  ASSERT_TRUE(vm_err.has_value());
+  EXPECT_TRUE(lox::is_variant_v<lox::SyntaxError>(vm_err.value()));
+  EXPECT_FALSE(vm.get_variable(identifier("a")).has_value());
+}
+
+TEST(LazyFunction, smaller_arena)
+{
+  std::string source;
+  for (size_t i = 0; i < 200; ++i) {
+    const auto name = "f" + std::to_string(i);
+    source += "fun " + name + "(a) { var s = 0; while (s < a) { s = s + " + std::to_string(i) +
+              "; } return s; }\n";
+  }
+  source += "var result = f7(100);\n";
+  const auto eager = parse(source, lox::ParseMode::Eager);
+  const auto lazy = parse(source, lox::ParseMode::Lazy);
+  EXPECT_LT(lazy.arena->reserved_bytes() * 2, eager.arena->reserved_bytes());
+
+  lox::Interpreter interpreter;
+  ASSERT_FALSE(interpreter.execute(lazy).has_value());
+  const auto result = interpreter.get_variable(identifier("result"));
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(lox::as_variant<int64_t>(result.value()), 105);
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,172 @@
+#include <cpplox/interpreter.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/tokenizer.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <string>
+
+static size_t allocation_count = 0;
+
+void * operator new(size_t size)
+{
+  allocation_count++;
+  if (void * ptr = std::malloc(size); ptr) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace
+{
+/**
+ * @brief replace every "$N" in `source` with `n`
+ */
+std::string with_count(std::string source, const size_t n)
+{
+  const auto count = std::to_string(n);
+  for (auto pos = source.find("$N"); pos != std::string::npos; pos = source.find("$N")) {
+    source.replace(pos, 2, count);
+  }
+  return source;
+}
+
+/**
+ * @brief the number of the heap allocations made while executing `source`, excluding the
+ * tokenizer, the parser, the resolver and the garbage collector
+ */
+size_t count_execute_allocations(const std::string & source)
+{
+  auto tokenizer = lox::Tokenizer(source);
+  const auto tokens = lox::as_variant<lox::Tokens>(tokenizer.take_tokens());
+  auto parser = lox::Parser(tokens);
+  const auto program = lox::as_variant<lox::Program>(parser.program());
+  // the heap is large enough not to collect, so that the collector does not allocate
+  constexpr size_t Unlimited = std::numeric_limits<size_t>::max() / 2;
+  lox::Interpreter interpreter(Unlimited, Unlimited);
+  EXPECT_FALSE(interpreter.resolve(program).has_value());
+  const auto start_count = allocation_count;
+  EXPECT_FALSE(interpreter.execute(program).has_value());
+  return allocation_count - start_count;
+}
+
+/**
+ * @brief the number of the heap allocations made by a single iteration of the loop in `source`.
+ * the loop is executed N and 2N times so that the cost of the setup is cancelled out
+ */
+size_t count_allocations_per_iteration(const std::string & source)
+{
+  constexpr size_t N = 100;
+  const auto once = count_execute_allocations(with_count(source, N));
+  const auto twice = count_execute_allocations(with_count(source, 2 * N));
+  EXPECT_EQ((twice - once) % N, 0);
+  return (twice - once) / N;
+}
+
+/**
+ * @brief `n` statements which neither declare variables nor allocate values
+ */
+std::string repeat_body(const size_t n)
+{
+  std::string body;
+  for (size_t i = 0; i < n; ++i) {
+    body += "  x = x + i * 2 - (i - 1) / 3;\n";
+  }
+  return body;
+}
+}  // namespace
+
+/**
+ * the loop bodies are executed in place, and their variables are placed in the frame, so an
+ * iteration does not allocate regardless of the size of the body
+ */
+TEST(LoopAllocation, while_body_is_not_copied)
+{
+  const auto make_source = [](const size_t n) {
+    return "var x = 0;\nvar i = 0;\nwhile (i < $N) {\n" + repeat_body(n) + "  i = i + 1;\n}\n";
+  };
+  EXPECT_EQ(count_allocations_per_iteration(make_source(1)), 0);
+  EXPECT_EQ(count_allocations_per_iteration(make_source(100)), 0);
+}
+
+TEST(LoopAllocation, for_body_is_not_copied)
+{
+  const auto make_source = [](const size_t n) {
+    return "var x = 0;\nfor (var i = 0; i < $N; i = i + 1) {\n" + repeat_body(n) + "}\n";
+  };
+  EXPECT_EQ(count_allocations_per_iteration(make_source(1)), 0);
+  EXPECT_EQ(count_allocations_per_iteration(make_source(100)), 0);
+}
+
+TEST(LoopAllocation, branch_clause_declaration_is_not_copied)
+{
+  const auto make_source = [](const size_t n) {
+    std::string source = "var x = 0;\nfor (var i = 0; i < $N; i = i + 1) {\n";
+    for (size_t j = 0; j < n; ++j) {
+      source += "  if (var y = x + i * 2; y < 0) { x = 0; } else if (y < -1) { x = 1; }\n";
+    }
+    return source + "}\n";
+  };
+  // `y` is not captured, so it is placed in the frame and the if-block allocates nothing
+  const auto none = count_allocations_per_iteration(make_source(0));
+  const auto one = count_allocations_per_iteration(make_source(1));
+  EXPECT_EQ(one - none, 0);
+  EXPECT_EQ(count_allocations_per_iteration(make_source(100)) - none, 100 * (one - none));
+}
+
+TEST(LoopAllocation, closure_does_not_copy_the_body)
+{
+  const auto make_source = [](const size_t n) {
+    return "var x = 0;\nfor (var i = 0; i < $N; i = i + 1) {\n  fun f() {\n" + repeat_body(n) +
+           "  }\n}\n";
+  };
+  // the closure refers to the declaration in place, and only the list of its upvalue of `i` is
+  // allocated regardless of the size of the body
+  EXPECT_EQ(count_allocations_per_iteration(make_source(1)), 1);
+  EXPECT_EQ(count_allocations_per_iteration(make_source(100)), 1);
+}
+
+TEST(LoopAllocation, captured_variable_allocates_upvalue)
+{
+  const auto make_source = [](const size_t n) {
+    return "var x = 0;\nfor (var i = 0; i < $N; i = i + 1) {\n  var y = i;\n  fun f() {\n" +
+           repeat_body(n) + "    return y;\n  }\n}\n";
+  };
+  // the upvalue of `y` and the closure of `f` are placed in the nursery, and only the list of the
+  // upvalues of the closure is allocated
+  EXPECT_EQ(count_allocations_per_iteration(make_source(1)), 1);
+  EXPECT_EQ(count_allocations_per_iteration(make_source(100)), 1);
+}
+
+TEST(LoopAllocation, class_does_not_copy_the_methods)
+{
+  const auto make_source = [](const size_t n) {
+    std::string source = "var x = 0;\nclass A {\n";
+    for (size_t j = 0; j < 3; ++j) {
+      source += "  fun f" + std::to_string(j) + "(i) {\n" + repeat_body(n) + "  }\n";
+    }
+    return source + "}\n";
+  };
+  // the cost of defining a class depends on the number of the methods, but not on their bodies
+  EXPECT_EQ(
+    count_execute_allocations(make_source(1)), count_execute_allocations(make_source(100)));
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -66,7 +66,7 @@ void test_as(
   } else if (type_index == lox::helper::double_Index) {
     ASSERT_NO_FATAL_FAILURE(test_as_t<double>(value_opt, lox::as_variant<double>(test)));
   } else if (type_index == lox::helper::str_Index) {
-    ASSERT_NO_FATAL_FAILURE(test_as_t<std::string>(value_opt, lox::as_variant<std::string>(test)));
+    ASSERT_NO_FATAL_FAILURE(test_as_t<lox::String>(value_opt, lox::as_variant<lox::String>(test)));
   }
 }
 
@@ -344,7 +344,7 @@ b = (c == "before") and (c = "after") == "after";
        {
          11,                      //<! "c"
          lox::helper::str_Index,  //<! string
-         std::string("after"),    //<! test
+         lox::String("after"),    //<! test
        }}},                       //
     //
     TestStmtVariableSideEffectParam{
@@ -362,7 +362,7 @@ b = (c == "before") or (c = "after") == "after";
        {
          11,                      //<! "c"
          lox::helper::str_Index,  //<! string
-         std::string("before")    //<! test
+         lox::String("before")    //<! test
        }}},                       //
     //
     TestStmtVariableSideEffectParam{
@@ -380,7 +380,7 @@ b = (c == "before2") and (c = "after") == "after";
        {
          11,                      //<! "c"
          lox::helper::str_Index,  //<! string
-         std::string("before")    //<! test
+         lox::String("before")    //<! test
        }}},                       //
     //
     TestStmtVariableSideEffectParam{
@@ -398,7 +398,7 @@ b = (c == "before2") or (c = "after") == "after";
        {
          11,                      //<! "c"
          lox::helper::str_Index,  //<! string
-         std::string("after")     //<! test
+         lox::String("after")     //<! test
        }}},                       //
     //
     TestStmtVariableSideEffectParam{
@@ -917,8 +917,8 @@ TEST(Statement, if_statement)
     ASSERT_NO_FATAL_FAILURE(CheckParseProgramTest(source));
     const auto [program, _] = ParseProgramTest(source);
 
-    EXPECT_EQ(lox::is_variant_v<lox::Stmt>(program[0]), true);
-    const auto & stmt = lox::as_variant<lox::Stmt>(program[0]);
+    EXPECT_EQ(lox::is_variant_v<lox::Stmt>(program.declarations[0]), true);
+    const auto & stmt = lox::as_variant<lox::Stmt>(program.declarations[0]);
     EXPECT_EQ(lox::is_variant_v<lox::ExprStmt>(stmt), true);
     const auto & stmt1 = lox::as_variant<lox::ExprStmt>(stmt);
 
@@ -936,8 +936,8 @@ print (1 + 2) * ( 3 + 4);
     ASSERT_NO_FATAL_FAILURE(CheckParseProgramTest(source));
     const auto [program, _] = ParseProgramTest(source);
 
-    EXPECT_EQ(lox::is_variant_v<lox::Stmt>(program[0]), true);
-    const auto & stmt = lox::as_variant<lox::Stmt>(program[0]);
+    EXPECT_EQ(lox::is_variant_v<lox::Stmt>(program.declarations[0]), true);
+    const auto & stmt = lox::as_variant<lox::Stmt>(program.declarations[0]);
     EXPECT_EQ(lox::is_variant_v<lox::PrintStmt>(stmt), true);
     const auto & stmt1 = lox::as_variant<lox::PrintStmt>(stmt);
 
@@ -955,8 +955,8 @@ var a = (1 + 2) * ( 3 + 4);
     ASSERT_NO_FATAL_FAILURE(CheckParseProgramTest(source));
     const auto [program, _] = ParseProgramTest(source);
 
-    EXPECT_EQ(lox::is_variant_v<lox::VarDecl>(program[0]), true);
-    const auto & stmt1 = lox::as_variant<lox::VarDecl>(program[0]);
+    EXPECT_EQ(lox::is_variant_v<lox::VarDecl>(program.declarations[0]), true);
+    const auto & stmt1 = lox::as_variant<lox::VarDecl>(program.declarations[0]);
 
     auto interpreter = lox::Interpreter{};
     const auto & eval_opt = interpreter.evaluate_expr(stmt1.initializer.value());
@@ -0,0 +1,68 @@
+#include <cpplox/arena.hpp>
+#include <cpplox/debug.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace
+{
+struct Counted
+{
+  int & alive;
+  explicit Counted(int & alive) : alive(alive) { alive++; }
+  ~Counted() { alive--; }
+};
+}  // namespace
+
+TEST(Arena, make)
+{
+  int alive = 0;
+  {
+    lox::Arena arena;
+    for (int i = 0; i < 10000; ++i) {
+      const auto node = arena.make<Counted>(alive);
+      EXPECT_EQ(&node->alive, &alive);
+    }
+    const auto d = arena.make<double>(3.14);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&d.get()) % alignof(double), 0);
+    EXPECT_EQ(d.get(), 3.14);
+    EXPECT_EQ(alive, 10000);
+    // the nodes are packed into a few chunks
+    EXPECT_LT(arena.reserved_bytes(), 2 * 10000 * sizeof(Counted) + 16 * 1024);
+  }
+  EXPECT_EQ(alive, 0);
+}
+
+TEST(Arena, program_owns_nodes)
+{
+  const std::string source = R"(var a = (1 + 2) * -3;
+{
+  var b = a;
+})";
+  auto program = [&]() {
+    auto tokenizer = lox::Tokenizer(source);
+    const auto tokens = lox::as_variant<lox::Tokens>(tokenizer.take_tokens());
+    auto parser = lox::Parser(tokens);
+    return lox::as_variant<lox::Program>(parser.program());
+  }();
+  // the parser is destroyed, but the nodes are kept by the program
+  ASSERT_EQ(program.declarations.size(), 2);
+  EXPECT_EQ(program.arena.use_count(), 1);
+  const auto & var_decl = lox::as_variant<lox::VarDecl>(program.declarations[0]);
+  EXPECT_EQ(lox::to_lisp_repr(var_decl.initializer.value()), "(* (group (+ 1 2)) (- 3))");
+  const auto & block = lox::as_variant<lox::Block>(
+    lox::as_variant<lox::Stmt>(program.declarations[1]));
+  EXPECT_EQ(block.declarations.size(), 1);
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
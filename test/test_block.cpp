@@ -43,69 +43,69 @@ var c = "global c";
   EXPECT_EQ(lox::is_variant_v<lox::Program>(parse_result), true);
   const auto & program = lox::as_variant<lox::Program>(parse_result);
 
-  EXPECT_EQ(program.size(), 4);
+  EXPECT_EQ(program.declarations.size(), 4);
 
   // final result
   lox::Interpreter interpreter{};
   [[maybe_unused]] const auto exec = interpreter.execute(program);
   const auto a_opt = interpreter.get_variable(tokens[1]);
   EXPECT_EQ(a_opt.has_value(), true);
-  EXPECT_EQ(lox::is_variant_v<std::string>(a_opt.value()), true);
-  EXPECT_EQ(lox::as_variant<std::string>(a_opt.value()), "global a");
+  EXPECT_EQ(lox::is_variant_v<lox::String>(a_opt.value()), true);
+  EXPECT_EQ(lox::as_variant<lox::String>(a_opt.value()), "global a");
   const auto b_opt = interpreter.get_variable(tokens[6]);
   EXPECT_EQ(b_opt.has_value(), true);
-  EXPECT_EQ(lox::is_variant_v<std::string>(b_opt.value()), true);
-  EXPECT_EQ(lox::as_variant<std::string>(b_opt.value()), "global b");
+  EXPECT_EQ(lox::is_variant_v<lox::String>(b_opt.value()), true);
+  EXPECT_EQ(lox::as_variant<lox::String>(b_opt.value()), "global b");
   const auto c_opt = interpreter.get_variable(tokens[11]);
   EXPECT_EQ(c_opt.has_value(), true);
-  EXPECT_EQ(lox::is_variant_v<std::string>(c_opt.value()), true);
-  EXPECT_EQ(lox::as_variant<std::string>(c_opt.value()), "global c");
+  EXPECT_EQ(lox::is_variant_v<lox::String>(c_opt.value()), true);
+  EXPECT_EQ(lox::as_variant<lox::String>(c_opt.value()), "global c");
 
   // first block
   {
     lox::Interpreter interpreter_first;
-    const auto & first_block_decl = program[3];
+    const auto & first_block_decl = program.declarations[3];
     EXPECT_EQ(lox::is_variant_v<lox::Stmt>(first_block_decl), true);
     const auto & first_block_stmt = lox::as_variant<lox::Stmt>(first_block_decl);
     EXPECT_EQ(lox::is_variant_v<lox::Block>(first_block_stmt), true);
     const auto & first_block = lox::as_variant<lox::Block>(first_block_stmt);
-    const auto & first_block_program = first_block.declarations;
-    EXPECT_EQ(first_block_program.size(), 5);
+    const auto first_block_program = lox::Program{first_block.declarations, program.arena};
+    EXPECT_EQ(first_block_program.declarations.size(), 5);
     [[maybe_unused]] const auto exec = interpreter_first.execute(first_block_program);
     const auto a_opt = interpreter_first.get_variable(tokens[1]);
     EXPECT_EQ(a_opt.has_value(), true);
-    EXPECT_EQ(lox::is_variant_v<std::string>(a_opt.value()), true);
-    EXPECT_EQ(lox::as_variant<std::string>(a_opt.value()), "inner1_a");
+    EXPECT_EQ(lox::is_variant_v<lox::String>(a_opt.value()), true);
+    EXPECT_EQ(lox::as_variant<lox::String>(a_opt.value()), "inner1_a");
     const auto b_opt = interpreter_first.get_variable(tokens[6]);
     EXPECT_EQ(b_opt.has_value(), true);
-    EXPECT_EQ(lox::is_variant_v<std::string>(b_opt.value()), true);
-    EXPECT_EQ(lox::as_variant<std::string>(b_opt.value()), "inner1_b");
+    EXPECT_EQ(lox::is_variant_v<lox::String>(b_opt.value()), true);
+    EXPECT_EQ(lox::as_variant<lox::String>(b_opt.value()), "inner1_b");
     const auto c_opt = interpreter_first.get_variable(tokens[11]);
     EXPECT_EQ(c_opt.has_value(), true);
-    EXPECT_EQ(lox::is_variant_v<std::string>(c_opt.value()), true);
-    EXPECT_EQ(lox::as_variant<std::string>(c_opt.value()), "inner1_c_after");
+    EXPECT_EQ(lox::is_variant_v<lox::String>(c_opt.value()), true);
+    EXPECT_EQ(lox::as_variant<lox::String>(c_opt.value()), "inner1_c_after");
     // second block
     {
       lox::Interpreter interpreter_second;
-      const auto & second_block_decl = first_block_program[3];
+      const auto & second_block_decl = first_block_program.declarations[3];
       EXPECT_EQ(lox::is_variant_v<lox::Stmt>(second_block_decl), true);
       const auto & second_block_stmt = lox::as_variant<lox::Stmt>(second_block_decl);
       EXPECT_EQ(lox::is_variant_v<lox::Block>(second_block_stmt), true);
       const auto & second_block = lox::as_variant<lox::Block>(second_block_stmt);
-      const auto & second_block_program = second_block.declarations;
+      const auto second_block_program = lox::Program{second_block.declarations, program.arena};
       [[maybe_unused]] const auto exec = interpreter_second.execute(second_block_program);
       const auto a_opt = interpreter_second.get_variable(tokens[1]);
       EXPECT_EQ(a_opt.has_value(), true);
-      EXPECT_EQ(lox::is_variant_v<std::string>(a_opt.value()), true);
-      EXPECT_EQ(lox::as_variant<std::string>(a_opt.value()), "inner2_a");
+      EXPECT_EQ(lox::is_variant_v<lox::String>(a_opt.value()), true);
+      EXPECT_EQ(lox::as_variant<lox::String>(a_opt.value()), "inner2_a");
       const auto b_opt = interpreter_second.get_variable(tokens[6]);
       EXPECT_EQ(b_opt.has_value(), true);
-      EXPECT_EQ(lox::is_variant_v<std::string>(b_opt.value()), true);
-      EXPECT_EQ(lox::as_variant<std::string>(b_opt.value()), "inner2_b");
+      EXPECT_EQ(lox::is_variant_v<lox::String>(b_opt.value()), true);
+      EXPECT_EQ(lox::as_variant<lox::String>(b_opt.value()), "inner2_b");
       const auto c_opt = interpreter_second.get_variable(tokens[11]);
       EXPECT_EQ(c_opt.has_value(), true);
-      EXPECT_EQ(lox::is_variant_v<std::string>(c_opt.value()), true);
-      EXPECT_EQ(lox::as_variant<std::string>(c_opt.value()), "inner2_c");
+      EXPECT_EQ(lox::is_variant_v<lox::String>(c_opt.value()), true);
+      EXPECT_EQ(lox::as_variant<lox::String>(c_opt.value()), "inner2_c");
     }
   }
 }
@@ -148,16 +148,16 @@ var c = "global c";
   [[maybe_unused]] const auto exec = interpreter.execute(program);
   const auto a_opt = interpreter.get_variable(tokens[1]);
   EXPECT_EQ(a_opt.has_value(), true);
-  EXPECT_EQ(lox::is_variant_v<std::string>(a_opt.value()), true);
-  EXPECT_EQ(lox::as_variant<std::string>(a_opt.value()), "global a");
+  EXPECT_EQ(lox::is_variant_v<lox::String>(a_opt.value()), true);
+  EXPECT_EQ(lox::as_variant<lox::String>(a_opt.value()), "global a");
   const auto b_opt = interpreter.get_variable(tokens[6]);
   EXPECT_EQ(b_opt.has_value(), true);
-  EXPECT_EQ(lox::is_variant_v<std::string>(b_opt.value()), true);
-  EXPECT_EQ(lox::as_variant<std::string>(b_opt.value()), "global b");
+  EXPECT_EQ(lox::is_variant_v<lox::String>(b_opt.value()), true);
+  EXPECT_EQ(lox::as_variant<lox::String>(b_opt.value()), "global b");
   const auto c_opt = interpreter.get_variable(tokens[11]);
   EXPECT_EQ(c_opt.has_value(), true);
-  EXPECT_EQ(lox::is_variant_v<std::string>(c_opt.value()), true);
-  EXPECT_EQ(lox::as_variant<std::string>(c_opt.value()), "inner2_c");
+  EXPECT_EQ(lox::is_variant_v<lox::String>(c_opt.value()), true);
+  EXPECT_EQ(lox::as_variant<lox::String>(c_opt.value()), "inner2_c");
 }
 
 TEST(Block, block_error)
@@ -243,6 +243,64 @@ var c = "global c";
   EXPECT_EQ(lox::is_variant_v<lox::UndefinedVariableError>(err_opt.value()), true);
 }
 
+TEST(Block, slot_resolution)
+{
+  const std::string source1 = R"(
+var a = 1;
+var b = 2;
+var a = 3;
+{
+   var b = a;
+   var c = b + 10;
+   {
+      var a = c;
+      b = a + b;
+   }
+   a = b;
+}
+)";
+  auto tokenizer = lox::Tokenizer(source1);
+  const auto result = tokenizer.take_tokens();
+  EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
+  const auto & tokens = lox::as_variant<lox::Tokens>(result);
+
+  auto parser = lox::Parser(tokens);
+  const auto parse_result = parser.program();
+  EXPECT_EQ(lox::is_variant_v<lox::Program>(parse_result), true);
+  const auto & program = lox::as_variant<lox::Program>(parse_result);
+
+  lox::Interpreter interpreter{};
+  const auto err_opt = interpreter.execute(program);
+  EXPECT_EQ(err_opt.has_value(), false);
+  // NOTE: the redeclared "a" reuses the slot of the first "a"
+  const auto a_opt = interpreter.get_variable(tokens[1]);
+  EXPECT_EQ(a_opt.has_value(), true);
+  EXPECT_EQ(lox::as_variant<int64_t>(a_opt.value()), 3 + (3 + 10));
+  const auto b_opt = interpreter.get_variable(tokens[6]);
+  EXPECT_EQ(b_opt.has_value(), true);
+  EXPECT_EQ(lox::as_variant<int64_t>(b_opt.value()), 2);
+
+  // the global variables are kept for the next program
+  const std::string source2 = R"(
+var d = a + b;
+)";
+  auto tokenizer2 = lox::Tokenizer(source2);
+  const auto result2 = tokenizer2.take_tokens();
+  EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result2), true);
+  const auto & tokens2 = lox::as_variant<lox::Tokens>(result2);
+
+  auto parser2 = lox::Parser(tokens2);
+  const auto parse_result2 = parser2.program();
+  EXPECT_EQ(lox::is_variant_v<lox::Program>(parse_result2), true);
+  const auto & program2 = lox::as_variant<lox::Program>(parse_result2);
+
+  const auto err_opt2 = interpreter.execute(program2);
+  EXPECT_EQ(err_opt2.has_value(), false);
+  const auto d_opt = interpreter.get_variable(tokens2[1]);
+  EXPECT_EQ(d_opt.has_value(), true);
+  EXPECT_EQ(lox::as_variant<int64_t>(d_opt.value()), 3 + (3 + 10) + 2);
+}
+
 int main(int argc, char ** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
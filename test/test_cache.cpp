@@ -0,0 +1,188 @@
+#include <cpplox/cache.hpp>
+#include <cpplox/debug.hpp>
+#include <cpplox/interpreter.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/resolver.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+
+namespace
+{
+const std::string source = R"(
+var count = 0;
+var name = "lox";
+fun fib(n) {
+  if (n < 2) {
+    return n;
+  }
+  return fib(n - 1) + fib(n - 2);
+}
+class Counter {
+  fun increment(step) {
+    count = count + step;
+    return count;
+  }
+}
+var counter = Counter();
+counter.total = 1.5;
+for (var i = 0; i < 10; i = i + 1) {
+  if (var half = i / 2; i == 3) {
+    count = count + half;
+  } else if (i == 8 or !(i < 9)) {
+    break;
+  } else {
+    counter.increment(1);
+  }
+}
+var j = nil;
+for (j = 0; j < 2;) {
+  j = j + 1;
+}
+while (false) {
+  print -count;
+  continue;
+}
+{
+  var local = fib(10) + counter.total;
+  print local;
+}
+var result = fib(10);
+)";
+
+/**
+ * @brief parse and resolve `source` as the cache is saved by the main program
+ */
+auto parse_and_resolve(
+  const std::string & source, const lox::ParseMode mode = lox::ParseMode::Eager) -> lox::Program
+{
+  auto parser = lox::Parser(lox::TokenStream(source), mode);
+  auto program = lox::as_variant<lox::Program>(parser.program());
+  lox::Scope globals;
+  EXPECT_FALSE(lox::resolve_program(program, globals).has_value());
+  program.resolved_globals = lox::to_global_slots(globals);
+  return program;
+}
+
+/**
+ * @brief dump the nodes of `program` with their annotations by the resolver
+ */
+auto dump(const lox::Program & program) -> std::string
+{
+  std::string result;
+  for (const auto & declaration : program.declarations) {
+    lox::PrintResolveDeclVisitor visitor(0);
+    boost::apply_visitor(visitor, declaration);
+    result += visitor.ss.str();
+  }
+  return result;
+}
+}  // namespace
+
+TEST(Cache, round_trip)
+{
+  const auto program = parse_and_resolve(source);
+  const auto data = lox::serialize_program(program, source, lox::ParseMode::Eager);
+  const auto loaded = lox::deserialize_program(data, source, lox::ParseMode::Eager);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(dump(loaded.value()), dump(program));
+  ASSERT_TRUE(loaded->resolved_globals.has_value());
+  EXPECT_EQ(loaded->resolved_globals->size(), program.resolved_globals->size());
+
+  // the tokens refer to the source rather than to the cache
+  const auto & var_decl = boost::get<lox::VarDecl>(loaded->declarations.front());
+  EXPECT_EQ(var_decl.name.lexeme, "count");
+  EXPECT_GE(var_decl.name.lexeme.data(), source.data());
+  EXPECT_LT(var_decl.name.lexeme.data(), source.data() + source.size());
+
+  // a program loaded from the cache runs as the parsed one
+  lox::Interpreter interpreter;
+  ASSERT_FALSE(interpreter.execute(loaded.value()).has_value());
+  const auto result = interpreter.get_variable(
+    lox::Token(lox::TokenType::Identifier, std::string_view("result"), 0));
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(lox::as_variant<int64_t>(result.value()), 55);
+  const auto count = interpreter.get_variable(
+    lox::Token(lox::TokenType::Identifier, std::string_view("count"), 0));
+  ASSERT_TRUE(count.has_value());
+  EXPECT_EQ(lox::as_variant<int64_t>(count.value()), 8);
+}
+
+TEST(Cache, reject_stale_cache)
+{
+  const auto program = parse_and_resolve(source);
+  const auto data = lox::serialize_program(program, source, lox::ParseMode::Eager);
+
+  // the source is edited
+  auto edited = source;
+  edited.back() = ' ';
+  EXPECT_FALSE(lox::deserialize_program(data, edited, lox::ParseMode::Eager).has_value());
+  EXPECT_FALSE(lox::deserialize_program(data, source + "\n", lox::ParseMode::Eager).has_value());
+
+  // the format is changed
+  auto old_version = data;
+  old_version[4] = static_cast<char>(lox::CacheVersion + 1);
+  EXPECT_FALSE(lox::deserialize_program(old_version, source, lox::ParseMode::Eager).has_value());
+
+  // the file is truncated or broken
+  for (const auto size : {size_t{0}, size_t{3}, data.size() / 2, data.size() - 1}) {
+    EXPECT_FALSE(
+      lox::deserialize_program(data.substr(0, size), source, lox::ParseMode::Eager).has_value());
+  }
+  auto broken = data;
+  broken[broken.size() - 5] ^= 0x40;
+  EXPECT_FALSE(lox::deserialize_program(broken, source, lox::ParseMode::Eager).has_value());
+}
+
+TEST(Cache, save_and_load)
+{
+  const auto program = parse_and_resolve(source);
+  const auto path = ::testing::TempDir() + "save_and_load.lox";
+  const auto cache_path = lox::cache_path_of(path, source, std::nullopt);
+  EXPECT_EQ(cache_path, path + "c");
+  EXPECT_FALSE(lox::load_cache(cache_path, source, lox::ParseMode::Eager).has_value());
+
+  ASSERT_TRUE(lox::save_cache(cache_path, program, source, lox::ParseMode::Eager));
+  const auto loaded = lox::load_cache(cache_path, source, lox::ParseMode::Eager);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(dump(loaded.value()), dump(program));
+  std::remove(cache_path.c_str());
+
+  // the caches in a directory are named by the content
+  const auto dir = ::testing::TempDir();
+  EXPECT_EQ(lox::cache_path_of(path, source, dir), lox::cache_path_of("other.lox", source, dir));
+  EXPECT_NE(lox::cache_path_of(path, source, dir), lox::cache_path_of(path, source + " ", dir));
+}
+
+TEST(Cache, reject_other_parse_mode)
+{
+  // the body of `broken` is only pre-parsed in the lazy mode, so its syntax error is not reported
+  const std::string lazy_source = R"(
+fun broken() { var = ; }
+var result = 1;
+)";
+  const auto program = parse_and_resolve(lazy_source, lox::ParseMode::Lazy);
+  const auto path = ::testing::TempDir() + "reject_other_parse_mode.lox";
+  const auto cache_path = lox::cache_path_of(path, lazy_source, std::nullopt);
+  ASSERT_TRUE(lox::save_cache(cache_path, program, lazy_source, lox::ParseMode::Lazy));
+
+  // the eager mode parses the source again and reports the error
+  EXPECT_FALSE(lox::load_cache(cache_path, lazy_source, lox::ParseMode::Eager).has_value());
+  auto parser = lox::Parser(lox::TokenStream(lazy_source));
+  EXPECT_TRUE(lox::is_variant_v<lox::SyntaxError>(parser.program()));
+
+  const auto loaded = lox::load_cache(cache_path, lazy_source, lox::ParseMode::Lazy);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(dump(loaded.value()), dump(program));
+  std::remove(cache_path.c_str());
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
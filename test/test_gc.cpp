@@ -0,0 +1,455 @@
+#include <cpplox/interpreter.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/tokenizer.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+
+// NOTE: the marker threads allocate as well
+static std::atomic<size_t> live_allocations{0};
+static std::atomic<size_t> peak_live_allocations{0};
+
+void * operator new(size_t size)
+{
+  const auto live = ++live_allocations;
+  for (auto peak = peak_live_allocations.load();
+       live > peak && !peak_live_allocations.compare_exchange_weak(peak, live);) {
+  }
+  if (void * ptr = std::malloc(size); ptr) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept
+{
+  if (ptr) {
+    live_allocations--;
+  }
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+  if (ptr) {
+    live_allocations--;
+  }
+  std::free(ptr);
+}
+
+namespace
+{
+constexpr size_t SmallHeap = 16 * 1024;
+
+auto parse(const std::string & source) -> lox::Program
+{
+  auto parser = lox::Parser(lox::TokenStream(source));
+  auto result = parser.program();
+  EXPECT_TRUE(lox::is_variant_v<lox::Program>(result)) << source;
+  return lox::as_variant<lox::Program>(result);
+}
+
+auto get(const lox::Interpreter & interpreter, const std::string & name) -> lox::Value
+{
+  const auto value =
+    interpreter.get_variable(lox::Token(lox::TokenType::Identifier, std::string_view(name), 0));
+  EXPECT_TRUE(value.has_value()) << name;
+  return value.value_or(lox::Nil{});
+}
+
+/**
+ * @brief each iteration makes a closure, which captures the parameter of its call, and an
+ * instance holding it. only the ones made before the loop are reachable at the end
+ */
+auto closures_in_loop(const size_t n) -> std::string
+{
+  return R"(
+fun make(n) {
+  fun get() { return n; }
+  return get;
+}
+class Box {
+  fun unwrap(box) { return box.value(); }
+}
+var kept = make(1);
+var box = Box();
+box.value = make(2);
+var sum = 0;
+for (var i = 0; i < )" +
+         std::to_string(n) + R"(; i = i + 1) {
+  var f = make(i);
+  var b = Box();
+  b.value = f;
+  sum = sum + b.unwrap(b);
+}
+var result = kept() + box.value();
+)";
+}
+
+struct Footprint
+{
+  size_t peak_live_allocations;
+  lox::HeapStats stats;
+};
+
+/**
+ * @brief the peak of the live allocations while executing `closures_in_loop(n)`
+ */
+auto run_closures_in_loop(const size_t n) -> Footprint
+{
+  const auto source = closures_in_loop(n);
+  const auto program = parse(source);
+  lox::Interpreter interpreter(SmallHeap);
+  const size_t start = live_allocations;
+  peak_live_allocations = start;
+  EXPECT_FALSE(interpreter.execute(program).has_value());
+  const auto peak = peak_live_allocations - start;
+
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "sum")), n * (n - 1) / 2);
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "result")), 3);
+  return {peak, interpreter.heap_stats()};
+}
+}  // namespace
+
+TEST(GC, closures_in_loop_stay_flat)
+{
+  constexpr size_t N = 2000;
+  const auto once = run_closures_in_loop(N);
+  const auto ten_times = run_closures_in_loop(10 * N);
+
+  // the garbage is released along the loop, so the footprint does not grow with the iterations
+  EXPECT_GT(once.stats.collections, 0);
+  EXPECT_GT(ten_times.stats.collections, 5 * once.stats.collections);
+  EXPECT_GT(ten_times.stats.allocated, 9 * once.stats.allocated);
+  EXPECT_LE(ten_times.stats.peak_bytes, 2 * SmallHeap);
+  EXPECT_LE(ten_times.stats.objects, 2 * once.stats.objects + 10);
+  EXPECT_LE(ten_times.stats.chunks, once.stats.chunks);
+  EXPECT_LE(ten_times.peak_live_allocations, once.peak_live_allocations + 10);
+
+  // most of the objects die in the nursery
+  EXPECT_GT(ten_times.stats.minor_collections, 0);
+  EXPECT_LT(ten_times.stats.promoted * 10, ten_times.stats.allocated);
+}
+
+TEST(GC, nursery)
+{
+  lox::Heap heap(1024 * 1024, 1024);
+  auto * old_env = heap.make<lox::Environment>();
+  const lox::Heap::Root root(heap, old_env);
+  EXPECT_TRUE(old_env->young);
+  heap.collect_minor();
+  EXPECT_FALSE(old_env->young);
+  EXPECT_EQ(heap.stats().promoted, 1);
+
+  // the young objects which are not reachable are released by the next minor collection
+  for (size_t i = 0; i < 100; ++i) {
+    heap.make<lox::Environment>();
+  }
+  EXPECT_GT(heap.stats().minor_collections, 1);
+  heap.collect_minor();
+  EXPECT_EQ(heap.stats().objects, 1);
+  EXPECT_EQ(heap.stats().promoted, 1);
+  EXPECT_EQ(heap.stats().young_bytes, 0);
+  EXPECT_EQ(heap.stats().collections, heap.stats().minor_collections);
+
+  // the write barrier remembers the old environment which refers to a young object
+  auto * young = heap.make<lox::InstanceObject>(nullptr);
+  old_env->define(0, lox::Instance(young), heap);
+  heap.collect_minor();
+  EXPECT_EQ(heap.stats().objects, 2);
+  EXPECT_FALSE(young->young);
+
+  // the old objects are released only by a major collection
+  old_env->define(0, lox::Nil{}, heap);
+  heap.collect_minor();
+  EXPECT_EQ(heap.stats().objects, 2);
+  heap.collect();
+  EXPECT_EQ(heap.stats().objects, 1);
+}
+
+TEST(GC, write_barrier)
+{
+  // `holder` and the global environment are promoted soon, and the young closures are written to
+  // them across the minor collections
+  lox::Interpreter interpreter(SmallHeap);
+  const std::string source = R"(
+fun make(n) {
+  fun get() { return n; }
+  return get;
+}
+class Node {}
+var holder = Node();
+var g = nil;
+var sum = 0;
+for (var i = 0; i < 1000; i = i + 1) {
+  holder.f = make(i);
+  g = make(i + 1);
+  var garbage = make(0);
+  garbage = Node();
+  sum = sum + holder.f() + g();
+}
+)";
+  ASSERT_FALSE(interpreter.execute(parse(source)).has_value());
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "sum")), 1000 * 1000);
+  EXPECT_GT(interpreter.heap_stats().minor_collections, 10);
+}
+
+TEST(GC, release_unreachable_cycle)
+{
+  lox::Interpreter interpreter(SmallHeap);
+  const std::string source = R"(
+class Node {}
+var root = Node();
+{
+  // the closure and the upvalue of the variable holding it refer to each other
+  fun loop() { return loop; }
+  var a = Node();
+  var b = Node();
+  a.next = b;
+  b.next = a;
+  a.f = loop;
+  root.child = Node();
+}
+)";
+  ASSERT_FALSE(interpreter.execute(parse(source)).has_value());
+  const auto before = interpreter.heap_stats();
+  interpreter.collect_garbage();
+  const auto after = interpreter.heap_stats();
+
+  // the closure of `loop`, its upvalue, `a` and `b` are released, and the global env, Node, root
+  // and its child are not
+  EXPECT_EQ(after.collections, before.collections + 1);
+  EXPECT_EQ(before.objects - after.objects, 4);
+  EXPECT_EQ(after.objects, 4);
+  EXPECT_EQ(after.freed, after.allocated - after.objects);
+
+  const auto root = get(interpreter, "root");
+  ASSERT_TRUE(lox::is_variant_v<lox::Instance>(root));
+  const auto & fields = lox::as_variant<lox::Instance>(root)->fields;
+  ASSERT_EQ(fields.count("child"), 1);
+  EXPECT_TRUE(lox::is_variant_v<lox::Instance>(fields.at("child")));
+}
+
+TEST(GC, collect_during_evaluation)
+{
+  // the heap collects as soon as it holds a few objects, so the temporaries have to be rooted
+  lox::Interpreter interpreter(1);
+  const std::string source = R"(
+fun make(n) {
+  fun get() { return n; }
+  return get;
+}
+fun add(f, g) { return f() + g(); }
+class Pair {
+  fun sum(pair) { return pair.first() + pair.second(); }
+}
+var p = Pair();
+p.first = make(1);
+p.second = make(2);
+var a = add(make(10), make(20)) + make(30)() + p.sum(p);
+)";
+  ASSERT_FALSE(interpreter.execute(parse(source)).has_value());
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "a")), 63);
+  EXPECT_GT(interpreter.heap_stats().collections, 3);
+}
+
+TEST(GC, closure_retains_only_captured_variables)
+{
+  lox::Interpreter interpreter(SmallHeap);
+  const std::string source = R"(
+class Big {}
+fun make() {
+  var a = Big();
+  var b = Big();
+  var c = Big();
+  var count = 0;
+  fun counter() {
+    count = count + 1;
+    return count;
+  }
+  return counter;
+}
+var counter = make();
+counter();
+var result = counter();
+)";
+  ASSERT_FALSE(interpreter.execute(parse(source)).has_value());
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "result")), 2);
+  interpreter.collect_garbage();
+
+  // the other variables of the call are released with their instances, and only the global env,
+  // Big, the closure and the upvalue of `count` remain
+  EXPECT_EQ(interpreter.heap_stats().objects, 4);
+  const auto counter = get(interpreter, "counter");
+  ASSERT_TRUE(lox::is_variant_v<lox::Callable>(counter));
+  const auto * closure = lox::as_variant<lox::Callable>(counter).closure;
+  ASSERT_NE(closure, nullptr);
+  ASSERT_EQ(closure->upvalues.size(), 1);
+  EXPECT_FALSE(closure->upvalues.at(0)->is_open);
+  EXPECT_EQ(lox::as_variant<int64_t>(closure->upvalues.at(0)->closed), 2);
+}
+
+namespace
+{
+/**
+ * @brief assign the field of `instance` through the write barrier as the interpreter does
+ */
+auto set_field(
+  lox::Heap & heap, lox::InstanceObject * instance, const std::string_view name,
+  const lox::Value & value) -> void
+{
+  auto & field = instance->fields[name];
+  heap.write_barrier(instance, &field, value);
+  field = value;
+}
+}  // namespace
+
+TEST(GC, parallel_marking)
+{
+  constexpr size_t N = 5000;
+  for (const size_t threads : {1, 2, 4}) {
+    lox::Heap heap(1024 * 1024 * 1024, 0);
+    heap.use_parallel_marking(threads);
+    auto * root_env = heap.make<lox::Environment>();
+    const lox::Heap::Root root(heap, root_env);
+    // a tree of the reachable instances and the same number of garbage referring to them
+    for (size_t i = 0; i < N; ++i) {
+      auto * parent = heap.make<lox::InstanceObject>(nullptr);
+      root_env->define(i, lox::Instance(parent), heap);
+      set_field(heap, parent, "child", lox::Instance(heap.make<lox::InstanceObject>(nullptr)));
+      set_field(heap, heap.make<lox::InstanceObject>(nullptr), "parent", lox::Instance(parent));
+      set_field(heap, heap.make<lox::InstanceObject>(nullptr), "parent", lox::Instance(parent));
+    }
+    ASSERT_GE(heap.stats().objects, lox::Heap::ParallelMarkThreshold);
+    heap.collect();
+    EXPECT_EQ(heap.stats().objects, 1 + 2 * N) << threads;
+    EXPECT_EQ(heap.stats().freed, 2 * N) << threads;
+
+    // all the marks are cleared for the next collection
+    root_env->define(N - 1, lox::Nil{}, heap);
+    heap.collect();
+    EXPECT_EQ(heap.stats().objects, 1 + 2 * (N - 1)) << threads;
+
+    // the markers are restarted only when their number changes
+    heap.use_parallel_marking(threads + 1);
+    root_env->define(N - 2, lox::Nil{}, heap);
+    heap.collect();
+    EXPECT_EQ(heap.stats().objects, 1 + 2 * (N - 2)) << threads;
+  }
+}
+
+TEST(GC, incremental_marking)
+{
+  constexpr size_t Depth = 4 * lox::Heap::MarkStepBudget;
+  lox::Heap heap(1024 * 1024 * 1024, 0);
+  heap.use_incremental_marking(true);
+  auto * root_env = heap.make<lox::Environment>();
+  const lox::Heap::Root root(heap, root_env);
+  // root_env -> chain[0] -> ... -> chain[Depth - 1] -> target
+  auto * chain = heap.make<lox::InstanceObject>(nullptr);
+  root_env->define(0, lox::Instance(chain), heap);
+  for (size_t i = 1; i < Depth; ++i) {
+    auto * next = heap.make<lox::InstanceObject>(nullptr);
+    set_field(heap, chain, "next", lox::Instance(next));
+    chain = next;
+  }
+  auto * target = heap.make<lox::InstanceObject>(nullptr);
+  set_field(heap, chain, "next", lox::Instance(target));
+  heap.make<lox::Environment>();  // garbage
+  EXPECT_EQ(heap.stats().objects, Depth + 3);
+
+  heap.collect_major();
+  EXPECT_EQ(heap.stats().collections, 0);
+  // the first slice traces root_env, and then `target` is moved to it before it is reached. the
+  // write barrier marks the overwritten reference, otherwise `target` is lost
+  heap.make<lox::Environment>();
+  EXPECT_EQ(heap.stats().mark_steps, 1);
+  root_env->define(1, lox::Instance(target), heap);
+  set_field(heap, chain, "next", lox::Nil{});
+  while (heap.stats().collections == 0) {
+    heap.make<lox::Environment>();
+  }
+  // the objects allocated while marking survive until the next collection
+  const auto steps = heap.stats().mark_steps;
+  EXPECT_GE(steps, 4);
+  EXPECT_EQ(heap.stats().objects, Depth + 2 + steps);
+
+  heap.collect();
+  EXPECT_EQ(heap.stats().objects, Depth + 2);
+  EXPECT_EQ(heap.pauses().size(), steps + 2);
+  EXPECT_EQ(heap.stats().pauses, steps + 2);
+}
+
+TEST(GC, pause_window)
+{
+  lox::Heap heap(SmallHeap);
+  const size_t collections = lox::Heap::PauseWindow + 100;
+  for (size_t i = 0; i < collections; ++i) {
+    heap.collect_minor();
+  }
+  // all the pauses are counted, but only the recent ones are kept for the percentiles
+  EXPECT_EQ(heap.stats().pauses, collections);
+  EXPECT_EQ(heap.pauses().size(), lox::Heap::PauseWindow);
+  EXPECT_LE(heap.pause_percentile(50), heap.pause_percentile(99));
+  EXPECT_EQ(
+    heap.pause_percentile(100), *std::max_element(heap.pauses().begin(), heap.pauses().end()));
+}
+
+TEST(GC, incremental_and_parallel_interpreter)
+{
+  const std::string source = R"(
+fun make(n) {
+  fun get() { return n; }
+  return get;
+}
+class Node {}
+var head = nil;
+for (var i = 0; i < 3000; i = i + 1) {
+  var node = Node();
+  node.next = head;
+  node.value = make(i);
+  head = node;
+}
+var sum = 0;
+for (var j = 0; j < 20; j = j + 1) {
+  var node = head;
+  while (node != nil) {
+    var f = make(node.value());
+    node.value = f;
+    sum = sum + f();
+    node = node.next;
+  }
+}
+)";
+  for (const size_t nursery_size : {size_t(0), lox::Heap::DefaultNurserySize}) {
+    for (const bool incremental : {false, true}) {
+      lox::Interpreter interpreter(64 * 1024, nursery_size);
+      interpreter.heap().use_incremental_marking(incremental);
+      interpreter.heap().use_parallel_marking(4);
+      ASSERT_FALSE(interpreter.execute(parse(source)).has_value());
+      EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "sum")), 20 * 3000 * 2999 / 2);
+      const auto & stats = interpreter.heap_stats();
+      EXPECT_GT(stats.collections - stats.minor_collections, 0);
+      EXPECT_EQ(stats.mark_steps > 0, incremental);
+
+      const auto & heap = interpreter.heap();
+      EXPECT_FALSE(heap.pauses().empty());
+      EXPECT_LE(heap.pause_percentile(50), heap.pause_percentile(99));
+      EXPECT_LE(heap.pause_percentile(99), heap.pause_percentile(100));
+      EXPECT_EQ(
+        heap.pause_percentile(100), *std::max_element(heap.pauses().begin(), heap.pauses().end()));
+    }
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,130 @@
+#include <cpplox/debug.hpp>
+#include <cpplox/interpreter.hpp>
+#include <cpplox/optimizer.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/resolver.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace
+{
+auto parse(const std::string & source, const lox::ParseMode mode = lox::ParseMode::Eager)
+  -> lox::Program
+{
+  auto parser = lox::Parser(lox::TokenStream(source), mode);
+  auto result = parser.program();
+  EXPECT_TRUE(lox::is_variant_v<lox::Program>(result)) << source;
+  return lox::as_variant<lox::Program>(result);
+}
+
+/**
+ * @brief the program after the resolution and the constant folding in lisp notation
+ */
+auto optimize(const std::string & source) -> std::string
+{
+  const auto program = parse(source);
+  lox::Scope globals;
+  EXPECT_FALSE(lox::resolve_program(program, globals).has_value()) << source;
+  lox::optimize_program(program);
+  return lox::to_lisp_repr(program);
+}
+
+auto get(const lox::Interpreter & interpreter, const std::string & name) -> lox::Value
+{
+  const auto value =
+    interpreter.get_variable(lox::Token(lox::TokenType::Identifier, std::string_view(name), 0));
+  EXPECT_TRUE(value.has_value()) << name;
+  return value.value_or(lox::Nil{});
+}
+}  // namespace
+
+TEST(Optimizer, fold_constant)
+{
+  EXPECT_EQ(optimize("var a = 1 + 2;"), "(var a 3)\n");
+  EXPECT_EQ(optimize("var a = (1 + 2) * -3 - 4 / 2;"), "(var a -11)\n");
+  EXPECT_EQ(optimize("var a = 1 + 0.5;"), "(var a 1.5)\n");
+  EXPECT_EQ(optimize("var a = 7 / 2;"), "(var a 3)\n");
+  EXPECT_EQ(optimize(R"(var a = "Hello" + " " + " World!";)"), "(var a Hello  World!)\n");
+  EXPECT_EQ(optimize("var a = !true;"), "(var a false)\n");
+  EXPECT_EQ(optimize("var a = !nil == (1 < 2);"), "(var a true)\n");
+  EXPECT_EQ(optimize("var a = 1 == 1.0 or 2 != 3;"), "(var a true)\n");
+
+  // only the constant subtrees are folded
+  EXPECT_EQ(optimize("var x = 1; var a = x * (2 + 3);"), "(var x 1)\n(var a (* x 5))\n");
+  EXPECT_EQ(optimize("var x = 1; var a = x + 2 + 3;"), "(var x 1)\n(var a (+ (+ x 2) 3))\n");
+  EXPECT_EQ(
+    optimize("fun f(a) { while (a < 2 * 5) { a = a + 1; } return -(-a); }"),
+    "(fun f (a) (block (while (< a 10) (block (= a (+ a 1)))) (return (- (group (- a))))))\n");
+
+  // `false and x` and `true or x` do not evaluate x
+  EXPECT_EQ(optimize("var x = 1; var a = false and x;"), "(var x 1)\n(var a false)\n");
+  EXPECT_EQ(optimize("var x = 1; var a = 1 < 2 or x;"), "(var x 1)\n(var a true)\n");
+  EXPECT_EQ(optimize("var x = 1; var a = true and x;"), "(var x 1)\n(var a (and truex))\n");
+}
+
+TEST(Optimizer, keep_runtime_error)
+{
+  // the errors are raised only if they are executed
+  EXPECT_EQ(optimize(R"(var a = 1 + "s";)"), "(var a (+ 1 s))\n");
+  EXPECT_EQ(optimize("var a = -nil;"), "(var a (- nil))\n");
+  EXPECT_EQ(optimize("var a = 1 / 0;"), "(var a (/ 1 0))\n");
+  EXPECT_EQ(optimize("var a = 1.0 / 0;"), "(var a inf)\n");
+
+  const std::string source = R"(
+var a = 0;
+if (false) { a = 1 / 0; }
+var b = 2 * (1 + "s");
+var c = 3;
+)";
+  lox::Interpreter interpreter;
+  const auto err = interpreter.execute(parse(source));
+  ASSERT_TRUE(err.has_value());
+  EXPECT_TRUE(lox::is_variant_v<lox::TypeError>(err.value()));
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "a")), 0);
+}
+
+TEST(Optimizer, execute)
+{
+  const std::string source = R"(
+var a = 1 + 2 * 3;
+var b = "lox" + "!";
+var c = 2.5 * 2;
+var d = 0;
+for (var i = 0; i < 2 + 3; i = i + 1) {
+  d = d + (10 - 8);
+}
+fun f(x) {
+  if (!false and 1 < 2) { return x * (3 - 1); }
+  return 0;
+}
+var e = f(2);
+)";
+  lox::Interpreter interpreter;
+  ASSERT_FALSE(interpreter.execute(parse(source)).has_value());
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "a")), 7);
+  EXPECT_EQ(lox::as_variant<lox::String>(get(interpreter, "b")), "lox!");
+  EXPECT_EQ(lox::as_variant<double>(get(interpreter, "c")), 5.0);
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "d")), 10);
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "e")), 4);
+}
+
+TEST(Optimizer, lazy_function)
+{
+  const std::string source = "fun f() { return 2 * 3; }\nvar a = f();";
+  const auto program = parse(source, lox::ParseMode::Lazy);
+  lox::Interpreter interpreter;
+  ASSERT_FALSE(interpreter.execute(program).has_value());
+  EXPECT_EQ(lox::as_variant<int64_t>(get(interpreter, "a")), 6);
+  // the body is folded when it is materialized on the first call
+  EXPECT_EQ(lox::to_lisp_repr(program), "(fun f () (block (return 6)))\n(var a f())\n");
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
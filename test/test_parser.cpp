@@ -5,6 +5,10 @@
 
 #include <gtest/gtest.h>
 
+#include <random>
+#include <string>
+#include <vector>
+
 void CheckParseTokensTest(const std::string & source)
 {
   auto tokenizer = lox::Tokenizer(source);
@@ -35,6 +39,29 @@ TEST(Tokenizer, parse_success_simple_expr)
   EXPECT_EQ(lox::to_lisp_repr(expr), "(* (- 123) (group 45.67))");
 }
 
+TEST(Parser, literal_constant)
+{
+  const std::string source = R"(f(123, 45.67, 1e3, "str", true, false, nil))";
+  const auto & tokens = ParseTokensTest(source);
+
+  auto parser = lox::Parser(tokens);
+  const auto parse_result = parser.expression();
+  ASSERT_EQ(lox::is_variant_v<lox::Expr>(parse_result), true);
+
+  const auto & call = lox::as_variant<lox::Call>(lox::as_variant<lox::Expr>(parse_result));
+  ASSERT_EQ(call.arguments.size(), 7);
+  auto constant = [&](const size_t i) {
+    return lox::as_variant<lox::Literal>(call.arguments[i]).constant;
+  };
+  EXPECT_EQ(std::get<int64_t>(constant(0)), 123);
+  EXPECT_EQ(std::get<double>(constant(1)), 45.67);
+  EXPECT_EQ(std::get<int64_t>(constant(2)), 1000);
+  EXPECT_EQ(std::get<lox::String>(constant(3)), "str");
+  EXPECT_EQ(std::get<bool>(constant(4)), true);
+  EXPECT_EQ(std::get<bool>(constant(5)), false);
+  EXPECT_EQ(std::holds_alternative<lox::Nil>(constant(6)), true);
+}
+
 using TestSyntaxErrorKindParamT = std::pair<const std::string, lox::SyntaxErrorKind>;
 
 class TestSyntaxErrorKindTokenizer : public ::testing::TestWithParam<TestSyntaxErrorKindParamT>
@@ -80,8 +107,8 @@ TEST(Tokenizer, parse_errors)
     EXPECT_EQ(lox::is_variant_v<lox::SyntaxError>(parse_result), true);
     const auto & err = lox::as_variant<lox::SyntaxError>(parse_result);
     EXPECT_EQ(err.kind, lox::SyntaxErrorKind::UnmatchedParenError);
-    EXPECT_EQ(err.line->number, 1);
-    EXPECT_EQ(err.get_lexical_column(), 8);
+    EXPECT_EQ(err.line, 1);
+    EXPECT_EQ(err.get_lexical_column(lox::LineTable(source)), 8);
   }
   {
     const std::string source = R"(123 * (123 * 456 + 789 -))";
@@ -100,6 +127,151 @@ TEST(Tokenizer, parse_errors)
   }
 }
 
+TEST(Parser, parse_token_stream)
+{
+  const std::string source = R"(
+var a = (1 + 2) * -3;
+fun f(x, y) { return x.y(a, "s") or !y; }
+class A { fun get() { return a; } }
+for (var i = 0; i < 10; i = i + 1) { if (i == 5) { break; } else { print i; } }
+)";
+  auto from_tokens = lox::Parser(ParseTokensTest(source));
+  auto from_stream = lox::Parser(lox::TokenStream(source));
+  const auto expected = from_tokens.program();
+  const auto result = from_stream.program();
+  ASSERT_TRUE(lox::is_variant_v<lox::Program>(expected));
+  ASSERT_TRUE(lox::is_variant_v<lox::Program>(result));
+  EXPECT_EQ(
+    lox::as_variant<lox::Program>(result).declarations.size(),
+    lox::as_variant<lox::Program>(expected).declarations.size());
+
+  const std::string expr = R"(a.b(1, -2)(3) * (4 + 5) / 6 == 7 or !nil and "s")";
+  // NOTE: the nodes are owned by the arena of the parser, so it is kept while they are used
+  auto expr_from_stream = lox::Parser(lox::TokenStream(expr));
+  auto expr_from_tokens = lox::Parser(ParseTokensTest(expr));
+  const auto expr_result = expr_from_stream.expression();
+  const auto expr_expected = expr_from_tokens.expression();
+  ASSERT_TRUE(lox::is_variant_v<lox::Expr>(expr_result));
+  ASSERT_TRUE(lox::is_variant_v<lox::Expr>(expr_expected));
+  EXPECT_EQ(
+    lox::to_lisp_repr(lox::as_variant<lox::Expr>(expr_result)),
+    lox::to_lisp_repr(lox::as_variant<lox::Expr>(expr_expected)));
+}
+
+TEST(Parser, token_stream_errors)
+{
+  {
+    // the error of the tokenizer comes first even if the parser fails before reaching it
+    const std::string source = "var a = ;\nvar b = \"abc;\n";
+    const auto result = lox::Parser(lox::TokenStream(source)).program();
+    ASSERT_TRUE(lox::is_variant_v<lox::SyntaxError>(result));
+    const auto & err = lox::as_variant<lox::SyntaxError>(result);
+    EXPECT_EQ(err.kind, lox::SyntaxErrorKind::NonTerminatedStringError);
+    EXPECT_EQ(err.line, 2);
+  }
+  {
+    // the error of the tokenizer after the valid declarations
+    const std::string source = "var a = 1;\nprint a;\n@";
+    const auto result = lox::Parser(lox::TokenStream(source)).program();
+    ASSERT_TRUE(lox::is_variant_v<lox::SyntaxError>(result));
+    const auto & err = lox::as_variant<lox::SyntaxError>(result);
+    EXPECT_EQ(err.kind, lox::SyntaxErrorKind::InvalidCharacterError);
+    EXPECT_EQ(err.line, 3);
+  }
+  {
+    // the syntax error at EOF is reported right after the last token
+    const std::string source = "fun f(a)\n\n";
+    const auto result = lox::Parser(lox::TokenStream(source)).program();
+    ASSERT_TRUE(lox::is_variant_v<lox::SyntaxError>(result));
+    const auto & err = lox::as_variant<lox::SyntaxError>(result);
+    EXPECT_EQ(err.kind, lox::SyntaxErrorKind::MissingFuncBodyDecl);
+    EXPECT_EQ(err.line, 1);
+    EXPECT_EQ(err.get_lexical_column(lox::LineTable(source)), 9);
+  }
+}
+
+namespace
+{
+/**
+ * @brief parse `source` as an expression by the precedence climbing or by the recursive descent,
+ * and return it in the lisp notation while the parser keeps the nodes
+ */
+auto parse_expression(const std::string & source, const bool recursive_descent)
+  -> std::variant<std::string, lox::SyntaxError>
+{
+  auto parser = lox::Parser(lox::TokenStream(source));
+  parser.use_recursive_descent(recursive_descent);
+  const auto result = parser.expression();
+  if (lox::is_variant_v<lox::SyntaxError>(result)) {
+    return lox::as_variant<lox::SyntaxError>(result);
+  }
+  return lox::to_lisp_repr(lox::as_variant<lox::Expr>(result));
+}
+
+/**
+ * @brief a random expression of `depth` with all the operators
+ */
+auto random_expression(std::mt19937 & rng, const size_t depth) -> std::string
+{
+  static const std::vector<std::string> binary_ops = {
+    " or ", " and ", " == ", " != ", " < ", " <= ", " > ", " >= ", " + ", " - ", " * ", " / "};
+  static const std::vector<std::string> operands = {"1", "2.5", "\"s\"", "nil", "true", "a",
+                                                    "a.b", "f()", "f(1, x)"};
+  if (depth == 0) {
+    return operands[rng() % operands.size()];
+  }
+  switch (rng() % 4) {
+    case 0:
+      return (rng() % 2 == 0 ? "-" : "!") + random_expression(rng, depth - 1);
+    case 1:
+      return "(" + random_expression(rng, depth - 1) + ")";
+    default:
+      return random_expression(rng, depth - 1) + binary_ops[rng() % binary_ops.size()] +
+             random_expression(rng, depth - 1);
+  }
+}
+}  // namespace
+
+TEST(Parser, precedence_climbing)
+{
+  std::vector<std::string> sources = {
+    "1",
+    "1 + 2 * 3 - 4 / 5",
+    "1 - 2 - 3 - 4",
+    "a or b or c and d and e",
+    "-a * !b == c < d + e or f",
+    "(1 + 2) * (3 - (4 / 5))",
+    "a.b(1, -2)(3).c * 4 >= 5 != !nil",
+    "a = b = c or d",
+    "a.b.c = 1 + 2 * 3",
+    "--1 - -1",
+  };
+  std::mt19937 rng(19);
+  for (size_t i = 0; i < 200; ++i) {
+    sources.push_back(random_expression(rng, 1 + i % 6));
+  }
+  for (const auto & source : sources) {
+    const auto expected = parse_expression(source, true);
+    const auto result = parse_expression(source, false);
+    ASSERT_TRUE(lox::is_variant_v<std::string>(expected)) << source;
+    ASSERT_TRUE(lox::is_variant_v<std::string>(result)) << source;
+    EXPECT_EQ(lox::as_variant<std::string>(result), lox::as_variant<std::string>(expected))
+      << source;
+  }
+
+  // the same error at the same token
+  for (const std::string source : {"1 + ", "1 * (2 + )", "a or and", "1 + 2 = 3", "-", "f(1,"}) {
+    const auto expected = parse_expression(source, true);
+    const auto result = parse_expression(source, false);
+    ASSERT_TRUE(lox::is_variant_v<lox::SyntaxError>(expected)) << source;
+    ASSERT_TRUE(lox::is_variant_v<lox::SyntaxError>(result)) << source;
+    const auto & expected_err = lox::as_variant<lox::SyntaxError>(expected);
+    const auto & err = lox::as_variant<lox::SyntaxError>(result);
+    EXPECT_EQ(err.kind, expected_err.kind) << source;
+    EXPECT_EQ(err.ctx.data(), expected_err.ctx.data()) << source;
+  }
+}
+
 int main(int argc, char ** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
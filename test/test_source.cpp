@@ -0,0 +1,108 @@
+#include <cpplox/parser.hpp>
+#include <cpplox/source.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/variant.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <utility>
+
+namespace
+{
+/**
+ * @brief a file under the temporary directory which is removed at the end of the scope
+ */
+class TemporaryFile
+{
+public:
+  TemporaryFile(const std::string & name, const std::string & content)
+  : path_(::testing::TempDir() + name)
+  {
+    std::ofstream ofs(path_, std::ios::binary);
+    ofs << content;
+  }
+
+  ~TemporaryFile() { std::remove(path_.c_str()); }
+
+  auto path() const -> const std::string & { return path_; }
+
+private:
+  std::string path_;
+};
+}  // namespace
+
+TEST(SourceBuffer, map_file)
+{
+  const std::string content = "var a = \"abc\";\nprint a;\n";
+  const auto file = TemporaryFile("map_file.lox", content);
+  const auto buffer = lox::SourceBuffer::open(file.path());
+  ASSERT_TRUE(buffer.has_value());
+  EXPECT_TRUE(buffer->is_mapped());
+  EXPECT_EQ(buffer->view(), content);
+}
+
+TEST(SourceBuffer, empty_file)
+{
+  const auto file = TemporaryFile("empty_file.lox", "");
+  const auto buffer = lox::SourceBuffer::open(file.path());
+  ASSERT_TRUE(buffer.has_value());
+  EXPECT_FALSE(buffer->is_mapped());
+  EXPECT_TRUE(buffer->view().empty());
+}
+
+TEST(SourceBuffer, missing_file)
+{
+  EXPECT_FALSE(lox::SourceBuffer::open(::testing::TempDir() + "no_such_file.lox").has_value());
+}
+
+TEST(SourceBuffer, move)
+{
+  {
+    // a short string is moved by copying its characters, and the view follows them
+    auto buffer = lox::SourceBuffer(std::string("print 1;"));
+    const auto moved = std::move(buffer);
+    EXPECT_FALSE(moved.is_mapped());
+    EXPECT_EQ(moved.view(), "print 1;");
+  }
+  {
+    const auto file = TemporaryFile("move.lox", "print 2;");
+    auto buffer = lox::SourceBuffer::open(file.path());
+    ASSERT_TRUE(buffer.has_value());
+    const auto data = buffer->view().data();
+    const auto moved = std::move(buffer.value());
+    EXPECT_TRUE(moved.is_mapped());
+    EXPECT_EQ(moved.view().data(), data);
+    EXPECT_FALSE(buffer->is_mapped());
+  }
+}
+
+TEST(SourceBuffer, tokens_refer_to_mapping)
+{
+  const auto file = TemporaryFile("tokens.lox", "fun f(x) { return x + \"s\"; }\nprint f(1);");
+  const auto buffer = lox::SourceBuffer::open(file.path());
+  ASSERT_TRUE(buffer.has_value());
+  const auto source = buffer->view();
+
+  const auto result = lox::Tokenizer(source).take_tokens();
+  ASSERT_TRUE(lox::is_variant_v<lox::Tokens>(result));
+  const auto & tokens = lox::as_variant<lox::Tokens>(result);
+  ASSERT_EQ(tokens.size(), 18);
+  for (const auto & token : tokens) {
+    EXPECT_GE(token.lexeme.data(), source.data());
+    EXPECT_LE(token.lexeme.data() + token.lexeme.size(), source.data() + source.size());
+  }
+
+  auto parser = lox::Parser(lox::TokenStream(source));
+  const auto program = parser.program();
+  ASSERT_TRUE(lox::is_variant_v<lox::Program>(program));
+  EXPECT_EQ(lox::as_variant<lox::Program>(program).declarations.size(), 2);
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
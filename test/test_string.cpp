@@ -0,0 +1,50 @@
+#include <cpplox/expression.hpp>
+#include <cpplox/string.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unordered_set>
+
+TEST(String, intern)
+{
+  const auto a1 = lox::String::intern("hello");
+  const auto a2 = lox::String::intern(std::string("hel") + "lo");
+  const auto b = lox::String::intern("world");
+  EXPECT_EQ(a1.is_interned(), true);
+  EXPECT_EQ(a1.str().data(), a2.str().data());
+  EXPECT_EQ(a1 == a2, true);
+  EXPECT_EQ(a1 == b, false);
+  EXPECT_EQ(a1.hash(), std::hash<std::string_view>()("hello"));
+}
+
+TEST(String, equality)
+{
+  const auto interned = lox::String::intern("hello world");
+  const auto concat = lox::String("hello ") + lox::String("world");
+  EXPECT_EQ(concat.is_interned(), false);
+  EXPECT_EQ(concat == interned, true);
+  EXPECT_EQ(concat, "hello world");
+  EXPECT_EQ(concat != lox::String("hello"), true);
+
+  std::unordered_set<lox::String> set{interned};
+  EXPECT_EQ(set.count(concat), 1);
+}
+
+TEST(String, value)
+{
+  const lox::Value value = lox::String::intern("foo");
+  const lox::Value copied = value;
+  EXPECT_EQ(lox::is_equal(value, copied), true);
+  EXPECT_EQ(lox::is_equal(value, lox::Value{lox::String("foo")}), true);
+  EXPECT_EQ(lox::is_equal(value, lox::Value{lox::String("bar")}), false);
+  EXPECT_EQ(
+    lox::as_variant<lox::String>(value).str().data(),
+    lox::as_variant<lox::String>(copied).str().data());
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -3,6 +3,11 @@
 
 #include <gtest/gtest.h>
 
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
 TEST(Tokenizer, is_at_end)
 {
   {
@@ -82,6 +87,7 @@ TEST(Tokenizer, scan_semicolun_comment)
 ;
 )";
   auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
   const auto result = tokenizer.take_tokens();
   EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
 
@@ -90,29 +96,30 @@ TEST(Tokenizer, scan_semicolun_comment)
 
   EXPECT_EQ(tokens[0].type, lox::TokenType::Plus);
   EXPECT_EQ(tokens[0].lexeme, "+");
-  EXPECT_EQ(tokens[0].line->number, 1);
-  EXPECT_EQ(tokens[0].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[0].line, 1);
+  EXPECT_EQ(tokens[0].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[1].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[1].lexeme, ";");
-  EXPECT_EQ(tokens[1].line->number, 1);
-  EXPECT_EQ(tokens[1].get_lexical_column(), 2);
+  EXPECT_EQ(tokens[1].line, 1);
+  EXPECT_EQ(tokens[1].get_lexical_column(lines), 2);
 
   EXPECT_EQ(tokens[2].type, lox::TokenType::Slash);
   EXPECT_EQ(tokens[2].lexeme, "/");
-  EXPECT_EQ(tokens[2].line->number, 3);
-  EXPECT_EQ(tokens[2].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[2].line, 3);
+  EXPECT_EQ(tokens[2].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[3].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[3].lexeme, ";");
-  EXPECT_EQ(tokens[3].line->number, 4);
-  EXPECT_EQ(tokens[3].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[3].line, 4);
+  EXPECT_EQ(tokens[3].get_lexical_column(lines), 1);
 }
 
 TEST(Tokenizer, scan_plus_minus_star_slash)
 {
   const std::string source = "+ - * /";
   auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
   const auto result = tokenizer.take_tokens();
   EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
 
@@ -121,29 +128,30 @@ TEST(Tokenizer, scan_plus_minus_star_slash)
 
   EXPECT_EQ(tokens[0].type, lox::TokenType::Plus);
   EXPECT_EQ(tokens[0].lexeme, "+");
-  EXPECT_EQ(tokens[0].line->number, 1);
-  EXPECT_EQ(tokens[0].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[0].line, 1);
+  EXPECT_EQ(tokens[0].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[1].type, lox::TokenType::Minus);
   EXPECT_EQ(tokens[1].lexeme, "-");
-  EXPECT_EQ(tokens[1].line->number, 1);
-  EXPECT_EQ(tokens[1].get_lexical_column(), 3);
+  EXPECT_EQ(tokens[1].line, 1);
+  EXPECT_EQ(tokens[1].get_lexical_column(lines), 3);
 
   EXPECT_EQ(tokens[2].type, lox::TokenType::Star);
   EXPECT_EQ(tokens[2].lexeme, "*");
-  EXPECT_EQ(tokens[2].line->number, 1);
-  EXPECT_EQ(tokens[2].get_lexical_column(), 5);
+  EXPECT_EQ(tokens[2].line, 1);
+  EXPECT_EQ(tokens[2].get_lexical_column(lines), 5);
 
   EXPECT_EQ(tokens[3].type, lox::TokenType::Slash);
   EXPECT_EQ(tokens[3].lexeme, "/");
-  EXPECT_EQ(tokens[3].line->number, 1);
-  EXPECT_EQ(tokens[3].get_lexical_column(), 7);
+  EXPECT_EQ(tokens[3].line, 1);
+  EXPECT_EQ(tokens[3].get_lexical_column(lines), 7);
 }
 
 TEST(Tokenizer, scan_compare)
 {
   const std::string source = "!, =, !=, ==, <, >, <=, >=";
   auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
   const auto result = tokenizer.take_tokens();
   EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
 
@@ -152,49 +160,50 @@ TEST(Tokenizer, scan_compare)
 
   EXPECT_EQ(tokens[0].type, lox::TokenType::Bang);
   EXPECT_EQ(tokens[0].lexeme, "!");
-  EXPECT_EQ(tokens[0].line->number, 1);
-  EXPECT_EQ(tokens[0].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[0].line, 1);
+  EXPECT_EQ(tokens[0].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[2].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[2].lexeme, "=");
-  EXPECT_EQ(tokens[2].line->number, 1);
-  EXPECT_EQ(tokens[2].get_lexical_column(), 4);
+  EXPECT_EQ(tokens[2].line, 1);
+  EXPECT_EQ(tokens[2].get_lexical_column(lines), 4);
 
   EXPECT_EQ(tokens[4].type, lox::TokenType::BangEqual);
   EXPECT_EQ(tokens[4].lexeme, "!=");
-  EXPECT_EQ(tokens[4].line->number, 1);
-  EXPECT_EQ(tokens[4].get_lexical_column(), 7);
+  EXPECT_EQ(tokens[4].line, 1);
+  EXPECT_EQ(tokens[4].get_lexical_column(lines), 7);
 
   EXPECT_EQ(tokens[6].type, lox::TokenType::EqualEqual);
   EXPECT_EQ(tokens[6].lexeme, "==");
-  EXPECT_EQ(tokens[6].line->number, 1);
-  EXPECT_EQ(tokens[6].get_lexical_column(), 11);
+  EXPECT_EQ(tokens[6].line, 1);
+  EXPECT_EQ(tokens[6].get_lexical_column(lines), 11);
 
   EXPECT_EQ(tokens[8].type, lox::TokenType::Less);
   EXPECT_EQ(tokens[8].lexeme, "<");
-  EXPECT_EQ(tokens[8].line->number, 1);
-  EXPECT_EQ(tokens[8].get_lexical_column(), 15);
+  EXPECT_EQ(tokens[8].line, 1);
+  EXPECT_EQ(tokens[8].get_lexical_column(lines), 15);
 
   EXPECT_EQ(tokens[10].type, lox::TokenType::Greater);
   EXPECT_EQ(tokens[10].lexeme, ">");
-  EXPECT_EQ(tokens[10].line->number, 1);
-  EXPECT_EQ(tokens[10].get_lexical_column(), 18);
+  EXPECT_EQ(tokens[10].line, 1);
+  EXPECT_EQ(tokens[10].get_lexical_column(lines), 18);
 
   EXPECT_EQ(tokens[12].type, lox::TokenType::LessEqual);
   EXPECT_EQ(tokens[12].lexeme, "<=");
-  EXPECT_EQ(tokens[12].line->number, 1);
-  EXPECT_EQ(tokens[12].get_lexical_column(), 21);
+  EXPECT_EQ(tokens[12].line, 1);
+  EXPECT_EQ(tokens[12].get_lexical_column(lines), 21);
 
   EXPECT_EQ(tokens[14].type, lox::TokenType::GreaterEqual);
   EXPECT_EQ(tokens[14].lexeme, ">=");
-  EXPECT_EQ(tokens[14].line->number, 1);
-  EXPECT_EQ(tokens[14].get_lexical_column(), 25);
+  EXPECT_EQ(tokens[14].line, 1);
+  EXPECT_EQ(tokens[14].get_lexical_column(lines), 25);
 }
 
 TEST(Tokenizer, scan_skip)
 {
   const std::string source = "+ - \r\t\n * /";
   auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
   const auto result = tokenizer.take_tokens();
   EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
 
@@ -203,23 +212,23 @@ TEST(Tokenizer, scan_skip)
 
   EXPECT_EQ(tokens[0].type, lox::TokenType::Plus);
   EXPECT_EQ(tokens[0].lexeme, "+");
-  EXPECT_EQ(tokens[0].line->number, 1);
-  EXPECT_EQ(tokens[0].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[0].line, 1);
+  EXPECT_EQ(tokens[0].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[1].type, lox::TokenType::Minus);
   EXPECT_EQ(tokens[1].lexeme, "-");
-  EXPECT_EQ(tokens[1].line->number, 1);
-  EXPECT_EQ(tokens[1].get_lexical_column(), 3);
+  EXPECT_EQ(tokens[1].line, 1);
+  EXPECT_EQ(tokens[1].get_lexical_column(lines), 3);
 
   EXPECT_EQ(tokens[2].type, lox::TokenType::Star);
   EXPECT_EQ(tokens[2].lexeme, "*");
-  EXPECT_EQ(tokens[2].line->number, 2);
-  EXPECT_EQ(tokens[2].get_lexical_column(), 2);
+  EXPECT_EQ(tokens[2].line, 2);
+  EXPECT_EQ(tokens[2].get_lexical_column(lines), 2);
 
   EXPECT_EQ(tokens[3].type, lox::TokenType::Slash);
   EXPECT_EQ(tokens[3].lexeme, "/");
-  EXPECT_EQ(tokens[3].line->number, 2);
-  EXPECT_EQ(tokens[3].get_lexical_column(), 4);
+  EXPECT_EQ(tokens[3].line, 2);
+  EXPECT_EQ(tokens[3].get_lexical_column(lines), 4);
 }
 
 TEST(Tokenizer, scan_string)
@@ -229,6 +238,7 @@ TEST(Tokenizer, scan_string)
 This is a very long comment 2.
 This is a very long comment 3.")";
   auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
   const auto result = tokenizer.take_tokens();
   EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
   const auto & tokens = lox::as_variant<lox::Tokens>(result);
@@ -236,31 +246,31 @@ This is a very long comment 3.")";
 
   EXPECT_EQ(tokens[0].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[0].lexeme, "=");
-  EXPECT_EQ(tokens[0].line->number, 1);
-  EXPECT_EQ(tokens[0].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[0].line, 1);
+  EXPECT_EQ(tokens[0].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[1].type, lox::TokenType::String);
   EXPECT_EQ(tokens[1].lexeme, R"(xyz)");
-  EXPECT_EQ(tokens[1].line->number, 1);
+  EXPECT_EQ(tokens[1].line, 1);
   // NOTE: for string, I decided to define the start position from the content
-  EXPECT_EQ(tokens[1].get_lexical_column(), 4);
+  EXPECT_EQ(tokens[1].get_lexical_column(lines), 4);
 
   EXPECT_EQ(tokens[2].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[2].lexeme, ";");
-  EXPECT_EQ(tokens[2].line->number, 1);
-  EXPECT_EQ(tokens[2].get_lexical_column(), 8);
+  EXPECT_EQ(tokens[2].line, 1);
+  EXPECT_EQ(tokens[2].get_lexical_column(lines), 8);
 
   EXPECT_EQ(tokens[3].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[3].lexeme, "=");
-  EXPECT_EQ(tokens[3].line->number, 2);
-  EXPECT_EQ(tokens[3].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[3].line, 2);
+  EXPECT_EQ(tokens[3].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[4].type, lox::TokenType::String);
   EXPECT_EQ(tokens[4].lexeme, R"(This is a very long comment 1.
 This is a very long comment 2.
 This is a very long comment 3.)");
   // TODO(soblin): handle error report for multiline expression
-  // EXPECT_EQ(tokens[4].line->number, 4);
+  // EXPECT_EQ(tokens[4].line, 4);
 }
 
 TEST(Tokenizer, scan_number)
@@ -269,6 +279,7 @@ TEST(Tokenizer, scan_number)
 = 123.456;
 = 0.123;)";
   auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
   const auto result = tokenizer.take_tokens();
   EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
 
@@ -277,31 +288,32 @@ TEST(Tokenizer, scan_number)
 
   EXPECT_EQ(tokens[1].type, lox::TokenType::Number);
   EXPECT_EQ(tokens[1].lexeme, "123");
-  EXPECT_EQ(tokens[1].line->number, 1);
-  EXPECT_EQ(tokens[1].get_lexical_column(), 3);
+  EXPECT_EQ(tokens[1].line, 1);
+  EXPECT_EQ(tokens[1].get_lexical_column(lines), 3);
 
   EXPECT_EQ(tokens[4].type, lox::TokenType::Number);
   EXPECT_EQ(tokens[4].lexeme, "123.456");
-  EXPECT_EQ(tokens[4].line->number, 2);
-  EXPECT_EQ(tokens[4].get_lexical_column(), 3);
+  EXPECT_EQ(tokens[4].line, 2);
+  EXPECT_EQ(tokens[4].get_lexical_column(lines), 3);
 
   EXPECT_EQ(tokens[7].type, lox::TokenType::Number);
   EXPECT_EQ(tokens[7].lexeme, "0.123");
-  EXPECT_EQ(tokens[7].line->number, 3);
-  EXPECT_EQ(tokens[7].get_lexical_column(), 3);
+  EXPECT_EQ(tokens[7].line, 3);
+  EXPECT_EQ(tokens[7].get_lexical_column(lines), 3);
 }
 
 TEST(Tokenizer, scan_invalid_number2)
 {
   const std::string source = R"(a = 12.a56;)";
   auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
   const auto result = tokenizer.take_tokens();
   EXPECT_EQ(lox::is_variant_v<lox::SyntaxError>(result), true);
 
   const auto & parse_error = lox::as_variant<lox::SyntaxError>(result);
   EXPECT_EQ(parse_error.kind, lox::SyntaxErrorKind::InvalidNumberError);
-  EXPECT_EQ(parse_error.line->number, 1);
-  EXPECT_EQ(parse_error.get_lexical_column(), 5 /* 1-start column number */);
+  EXPECT_EQ(parse_error.line, 1);
+  EXPECT_EQ(parse_error.get_lexical_column(lines), 5 /* 1-start column number */);
 }
 
 TEST(Tokenizer, scan_invalid_number1)
@@ -315,8 +327,8 @@ TEST(Tokenizer, scan_invalid_number1)
 
     const auto & parse_error = lox::as_variant<lox::SyntaxError>(result);
     EXPECT_EQ(parse_error.kind, lox::SyntaxErrorKind::InvalidNumberError);
-    EXPECT_EQ(parse_error.line->number, 2);
-    EXPECT_EQ(parse_error.get_lexical_column(), 5);
+    EXPECT_EQ(parse_error.line, 2);
+    EXPECT_EQ(parse_error.get_lexical_column(lox::LineTable(source)), 5);
   }
   {
     const std::string source = R"(= 123;
@@ -327,8 +339,8 @@ TEST(Tokenizer, scan_invalid_number1)
 
     const auto & parse_error = lox::as_variant<lox::SyntaxError>(result);
     EXPECT_EQ(parse_error.kind, lox::SyntaxErrorKind::InvalidNumberError);
-    EXPECT_EQ(parse_error.line->number, 2);
-    EXPECT_EQ(parse_error.get_lexical_column(), 5);
+    EXPECT_EQ(parse_error.line, 2);
+    EXPECT_EQ(parse_error.get_lexical_column(lox::LineTable(source)), 5);
   }
   {
     const std::string source = R"(= 123a)";
@@ -338,11 +350,24 @@ TEST(Tokenizer, scan_invalid_number1)
 
     const auto & parse_error = lox::as_variant<lox::SyntaxError>(result);
     EXPECT_EQ(parse_error.kind, lox::SyntaxErrorKind::InvalidNumberError);
-    EXPECT_EQ(parse_error.line->number, 1);
-    EXPECT_EQ(parse_error.get_lexical_column(), 3);
+    EXPECT_EQ(parse_error.line, 1);
+    EXPECT_EQ(parse_error.get_lexical_column(lox::LineTable(source)), 3);
   }
 }
 
+TEST(Tokenizer, parse_number)
+{
+  EXPECT_EQ(std::get<int64_t>(lox::parse_number("0").value()), 0);
+  EXPECT_EQ(std::get<int64_t>(lox::parse_number("9007199254740993").value()), 9007199254740993);
+  EXPECT_EQ(std::get<int64_t>(lox::parse_number("2e2").value()), 200);
+  EXPECT_EQ(std::get<double>(lox::parse_number("0.125").value()), 0.125);
+  EXPECT_EQ(std::get<double>(lox::parse_number("1.5e1").value()), 15.0);
+  EXPECT_EQ(lox::parse_number("12a").has_value(), false);
+  EXPECT_EQ(lox::parse_number("1.2.3").has_value(), false);
+  EXPECT_EQ(lox::parse_number("0x10").has_value(), false);
+  EXPECT_EQ(lox::parse_number("1e100").has_value(), false);
+}
+
 TEST(Tokenizer, scan_identifier)
 {
   const std::string source = R"(
@@ -352,6 +377,7 @@ varFoo_1 = "abc";
 matched = true;
 )";
   auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
   const auto result = tokenizer.take_tokens();
   EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
 
@@ -360,83 +386,83 @@ matched = true;
 
   EXPECT_EQ(tokens[0].type, lox::TokenType::Identifier);
   EXPECT_EQ(tokens[0].lexeme, "a1");
-  EXPECT_EQ(tokens[0].line->number, 2);
-  EXPECT_EQ(tokens[0].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[0].line, 2);
+  EXPECT_EQ(tokens[0].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[1].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[1].lexeme, "=");
-  EXPECT_EQ(tokens[1].line->number, 2);
-  EXPECT_EQ(tokens[1].get_lexical_column(), 4);
+  EXPECT_EQ(tokens[1].line, 2);
+  EXPECT_EQ(tokens[1].get_lexical_column(lines), 4);
 
   EXPECT_EQ(tokens[2].type, lox::TokenType::Number);
   EXPECT_EQ(tokens[2].lexeme, "123");
-  EXPECT_EQ(tokens[2].line->number, 2);
-  EXPECT_EQ(tokens[2].get_lexical_column(), 6);
+  EXPECT_EQ(tokens[2].line, 2);
+  EXPECT_EQ(tokens[2].get_lexical_column(lines), 6);
 
   EXPECT_EQ(tokens[3].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[3].lexeme, ";");
-  EXPECT_EQ(tokens[3].line->number, 2);
-  EXPECT_EQ(tokens[3].get_lexical_column(), 9);
+  EXPECT_EQ(tokens[3].line, 2);
+  EXPECT_EQ(tokens[3].get_lexical_column(lines), 9);
 
   EXPECT_EQ(tokens[4].type, lox::TokenType::Identifier);
   EXPECT_EQ(tokens[4].lexeme, "_this");
-  EXPECT_EQ(tokens[4].line->number, 3);
-  EXPECT_EQ(tokens[4].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[4].line, 3);
+  EXPECT_EQ(tokens[4].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[5].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[5].lexeme, "=");
-  EXPECT_EQ(tokens[5].line->number, 3);
-  EXPECT_EQ(tokens[5].get_lexical_column(), 7);
+  EXPECT_EQ(tokens[5].line, 3);
+  EXPECT_EQ(tokens[5].get_lexical_column(lines), 7);
 
   EXPECT_EQ(tokens[6].type, lox::TokenType::Number);
   EXPECT_EQ(tokens[6].lexeme, "123.456");
-  EXPECT_EQ(tokens[6].line->number, 3);
-  EXPECT_EQ(tokens[6].get_lexical_column(), 9);
+  EXPECT_EQ(tokens[6].line, 3);
+  EXPECT_EQ(tokens[6].get_lexical_column(lines), 9);
 
   EXPECT_EQ(tokens[7].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[7].lexeme, ";");
-  EXPECT_EQ(tokens[7].line->number, 3);
-  EXPECT_EQ(tokens[7].get_lexical_column(), 16);
+  EXPECT_EQ(tokens[7].line, 3);
+  EXPECT_EQ(tokens[7].get_lexical_column(lines), 16);
 
   EXPECT_EQ(tokens[8].type, lox::TokenType::Identifier);
   EXPECT_EQ(tokens[8].lexeme, "varFoo_1");
-  EXPECT_EQ(tokens[8].line->number, 4);
-  EXPECT_EQ(tokens[8].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[8].line, 4);
+  EXPECT_EQ(tokens[8].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[9].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[9].lexeme, "=");
-  EXPECT_EQ(tokens[9].line->number, 4);
-  EXPECT_EQ(tokens[9].get_lexical_column(), 10);
+  EXPECT_EQ(tokens[9].line, 4);
+  EXPECT_EQ(tokens[9].get_lexical_column(lines), 10);
 
   EXPECT_EQ(tokens[10].type, lox::TokenType::String);
   EXPECT_EQ(tokens[10].lexeme, "abc");
-  EXPECT_EQ(tokens[10].line->number, 4);
-  EXPECT_EQ(tokens[10].get_lexical_column(), 13);
+  EXPECT_EQ(tokens[10].line, 4);
+  EXPECT_EQ(tokens[10].get_lexical_column(lines), 13);
 
   EXPECT_EQ(tokens[11].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[11].lexeme, ";");
-  EXPECT_EQ(tokens[11].line->number, 4);
-  EXPECT_EQ(tokens[11].get_lexical_column(), 17);
+  EXPECT_EQ(tokens[11].line, 4);
+  EXPECT_EQ(tokens[11].get_lexical_column(lines), 17);
 
   EXPECT_EQ(tokens[12].type, lox::TokenType::Identifier);
   EXPECT_EQ(tokens[12].lexeme, "matched");
-  EXPECT_EQ(tokens[12].line->number, 5);
-  EXPECT_EQ(tokens[12].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[12].line, 5);
+  EXPECT_EQ(tokens[12].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[13].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[13].lexeme, "=");
-  EXPECT_EQ(tokens[13].line->number, 5);
-  EXPECT_EQ(tokens[13].get_lexical_column(), 9);
+  EXPECT_EQ(tokens[13].line, 5);
+  EXPECT_EQ(tokens[13].get_lexical_column(lines), 9);
 
   EXPECT_EQ(tokens[14].type, lox::TokenType::True);
   EXPECT_EQ(tokens[14].lexeme, "true");
-  EXPECT_EQ(tokens[14].line->number, 5);
-  EXPECT_EQ(tokens[14].get_lexical_column(), 11);
+  EXPECT_EQ(tokens[14].line, 5);
+  EXPECT_EQ(tokens[14].get_lexical_column(lines), 11);
 
   EXPECT_EQ(tokens[15].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[15].lexeme, ";");
-  EXPECT_EQ(tokens[15].line->number, 5);
-  EXPECT_EQ(tokens[15].get_lexical_column(), 15);
+  EXPECT_EQ(tokens[15].line, 5);
+  EXPECT_EQ(tokens[15].get_lexical_column(lines), 15);
 }
 
 TEST(Tokenizer, scan_keyword)
@@ -447,6 +473,7 @@ cond2 = (false or false);
 cond3 = (cond1 and cond2);
 )";
   auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
   const auto result = tokenizer.take_tokens();
   EXPECT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
 
@@ -456,125 +483,441 @@ cond3 = (cond1 and cond2);
   auto base = 0;
   EXPECT_EQ(tokens[base + 0].type, lox::TokenType::Identifier);
   EXPECT_EQ(tokens[base + 0].lexeme, "cond1");
-  EXPECT_EQ(tokens[base + 0].line->number, 2);
-  EXPECT_EQ(tokens[base + 0].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[base + 0].line, 2);
+  EXPECT_EQ(tokens[base + 0].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[base + 1].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[base + 1].lexeme, "=");
-  EXPECT_EQ(tokens[base + 1].line->number, 2);
-  EXPECT_EQ(tokens[base + 1].get_lexical_column(), 7);
+  EXPECT_EQ(tokens[base + 1].line, 2);
+  EXPECT_EQ(tokens[base + 1].get_lexical_column(lines), 7);
 
   EXPECT_EQ(tokens[base + 2].type, lox::TokenType::LeftParen);
   EXPECT_EQ(tokens[base + 2].lexeme, "(");
-  EXPECT_EQ(tokens[base + 2].line->number, 2);
-  EXPECT_EQ(tokens[base + 2].get_lexical_column(), 9);
+  EXPECT_EQ(tokens[base + 2].line, 2);
+  EXPECT_EQ(tokens[base + 2].get_lexical_column(lines), 9);
 
   EXPECT_EQ(tokens[base + 3].type, lox::TokenType::True);
   EXPECT_EQ(tokens[base + 3].lexeme, "true");
-  EXPECT_EQ(tokens[base + 3].line->number, 2);
-  EXPECT_EQ(tokens[base + 3].get_lexical_column(), 10);
+  EXPECT_EQ(tokens[base + 3].line, 2);
+  EXPECT_EQ(tokens[base + 3].get_lexical_column(lines), 10);
 
   EXPECT_EQ(tokens[base + 4].type, lox::TokenType::And);
   EXPECT_EQ(tokens[base + 4].lexeme, "and");
-  EXPECT_EQ(tokens[base + 4].line->number, 2);
-  EXPECT_EQ(tokens[base + 4].get_lexical_column(), 15);
+  EXPECT_EQ(tokens[base + 4].line, 2);
+  EXPECT_EQ(tokens[base + 4].get_lexical_column(lines), 15);
 
   EXPECT_EQ(tokens[base + 5].type, lox::TokenType::True);
   EXPECT_EQ(tokens[base + 5].lexeme, "true");
-  EXPECT_EQ(tokens[base + 5].line->number, 2);
-  EXPECT_EQ(tokens[base + 5].get_lexical_column(), 19);
+  EXPECT_EQ(tokens[base + 5].line, 2);
+  EXPECT_EQ(tokens[base + 5].get_lexical_column(lines), 19);
 
   EXPECT_EQ(tokens[base + 6].type, lox::TokenType::RightParen);
   EXPECT_EQ(tokens[base + 6].lexeme, ")");
-  EXPECT_EQ(tokens[base + 6].line->number, 2);
-  EXPECT_EQ(tokens[base + 6].get_lexical_column(), 23);
+  EXPECT_EQ(tokens[base + 6].line, 2);
+  EXPECT_EQ(tokens[base + 6].get_lexical_column(lines), 23);
 
   EXPECT_EQ(tokens[base + 7].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[base + 7].lexeme, ";");
-  EXPECT_EQ(tokens[base + 7].line->number, 2);
-  EXPECT_EQ(tokens[base + 7].get_lexical_column(), 24);
+  EXPECT_EQ(tokens[base + 7].line, 2);
+  EXPECT_EQ(tokens[base + 7].get_lexical_column(lines), 24);
 
   base = 8;
   EXPECT_EQ(tokens[base + 0].type, lox::TokenType::Identifier);
   EXPECT_EQ(tokens[base + 0].lexeme, "cond2");
-  EXPECT_EQ(tokens[base + 0].line->number, 3);
-  EXPECT_EQ(tokens[base + 0].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[base + 0].line, 3);
+  EXPECT_EQ(tokens[base + 0].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[base + 1].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[base + 1].lexeme, "=");
-  EXPECT_EQ(tokens[base + 1].line->number, 3);
-  EXPECT_EQ(tokens[base + 1].get_lexical_column(), 7);
+  EXPECT_EQ(tokens[base + 1].line, 3);
+  EXPECT_EQ(tokens[base + 1].get_lexical_column(lines), 7);
 
   EXPECT_EQ(tokens[base + 2].type, lox::TokenType::LeftParen);
   EXPECT_EQ(tokens[base + 2].lexeme, "(");
-  EXPECT_EQ(tokens[base + 2].line->number, 3);
-  EXPECT_EQ(tokens[base + 2].get_lexical_column(), 9);
+  EXPECT_EQ(tokens[base + 2].line, 3);
+  EXPECT_EQ(tokens[base + 2].get_lexical_column(lines), 9);
 
   EXPECT_EQ(tokens[base + 3].type, lox::TokenType::False);
   EXPECT_EQ(tokens[base + 3].lexeme, "false");
-  EXPECT_EQ(tokens[base + 3].line->number, 3);
-  EXPECT_EQ(tokens[base + 3].get_lexical_column(), 10);
+  EXPECT_EQ(tokens[base + 3].line, 3);
+  EXPECT_EQ(tokens[base + 3].get_lexical_column(lines), 10);
 
   EXPECT_EQ(tokens[base + 4].type, lox::TokenType::Or);
   EXPECT_EQ(tokens[base + 4].lexeme, "or");
-  EXPECT_EQ(tokens[base + 4].line->number, 3);
-  EXPECT_EQ(tokens[base + 4].get_lexical_column(), 16);
+  EXPECT_EQ(tokens[base + 4].line, 3);
+  EXPECT_EQ(tokens[base + 4].get_lexical_column(lines), 16);
 
   EXPECT_EQ(tokens[base + 5].type, lox::TokenType::False);
   EXPECT_EQ(tokens[base + 5].lexeme, "false");
-  EXPECT_EQ(tokens[base + 5].line->number, 3);
-  EXPECT_EQ(tokens[base + 5].get_lexical_column(), 19);
+  EXPECT_EQ(tokens[base + 5].line, 3);
+  EXPECT_EQ(tokens[base + 5].get_lexical_column(lines), 19);
 
   EXPECT_EQ(tokens[base + 6].type, lox::TokenType::RightParen);
   EXPECT_EQ(tokens[base + 6].lexeme, ")");
-  EXPECT_EQ(tokens[base + 6].line->number, 3);
-  EXPECT_EQ(tokens[base + 6].get_lexical_column(), 24);
+  EXPECT_EQ(tokens[base + 6].line, 3);
+  EXPECT_EQ(tokens[base + 6].get_lexical_column(lines), 24);
 
   EXPECT_EQ(tokens[base + 7].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[base + 7].lexeme, ";");
-  EXPECT_EQ(tokens[base + 7].line->number, 3);
-  EXPECT_EQ(tokens[base + 7].get_lexical_column(), 25);
+  EXPECT_EQ(tokens[base + 7].line, 3);
+  EXPECT_EQ(tokens[base + 7].get_lexical_column(lines), 25);
 
   base = 16;
   EXPECT_EQ(tokens[base + 0].type, lox::TokenType::Identifier);
   EXPECT_EQ(tokens[base + 0].lexeme, "cond3");
-  EXPECT_EQ(tokens[base + 0].line->number, 4);
-  EXPECT_EQ(tokens[base + 0].get_lexical_column(), 1);
+  EXPECT_EQ(tokens[base + 0].line, 4);
+  EXPECT_EQ(tokens[base + 0].get_lexical_column(lines), 1);
 
   EXPECT_EQ(tokens[base + 1].type, lox::TokenType::Equal);
   EXPECT_EQ(tokens[base + 1].lexeme, "=");
-  EXPECT_EQ(tokens[base + 1].line->number, 4);
-  EXPECT_EQ(tokens[base + 1].get_lexical_column(), 7);
+  EXPECT_EQ(tokens[base + 1].line, 4);
+  EXPECT_EQ(tokens[base + 1].get_lexical_column(lines), 7);
 
   EXPECT_EQ(tokens[base + 2].type, lox::TokenType::LeftParen);
   EXPECT_EQ(tokens[base + 2].lexeme, "(");
-  EXPECT_EQ(tokens[base + 2].line->number, 4);
-  EXPECT_EQ(tokens[base + 2].get_lexical_column(), 9);
+  EXPECT_EQ(tokens[base + 2].line, 4);
+  EXPECT_EQ(tokens[base + 2].get_lexical_column(lines), 9);
 
   EXPECT_EQ(tokens[base + 3].type, lox::TokenType::Identifier);
   EXPECT_EQ(tokens[base + 3].lexeme, "cond1");
-  EXPECT_EQ(tokens[base + 3].line->number, 4);
-  EXPECT_EQ(tokens[base + 3].get_lexical_column(), 10);
+  EXPECT_EQ(tokens[base + 3].line, 4);
+  EXPECT_EQ(tokens[base + 3].get_lexical_column(lines), 10);
 
   EXPECT_EQ(tokens[base + 4].type, lox::TokenType::And);
   EXPECT_EQ(tokens[base + 4].lexeme, "and");
-  EXPECT_EQ(tokens[base + 4].line->number, 4);
-  EXPECT_EQ(tokens[base + 4].get_lexical_column(), 16);
+  EXPECT_EQ(tokens[base + 4].line, 4);
+  EXPECT_EQ(tokens[base + 4].get_lexical_column(lines), 16);
 
   EXPECT_EQ(tokens[base + 5].type, lox::TokenType::Identifier);
   EXPECT_EQ(tokens[base + 5].lexeme, "cond2");
-  EXPECT_EQ(tokens[base + 5].line->number, 4);
-  EXPECT_EQ(tokens[base + 5].get_lexical_column(), 20);
+  EXPECT_EQ(tokens[base + 5].line, 4);
+  EXPECT_EQ(tokens[base + 5].get_lexical_column(lines), 20);
 
   EXPECT_EQ(tokens[base + 6].type, lox::TokenType::RightParen);
   EXPECT_EQ(tokens[base + 6].lexeme, ")");
-  EXPECT_EQ(tokens[base + 6].line->number, 4);
-  EXPECT_EQ(tokens[base + 6].get_lexical_column(), 25);
+  EXPECT_EQ(tokens[base + 6].line, 4);
+  EXPECT_EQ(tokens[base + 6].get_lexical_column(lines), 25);
 
   EXPECT_EQ(tokens[base + 7].type, lox::TokenType::Semicolun);
   EXPECT_EQ(tokens[base + 7].lexeme, ";");
-  EXPECT_EQ(tokens[base + 7].line->number, 4);
-  EXPECT_EQ(tokens[base + 7].get_lexical_column(), 26);
+  EXPECT_EQ(tokens[base + 7].line, 4);
+  EXPECT_EQ(tokens[base + 7].get_lexical_column(lines), 26);
+}
+
+TEST(Tokenizer, keyword_type)
+{
+  const std::vector<std::pair<std::string, lox::TokenType>> keywords = {
+    {"and", lox::TokenType::And},       {"break", lox::TokenType::Break},
+    {"class", lox::TokenType::Class},   {"continue", lox::TokenType::Continue},
+    {"else", lox::TokenType::Else},     {"false", lox::TokenType::False},
+    {"fun", lox::TokenType::Fun},       {"for", lox::TokenType::For},
+    {"if", lox::TokenType::If},         {"nil", lox::TokenType::Nil},
+    {"or", lox::TokenType::Or},         {"print", lox::TokenType::Print},
+    {"return", lox::TokenType::Return}, {"super", lox::TokenType::Super},
+    {"this", lox::TokenType::This},     {"true", lox::TokenType::True},
+    {"var", lox::TokenType::Var},       {"while", lox::TokenType::While},
+  };
+  for (const auto & [keyword, type] : keywords) {
+    EXPECT_EQ(lox::keyword_type(keyword), type) << keyword;
+    EXPECT_TRUE(lox::is_keyword(keyword)) << keyword;
+
+    // scanned as a keyword
+    const auto result = lox::Tokenizer(keyword).take_tokens();
+    ASSERT_TRUE(lox::is_variant_v<lox::Tokens>(result)) << keyword;
+    const auto & tokens = lox::as_variant<lox::Tokens>(result);
+    ASSERT_EQ(tokens.size(), 1) << keyword;
+    EXPECT_EQ(tokens[0].type, type) << keyword;
+  }
+}
+
+TEST(Tokenizer, keyword_near_miss)
+{
+  // prefixes, extensions, different cases, and the words which share the first and last characters
+  // and the length with a keyword, so that they fall on the same slot of the hash table
+  const std::vector<std::string> identifiers = {
+    "a",    "an",     "andd",    "And",       "AND",     "brake",  "breaks", "klass",  "clas",
+    "cont", "contine", "continues", "els", "elsE",    "fals",   "falsee", "fn",     "funn",
+    "fOr",  "forr",   "fur",     "i",         "iff",     "in",     "nill",   "nul",    "o",
+    "orr",  "pront",  "printf",  "retrun",    "returns", "supper", "sum",    "thus",   "thiss",
+    "tree", "truee",  "vaR",     "vr",        "vor",     "whale",  "whilee", "w",      "_if",
+    "if_",  "",       "xxxxxxxxx",
+  };
+  for (const auto & identifier : identifiers) {
+    EXPECT_EQ(lox::keyword_type(identifier), std::nullopt) << identifier;
+    EXPECT_FALSE(lox::is_keyword(identifier)) << identifier;
+  }
+  for (const auto & identifier : identifiers) {
+    if (identifier.empty()) {
+      continue;
+    }
+    const auto result = lox::Tokenizer(identifier).take_tokens();
+    ASSERT_TRUE(lox::is_variant_v<lox::Tokens>(result)) << identifier;
+    const auto & tokens = lox::as_variant<lox::Tokens>(result);
+    ASSERT_EQ(tokens.size(), 1) << identifier;
+    EXPECT_EQ(tokens[0].type, lox::TokenType::Identifier) << identifier;
+    EXPECT_EQ(tokens[0].lexeme, identifier);
+  }
+}
+
+TEST(Tokenizer, scan_long_runs)
+{
+  // the runs of whitespaces and identifiers cross the boundaries of the 16/32 bytes chunks
+  const std::string identifier(70, 'a');
+  const std::string source = identifier + "_9" + std::string(40, ' ') + "\n\t\r\n" +
+                             std::string(33, '\n') + "  while" + std::string(17, ' ') + "12345" +
+                             "678901 // the comment at the end";
+  auto tokenizer = lox::Tokenizer(source);
+  const auto lines = lox::LineTable(source);
+  const auto result = tokenizer.take_tokens();
+  ASSERT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
+
+  const auto & tokens = lox::as_variant<lox::Tokens>(result);
+  ASSERT_EQ(tokens.size(), 3);
+  EXPECT_EQ(tokens[0].type, lox::TokenType::Identifier);
+  EXPECT_EQ(tokens[0].lexeme, identifier + "_9");
+  EXPECT_EQ(tokens[0].line, 1);
+  EXPECT_EQ(tokens[1].type, lox::TokenType::While);
+  EXPECT_EQ(tokens[1].line, 36);
+  EXPECT_EQ(tokens[1].get_lexical_column(lines), 3);
+  EXPECT_EQ(tokens[2].type, lox::TokenType::Number);
+  EXPECT_EQ(tokens[2].lexeme, "12345678901");
+  EXPECT_EQ(tokens[2].line, 36);
+}
+
+TEST(Tokenizer, scan_invalid_character)
+{
+  const std::vector<std::string> sources = {
+    "var a = 1; @", "var \xc3\xa9 = 1;", std::string("a\0b", 3)};
+  for (const auto & source : sources) {
+    auto tokenizer = lox::Tokenizer(source);
+    const auto result = tokenizer.take_tokens();
+    ASSERT_EQ(lox::is_variant_v<lox::SyntaxError>(result), true);
+    EXPECT_EQ(
+      lox::as_variant<lox::SyntaxError>(result).kind, lox::SyntaxErrorKind::InvalidCharacterError);
+  }
+}
+
+TEST(Tokenizer, next_token)
+{
+  const std::string source = "var a = 1; // comment\nprint a;";
+  auto tokenizer = lox::Tokenizer(source);
+  const auto expected = lox::as_variant<lox::Tokens>(lox::Tokenizer(source).take_tokens());
+  for (const auto & token : expected) {
+    const auto result = tokenizer.next_token();
+    ASSERT_TRUE(lox::is_variant_v<std::optional<lox::Token>>(result));
+    EXPECT_EQ(lox::as_variant<std::optional<lox::Token>>(result), token);
+  }
+  for (size_t i = 0; i < 2; ++i) {
+    const auto result = tokenizer.next_token();
+    ASSERT_TRUE(lox::is_variant_v<std::optional<lox::Token>>(result));
+    EXPECT_EQ(lox::as_variant<std::optional<lox::Token>>(result), std::nullopt);
+  }
+}
+
+TEST(TokenStream, peek_and_advance)
+{
+  const std::string source = "var abc = (1 + 2) * 3;\nprint abc;";
+  const auto expected = lox::as_variant<lox::Tokens>(lox::Tokenizer(source).take_tokens());
+  ASSERT_EQ(expected.size(), 14);
+
+  auto stream = lox::TokenStream(source);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    // look ahead as far as the ring buffer allows, across its wraparound
+    for (size_t k = 0; k < lox::TokenStream::Lookahead; ++k) {
+      if (i + k < expected.size()) {
+        EXPECT_EQ(stream.peek(k), expected[i + k]);
+      } else {
+        EXPECT_EQ(stream.peek(k).type, lox::TokenType::Eof);
+      }
+    }
+    EXPECT_EQ(stream.advance(), expected[i]);
+  }
+  // EOF is right after the last token on its line, and is never consumed
+  for (size_t i = 0; i < 3; ++i) {
+    const auto eof = stream.advance();
+    EXPECT_EQ(eof.type, lox::TokenType::Eof);
+    EXPECT_EQ(eof.line, 2);
+    EXPECT_EQ(eof.lexeme.data(), source.data() + source.size());
+  }
+  EXPECT_FALSE(stream.error().has_value());
+}
+
+TEST(TokenStream, same_as_replayed_tokens)
+{
+  const std::string source = R"(
+fun fib(n) {
+  if (n < 2) { return n; } // base case
+  return fib(n - 1) + fib(n - 2);
+}
+print fib(10) >= 55 and "ok" != nil;
+)";
+  auto stream = lox::TokenStream(source);
+  auto tokens = lox::as_variant<lox::Tokens>(lox::Tokenizer(source).take_tokens());
+  auto replayed = lox::TokenStream(std::move(tokens));
+  for (;;) {
+    const auto token = stream.advance();
+    EXPECT_EQ(token, replayed.advance());
+    if (token.type == lox::TokenType::Eof) {
+      break;
+    }
+  }
+}
+
+TEST(TokenStream, empty_source)
+{
+  const std::string source = "  // nothing but a comment\n";
+  auto stream = lox::TokenStream(source);
+  EXPECT_EQ(stream.peek().type, lox::TokenType::Eof);
+  EXPECT_EQ(stream.peek().line, 1);
+  EXPECT_FALSE(stream.drain().has_value());
+}
+
+TEST(TokenStream, error)
+{
+  const std::string source = "var a = 1;\nvar b = a @ 2;\nvar c = 3;";
+  auto stream = lox::TokenStream(source);
+  // the tokens before the invalid character are yielded, and then EOF
+  for (const auto * lexeme : {"var", "a", "=", "1", ";", "var", "b", "=", "a"}) {
+    EXPECT_EQ(stream.advance().lexeme, lexeme);
+  }
+  EXPECT_EQ(stream.peek().type, lox::TokenType::Eof);
+  ASSERT_TRUE(stream.error().has_value());
+  EXPECT_EQ(stream.error()->kind, lox::SyntaxErrorKind::InvalidCharacterError);
+  EXPECT_EQ(stream.error()->line, 2);
+
+  // drain() finds the error even if it is not reached yet
+  auto drained = lox::TokenStream(source);
+  EXPECT_EQ(drained.advance().lexeme, "var");
+  EXPECT_FALSE(drained.error().has_value());
+  ASSERT_TRUE(drained.drain().has_value());
+  EXPECT_EQ(drained.error()->kind, lox::SyntaxErrorKind::InvalidCharacterError);
+}
+
+namespace
+{
+/**
+ * @brief a large source whose lines are either code, comments with '"' or strings over multiple
+ * lines, so that some chunk boundaries fall into a string or a comment
+ */
+std::string large_source(const size_t n_lines)
+{
+  std::string source;
+  for (size_t i = 0; i < n_lines; ++i) {
+    switch (i % 5) {
+      case 0:
+        source += "var x" + std::to_string(i) + " = " + std::to_string(i) + ".5 * (y + 1);\n";
+        break;
+      case 1:
+        source += "// a comment with \" and // inside " + std::to_string(i) + "\n";
+        break;
+      case 2:
+        source += "print \"a string\n\nover lines // not a comment\n\";\n";
+        break;
+      case 3:
+        source += "\n\n  if (a >= b and c != d) { return nil; } else { e = f / g; }\n";
+        break;
+      default:
+        source += "fun f" + std::to_string(i) + "(a, b) { while (true) { break; } }";
+        source += std::string(i % 7, ' ') + "\n";
+    }
+  }
+  return source;
+}
+
+/**
+ * @brief check if take_tokens_parallel() returns the same tokens or the same error as Tokenizer
+ */
+void expect_same_as_sequential(const std::string & source, const size_t n_threads)
+{
+  const auto expected = lox::Tokenizer(source).take_tokens();
+  const auto result = lox::take_tokens_parallel(source, n_threads);
+  ASSERT_EQ(lox::is_variant_v<lox::Tokens>(result), lox::is_variant_v<lox::Tokens>(expected));
+  if (lox::is_variant_v<lox::SyntaxError>(expected)) {
+    const auto & err = lox::as_variant<lox::SyntaxError>(result);
+    const auto & expected_err = lox::as_variant<lox::SyntaxError>(expected);
+    EXPECT_EQ(err.kind, expected_err.kind);
+    EXPECT_EQ(err.line, expected_err.line);
+    EXPECT_EQ(err.ctx.data(), expected_err.ctx.data());
+    EXPECT_EQ(err.ctx.size(), expected_err.ctx.size());
+    return;
+  }
+  const auto & tokens = lox::as_variant<lox::Tokens>(result);
+  const auto & expected_tokens = lox::as_variant<lox::Tokens>(expected);
+  ASSERT_EQ(tokens.size(), expected_tokens.size());
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    ASSERT_EQ(tokens[i], expected_tokens[i]) << i;
+    ASSERT_EQ(tokens[i].line, expected_tokens[i].line) << i;
+  }
+}
+}  // namespace
+
+TEST(Tokenizer, take_tokens_parallel)
+{
+  const auto source = large_source(50000);
+  ASSERT_GT(source.size(), 1024 * 1024);
+  ASSERT_TRUE(lox::is_variant_v<lox::Tokens>(lox::Tokenizer(source).take_tokens()));
+  for (const size_t n_threads : {1, 2, 3, 8}) {
+    SCOPED_TRACE(n_threads);
+    expect_same_as_sequential(source, n_threads);
+  }
+}
+
+TEST(Tokenizer, take_tokens_parallel_error)
+{
+  const auto base = large_source(50000);
+  const std::vector<std::string> sources = {
+    // an invalid character in the middle
+    base + "var z = @;\n" + base,
+    // an unterminated string at the end
+    base + base + "print \"abc\n",
+    // a '"' in the middle, which turns the strings after it inside out
+    base + "print \"abc\n" + base,
+    // an invalid character before an unterminated string
+    base.substr(0, base.size() / 3) + "\n@\n" + base.substr(base.size() / 3) + "\"abc",
+  };
+  for (const auto & source : sources) {
+    SCOPED_TRACE(source.size());
+    expect_same_as_sequential(source, 4);
+  }
+  ASSERT_TRUE(lox::is_variant_v<lox::SyntaxError>(lox::Tokenizer(sources[0]).take_tokens()));
+  ASSERT_TRUE(lox::is_variant_v<lox::SyntaxError>(lox::Tokenizer(sources[1]).take_tokens()));
+}
+
+TEST(Tokenizer, token_size)
+{
+  // the lexeme, the line number and the type
+  EXPECT_LE(sizeof(lox::Token), 24);
+}
+
+TEST(Tokenizer, line_table)
+{
+  const std::string source = "var a = 1;\n\n  print a;\nprint \"a\nb\";";
+  const auto lines = lox::LineTable(source, "main.lox");
+  EXPECT_EQ(lines.filename().value(), "main.lox");
+  EXPECT_EQ(lines.line_count(), 5);
+  EXPECT_EQ(lines.start_index(1), 0);
+  EXPECT_EQ(lines.end_index(1), 10);
+  EXPECT_EQ(lines.start_index(2), 11);
+  EXPECT_EQ(lines.end_index(2), 11);
+  EXPECT_EQ(lines.start_index(3), 12);
+  EXPECT_EQ(lines.end_index(5), source.size() - 1);
+  EXPECT_EQ(lines.line_number(0), 1);
+  EXPECT_EQ(lines.line_number(10), 1);
+  EXPECT_EQ(lines.line_number(11), 2);
+  EXPECT_EQ(lines.line_number(14), 3);
+  EXPECT_EQ(lines.column(14), 3);
+
+  auto tokenizer = lox::Tokenizer(source);
+  const auto result = tokenizer.take_tokens();
+  const auto & tokens = lox::as_variant<lox::Tokens>(result);
+  ASSERT_EQ(tokens.size(), 11);
+  // print a;
+  EXPECT_EQ(tokens[5].line, 3);
+  EXPECT_EQ(tokens[5].get_lexical_column(lines), 3);
+  EXPECT_EQ(lines.line_number(tokens[5].get_start_index(lines)), 3);
+  // the string token belongs to the line where it starts
+  EXPECT_EQ(tokens[9].line, 4);
+  EXPECT_EQ(tokens[9].get_lexical_column(lines), 8);
 }
 
 int main(int argc, char ** argv)
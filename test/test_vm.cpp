@@ -0,0 +1,161 @@
+#include <cpplox/debug.hpp>
+#include <cpplox/interpreter.hpp>
+#include <cpplox/parser.hpp>
+#include <cpplox/tokenizer.hpp>
+#include <cpplox/vm.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/**
+ * @brief run `source` on both the tree-walking interpreter and the VM, and check that they agree
+ * on the error kind and the final values of the given global variables
+ */
+static void expect_same_result(const std::string & source, const std::vector<std::string> & names)
+{
+  auto tokenizer = lox::Tokenizer(source);
+  const auto result = tokenizer.take_tokens();
+  ASSERT_EQ(lox::is_variant_v<lox::Tokens>(result), true);
+  const auto & tokens = lox::as_variant<lox::Tokens>(result);
+
+  auto parser = lox::Parser(tokens);
+  const auto parse_result = parser.program();
+  ASSERT_EQ(lox::is_variant_v<lox::Program>(parse_result), true);
+  const auto & program = lox::as_variant<lox::Program>(parse_result);
+
+  lox::Interpreter interpreter{};
+  const auto tree_err = interpreter.execute(program);
+  lox::vm::VM vm{};
+  const auto vm_err = vm.execute(program);
+
+  ASSERT_EQ(tree_err.has_value(), vm_err.has_value()) << source;
+  if (tree_err) {
+    EXPECT_EQ(tree_err.value().index(), vm_err.value().index()) << source;
+  }
+
+  for (const auto & name : names) {
+    const auto it = std::find_if(tokens.begin(), tokens.end(), [&](const auto & token) {
+      return token.lexeme == name;
+    });
+    ASSERT_NE(it, tokens.end());
+    const auto tree_value = interpreter.get_variable(*it);
+    const auto vm_value = vm.get_variable(*it);
+    ASSERT_EQ(tree_value.has_value(), vm_value.has_value()) << name;
+    if (tree_value) {
+      EXPECT_EQ(lox::stringify(tree_value.value()), lox::vm::stringify(vm_value.value())) << name;
+    }
+  }
+}
+
+TEST(VM, arithmetic)
+{
+  expect_same_result(
+    R"(
+var a = 1 + 2 * 3 - 4 / 2;
+var b = 1.5 * 2;
+var c = 7 / 2;
+var d = -a + 10;
+var e = "Hello" + " " + "World";
+var f = (1 < 2) == !(3 >= 4);
+var g = 1 == 1.0;
+var h = nil or 10;
+)",
+    {"a", "b", "c", "d", "e", "f", "g", "h"});
+}
+
+TEST(VM, scope_and_control_flow)
+{
+  expect_same_result(
+    R"(
+var a = 0;
+var b = 0;
+{
+  var a = 10;
+  b = a;
+}
+var sum = 0;
+for (var i = 0; i < 10; i = i + 1) {
+  if (i == 5) {
+    continue;
+  } else if (i == 8) {
+    break;
+  }
+  sum = sum + i;
+}
+var n = 0;
+while (n < 100) {
+  var tmp = n;
+  n = tmp + 3;
+}
+)",
+    {"a", "b", "sum", "n"});
+}
+
+TEST(VM, closure)
+{
+  expect_same_result(
+    R"(
+fun make_counter() {
+  var count = 0;
+  fun counter() {
+    count = count + 1;
+    return count;
+  }
+  return counter;
+}
+var counter = make_counter();
+counter();
+counter();
+var a = counter();
+
+fun fib(n) {
+  if (n < 2) {
+    return n;
+  }
+  return fib(n - 1) + fib(n - 2);
+}
+var b = fib(15);
+)",
+    {"a", "b"});
+}
+
+TEST(VM, class)
+{
+  expect_same_result(
+    R"(
+class Foo {
+  fun bar(a) {
+    return a + " from Foo::bar";
+  }
+}
+var foo = Foo();
+foo.x = 10;
+var a = foo.x;
+var b = foo.bar("Hello");
+var c = Foo;
+)",
+    {"a", "b", "c"});
+}
+
+TEST(VM, runtime_error)
+{
+  expect_same_result("var a = 1 + \"2\";", {});
+  expect_same_result("var a = -\"2\";", {});
+  expect_same_result("var a = 10; a = b;", {"a"});
+  expect_same_result("var a = 10; a();", {"a"});
+  expect_same_result("fun foo(a) { return a; } foo(1, 2);", {});
+  expect_same_result("fun foo() { print 1; } foo();", {});
+  expect_same_result("var a = 10; a.b = 10;", {});
+  expect_same_result("class Foo {} var foo = Foo(); var a = foo.b;", {});
+  expect_same_result("var a = 0; while (true) { a = a + 1; }", {"a"});
+  expect_same_result("var a = 0; { var a = a; }", {"a"});
+}
+
+int main(int argc, char ** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}